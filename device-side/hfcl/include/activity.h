@@ -30,6 +30,7 @@
 #include "activity/activitystack.h"
 #include "activity/baseactivity.h"
 #include "activity/controller.h"
+#include "activity/eventqueue.h"
 #include "activity/intent.h"
 #include "activity/window.h"
 
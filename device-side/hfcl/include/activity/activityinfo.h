@@ -23,12 +23,14 @@
 #define HFCL_ACTIVITY_ACTIVITYINFO_H_
 
 #include "../common/common.h"
+#include "../common/smallalloc.h"
 //#include "../common/contextstream.h"
 #include "baseactivity.h"
 
 namespace hfcl {
 
 class ActivityInfo {
+    HFCL_POOLED_CLASS
 public:
     ActivityInfo();
     ActivityInfo(utf8string name, BaseActivity* act, ContextStream* cs);
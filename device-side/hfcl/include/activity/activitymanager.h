@@ -29,6 +29,7 @@
 #include "../common/stlalternative.h"
 #include "../activity/intent.h"
 #include "../activity/activitystack.h"
+#include "../activity/eventqueue.h"
 
 namespace hfcl {
 
@@ -49,6 +50,8 @@ class ActivityManager
 {
 public:
     MAPCLASSKEY(utf8string, ActivityFactory*, ActivityFactoryMap);
+    // the preloadable activities; NULL if not preloaded yet
+    MAPCLASSKEY(utf8string, BaseActivity*, PreloadedActivityMap);
     PAIR(utf8string, ActivityFactory*, ActivityFactoryPair);
 
     ActivityManager() : m_hostingWnd(HWND_INVALID) { init(); }
@@ -67,7 +70,21 @@ public:
     int actNumOnRun() { return m_actstack.size(); }
     const ActivityFactoryMap& actlications() const { return m_acts; }
 
-    void registerActivity(utf8string name, ActivityFactory *actFactory);
+    /***
+     * register an activity
+     *
+     * A preloadable activity is created, and gets onCreate(NULL, NULL)
+     * with its window hidden, when the UI loop is idle; startActivity
+     * then only shows it and passes the intent to onNewIntent. It is
+     * preloaded again after it exits.
+     ***/
+    void registerActivity(utf8string name, ActivityFactory *actFactory,
+            bool preload = false);
+    // preloads one activity; returns false if there is nothing to preload
+    bool preloadActivity();
+    // destroys the preloaded activities which are not started yet; run()
+    // calls this when the loop ends
+    void destroyPreloadedActivities();
 
     bool actIsExist(BaseActivity *obj);
     bool actIsExist(const char * actName);
@@ -113,6 +130,15 @@ public:
     void startTimerService();
     void stopTimerService();
 
+    /***
+     * post an event to the UI thread from any thread
+     *
+     * The event is delivered by run() in the UI thread, and then
+     * released. Posting does not lock or allocate.
+     ***/
+    void postEvent(PostedEvent* event) { m_eventQueue.post(event); }
+    EventQueue* eventQueue() { return &m_eventQueue; }
+
     void freezeChar(bool f) { m_charFreezon = f; }
     bool isCharFreezon() {return m_charFreezon; }
 
@@ -121,6 +147,7 @@ public:
 
 private:
     bool init();
+    BaseActivity* takePreloadedActivity(const utf8string& name);
     static LRESULT defaultHostingProc(HWND hWnd, UINT message,
             WPARAM wParam, LPARAM lParam);
 
@@ -129,9 +156,11 @@ private:
     static ActivityManager* s_actManager;
 
     ActivityFactoryMap m_acts;
+    PreloadedActivityMap m_preloaded;
     KeyHookCallback m_key_hook;
     bool m_charFreezon;
     int  m_disableLockTick;
+    EventQueue m_eventQueue;
 };
 
 } // namespace hfcl
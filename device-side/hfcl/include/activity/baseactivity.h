@@ -72,6 +72,8 @@ public:
     virtual void onSleep(){}
     virtual void onWakeup(){}
     virtual void onMove2Top() {}
+    // called instead of onCreate when a preloaded activity is started
+    virtual void onNewIntent(Intent *intent) {}
     virtual Intent *onDestroy(ContextStream *contextStream) {
         return NULL;
     }
@@ -80,6 +82,7 @@ public:
     virtual void exit() { close(); }
 
 protected:
+    friend class ActivityManager;
     virtual Window *getWindow() { return NULL; }
 
     char * m_name;
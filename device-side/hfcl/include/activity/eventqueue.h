@@ -0,0 +1,205 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HFCL_ACTIVITY_EVENTQUEUE_H_
+#define HFCL_ACTIVITY_EVENTQUEUE_H_
+
+#include <new>
+
+#include "../mgcl/mgcl.h"
+#include "../common/common.h"
+#include "../common/event.h"
+
+namespace hfcl {
+
+// TUNNING CONDITION: the number of events in a PostedEventPool
+#define EVENTQUEUE_DEFAULT_POOL_SIZE    64
+
+class EventPool;
+
+/*
+ * An event posted from any thread to the UI thread. The poster fills
+ * the event in, posts it to an EventQueue, and does not touch it any
+ * more; the UI thread calls deliver() and then release().
+ */
+class PostedEvent {
+public:
+    PostedEvent() : m_next(NULL), m_pool(NULL), m_postTime(0) { }
+    virtual ~PostedEvent() { }
+
+    // called in the UI thread
+    virtual void deliver() = 0;
+    // destroys the event and gives its memory back to the pool
+    void release();
+
+private:
+    friend class EventQueue;
+    template <class T> friend class PostedEventPool;
+
+    PostedEvent* m_next;
+    EventPool* m_pool;
+    // the time of posting, in microseconds
+    unsigned long long m_postTime;
+};
+
+/*
+ * A fixed number of memory blocks for the posted events. allocBlock() and
+ * freeBlock() can be called from any thread; they do not lock, and do not
+ * call malloc once the pool is created.
+ */
+class EventPool {
+public:
+    EventPool(size_t eventSize, int nrEvents);
+    ~EventPool();
+
+    // returns NULL if all blocks are used
+    void* allocBlock();
+    void freeBlock(void* block);
+
+    int capacity() const { return m_nrBlocks; }
+    // the number of times allocBlock() found the pool empty
+    unsigned int misses() const {
+        return __atomic_load_n(&m_misses, __ATOMIC_RELAXED);
+    }
+
+private:
+    Uint8* m_blocks;
+    // the index + 1 of the next free block, 0 for the end
+    Uint16* m_next;
+    size_t m_blockSize;
+    int m_nrBlocks;
+    // the index + 1 of the first free block in the low 16 bits, and a
+    // tag changed by each update in the high 16 bits against ABA
+    Uint32 m_free;
+    unsigned int m_misses;
+};
+
+/*
+ * The pool of the posted events of type T, which must have a default
+ * constructor. If the pool is empty, get() creates the event on the
+ * heap.
+ */
+template <class T>
+class PostedEventPool : public EventPool {
+public:
+    PostedEventPool(int nrEvents = EVENTQUEUE_DEFAULT_POOL_SIZE)
+        : EventPool(sizeof(T), nrEvents) { }
+
+    T* get() {
+        void* block = allocBlock();
+        if (block == NULL)
+            return HFCL_NEW_EX(T, ());
+
+        T* event = new (block) T();
+        event->m_pool = this;
+        return event;
+    }
+};
+
+/*
+ * Raises a UserEvent on the target in the UI thread. The target must
+ * live until the event is delivered.
+ */
+class PostedUserEvent : public PostedEvent {
+public:
+    PostedUserEvent() : m_target(NULL), m_type(0), m_param(0), m_exParam(0) { }
+
+    void set(EventBroadcaster* target, int type, HTData param,
+            HTData exParam = 0) {
+        m_target = target;
+        m_type = type;
+        m_param = param;
+        m_exParam = exParam;
+    }
+
+    virtual void deliver();
+
+private:
+    EventBroadcaster* m_target;
+    int m_type;
+    HTData m_param;
+    HTData m_exParam;
+};
+
+/*
+ * The queue of the events posted to the UI thread.
+ *
+ * It is an intrusive multi-producer, single-consumer queue: post() links
+ * the event with one atomic exchange and never blocks or allocates. The
+ * first post after a drain wakes the UI loop with a single
+ * MGCL_MSG_POSTEDEVENTS message; the following posts only link their
+ * events until the UI thread drains the queue.
+ */
+class EventQueue {
+public:
+    struct Stats {
+        unsigned int delivered;
+        unsigned int drains;
+        int maxDepth;
+        // the time from post to delivery, in microseconds
+        unsigned int lastLatency;
+        unsigned int maxLatency;
+        unsigned long long totalLatency;
+    };
+
+    EventQueue();
+    // releases the events not delivered
+    ~EventQueue();
+
+    void setWakeupWindow(HWND hwnd) { m_hwnd = hwnd; }
+
+    // any thread
+    void post(PostedEvent* event);
+    // the number of events posted but not delivered yet
+    int depth() const { return __atomic_load_n(&m_depth, __ATOMIC_RELAXED); }
+
+    // the UI thread; returns the number of events delivered
+    int drain();
+
+    const Stats& stats() const { return m_stats; }
+    void resetStats();
+    void dumpStats();
+
+private:
+    class StubEvent : public PostedEvent {
+    public:
+        virtual void deliver() { }
+    };
+
+    void push(PostedEvent* event);
+    PostedEvent* pop();
+
+    // the producers link the events at the head
+    PostedEvent* m_head;
+    // the consumer takes the events from the tail
+    PostedEvent* m_tail;
+    StubEvent m_stub;
+
+    int m_depth;
+    // 1 if the wakeup message is posted but the queue is not drained
+    int m_wakeup;
+    HWND m_hwnd;
+    Stats m_stats;
+};
+
+} // namespace hfcl
+
+#endif /* HFCL_ACTIVITY_EVENTQUEUE_H_ */
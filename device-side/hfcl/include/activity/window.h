@@ -59,6 +59,9 @@ public:
 
     void show(bool updateBg = true);
     void hide();
+    // makes create() make the main window hidden, whatever it is asked;
+    // used to preload an activity without flashing it on the screen
+    void setCreateHidden(bool hidden) { m_createHidden = hidden; }
     void destroy();
 
     HWND getSysWindow() const { return m_sysWnd; }
@@ -70,6 +73,19 @@ public:
     void updateWindow(bool updateBg = true);
     void asyncUpdateRect(int x, int y, int w, int h, bool updateBg = true);
     void syncUpdateRect(int x, int y, int w, int h, bool updateBg = true);
+    // moves the pixels in the rect by (dx, dy) with one blit, and
+    // invalidates only the part of the rect which is exposed
+    void scrollRect(const IntRect& rc, int dx, int dy);
+    // paints the invalid part of the window now
+    void flushUpdates();
+
+    // keeps a copy of the pixels of the client area
+    bool takeSnapshot();
+    // shows the window with the pixels of the snapshot at once, and drops
+    // the snapshot; the views are painted over it as usual
+    bool showSnapshot();
+    void dropSnapshot();
+    bool hasSnapshot() const { return m_snapshot != HDC_INVALID; }
 
     unsigned int doModalView();
 
@@ -97,6 +113,8 @@ public:
 protected:
     HWND m_sysWnd;
     RootView* m_rootView;
+    HDC m_snapshot;
+    bool m_createHidden;
 
     LRESULT commWindowProc(HWND hWnd, UINT message,
             WPARAM wParam, LPARAM lParam);
@@ -23,10 +23,17 @@
 
 #include "mgcl/mgcl.h"
 #include "common/object.h"
+#include "services/framescheduler.h"
 
 namespace hfcl {
 
-class Animation : public Object
+/*
+ * The values computed by mGEff are not set to the target at once; the
+ * last value of each animation is set in the next frame of the
+ * FrameScheduler, together with the values of the other animations, so
+ * that a frame is painted once however many animations run.
+ */
+class Animation : public Object, public FrameClient
 {
     friend class GroupAnimation;
 
@@ -87,10 +94,26 @@ class Animation : public Object
         virtual void setProperty(int id, void *curvalue) = 0;
         static void _setProperty(MGEFF_ANIMATION handle, void *target, int id, void *value);
         virtual void onStart(){};
+        // sets the pending value to the target
+        virtual bool onFrame(Uint32 ticks);
+        // sets the pending value at once; the destructors of the
+        // subclasses call this, as ~Animation can not call setProperty()
+        void applyPendingValue();
+        void dropPendingValue();
 
 
     private:
         bool m_stop_in_progress;
+
+        // the size of the value, or 0 to set the values at once
+        int m_value_size;
+        bool m_value_pending;
+        int m_pending_id;
+        union {
+            double d;
+            RECT rc;
+            Uint8 bytes[32];
+        } m_pending_value;
 };
 
 } // namespace hfcl
@@ -32,6 +32,7 @@ class MoveViewAnimation : public ViewAnimation
     public:
         /*param pt is target point.*/
         MoveViewAnimation(View *view, Point pt);
+        ~MoveViewAnimation();
 
         /*set start value.*/
         void onStart();
@@ -34,7 +34,7 @@ class ScaleViewAnimation  : public ViewAnimation
             setEndValue((void *)&rect);
         }
         virtual ~ScaleViewAnimation(){
-
+            applyPendingValue();
         }
 
     protected:
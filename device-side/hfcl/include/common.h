@@ -31,6 +31,8 @@
 #include "common/methodeventlistener.h"
 #include "common/helpers.h"
 #include "common/log.h"
+#include "common/textbuffer.h"
+#include "common/smallalloc.h"
 
 #endif // HFCL_COMMON_H_
 
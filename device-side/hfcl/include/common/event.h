@@ -28,6 +28,7 @@
 #include "../common/common.h"
 #include "../common/stlalternative.h"
 #include "../common/object.h"
+#include "../common/smallalloc.h"
 
 // GOON_DISPATCH to continue dispatching the event;
 // STOP_DISPATCH to stop dispatching the event.
@@ -37,6 +38,7 @@
 namespace hfcl {
 
 class Event {
+    HFCL_POOLED_CLASS
 public:
     enum EventType {
         ET_KEY,
@@ -323,12 +325,61 @@ protected:
     EventListener(int start_ref) : RefCount(start_ref) { }
 };
 
+/*
+ * A compact array of event listeners which may be changed while the
+ * listeners are called.
+ *
+ * raise() calls the listeners present when it starts; they are read
+ * by index from the array, so dispatching does not allocate. A listener
+ * removed during a dispatch is set to NULL at once and so not called
+ * any more; the array is compacted when the outermost dispatch ends.
+ * A listener added during a dispatch is appended and gets the next
+ * event. Any number of listeners can be added or removed, even by
+ * nested dispatches.
+ */
+class EventListenerArray {
+public:
+    // refs: whether the array holds a reference to its listeners
+    // newestFirst: whether raise() calls the last added listener first
+    EventListenerArray(bool refs, bool newestFirst);
+    ~EventListenerArray();
+
+    void add(EventListener* listener);
+    // removes all occurrences of the listener
+    void remove(EventListener* listener);
+    void clear();
+
+    // the number of listeners not removed
+    int size() const { return m_count - m_nrRemoved; }
+    // changes with each add or remove
+    unsigned int version() const { return m_version; }
+
+    // returns true if a listener handled the event; stops at the first
+    // one which handled the event if stopOnHandled
+    bool raise(Event* event, bool stopOnHandled);
+
+private:
+    void compact();
+    void release(EventListener* listener);
+
+    EventListener** m_items;
+    int m_count;
+    int m_capacity;
+    int m_nrRemoved;
+    // the removed listeners to unref once the outermost raise() ends
+    EventListener** m_released;
+    int m_nrReleased;
+    int m_releasedCapacity;
+    // the depth of the nested raise() calls
+    int m_raising;
+    unsigned int m_version;
+    bool m_refs;
+    bool m_newestFirst;
+};
+
 class EventBroadcaster {
 public:
-    EventBroadcaster() {
-        m_current_raise = NULL;
-        m_want_to_remove = NULL;
-    }
+    EventBroadcaster() : m_listeners(false, false) { }
     virtual ~EventBroadcaster() {
         releaseEventListeners();
     }
@@ -344,11 +395,7 @@ protected:
     // notice : dont unref for these event listeners
     // becuase the add interface haven't add the reference
     //
-    LIST(EventListener *, EventListenerList);
-    EventListenerList m_listeners;
-
-    EventListener* m_current_raise;
-    EventListener* m_want_to_remove;
+    EventListenerArray m_listeners;
 };
 
 } // namespace hfcl
@@ -0,0 +1,91 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HFCL_COMMON_SMALLALLOC_H_
+#define HFCL_COMMON_SMALLALLOC_H_
+
+#include "../common/common.h"
+
+namespace hfcl {
+
+// TUNNING CONDITION: the size of a slab; must be a power of 2
+#define SMALLALLOC_SLAB_SIZE        16384
+// TUNNING CONDITION: the number of empty slabs kept by each size class
+#define SMALLALLOC_SPARE_SLABS      1
+
+/*
+ * SmallAllocator allocates the small objects of HFCL by size classes.
+ *
+ * The objects of a size class are cut from slabs of SMALLALLOC_SLAB_SIZE
+ * bytes, aligned to their size, so the slab of an object is found from
+ * its address. A slab only holds objects of one size, and it is given
+ * back to the system once all of its objects are freed; a device which
+ * creates and destroys views for days does not scatter small holes over
+ * the heap. The objects larger than the largest class, and all objects
+ * while the allocator is disabled, come from malloc.
+ *
+ * The allocator is thread-safe. It is enabled if HFCL is configured with
+ * --enable-smallalloc, or by setEnabled(true); the objects allocated
+ * before switching can be freed after switching.
+ */
+class SmallAllocator {
+public:
+    struct ClassStats {
+        // the size of the objects; 0 for the objects from malloc
+        size_t size;
+        unsigned int live;
+        unsigned int peak;
+        unsigned int slabs;
+        unsigned long long allocs;
+        // the bytes of the slabs not used by live objects, in percent
+        int fragmentation;
+    };
+
+    static void* alloc(size_t size);
+    static void release(void* p);
+
+    static bool isEnabled();
+    static void setEnabled(bool enabled);
+
+    // the number of size classes, and one more for the objects from malloc
+    static int nrClasses();
+    static bool getClassStats(int index, ClassStats* stats);
+    // logs the stats of the size classes through Log::logMemory
+    static void dumpStats();
+};
+
+} // namespace hfcl
+
+/*
+ * Put HFCL_POOLED_CLASS at the start of a class to allocate the class
+ * and its subclasses from SmallAllocator with HFCL_NEW and HFCL_NEW_EX.
+ */
+#define HFCL_POOLED_CLASS \
+    public: \
+        static void* operator new(size_t size) throw() { \
+            return hfcl::SmallAllocator::alloc(size); \
+        } \
+        static void operator delete(void* p) { \
+            hfcl::SmallAllocator::release(p); \
+        } \
+    private:
+
+#endif /* HFCL_COMMON_SMALLALLOC_H_ */
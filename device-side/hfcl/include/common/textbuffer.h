@@ -0,0 +1,133 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HFCL_COMMON_TEXTBUFFER_H_
+#define HFCL_COMMON_TEXTBUFFER_H_
+
+#include "../common/common.h"
+#include <string>
+
+namespace hfcl {
+
+// TUNNING CONDITION: the smallest gap left after growing the buffers
+#define TEXTBUFFER_MIN_GAP          256
+#define TEXTBUFFER_MIN_LINE_GAP     16
+
+/*
+ * TextBuffer is the text model of the edit views: UTF-8 text in a gap
+ * buffer, with no limit on the length.
+ *
+ * The gap stays where the last edit happened, so typing and deleting
+ * near the caret cost the size of the edit only. The lines (separated by
+ * '\n') are kept in a second gap array: the lines before the gap store
+ * their absolute byte and character offsets, and the lines after it
+ * store the offsets from the end of the text, so an edit changes none
+ * of them.
+ *
+ * Character indices are converted from the start of their line, or
+ * from the position of the last conversion if it is nearer; a caret
+ * moving in a line costs the distance it moves.
+ *
+ * Each line has an integer for the layout of the line (for example,
+ * the number of rows it wraps to), which is reset to -1 whenever the
+ * line changes. An edit view lays out again only the lines with -1.
+ */
+class TextBuffer {
+public:
+    TextBuffer();
+    ~TextBuffer();
+
+    // the length in bytes
+    int length() const { return m_length; }
+    int charCount() const { return m_nrChars; }
+    int lineCount() const { return m_nrLines; }
+
+    void clear();
+    bool setText(const char* text, int len = -1);
+    void getText(std::string& text) const;
+    // copies at most len bytes from pos; returns the bytes copied
+    int getText(int pos, int len, char* buf) const;
+    char byteAt(int pos) const {
+        return pos < m_gapStart ? m_buf[pos] : m_buf[pos + gapSize()];
+    }
+    // the bytes [pos, pos + len) in one piece; moves the gap if needed
+    const char* rangePtr(int pos, int len);
+
+    // the edits work on byte offsets at character boundaries
+    bool insert(int pos, const char* text, int len = -1);
+    void remove(int pos, int len);
+    bool replace(int pos, int len, const char* text, int textLen = -1);
+
+    int charToByte(int charIndex);
+    int byteToChar(int pos);
+    // the offsets of the next and previous characters
+    int nextChar(int pos) const;
+    int prevChar(int pos) const;
+
+    // the line which contains the byte
+    int lineOfByte(int pos) const;
+    int lineOfChar(int charIndex) const;
+    int lineStart(int line) const { return lineEntry(line, false); }
+    int lineCharStart(int line) const { return lineEntry(line, true); }
+    // the end of the line, not including the '\n'
+    int lineEnd(int line) const;
+
+    int lineLayout(int line) const;
+    void setLineLayout(int line, int layout);
+    // resets the layouts of all lines, for example, after the font changed
+    void invalidateLayouts();
+
+private:
+    struct Line {
+        // from the start of the text before the gap, from the end after it
+        int byteStart;
+        int charStart;
+        int layout;
+    };
+
+    int gapSize() const { return m_gapEnd - m_gapStart; }
+    bool moveGap(int pos, int room);
+    void moveLineGap(int line);
+    bool reserveLines(int nr);
+    int lineEntry(int line, bool chars) const;
+    int countChars(int pos, int len) const;
+
+    char* m_buf;
+    int m_size;
+    int m_gapStart;
+    int m_gapEnd;
+    int m_length;
+    int m_nrChars;
+
+    Line* m_lines;
+    int m_lineSize;
+    int m_lineGapStart;
+    int m_lineGapEnd;
+    int m_nrLines;
+
+    // the last conversion between bytes and characters
+    int m_cacheByte;
+    int m_cacheChar;
+};
+
+} // namespace hfcl
+
+#endif /* HFCL_COMMON_TEXTBUFFER_H_ */
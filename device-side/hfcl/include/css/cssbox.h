@@ -37,6 +37,7 @@ namespace hfcl {
 // Either for anonymous block-level boxes or normal block-level
 // or inline-block boxes
 class CssBox {
+    HFCL_POOLED_CLASS
 public:
     CssBox(CssComputed* css = NULL, bool anonymous = false);
     virtual ~CssBox();
@@ -42,6 +42,7 @@ public:
     bool append(CssDeclared* css);
 
     friend class RootView;
+    friend class ViewTemplate;
 
 protected:
     CssDeclaredVec m_css_vec;
@@ -25,9 +25,12 @@
 #include "graphics/color.h"
 #include "graphics/font.h"
 #include "graphics/gifanimate.h"
+#include "graphics/glyphatlas.h"
 #include "graphics/graphicscontext.h"
 #include "graphics/image.h"
 #include "graphics/ninepatchimage.h"
+#include "graphics/patchcache.h"
+#include "graphics/rasterkernels.h"
 #include "graphics/textmode.h"
 #include "graphics/threepatchimage.h"
 
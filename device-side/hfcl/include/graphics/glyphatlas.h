@@ -0,0 +1,168 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HFCL_GRAPHICS_GLYPHATLAS_H_
+#define HFCL_GRAPHICS_GLYPHATLAS_H_
+
+#include "../common/common.h"
+#include "../common/stlalternative.h"
+#include "../graphics/graphicscontext.h"
+
+namespace hfcl {
+
+// TUNNING CONDITION: the size of one atlas page (8-bit coverage)
+#define GLYPHATLAS_PAGE_WIDTH       256
+#define GLYPHATLAS_PAGE_HEIGHT      256
+// TUNNING CONDITION: the max number of pages shared by all fonts
+#define GLYPHATLAS_MAX_PAGES        8
+// TUNNING CONDITION: the max number of text colors cached per page
+#define GLYPHATLAS_MAX_TINTS        4
+// TUNNING CONDITION: the max bytes of the tinted pages of all fonts;
+// a tinted page takes 256 KiB at 32 bpp
+#define GLYPHATLAS_MAX_TINT_BYTES   (1024 * 1024)
+// TUNNING CONDITION: glyphs larger than this are drawn by MiniGUI directly
+#define GLYPHATLAS_MAX_GLYPH_SIZE   96
+
+class GlyphAtlasFont;
+class GlyphAtlasPage;
+
+/*
+ * GlyphAtlas caches the rasterized glyphs of a (Logfont, size) pair in
+ * shared 8-bit coverage pages. A page is drawn in a given text color by
+ * a solid color bitmap which shares the coverage of the page as its
+ * alpha mask, so one glyph costs one FillBoxWithBitmapPart call instead
+ * of a trip through the font engine.
+ */
+class GlyphAtlas {
+public:
+    struct Glyph {
+        GlyphAtlasPage* page;
+        short x;
+        short y;
+        short w;
+        short h;
+        short off_x;
+        short advance;
+    };
+
+    struct Stats {
+        unsigned int hits;
+        unsigned int misses;
+        unsigned int evictions;
+        unsigned int tint_evictions;
+        unsigned int blits;
+        unsigned int runs;
+        unsigned int fallbacks;
+    };
+
+    static GlyphAtlas* getInstance();
+    static void releaseInstance();
+
+    static bool isEnabled() { return s_enabled; }
+    static void setEnabled(bool enabled);
+
+    // returns NULL if the glyph can not be cached
+    const Glyph* getGlyph(Logfont* logfont, Uint32 code,
+            const char* mchar, int mchar_len);
+    int getLineHeight(Logfont* logfont);
+
+    // the bitmap to blit the page in the pixel value on hdc
+    const Bitmap* getTintedPage(GlyphAtlasPage* page, HDC hdc,
+            gal_pixel pixel);
+
+    void retainPage(GlyphAtlasPage* page);
+    void releasePage(GlyphAtlasPage* page);
+
+    const Stats& stats() const { return m_stats; }
+    Stats& stats() { return m_stats; }
+    void resetStats() { memset(&m_stats, 0, sizeof(m_stats)); }
+    void dumpStats();
+
+    // drop all cached glyphs which are not referenced by a pending batch
+    void purge();
+
+private:
+    GlyphAtlas();
+    ~GlyphAtlas();
+
+    GlyphAtlasFont* findFont(Logfont* logfont, bool create);
+    GlyphAtlasPage* newPage(GlyphAtlasFont* font);
+    bool evictPage();
+    bool evictTint();
+    bool rasterize(Logfont* logfont, const char* mchar, int mchar_len,
+            Glyph* glyph, GlyphAtlasFont* font);
+
+    LIST(GlyphAtlasFont*, FontList);
+
+    FontList     m_fonts;
+    int          m_nr_pages;
+    size_t       m_tint_bytes;
+    unsigned int m_clock;
+    HDC          m_scratch;
+    Stats        m_stats;
+
+    static GlyphAtlas* s_instance;
+    static bool s_enabled;
+};
+
+/*
+ * GlyphRunBatch collects the glyph blits of the text runs drawn through
+ * one GraphicsContext. The batch is flushed before any other drawing or
+ * clipping operation on the context, so the painting order is kept.
+ */
+class GlyphRunBatch {
+public:
+    GlyphRunBatch();
+    ~GlyphRunBatch();
+
+    // returns false if the run must be drawn by MiniGUI
+    bool addRun(HDC hdc, int x, int y, const char* text, int len,
+            gal_pixel pixel, Logfont* logfont, const RECT* clip);
+    // returns the width of the run, or -1 if the run can not be batched
+    int measureRun(Logfont* logfont, const char* text, int len,
+            int* height);
+
+    void flush(HDC hdc);
+    bool empty() const { return m_quads.size() == 0; }
+
+private:
+    struct GlyphQuad {
+        GlyphAtlasPage* page;
+        gal_pixel pixel;
+        short sx;
+        short sy;
+        short dx;
+        short dy;
+        short w;
+        short h;
+    };
+
+    VECTOR(GlyphQuad, GlyphQuadVec);
+
+    static bool isBatchable(Logfont* logfont, const char* text, int len);
+    static int nextChar(const char* text, int len, Uint32* code);
+
+    GlyphQuadVec m_quads;
+};
+
+} // namespace hfcl
+
+#endif /* HFCL_GRAPHICS_GLYPHATLAS_H_ */
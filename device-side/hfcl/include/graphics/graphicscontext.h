@@ -63,6 +63,7 @@ typedef struct _tagBitmapFrameArray
 
 class Image;
 class View;
+class Color;
 class GraphicsContextPrivate;
 
 class GraphicsContext : public Object {
@@ -88,6 +89,9 @@ public:
     void save();
     void restore();
 
+    // draws the batched text runs, before anything else draws on the DC
+    void flush();
+
     int setTextCharacterExtra(int extra) {
         return SetTextCharacterExtra (context(), extra);
     }
@@ -111,6 +115,10 @@ public:
     void fillBox(int x, int y, int w, int h);
     void bitBlt(GraphicsContext* src, int sx, int sy, int sw, int sh,
             int dx, int dy, Uint32 op);
+    // use these instead of calling MiniGUI on context(), so that the
+    // raster kernels know how to blit a memory DC.
+    bool setMemDCAlpha(DWORD flags, Uint8 alpha);
+    bool setMemDCColorKey(DWORD flags, Uint32 colorKey);
     void rectangle(int x0, int y0, int x1, int y1);
     void rectangle(int x0, int y0, int x1, int y1,
             Uint8 r, Uint8 g, Uint8 b, Uint8 a=255);
@@ -206,6 +214,18 @@ public:
     GraphicsContext* createMemGc(int w, int h);
 
 private:
+    // draws a single line text through the glyph atlas if possible
+    bool drawTextInBatch(const char* text, const RECT& rc,
+            Color& clr, Logfont* logfont, unsigned int format);
+
+    // draw 32bpp memory DCs with RasterKernels; return false to fall
+    // back to MiniGUI
+    bool rasterFillRect(const RECT& rc, gal_pixel pixel, Uint8 a);
+    bool rasterBitBlt(GraphicsContext* src, int sx, int sy, int sw, int sh,
+            int dx, int dy);
+    bool rasterFillBoxWithBitmap(int x, int y, int w, int h,
+            const Bitmap* bmp);
+
     GraphicsContextPrivate *m_data;
     static GraphicsContext *screen_graphics_context;
     static int screen_dpi;
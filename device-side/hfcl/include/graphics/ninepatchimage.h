@@ -23,6 +23,7 @@
 #define HFCL_GRAPHICS_NINEPATCHIMAGE_H_
 
 #include "../graphics/image.h"
+#include "../graphics/patchcache.h"
 
 namespace hfcl {
 
@@ -68,6 +69,7 @@ private:
     DRAWINFO m_di[PATCH_COUNT];
     IntRect m_subRc[PATCH_COUNT];
     Bitmap m_subBmp[PATCH_COUNT];
+    PatchCache m_cache;
 };
 
 } // namespace hfcl
@@ -0,0 +1,145 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HFCL_GRAPHICS_PATCHCACHE_H_
+#define HFCL_GRAPHICS_PATCHCACHE_H_
+
+#include "../common/intrect.h"
+#include "../graphics/graphicscontext.h"
+
+namespace hfcl {
+
+// TUNNING CONDITION: the number of composed sizes cached per image
+#define PATCHCACHE_MAX_SIZES        4
+// TUNNING CONDITION: the max number of slices of a patch image
+#define PATCHCACHE_MAX_SLICES       9
+// TUNNING CONDITION: the pre-stretched strips grow in steps of this
+#define PATCHCACHE_STRIP_STEP       64
+// TUNNING CONDITION: the max bytes of the bitmaps of all patch caches
+#define PATCHCACHE_MAX_BYTES        (512 * 1024)
+
+/*
+ * PatchCache keeps the rendering of a NinePatchImage or ThreePatchImage.
+ *
+ * The slices composed at one size are kept as a single bitmap, so that
+ * a repaint at a size already seen is one blit. A size is composed when
+ * it is asked for the second time in a row, which keeps the sizes of an
+ * animated resize from flushing the cache. The slices are stretched by
+ * FillBoxWithBitmap of MiniGUI, as they are when painted one by one;
+ * slices with an alpha mask are not composed, because a memory DC does
+ * not keep the mask.
+ *
+ * The other paints go slice by slice. A slice which does not change
+ * along the stretched axis (the usual border of a patch image) is
+ * stretched once to the longest length seen so far, and a shorter
+ * length is drawn as a part of this strip.
+ *
+ * The bitmaps of all the caches are bounded by PATCHCACHE_MAX_BYTES
+ * together; the least recently used ones are freed first.
+ */
+class PatchCache {
+public:
+    struct Stats {
+        unsigned int hits;
+        unsigned int misses;
+        unsigned int composes;
+        unsigned int evictions;
+        unsigned int strips;
+        unsigned int fallbacks;
+    };
+
+    PatchCache();
+    ~PatchCache();
+
+    // drops all cached bitmaps; call it when the slices change
+    void reset();
+
+    // draws the cached composition of rc; the key tells apart
+    // the compositions of the same size which are aligned differently
+    bool paintComposed(GraphicsContext* gc, const IntRect& rc, int key = 0);
+
+    // draws the slices at subRc; the slices must tile the rectangle
+    // which bounds subRc
+    void paint(GraphicsContext* gc, const IntRect& rc, int key,
+            const Bitmap* slices, const IntRect* subRc, int nr_slices);
+
+    static Stats& stats() { return s_stats; }
+    static void resetStats() { memset(&s_stats, 0, sizeof(s_stats)); }
+    static void dumpStats();
+
+    static bool isEnabled() { return s_enabled; }
+    static void setEnabled(bool enabled) { s_enabled = enabled; }
+
+private:
+    struct Composed {
+        int w;
+        int h;
+        int key;
+        // the offset of the bitmap in the painted rectangle
+        int xo;
+        int yo;
+        unsigned int age;
+        Bitmap bmp;
+    };
+
+    struct Strip {
+        bool checked;
+        bool uniformX;
+        bool uniformY;
+        unsigned int age;
+        Bitmap bmp;
+    };
+
+    Composed* find(int w, int h, int key);
+    bool compose(GraphicsContext* gc, const IntRect& rc, int key,
+            const Bitmap* slices, const IntRect* subRc, int nr_slices);
+    void paintSlice(GraphicsContext* gc, int idx, const IntRect& rc,
+            const Bitmap* slice);
+
+    static bool reserve(size_t size);
+    static bool evictOldest();
+    static bool initBitmap(Bitmap* bmp, const Bitmap* tmpl, int w, int h,
+            bool withMask);
+    static void freeBitmap(Bitmap* bmp);
+    static size_t bitmapSize(const Bitmap* bmp);
+    static void stretch(Bitmap* dst, int x, int y, int w, int h,
+            const Bitmap* src);
+
+    Composed     m_composed[PATCHCACHE_MAX_SIZES];
+    Strip        m_strips[PATCHCACHE_MAX_SLICES];
+    int          m_missW;
+    int          m_missH;
+    int          m_missKey;
+
+    // all the caches, for the eviction
+    PatchCache*  m_prev;
+    PatchCache*  m_next;
+
+    static PatchCache*  s_first;
+    static unsigned int s_age;
+    static size_t       s_bytes;
+    static Stats s_stats;
+    static bool  s_enabled;
+};
+
+} // namespace hfcl
+
+#endif /* HFCL_GRAPHICS_PATCHCACHE_H_ */
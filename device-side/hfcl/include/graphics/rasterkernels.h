@@ -0,0 +1,82 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HFCL_GRAPHICS_RASTERKERNELS_H_
+#define HFCL_GRAPHICS_RASTERKERNELS_H_
+
+#include "../common/common.h"
+
+namespace hfcl {
+
+/*
+ * The pixel kernels used by GraphicsContext on 32bpp memory DCs.
+ *
+ * All kernels work on one row of 32-bit pixels with the alpha channel in
+ * the most significant byte. Blending is not premultiplied:
+ *
+ *     dst = (src * a + dst * (255 - a)) / 255
+ *
+ * for every channel, where the alpha channel of src counts as 255, and
+ * the division is rounded to the nearest. The SIMD variants must give
+ * exactly the same pixels as the scalar ones.
+ *
+ * The scaler walks the source row in 16.16 fixed point: the destination
+ * pixel x samples the source at (fx0 + x * step).
+ */
+struct RasterKernels {
+    const char* name;
+
+    void (*fill)(Uint32* dst, int n, Uint32 pixel);
+    void (*blend)(Uint32* dst, const Uint32* src, int n);
+    void (*blendConst)(Uint32* dst, const Uint32* src, int n, Uint8 alpha);
+    void (*colorKey)(Uint32* dst, const Uint32* src, int n,
+            Uint32 key, Uint32 mask);
+    void (*scaleNearest)(Uint32* dst, int n, const Uint32* src, int sw,
+            int fx0, int step);
+
+    // the kernels selected by the CPU features, or by the environment
+    // variable HFCL_RASTER_KERNELS (scalar, sse2, avx2, or neon)
+    static const RasterKernels* get();
+    // returns NULL if the named kernels are not supported by the CPU
+    static const RasterKernels* byName(const char* name);
+    static const RasterKernels* scalar();
+
+    // whether GraphicsContext draws memory DCs with the kernels
+    static bool isEnabled() { return s_enabled; }
+    static void setEnabled(bool enabled) { s_enabled = enabled; }
+
+private:
+    static bool s_enabled;
+};
+
+#if defined(__i386__) || defined(__x86_64__)
+extern const RasterKernels raster_kernels_sse2;
+extern const RasterKernels raster_kernels_avx2;
+#endif
+
+// _HFCL_HAVE_NEON: only the NEON kernels are built with the NEON flags
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_HFCL_HAVE_NEON)
+extern const RasterKernels raster_kernels_neon;
+#endif
+
+} // namespace hfcl
+
+#endif /* HFCL_GRAPHICS_RASTERKERNELS_H_ */
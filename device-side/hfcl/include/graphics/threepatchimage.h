@@ -23,6 +23,7 @@
 #define HFCL_GRAPHICS_THREEPATCHIMAGE_H_
 
 #include "../graphics/image.h"
+#include "../graphics/patchcache.h"
 
 namespace hfcl {
 
@@ -72,6 +73,7 @@ private:
     DRAWINFO m_di[THREEH_PATCH_COUNT];
     IntRect m_subRc[THREEH_PATCH_COUNT];
     Bitmap m_subBmp[THREEH_PATCH_COUNT];
+    PatchCache m_cache;
     bool m_typeHoriz;
 };
 
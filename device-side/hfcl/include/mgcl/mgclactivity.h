@@ -26,6 +26,7 @@ namespace hfcl {
 
 #define MGCL_WS_EX_MODALDISABLED     0x10000000L
 #define MGCL_MSG_MNWND_ENDDIALOG   MSG_LASTUSERMSG + 4
+#define MGCL_MSG_POSTEDEVENTS      MSG_LASTUSERMSG + 5
 
 
 DWORD mgclDoModal(HWND hWnd, BOOL bAutoDestroy);
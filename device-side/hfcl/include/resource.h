@@ -26,6 +26,7 @@
 #include "resource/imageres.h"
 #include "resource/resloader.h"
 #include "resource/respackage.h"
+#include "resource/respkgfile.h"
 #include "resource/respkgmanager.h"
 #include "resource/restypes.h"
 #include "resource/textres.h"
@@ -28,6 +28,7 @@
 #include "../graphics/gifanimate.h"
 #include "../view/animateimageview.h"
 #include "../resource/restypes.h"
+#include "../resource/respkgfile.h"
 
 namespace hfcl {
 
@@ -50,6 +51,16 @@ public:
     void registerIncoreRes(const char* resname,
             const HFCL_INCORE_RES *incores, int count);
 
+    /*
+     * The resources in the mounted package files are looked up by name
+     * after the incore ones and before the file system. Unmounting drops
+     * the reference of the loader only; see ResPkgFile.
+     */
+    ResPkgFile* mountPackage(const char* path);
+    bool unmountPackage(const char* path);
+    void* loadPackageData(const char* name, unsigned int* size,
+            bool* mapped);
+
 #if 0 /* VM: deprecated code */
     struct InnerImage {
         INNER_RES_INFO * resInfo;
@@ -89,6 +100,9 @@ private:
     BitmapResMap m_bitmapRes;
     NameIncoresMap m_nameIncores;
 
+    VECTOR(ResPkgFile*, ResPkgFileVec);
+    ResPkgFileVec m_pkgFiles;
+
     static ResLoader* m_singleton;
 };
 
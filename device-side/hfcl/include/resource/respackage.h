@@ -39,6 +39,7 @@ class DrawableSetGroup;
 class Menu;
 class GifAnimate;
 class ThemeRes;
+class ResPkgFile;
 
 typedef struct _ResourceEntry {
     HTResId id;
@@ -101,6 +102,12 @@ public:
     const utf8string &getPackagePath(void);
     void setPackagePath(utf8string &packagePath);
 
+    /*
+     * Uses the resources in a package file (see respkgfile.h) which are
+     * not added to the package in code; they are looked up by HTResId.
+     */
+    bool setPackageFile(const char* path);
+
     /*
      * res package related
      */
@@ -180,6 +187,8 @@ public:
     ThemeRes* theme(void);
 
 private:
+    const char* getPackageFileName(HTResId id);
+
     ResourceBucket  m_resBuckets[NR_RES_TYPE];
     const ResourceEntry *m_imageResourceEntry;
     MENU_RES_ARRAY *m_pMenuResArray;
@@ -199,6 +208,7 @@ private:
     unsigned int m_ImagReseSize;
 
     utf8string m_packagePath;
+    ResPkgFile* m_pkgFile;
     ThemeRes* m_theme;
     HTResId m_theme_id;
 
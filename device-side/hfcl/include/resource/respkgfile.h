@@ -0,0 +1,138 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HFCL_RESOURCE_RESPKGFILE_H_
+#define HFCL_RESOURCE_RESPKGFILE_H_
+
+#include "../common/stlalternative.h"
+#include "../common/object.h"
+#include "../resource/restypes.h"
+
+/*
+ * The layout of a resource package file. All numbers are little endian.
+ *
+ *     +--------------------------------------+  0
+ *     | HFCL_RESPKG_HEADER                   |
+ *     +--------------------------------------+  index_offset
+ *     | HFCL_RESPKG_ENTRY [nr_entries]       |  grouped by type; the
+ *     |                                      |  entries of one type are
+ *     |                                      |  in the order of RESINDEX
+ *     +--------------------------------------+  names_offset
+ *     | Uint32 [nr_entries]                  |  entry indices sorted by
+ *     |                                      |  name (strcmp)
+ *     +--------------------------------------+  strings_offset
+ *     | NUL-terminated entry names           |
+ *     +--------------------------------------+  page aligned
+ *     | entry data, each one page aligned    |
+ *     +--------------------------------------+
+ *
+ * The id of a text entry (R_TYPE_TEXT_*) is MAKELONG(enc, lang) as the
+ * keys of ResPackage::addTextRes*; other entries have their HTResId.
+ * An entry with HFCL_RESPKG_F_ZLIB is compressed with zlib compress().
+ *
+ * src/resource/make_respkg.py makes a package from a manifest of files.
+ */
+#define HFCL_RESPKG_MAGIC       0x4B505248  /* "HRPK" */
+#define HFCL_RESPKG_VERSION     1
+#define HFCL_RESPKG_NR_TYPES    16
+
+#define HFCL_RESPKG_F_ZLIB      0x0001
+
+typedef struct _HFCL_RESPKG_HEADER {
+    Uint32  magic;
+    Uint32  version;
+    Uint32  page_size;
+    Uint32  nr_entries;
+    Uint32  index_offset;
+    Uint32  names_offset;
+    Uint32  strings_offset;
+    Uint32  reserved;
+    struct {
+        Uint16  first;
+        Uint16  count;
+    } types [HFCL_RESPKG_NR_TYPES];
+} __attribute__((__packed__)) HFCL_RESPKG_HEADER;
+
+typedef struct _HFCL_RESPKG_ENTRY {
+    Uint32  id;
+    Uint32  type;
+    Uint32  flags;
+    Uint32  offset;
+    Uint32  size;
+    Uint32  origin_size;
+    Uint32  name;
+    Uint32  reserved;
+} __attribute__((__packed__)) HFCL_RESPKG_ENTRY;
+
+#ifdef __cplusplus
+
+namespace hfcl {
+
+/*
+ * ResPkgFile maps a resource package read-only, so the processes using
+ * the same package share its page cache, and a start touches only the
+ * pages of the index and of the entries it uses.
+ *
+ * A package is reference counted: ResLoader holds a reference while the
+ * package is mounted, and each ResPackage using it holds another one, so
+ * the mapping, and the mapped data of the entries, stay valid after the
+ * package is unmounted until the last ResPackage releases it.
+ */
+class ResPkgFile : public RefCount {
+public:
+    // returns NULL if the file is not a valid package
+    static ResPkgFile* open(const char* path);
+    ~ResPkgFile();
+
+    const char* path() const { return m_path.c_str(); }
+    int count() const { return m_header->nr_entries; }
+
+    const HFCL_RESPKG_ENTRY* find(HTResId id) const;
+    const HFCL_RESPKG_ENTRY* find(const char* name) const;
+    const HFCL_RESPKG_ENTRY* findText(HIDResType type,
+            HIDLanguage lang, HIDEncoding enc) const;
+
+    // the entries found are checked; returns NULL for a bad entry
+    const char* name(const HFCL_RESPKG_ENTRY* entry) const;
+
+    // returns the bytes of the entry; they are in the mapping if mapped
+    // is set, or in a buffer from malloc() which the caller frees.
+    void* getData(const HFCL_RESPKG_ENTRY* entry, unsigned int* size,
+            bool* mapped) const;
+
+private:
+    ResPkgFile();
+    bool check() const;
+    bool checkEntry(const HFCL_RESPKG_ENTRY* entry) const;
+
+    utf8string  m_path;
+    Uint8*      m_base;
+    size_t      m_size;
+    const HFCL_RESPKG_HEADER* m_header;
+    const HFCL_RESPKG_ENTRY*  m_entries;
+    const Uint32*             m_names;
+};
+
+} // namespace hfcl
+
+#endif /* __cplusplus */
+
+#endif /* HFCL_RESOURCE_RESPKGFILE_H_ */
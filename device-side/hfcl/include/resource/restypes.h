@@ -162,16 +162,32 @@ typedef struct _HFCL_INCORE_RES {
     unsigned int size;
 } HFCL_INCORE_RES;
 
+/*
+ * The zipped strings are NUL-terminated strings compressed with zlib.
+ *
+ * If block_strings is zero, zipped_bytes is one zlib stream of all
+ * strings. Otherwise, the strings are compressed in blocks of
+ * block_strings strings (the last one may be shorter), and zipped_bytes
+ * starts with an HFCL_ZIPPED_BLOCK for each block; the offset of a block
+ * counts from zipped_bytes. A blocked string table can be used without
+ * inflating the blocks which are not used.
+ */
 typedef struct _HFCL_ZIPPED_STRINGS {
     Uint32  lang_id;
     Uint32  enc_id;
     Uint32  zipped_size;
     Uint32  origin_size;
     Uint32  nr_strings;
-    Uint32  reserved;
+    Uint32  block_strings;
     char    zipped_bytes [0];
 } __attribute__((__packed__)) HFCL_ZIPPED_STRINGS;
 
+typedef struct _HFCL_ZIPPED_BLOCK {
+    Uint32  offset;
+    Uint32  zipped_size;
+    Uint32  origin_size;
+} __attribute__((__packed__)) HFCL_ZIPPED_BLOCK;
+
 #ifdef __cplusplus
 
 namespace hfcl {
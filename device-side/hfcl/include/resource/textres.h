@@ -75,20 +75,44 @@ public:
     TextResZipped (const char* res_name)
         : TextRes (res_name)
         , m_string_bucket (NULL)
+        , m_raw_strings (NULL)
+        , m_nr_strings (0)
+        , m_zipped_str (NULL)
+        , m_from_incore (false)
+        , m_blocks (NULL)
+        , m_nr_blocks (0)
+        , m_nr_inflated (0)
     { }
     ~TextResZipped () { release (); }
 
     virtual bool load ();
     virtual void release ();
-    virtual const char* getText (HTStrId strId) {
-        if (m_raw_strings)
-            return m_raw_strings [strId];
-        return "";
-    }
+    virtual const char* getText (HTStrId strId);
+
+    // the number of blocks inflated, for a blocked string table
+    int nrInflatedBlocks () const { return m_nr_inflated; }
 
 private:
+    struct Block {
+        char* bucket;
+        const char** strings;
+    };
+
+    bool loadAll ();
+    bool inflateBlock (Uint32 idx);
+
     char* m_string_bucket;
     const char** m_raw_strings;
+    Uint32 m_nr_strings;
+
+    /* kept for the blocked string table; the blocks are inflated on
+       demand and are kept until release (), so the strings returned by
+       getText () stay valid like the ones of the other text resources */
+    HFCL_ZIPPED_STRINGS* m_zipped_str;
+    bool m_from_incore;
+    Block* m_blocks;
+    Uint32 m_nr_blocks;
+    int m_nr_inflated;
 };
 
 class TextResGnuMsg : public TextRes {
@@ -24,6 +24,7 @@
 
 #include "services/service.h"
 #include "services/timerservice.h"
+#include "services/framescheduler.h"
 
 #endif // HFCL_SERVICES_H_
 
@@ -0,0 +1,126 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HFCL_SERVICES_FRAMESCHEDULER_H_
+#define HFCL_SERVICES_FRAMESCHEDULER_H_
+
+#include "../common/common.h"
+#include "../common/stlalternative.h"
+#include "service.h"
+#include "timerservice.h"
+
+namespace hfcl {
+
+// TUNNING CONDITION: the default frames per second
+#define FRAMESCHEDULER_DEFAULT_RATE     50
+
+class Window;
+
+/*
+ * The object driven by the FrameScheduler once per frame. The ticks are
+ * the milliseconds since the system started; return false to stop getting
+ * frames.
+ */
+class FrameClient {
+public:
+    virtual ~FrameClient() { }
+    virtual bool onFrame(Uint32 ticks) = 0;
+};
+
+/*
+ * FrameScheduler runs all animations of the process on one frame clock.
+ *
+ * In a frame, the scheduler calls the clients one after another, so
+ * the animated properties change together. Then it paints each window
+ * invalidated in the frame, once. The frame timer runs only while there
+ * are clients; with nothing animating the scheduler sleeps.
+ *
+ * The frame rate is rounded to the ticks of TimerService. A frame which
+ * comes more than one interval late counts the frames it missed as
+ * dropped.
+ */
+class FrameScheduler : public Service, public TimerEventListener {
+public:
+    struct Stats {
+        unsigned int frames;
+        unsigned int dropped;
+        unsigned int paints;
+        // the time spent in the frames, in microseconds
+        unsigned int lastFrameTime;
+        unsigned int maxFrameTime;
+        unsigned long long totalFrameTime;
+    };
+
+    static FrameScheduler* getInstance();
+    virtual ~FrameScheduler();
+
+    virtual void start();
+    // removes all clients
+    virtual void stop();
+
+    int targetRate() const { return m_rate; }
+    void setTargetRate(int fps);
+    // the interval of frames in milliseconds
+    int frameInterval() const;
+
+    void addClient(FrameClient* client);
+    void removeClient(FrameClient* client);
+    bool hasClient(const FrameClient* client) const;
+    int nrClients() const { return m_clients.size(); }
+    bool inFrame() const { return m_inFrame; }
+
+    // the window is painted at the end of the current frame
+    void requestPaint(Window* window);
+    void cancelPaint(Window* window);
+
+    // milliseconds since the system started
+    static Uint32 ticks() { return (Uint32)GetTickCount() * 10; }
+
+    const Stats& stats() const { return m_stats; }
+    void resetStats() { memset(&m_stats, 0, sizeof(m_stats)); }
+    void dumpStats();
+
+    /* overloaded virtual functions */
+    virtual bool handler(Event* event);
+
+private:
+    FrameScheduler();
+
+    void runFrame();
+    void updateTimer();
+
+    VECTOR(FrameClient*, FrameClientVec);
+    VECTOR(Window*, WindowVec);
+
+    FrameClientVec m_clients;
+    WindowVec m_dirtyWindows;
+    int m_rate;
+    int m_timerId;
+    bool m_inFrame;
+    bool m_stopped;
+    Uint32 m_lastFrame;
+
+    Stats m_stats;
+};
+
+} // namespace hfcl
+
+#endif /* HFCL_SERVICES_FRAMESCHEDULER_H_ */
@@ -39,12 +39,48 @@ typedef enum {
 } TimerPriority;
 
 #define SERVICE_TIMER_ID         0xEF
+// the length of a tick of the timer wheel in milliseconds
 #define SERVICE_TIMER_INTERVAL     10
 
+// TUNNING CONDITION: a timer fired this many ticks after it was due
+// is counted as late
+#define SERVICE_TIMER_LATE_TICKS    2
+
 class TimerEventListener;
 
+// the link of a doubly linked list of timers
+struct TimerLink {
+    TimerLink* next;
+    TimerLink* prev;
+};
+
+/*
+ * TimerService runs all HFCL timers on one hierarchical timing wheel,
+ * driven by a single MiniGUI timer which ticks every
+ * SERVICE_TIMER_INTERVAL milliseconds, and only while there are timers.
+ *
+ * The first level has a slot for each of the next 256 ticks, and each
+ * of the other three levels has 64 slots, each covering 64 times the
+ * ticks of a slot one level lower, which gives about 7.7 days in all.
+ * Adding and removing a timer are O(1); when the first level wraps,
+ * one slot of the next level is spread over the lower ones.
+ *
+ * The timers due in the same tick fire together, the ones with higher
+ * priority first. If the ticks come late (the message loop was busy),
+ * each due timer still fires once, and a periodic timer skips the
+ * periods it missed. Pausing the service freezes the clock of the
+ * timers, so they keep their remaining time across pause() and resume().
+ */
 class TimerService : public Service {
 public:
+    struct Stats {
+        unsigned int timers;
+        unsigned int ticks;
+        unsigned int fired;
+        unsigned int lateFired;
+        unsigned int cascaded;
+    };
+
     static inline TimerService* getInstance() {
         static  TimerService* m_singleton = NULL;
         if (NULL == m_singleton)
@@ -55,62 +91,113 @@ public:
 
     bool canStop(void);
     void start(void);
+    // removes all timers
     void stop(void);
     void pause();
     void resume();
+    bool isPaused() const { return m_bPause; }
 
     int addTimerListenerPriority(int interval, TimerEventListener* listener,
             char *listenername) {
         return addTimerListener(interval, listener, TIMER_PRIORITY_LOW, listenername);
     }
 
+    // the interval is in milliseconds; returns the id of the timer, or 0
     int addTimerListener(int interval, TimerEventListener* listener,
             TimerPriority priority, const char *listenername);
     int addTimerListenerSingle(int interval, TimerEventListener* listener,
             TimerPriority priority, const char *listenername);
     void removeTimerListener(TimerEventListener* listener, int id);
+    // removes all timers of the listener
+    void removeTimerListeners(TimerEventListener* listener);
+
+    const Stats& stats() const { return m_stats; }
+    void dumpStats();
 
 private:
+    enum {
+        ROOT_BITS = 8,
+        LEVEL_BITS = 6,
+        NR_LEVELS = 4,
+        ROOT_SIZE = 1 << ROOT_BITS,
+        LEVEL_SIZE = 1 << LEVEL_BITS,
+        MAX_TICKS = (1 << (ROOT_BITS + LEVEL_BITS * (NR_LEVELS - 1))) - 1,
+    };
+
+    struct TimerNode {
+        // in a slot of the wheel; must be the first
+        TimerLink link;
+        // in the timers of the listener
+        TimerLink owner;
+        TimerEventListener* listener;
+        const char* name;
+        Uint32 expires;
+        // 0 for a one-shot timer
+        Uint32 interval;
+        int id;
+        int priority;
+    };
+
     BOOL m_bPause;
 
+    // the next tick to run, and the ticks not counted while paused
+    Uint32 m_now;
+    Uint32 m_pausedTicks;
+    Uint32 m_pauseStart;
+    bool m_driving;
+
+    TimerLink m_root[ROOT_SIZE];
+    TimerLink m_levels[NR_LEVELS - 1][LEVEL_SIZE];
+    // the timers being fired
+    TimerLink m_expiring;
+
+    // the nodes by the index in their ids; the free ones are linked
+    TimerNode** m_nodes;
+    int m_nrNodes;
+    TimerNode* m_freeNodes;
+
+    Stats m_stats;
+
     TimerService();
 
+    Uint32 currentTick() const;
+    int addTimer(int interval, TimerEventListener* listener,
+            TimerPriority priority, const char* name, bool oneShot);
+    TimerNode* nodeOfId(int id) const;
+    void freeNode(TimerNode* node);
+    void schedule(TimerNode* node);
+    void cascade(int level, int index);
+    void runTick(Uint32 now);
+    void updateDriver();
+
     static BOOL TimerProc(HWND listener, LINT id, DWORD data);
-    static BOOL OneShotTimerProc(HWND listener, LINT id, DWORD data);
 };
 
-#define LISTENER_TIMER_MAX 16
-
+/*
+ * A listener may have any number of timers; its timers are removed
+ * when it is deleted. The counts of fired and late timers tell the
+ * timer pressure on the listener.
+ */
 class TimerEventListener : public EventListener {
 public:
     TimerEventListener() : EventListener() {
-        memset(m_timerIdArray, 0, LISTENER_TIMER_MAX * sizeof(int));
+        initTimers();
     }
 
     TimerEventListener(int start_ref)
             : EventListener(start_ref) {
-        memset(m_timerIdArray, 0, LISTENER_TIMER_MAX * sizeof(int));
+        initTimers();
     }
 
     virtual ~TimerEventListener() {
-        for (int i = 0; i < LISTENER_TIMER_MAX; i++) {
-            if (m_timerIdArray[i] > 0) {
-                TimerService::getInstance()->removeTimerListener(this,
-                    m_timerIdArray[i]);
-                m_timerIdArray[i] = 0;
-            }
-        }
+        if (m_timers.next != &m_timers)
+            TimerService::getInstance()->removeTimerListeners(this);
     }
+
     int registerTimer(int interval, const char *listenername,
                 TimerPriority priority = TIMER_PRIORITY_LOW) {
-        for (int i = 0; i < LISTENER_TIMER_MAX; i++) {
-            if (m_timerIdArray[i] == 0) {
-                m_timerIdArray[i] = TimerService::getInstance()->
-                    addTimerListener(interval, this, priority, listenername);
-                return m_timerIdArray[i];
-            }
-        }
-        return 0;
+        return TimerService::getInstance()->
+            addTimerListener(interval, this, priority, listenername);
     }
 
     int registerTimerSingle(int interval, const char *listenername,
@@ -121,15 +208,24 @@ public:
 
     void removeTimer(int timerId) {
         TimerService::getInstance()->removeTimerListener(this, timerId);
-        for (int i = 0; i < LISTENER_TIMER_MAX; i++) {
-            if (m_timerIdArray[i] == timerId) {
-                m_timerIdArray[i] = 0;
-            }
-        }
     }
 
+    unsigned int nrTimersFired() const { return m_nrFired; }
+    unsigned int nrTimersLateFired() const { return m_nrLateFired; }
+    void resetTimerCounts() { m_nrFired = 0; m_nrLateFired = 0; }
+
 private:
-    int m_timerIdArray[LISTENER_TIMER_MAX];
+    friend class TimerService;
+
+    void initTimers() {
+        m_timers.next = m_timers.prev = &m_timers;
+        m_nrFired = 0;
+        m_nrLateFired = 0;
+    }
+
+    TimerLink m_timers;
+    unsigned int m_nrFired;
+    unsigned int m_nrLateFired;
 };
 
 } // namespace hfcl
@@ -25,6 +25,7 @@
 #include "view/view.h"
 #include "view/viewcontainer.h"
 #include "view/viewfactory.h"
+#include "view/viewtemplate.h"
 #include "view/rootview.h"
 #include "view/panelview.h"
 #include "view/contentview.h"
@@ -32,6 +33,8 @@
 #include "view/staticimageview.h"
 #include "view/animatedimageview.h"
 #include "view/transition.h"
+#include "view/kineticscroller.h"
+#include "view/virtuallistview.h"
 
 #endif // HFCL_VIEW_H_
 
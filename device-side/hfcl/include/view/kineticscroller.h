@@ -0,0 +1,116 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HFCL_VIEW_KINETICSCROLLER_H_
+#define HFCL_VIEW_KINETICSCROLLER_H_
+
+#include "../common/common.h"
+
+namespace hfcl {
+
+// TUNNING CONDITION: the time constant of the fling deceleration (ms)
+#define KINETIC_FLING_TAU           325
+// TUNNING CONDITION: the slowest fling (pixels per second)
+#define KINETIC_MIN_VELOCITY        50
+// TUNNING CONDITION: the farthest a drag or a fling goes beyond an edge
+#define KINETIC_MAX_OVERSCROLL      64
+// TUNNING CONDITION: the time constant of stopping beyond an edge (ms)
+#define KINETIC_OVERSCROLL_TAU      40
+// TUNNING CONDITION: the time constant of bouncing back to an edge (ms)
+#define KINETIC_BOUNCE_TAU          100
+// TUNNING CONDITION: the drag samples newer than it give the velocity (ms)
+#define KINETIC_VELOCITY_WINDOW     100
+
+/*
+ * KineticScroller computes the scroll offset of a drag and of the fling
+ * after the drag, as a function of time. It does not scroll anything;
+ * the scrolled view calls computeOffset() once per frame and applies
+ * offset().
+ *
+ * The velocity of a fling decays exponentially, so the fling travels
+ * v * KINETIC_FLING_TAU / 1000 pixels in all. An offset beyond the range
+ * is an overscroll: a drag moves at half speed there, a fling stops
+ * quickly there, and both bounce back to the edge afterwards.
+ */
+class KineticScroller {
+public:
+    KineticScroller();
+
+    void setRange(int minOffset, int maxOffset);
+    int minOffset() const { return m_min; }
+    int maxOffset() const { return m_max; }
+
+    int offset() const { return (int)(m_offset + (m_offset < 0 ? -0.5f : 0.5f)); }
+    // moves the offset without changing the motion
+    void setOffset(int offset) { m_offset = (float)offset; }
+    void offsetBy(int delta) { m_offset += delta; }
+    // pixels per second
+    float velocity() const { return m_velocity; }
+
+    bool isDragging() const { return m_state == DRAGGING; }
+    bool isFinished() const { return m_state == IDLE; }
+
+    // the positions are in pixels along the scroll direction
+    void beginDrag(int pos, Uint32 ticks);
+    void dragTo(int pos, Uint32 ticks);
+    // returns false if there is nothing to animate after the drag
+    bool endDrag(Uint32 ticks);
+
+    bool fling(float velocity, Uint32 ticks);
+    // flings so that the fling travels about the distance
+    bool flingBy(int distance, Uint32 ticks);
+    void abort();
+
+    // updates the offset for the time; returns false when the motion ends
+    bool computeOffset(Uint32 ticks);
+
+private:
+    enum {
+        IDLE,
+        DRAGGING,
+        FLINGING,
+        BOUNCING,
+    };
+
+    enum { NR_SAMPLES = 4 };
+
+    float overscroll() const;
+    bool startBounce(Uint32 ticks);
+
+    int m_state;
+    int m_min;
+    int m_max;
+
+    float m_offset;
+    float m_velocity;
+    Uint32 m_lastTicks;
+
+    // the drag
+    int m_dragPos;
+    float m_dragOffset;
+    int m_nrSamples;
+    int m_samplePos[NR_SAMPLES];
+    Uint32 m_sampleTicks[NR_SAMPLES];
+};
+
+} // namespace hfcl
+
+#endif /* HFCL_VIEW_KINETICSCROLLER_H_ */
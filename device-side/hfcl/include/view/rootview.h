@@ -53,6 +53,8 @@ public:
     virtual const char* tag() const { return "hvroot"; }
     virtual bool isRoot() const { return true; }
     virtual Window* getSysWindow() const { return m_window; }
+    virtual void onChildUpdateView(View *child,
+            int x, int y, int w, int h, bool upBackGnd = true);
 
 protected:
 
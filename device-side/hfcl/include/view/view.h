@@ -74,6 +74,7 @@ enum {
 #define VIEW_COMMON_ATTR_TABINDEX   "tabindex"
 
 class View : public Object {
+    HFCL_POOLED_CLASS
 public:
     View(const char* vtag, const char* vtype,
             const char* vclass, const char* vname, int vid);
@@ -294,6 +295,10 @@ public:
     bool checkAttribute(const char* attrKey, const char* attrValue) const;
     bool checkAttribute(const char* attrPair) const;
 
+    // Selects a CssDeclared object already matched by the caller,
+    // as ViewTemplate does for the views it creates
+    void appendMatchedCss(CssDeclared* css, DWORD specif, bool dynamic);
+
     virtual bool isContainer() const { return false; }
     virtual bool isRoot() const { return false; }
     virtual bool getIntrinsicWidth(HTReal* v) const { return false; }
@@ -526,10 +531,8 @@ protected:
     IntRect m_rc_viewport;
     IntRect m_rect;
 
-    LISTEX(EventListener *, EventListenerList,
-            do { return *v1 == *v2; } while (0),
-            do { (*n)->unref(); } while (0));
-    EventListenerList m_listeners;
+    // holds a reference to the listeners; the last added is called first
+    EventListenerArray m_listeners;
     void releaseEventListeners();
 
     bool raiseViewEvent(ViewEvent *event);
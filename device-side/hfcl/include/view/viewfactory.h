@@ -48,6 +48,9 @@ public:
     View *create(const char* vtag, const char* vtype,
             const char* vclass, const char* vname, int vid);
 
+    // returns NULL if no view is registered for the tag and the type
+    CB_VIEW_CREATOR getCreator(const char* vtag, const char* vtype);
+
     void list();
 
 private:
@@ -0,0 +1,172 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HFCL_VIEW_VIEWTEMPLATE_H_
+#define HFCL_VIEW_VIEWTEMPLATE_H_
+
+#include "../common/common.h"
+#include "../view/viewfactory.h"
+
+/*
+ * The layout of a compiled view template. All numbers are little endian;
+ * make_view_template.py in src/hvml/ makes it from HVML markup.
+ *
+ *     +--------------------------------------+  0
+ *     | HFCL_VIEWTMPL_HEADER                 |
+ *     +--------------------------------------+  nodes_offset
+ *     | HFCL_VIEWTMPL_NODE [nr_nodes]        |  in document order; the
+ *     |                                      |  parent of a node is
+ *     |                                      |  before it
+ *     +--------------------------------------+  attrs_offset
+ *     | HFCL_VIEWTMPL_ATTR [nr_attrs]        |
+ *     +--------------------------------------+  rules_offset
+ *     | HFCL_VIEWTMPL_RULE [nr_rules]        |  the matched CSS rules
+ *     +--------------------------------------+  atoms_offset
+ *     | Uint32 [nr_atoms]                    |  offsets of the atoms
+ *     +--------------------------------------+  strings_offset
+ *     | NUL-terminated atoms                 |  tags, classes, names,
+ *     |                                      |  attributes and texts
+ *     +--------------------------------------+
+ *
+ * An atom index of HFCL_VIEWTMPL_NONE means no value. The css field of
+ * a rule is the index of a CssDeclared in the CSS group cssg_id.
+ */
+#define HFCL_VIEWTMPL_MAGIC         0x4C545648  /* "HVTL" */
+#define HFCL_VIEWTMPL_VERSION       1
+#define HFCL_VIEWTMPL_NONE          0xFFFF
+
+#define HFCL_VIEWTMPL_RULE_DYNAMIC  0x0001
+
+typedef struct _HFCL_VIEWTMPL_HEADER {
+    Uint32  magic;
+    Uint32  version;
+    Uint32  cssg_id;
+    Uint16  nr_nodes;
+    Uint16  nr_attrs;
+    Uint16  nr_rules;
+    Uint16  nr_atoms;
+    Uint32  nodes_offset;
+    Uint32  attrs_offset;
+    Uint32  rules_offset;
+    Uint32  atoms_offset;
+    Uint32  strings_offset;
+    Uint32  strings_size;
+} __attribute__((__packed__)) HFCL_VIEWTMPL_HEADER;
+
+typedef struct _HFCL_VIEWTMPL_NODE {
+    Uint16  parent;
+    Uint16  tag;
+    Uint16  type;
+    Uint16  cls;
+    Uint16  name;
+    Uint16  content;
+    Sint32  id;
+    Uint16  first_attr;
+    Uint16  nr_attrs;
+    Uint16  first_rule;
+    Uint16  nr_rules;
+} __attribute__((__packed__)) HFCL_VIEWTMPL_NODE;
+
+typedef struct _HFCL_VIEWTMPL_ATTR {
+    Uint16  key;
+    Uint16  value;
+} __attribute__((__packed__)) HFCL_VIEWTMPL_ATTR;
+
+typedef struct _HFCL_VIEWTMPL_RULE {
+    Uint16  css;
+    Uint16  flags;
+    Uint32  specif;
+} __attribute__((__packed__)) HFCL_VIEWTMPL_RULE;
+
+namespace hfcl {
+
+class CssDeclared;
+class CssDeclaredGroup;
+
+/*
+ * ViewTemplate creates a view tree from a compiled view template in one
+ * pass over its nodes.
+ *
+ * The view creators of the tags are looked up once, when the template
+ * is opened. The CSS rules of each node are taken from the template if
+ * they were matched for the CSS group in use; otherwise they are matched
+ * once, on the first instance, and kept for the following ones. So a
+ * template must be instantiated in the same context each time, as the
+ * rows of a list are; selectors on the ancestors of the template root
+ * are matched with the parent of the first instance.
+ *
+ * The views come from SmallAllocator if it is enabled; see View.
+ */
+class ViewTemplate {
+public:
+    // the data is not copied; it must live as long as the template,
+    // as a mapped package entry or a static array does, and be 4-byte
+    // aligned. returns NULL if the data is not a valid template
+    static ViewTemplate* open(const void* data, size_t size);
+    ~ViewTemplate();
+
+    int nrNodes() const { return m_header->nr_nodes; }
+
+    // the CSS group whose rules the views get; 0 for no CSS
+    bool setCssGroup(HTResId cssgId);
+
+    // creates the views and adds the root view to the parent if it is
+    // not NULL; returns the root view
+    View* instantiate(ViewContainer* parent);
+
+private:
+    struct MatchedCss {
+        CssDeclared* css;
+        DWORD specif;
+        bool dynamic;
+    };
+
+    ViewTemplate();
+    bool check(size_t size) const;
+    const char* atom(Uint16 index) const {
+        return index == HFCL_VIEWTMPL_NONE ? NULL :
+            m_strings + m_atoms[index];
+    }
+    bool loadRules();
+    void matchRules(View** views);
+
+    const HFCL_VIEWTMPL_HEADER* m_header;
+    const HFCL_VIEWTMPL_NODE* m_nodes;
+    const HFCL_VIEWTMPL_ATTR* m_attrs;
+    const HFCL_VIEWTMPL_RULE* m_rules;
+    const Uint32* m_atoms;
+    const char* m_strings;
+
+    CB_VIEW_CREATOR* m_creators;
+    // the views of the nodes being instantiated
+    View** m_views;
+
+    HTResId m_cssgId;
+    CssDeclaredGroup* m_cssg;
+    // the rules of node i are m_matched[m_firstMatched[i]] to
+    // m_matched[m_firstMatched[i + 1] - 1]; NULL if not matched yet
+    MatchedCss* m_matched;
+    int* m_firstMatched;
+};
+
+} // namespace hfcl
+
+#endif /* HFCL_VIEW_VIEWTEMPLATE_H_ */
@@ -0,0 +1,169 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HFCL_VIEW_VIRTUALLISTVIEW_H_
+#define HFCL_VIEW_VIRTUALLISTVIEW_H_
+
+#include "../view/viewcontainer.h"
+#include "../view/kineticscroller.h"
+#include "../services/framescheduler.h"
+
+namespace hfcl {
+
+// TUNNING CONDITION: the rows bound beyond each edge of the viewport
+#define VLIST_OVERSCAN_ROWS         1
+
+/*
+ * ListAdapter gives the rows of a VirtualListView. The list view only
+ * asks for the rows which are on screen.
+ */
+class ListAdapter : public RefCount {
+public:
+    ListAdapter() { }
+    virtual ~ListAdapter() { }
+
+    virtual int getCount() = 0;
+    // the views of one type are recycled for the rows of the same type
+    virtual int getViewType(int row) { return 0; }
+    virtual View* createView(int viewType) = 0;
+    virtual void bindView(int row, View* view) = 0;
+    // the height of the row; -1 for the default row height of the list
+    virtual int getRowHeight(int row) { return -1; }
+};
+
+/*
+ * VirtualListView keeps item views only for the rows on screen. When a
+ * row scrolls out, its view is kept in a spare pool of its view type
+ * and is bound to the next row of that type which scrolls in, so the
+ * views ever created are no more than the rows once on screen.
+ *
+ * All rows have the default height until the adapter tells another one
+ * when the row is bound. The heights are kept in a Fenwick tree of
+ * prefix sums, so the offset of a row, the row at an offset and a
+ * height change are all O(log n). The tree is allocated only after a
+ * row has a height other than the default one.
+ *
+ * Dragging and the mouse wheel scroll the list kinetically, one step per
+ * frame of the FrameScheduler. A step moves the pixels still on
+ * screen with one blit and repaints only the rows exposed, so a frame
+ * costs the exposed strip instead of the whole viewport. Turn the blit
+ * off with setScrollBlit(false) if other views overlap the list.
+ */
+class VirtualListView : public ViewContainer, public FrameClient {
+public:
+    VirtualListView(const char* vtag, const char* vtype,
+            const char* vclass = NULL, const char* vname = NULL, int vid = 0);
+    virtual ~VirtualListView();
+
+    ListAdapter* adapter() const { return m_adapter; }
+    void setAdapter(ListAdapter* adapter);
+    // call it after the rows of the adapter changed
+    void notifyDataSetChanged();
+    // call it after the content (and the height) of one row changed
+    void notifyRowChanged(int row);
+
+    int defaultRowHeight() const { return m_defaultHeight; }
+    void setDefaultRowHeight(int height);
+
+    int rowCount() const { return m_rowCount; }
+    int contentHeight() const;
+    int rowOffset(int row) const;
+    int rowHeight(int row) const;
+    // the row at the offset from the top of the content; -1 if none
+    int rowAtOffset(int y) const;
+
+    int scrollOffset() const { return m_scrollY; }
+    // scrolls at once, stopping the kinetic scroll if any
+    void scrollTo(int y);
+    void scrollBy(int dy) { scrollTo(m_scrollY + dy); }
+    void scrollToRow(int row);
+    // velocity in pixels per second; positive to scroll down the content
+    void fling(int velocity);
+    bool isScrolling() const {
+        return FrameScheduler::getInstance()->hasClient(this);
+    }
+
+    bool scrollBlit() const { return m_scrollBlit; }
+    void setScrollBlit(bool blit) { m_scrollBlit = blit; }
+
+    int firstVisibleRow() const { return m_firstRow; }
+    int lastVisibleRow() const { return m_firstRow + m_nrActive - 1; }
+    // the view bound to the row, or NULL if the row is not on screen
+    View* viewOfRow(int row);
+    // the row of the point in the view coordinates; -1 if none
+    int rowAt(int x, int y) const;
+
+    virtual bool setRect(const IntRect& irc);
+
+    virtual void drawContent(GraphicsContext* context, IntRect &rc);
+    virtual bool onKeyEvent(const KeyEvent& evt);
+    virtual bool onMouseEvent(const MouseEvent& evt);
+    virtual bool onMouseWheelEvent(const MouseWheelEvent& evt);
+
+    virtual bool onFrame(Uint32 ticks);
+
+protected:
+    virtual void layOut(CssBox* ctnBlock);
+
+private:
+    struct ItemSlot {
+        View* view;
+        int type;
+    };
+
+    VECTOR(ItemSlot, ItemSlotVec);
+
+    // Fenwick tree of the row heights
+    void buildHeightTree();
+    void setRowHeight(int row, int height);
+
+    void layoutRows();
+    void moveContent(int scrollY, int overscroll);
+    void startFrames();
+    void stopFrames();
+    void recycleAll();
+    void recycle(const ItemSlot& slot);
+    View* obtainView(int type);
+    int bindRow(int row, ItemSlot* slot);
+
+    ListAdapter* m_adapter;
+    int m_rowCount;
+    int m_defaultHeight;
+    int m_scrollY;
+    // the content is drawn m_overscroll pixels beyond an edge
+    int m_overscroll;
+
+    KineticScroller m_scroller;
+    bool m_scrollBlit;
+
+    int* m_heightTree;
+    int  m_treeMask;
+
+    // the rows on screen are m_firstRow ... m_firstRow + m_nrActive - 1
+    int m_firstRow;
+    int m_nrActive;
+    ItemSlotVec m_active;
+    ItemSlotVec m_spare;
+};
+
+} // namespace hfcl
+
+#endif /* HFCL_VIEW_VIRTUALLISTVIEW_H_ */
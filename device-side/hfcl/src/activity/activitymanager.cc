@@ -221,6 +221,11 @@ bool ActivityManager::pushActivityRunningInBackground(const char * name)
 
     if (act->getState() == BaseActivity::RUNNING)
     {
+        // shown at once when the activity comes back to the front
+        Window* window = act->getWindow();
+        if (window)
+            window->takeSnapshot();
+
         act->setState(BaseActivity::SLEEP);
         act->onSleep();
     }
@@ -272,6 +277,11 @@ BaseActivity* ActivityManager::popActivityRunningToFrontdesk(const char * name)
           if(NULL == (act = curActivity->getActivity())) {
             return NULL;
         }
+
+        // the last frame first, then the views repaint over it
+        Window* window = act->getWindow();
+        if (window)
+            window->showSnapshot();
         act->onMove2Top();
 
         if (act->getState() == BaseActivity::SLEEP)
@@ -309,7 +319,12 @@ BaseActivity* ActivityManager::startActivity(utf8string act_name, Intent *intent
     BaseActivity* _newActivity = NULL;
 
     _DBG_PRINTF ("Activitymanager :: startActivity () ----  act [%s]", act_name.c_str());
-    _newActivity = getActivityFromFactory(act_name);
+    bool preloaded = false;
+    _newActivity = takePreloadedActivity(act_name);
+    if (_newActivity)
+        preloaded = true;
+    else
+        _newActivity = getActivityFromFactory(act_name);
     _curTopActivityInfo = m_actstack.top();
 
     if(_curTopActivityInfo != NULL)
@@ -334,7 +349,18 @@ BaseActivity* ActivityManager::startActivity(utf8string act_name, Intent *intent
         _newActivity->setName(act_name.c_str());
         m_actstack.push(act_info);
 
-        _newActivity->onCreate(NULL, intent);
+        if (preloaded) {
+            Window* window = _newActivity->getWindow();
+            if (window) {
+                window->show();
+                window->setActiveWindow(window->getSysWindow());
+            }
+            if (intent)
+                _newActivity->onNewIntent(intent);
+        }
+        else {
+            _newActivity->onCreate(NULL, intent);
+        }
 
         if(NULL != (_top = m_actstack.top()) && _top->getActivity() == _newActivity)
         {
@@ -344,9 +370,86 @@ BaseActivity* ActivityManager::startActivity(utf8string act_name, Intent *intent
     return _newActivity;
 }
 
-void ActivityManager::registerActivity(utf8string name, ActivityFactory *actfactory)
+void ActivityManager::registerActivity(utf8string name,
+        ActivityFactory *actfactory, bool preload)
 {
     m_acts[name] = actfactory;
+    if (preload)
+        m_preloaded[name] = NULL;
+}
+
+bool ActivityManager::preloadActivity()
+{
+    PreloadedActivityMap::iterator it;
+    for (it = m_preloaded.begin(); it != m_preloaded.end(); ++it) {
+        if ((*it).second != NULL || getActivityByName((*it).first.c_str()))
+            continue;
+
+        utf8string name = (*it).first;
+        BaseActivity* act = getActivityFromFactory(name);
+        if (act == NULL)
+            continue;
+
+        _DBG_PRINTF ("ActivityManager::preloadActivity: preload act [%s]",
+                name.c_str());
+        act->setName(name.c_str());
+
+        // the window is created hidden, and waits under the current
+        // activity; it is hidden again if onCreate shows it
+        Window* window = act->getWindow();
+        if (window)
+            window->setCreateHidden(true);
+        act->onCreate(NULL, NULL);
+        act->setState(BaseActivity::SLEEP);
+        if (window) {
+            window->setCreateHidden(false);
+            window->hide();
+        }
+
+        ActivityInfo* top = m_actstack.top();
+        if (top && top->getActivity() && top->getActivity()->getWindow()) {
+            window = top->getActivity()->getWindow();
+            window->setActiveWindow(window->getSysWindow());
+        }
+
+        m_preloaded[name] = act;
+        return true;
+    }
+
+    return false;
+}
+
+void ActivityManager::destroyPreloadedActivities()
+{
+    PreloadedActivityMap::iterator it;
+    for (it = m_preloaded.begin(); it != m_preloaded.end(); ++it) {
+        BaseActivity* act = (*it).second;
+        if (act == NULL)
+            continue;
+
+        _DBG_PRINTF ("ActivityManager::destroyPreloadedActivities: "
+                "destroy act [%s]", (*it).first.c_str());
+        (*it).second = NULL;
+        act->onDestroy(NULL);
+        HFCL_DELETE(act);
+    }
+}
+
+ActivityManager::~ActivityManager()
+{
+    destroyPreloadedActivities();
+}
+
+BaseActivity* ActivityManager::takePreloadedActivity(const utf8string& name)
+{
+    PreloadedActivityMap::iterator it = m_preloaded.find(name);
+    if (it == m_preloaded.end())
+        return NULL;
+
+    BaseActivity* act = (*it).second;
+    // preloaded again when idle, after this one exits
+    m_preloaded[name] = NULL;
+    return act;
 }
 
 BaseActivity* ActivityManager::getActivityFromFactory(utf8string name)
@@ -378,6 +481,10 @@ LRESULT ActivityManager::defaultHostingProc(HWND hWnd, UINT message, WPARAM wPar
         case MSG_CLOSE:
             DestroyMainWindow(hWnd);
             break;
+        case MSG_IDLE:
+            // warm up the preloadable activities
+            getInstance()->preloadActivity();
+            break;
         default:
             break;
     }
@@ -417,6 +524,7 @@ bool ActivityManager::init()
         return false;
     }
     ShowWindow(m_hostingWnd, SW_SHOWNORMAL);
+    m_eventQueue.setWakeupWindow(m_hostingWnd);
 
     m_key_hook = NULL;
     m_charFreezon = true;
@@ -441,6 +549,16 @@ void ActivityManager::run(void)
     MSG Msg;
     while (TRUE) {
         if (GetMessage(&Msg, m_hostingWnd)) {
+            // the events posted from the other threads; the wakeup message
+            // drains even when an earlier message got to its events first,
+            // since draining is also what lets the next post wake us again
+            if (Msg.message == MGCL_MSG_POSTEDEVENTS) {
+                m_eventQueue.drain();
+                continue;
+            }
+            if (m_eventQueue.depth() > 0)
+                m_eventQueue.drain();
+
             // update lcd service and key tone FIXME
             if (Msg.hwnd == HWND_DESKTOP
                 && ( Msg.message == MSG_KEYDOWN
@@ -459,6 +577,8 @@ void ActivityManager::run(void)
         else
             break;
     }
+
+    destroyPreloadedActivities();
 }
 
 void ActivityManager::startTimerService(void)
@@ -0,0 +1,252 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "activity/eventqueue.h"
+
+#include <time.h>
+
+namespace hfcl {
+
+static unsigned long long now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void PostedEvent::release()
+{
+    EventPool* pool = m_pool;
+
+    if (pool) {
+        this->~PostedEvent();
+        pool->freeBlock(this);
+    }
+    else {
+        HFCL_DELETE(this);
+    }
+}
+
+void PostedUserEvent::deliver()
+{
+    if (m_target) {
+        UserEvent event(m_type, m_param, m_exParam);
+        m_target->raiseEvent(&event);
+    }
+}
+
+EventPool::EventPool(size_t eventSize, int nrEvents)
+    : m_blocks(NULL)
+    , m_next(NULL)
+    , m_nrBlocks(0)
+    , m_free(0)
+    , m_misses(0)
+{
+    // keep the blocks aligned as malloc does
+    m_blockSize = (eventSize + 15) & ~(size_t)15;
+
+    if (nrEvents > 0xFFFE)
+        nrEvents = 0xFFFE;
+    if (nrEvents <= 0)
+        return;
+
+    m_blocks = (Uint8*)HFCL_MALLOC(m_blockSize * nrEvents);
+    m_next = (Uint16*)HFCL_MALLOC(sizeof(Uint16) * nrEvents);
+    if (m_blocks == NULL || m_next == NULL) {
+        _ERR_PRINTF("EventPool: failed to allocate %d events\n", nrEvents);
+        HFCL_FREE(m_blocks);
+        HFCL_FREE(m_next);
+        m_blocks = NULL;
+        m_next = NULL;
+        return;
+    }
+
+    m_nrBlocks = nrEvents;
+    for (int i = 0; i < nrEvents; i++)
+        m_next[i] = (i + 1 < nrEvents) ? i + 2 : 0;
+    m_free = 1;
+}
+
+EventPool::~EventPool()
+{
+    HFCL_FREE(m_blocks);
+    HFCL_FREE(m_next);
+}
+
+void* EventPool::allocBlock()
+{
+    Uint32 head = __atomic_load_n(&m_free, __ATOMIC_ACQUIRE);
+
+    for (;;) {
+        Uint32 index = head & 0xFFFF;
+        if (index == 0) {
+            __atomic_add_fetch(&m_misses, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+
+        // m_next may be stale here; the tag makes the exchange fail then
+        Uint32 next = __atomic_load_n(&m_next[index - 1], __ATOMIC_RELAXED);
+        Uint32 update = ((head + 0x10000) & 0xFFFF0000) | next;
+        if (__atomic_compare_exchange_n(&m_free, &head, update, true,
+                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return m_blocks + (index - 1) * m_blockSize;
+    }
+}
+
+void EventPool::freeBlock(void* block)
+{
+    Uint32 index = ((Uint8*)block - m_blocks) / m_blockSize + 1;
+    Uint32 head = __atomic_load_n(&m_free, __ATOMIC_RELAXED);
+
+    for (;;) {
+        __atomic_store_n(&m_next[index - 1], (Uint16)(head & 0xFFFF),
+                __ATOMIC_RELAXED);
+        Uint32 update = ((head + 0x10000) & 0xFFFF0000) | index;
+        if (__atomic_compare_exchange_n(&m_free, &head, update, true,
+                    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            return;
+    }
+}
+
+EventQueue::EventQueue()
+    : m_head(&m_stub)
+    , m_tail(&m_stub)
+    , m_depth(0)
+    , m_wakeup(0)
+    , m_hwnd(HWND_INVALID)
+{
+    resetStats();
+}
+
+EventQueue::~EventQueue()
+{
+    PostedEvent* event;
+
+    while ((event = pop()) != NULL)
+        event->release();
+}
+
+void EventQueue::push(PostedEvent* event)
+{
+    __atomic_store_n(&event->m_next, (PostedEvent*)NULL, __ATOMIC_RELAXED);
+    PostedEvent* prev = __atomic_exchange_n(&m_head, event, __ATOMIC_ACQ_REL);
+    // the consumer can not see the event until this store
+    __atomic_store_n(&prev->m_next, event, __ATOMIC_RELEASE);
+}
+
+PostedEvent* EventQueue::pop()
+{
+    PostedEvent* tail = m_tail;
+    PostedEvent* next = __atomic_load_n(&tail->m_next, __ATOMIC_ACQUIRE);
+
+    if (tail == &m_stub) {
+        if (next == NULL)
+            return NULL;
+        m_tail = next;
+        tail = next;
+        next = __atomic_load_n(&tail->m_next, __ATOMIC_ACQUIRE);
+    }
+
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+
+    // a producer is linking an event after the tail; try it later
+    if (tail != __atomic_load_n(&m_head, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    // the tail is the last event; put the stub after it to take it
+    push(&m_stub);
+    next = __atomic_load_n(&tail->m_next, __ATOMIC_ACQUIRE);
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+void EventQueue::post(PostedEvent* event)
+{
+    event->m_postTime = now_us();
+    push(event);
+    __atomic_add_fetch(&m_depth, 1, __ATOMIC_RELAXED);
+
+    if (__atomic_exchange_n(&m_wakeup, 1, __ATOMIC_ACQ_REL) == 0
+            && m_hwnd != HWND_INVALID) {
+        if (PostMessage(m_hwnd, MGCL_MSG_POSTEDEVENTS, 0, 0) != 0) {
+            // the message queue is full; the next post tries again,
+            // and the UI loop drains the queue once per message anyway
+            __atomic_store_n(&m_wakeup, 0, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+int EventQueue::drain()
+{
+    // the events posted from now on wake the UI loop again
+    __atomic_exchange_n(&m_wakeup, 0, __ATOMIC_ACQ_REL);
+
+    // do not deliver the events posted while delivering, or a busy
+    // poster can hold the UI thread here
+    int pending = depth();
+    if (pending > m_stats.maxDepth)
+        m_stats.maxDepth = pending;
+
+    int count = 0;
+    PostedEvent* event;
+    while (count < pending && (event = pop()) != NULL) {
+        __atomic_sub_fetch(&m_depth, 1, __ATOMIC_RELAXED);
+
+        unsigned int latency = (unsigned int)(now_us() - event->m_postTime);
+        m_stats.lastLatency = latency;
+        if (latency > m_stats.maxLatency)
+            m_stats.maxLatency = latency;
+        m_stats.totalLatency += latency;
+
+        event->deliver();
+        event->release();
+        count++;
+    }
+
+    m_stats.delivered += count;
+    m_stats.drains++;
+    return count;
+}
+
+void EventQueue::resetStats()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void EventQueue::dumpStats()
+{
+    unsigned int average = m_stats.delivered ?
+        (unsigned int)(m_stats.totalLatency / m_stats.delivered) : 0;
+
+    _MG_PRINTF("EventQueue: %u events in %u drains, depth %d (now), "
+            "%d (max), latency %u us (average), %u us (max)\n",
+            m_stats.delivered, m_stats.drains, depth(), m_stats.maxDepth,
+            average, m_stats.maxLatency);
+}
+
+} // namespace hfcl
@@ -23,6 +23,7 @@
 #undef DEBUG
 
 #include "activity/window.h"
+#include "services/framescheduler.h"
 
 #include <minigui/minigui.h>
 #include <minigui/gdi.h>
@@ -45,12 +46,16 @@ namespace hfcl {
 Window::Window()
     : m_sysWnd(HWND_INVALID)
     , m_rootView(0)
+    , m_snapshot(HDC_INVALID)
+    , m_createHidden(false)
 {
 }
 
 Window::~Window()
 {
     destroy();
+    dropSnapshot();
+    FrameScheduler::getInstance()->cancelPaint(this);
 }
 
 bool Window::create(HWND hosting, int x, int y, int w, int h, bool visible)
@@ -61,6 +66,9 @@ bool Window::create(HWND hosting, int x, int y, int w, int h, bool visible)
 
     MAINWINCREATE CreateInfo;
 
+    if (m_createHidden)
+        visible = false;
+
     CreateInfo.dwStyle = visible?WS_VISIBLE:WS_NONE;
     CreateInfo.dwExStyle = WS_EX_NONE;
     CreateInfo.spCaption = "HVRoot Main Window";
@@ -176,6 +184,9 @@ void Window::asyncUpdateRect(int x, int y, int w, int h, bool upBackGnd)
     _DBG_PRINTF ("Window::asyncUpdateRect called with (%d, %d, %d, %d)",
                  rc.left, rc.top, rc.right, rc.bottom);
     InvalidateRect(m_sysWnd, &rc, FALSE);
+
+    // the changes made in an animation frame are painted together
+    FrameScheduler::getInstance()->requestPaint(this);
 }
 
 void Window::syncUpdateRect(int x, int y, int w, int h, bool upBackGnd)
@@ -186,6 +197,62 @@ void Window::syncUpdateRect(int x, int y, int w, int h, bool upBackGnd)
     UpdateInvalidClient (m_sysWnd, FALSE);
 }
 
+void Window::scrollRect(const IntRect& irc, int dx, int dy)
+{
+    RECT rc = {irc.left(), irc.top(), irc.right(), irc.bottom()};
+
+    // MiniGUI also moves the invalid region in the rect
+    ScrollWindow(m_sysWnd, dx, dy, &rc, &rc);
+    FrameScheduler::getInstance()->requestPaint(this);
+}
+
+void Window::flushUpdates()
+{
+    UpdateInvalidClient(m_sysWnd, FALSE);
+}
+
+bool Window::takeSnapshot()
+{
+    RECT rc;
+
+    dropSnapshot();
+    if (m_sysWnd == HWND_INVALID || !IsWindowVisible(m_sysWnd))
+        return false;
+
+    GetClientRect(m_sysWnd, &rc);
+    HDC hdc = GetClientDC(m_sysWnd);
+    m_snapshot = CreateCompatibleDCEx(hdc, RECTW(rc), RECTH(rc));
+    if (m_snapshot != HDC_INVALID)
+        BitBlt(hdc, 0, 0, RECTW(rc), RECTH(rc), m_snapshot, 0, 0, 0);
+    ReleaseDC(hdc);
+
+    return m_snapshot != HDC_INVALID;
+}
+
+bool Window::showSnapshot()
+{
+    if (m_snapshot == HDC_INVALID)
+        return false;
+
+    ShowWindow(m_sysWnd, SW_SHOWNORMAL);
+    SetActiveWindow(m_sysWnd);
+
+    HDC hdc = GetClientDC(m_sysWnd);
+    BitBlt(m_snapshot, 0, 0, 0, 0, hdc, 0, 0, 0);
+    ReleaseDC(hdc);
+
+    dropSnapshot();
+    return true;
+}
+
+void Window::dropSnapshot()
+{
+    if (m_snapshot != HDC_INVALID) {
+        DeleteCompatibleDC(m_snapshot);
+        m_snapshot = HDC_INVALID;
+    }
+}
+
 void Window::drawBackground(GraphicsContext* context, IntRect &rc)
 {
     context->fillRect(rc,
@@ -362,6 +429,8 @@ LRESULT Window::commWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lP
                 root->onPaint(&gc);
 
                 if (!IsWindowEnabled(hWnd)) {
+                    // the text of the views goes under the dim overlay
+                    gc.flush();
                     GraphicsContext overlay_gc (hdc);
                     overlay_gc.fillRect(rcInv, 0, 0, 0, 256*3/10);
                 }
@@ -32,6 +32,7 @@ AlphaViewAnimation::AlphaViewAnimation(View* view, int endAlpha)
 
 AlphaViewAnimation::~AlphaViewAnimation()
 {
+    applyPendingValue();
 }
 
 void AlphaViewAnimation::setProperty(int id, void* value)
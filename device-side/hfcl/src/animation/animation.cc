@@ -24,6 +24,30 @@
 
 namespace hfcl {
 
+static int variant_size(enum EffVariantType varianttype)
+{
+    switch (varianttype) {
+    case MGEFF_INT:
+        return sizeof(int);
+    case MGEFF_FLOAT:
+        return sizeof(float);
+    case MGEFF_DOUBLE:
+        return sizeof(double);
+    case MGEFF_POINT:
+        return sizeof(POINT);
+    case MGEFF_POINTF:
+        return sizeof(float) * 2;
+    case MGEFF_3DPOINT:
+        return sizeof(int) * 3;
+    case MGEFF_3DPOINTF:
+        return sizeof(float) * 3;
+    case MGEFF_RECT:
+        return sizeof(RECT);
+    default:
+        return 0;
+    }
+}
+
 int Animation::initAnimation()
 {
     //FIXED: cannot call mGEffInit when init,
@@ -41,6 +65,9 @@ void Animation::deinitAnimation()
 Animation::Animation(enum EffVariantType varianttype)
 {
     m_stop_in_progress = false;
+    m_value_size = variant_size(varianttype);
+    m_value_pending = false;
+    m_pending_id = 0;
     static int _mgeff_is_inited = 0;
     // init the mGEff when needed!
     if(!_mgeff_is_inited)
@@ -61,12 +88,17 @@ Animation::Animation(enum EffVariantType varianttype)
 
 Animation::Animation(void)
     :m_animation(0) ,m_stop_in_progress(false)
+    ,m_value_size(0) ,m_value_pending(false), m_pending_id(0)
 {
 
 }
 
 Animation::~Animation(void)
 {
+    // setProperty() is no longer callable here; the subclasses apply the
+    // last value in their destructors, see applyPendingValue()
+    dropPendingValue();
+
     if (getCurState() != MGEFF_STATE_REMOVE)
         mGEffAnimationSetContext(m_animation, NULL);
 
@@ -79,6 +111,8 @@ void Animation::_finishcb(MGEFF_ANIMATION handle)
     Animation *animation = (Animation*)mGEffAnimationGetContext(handle);
     if(animation)
     {
+        // the last value is set now, not one frame after the end
+        animation->applyPendingValue();
         //把animation纳入到NGUX的事件机制中，这里暂不实?
     }
 }
@@ -86,11 +120,50 @@ void Animation::_finishcb(MGEFF_ANIMATION handle)
 void Animation::_setProperty(MGEFF_ANIMATION handle, void *target, int id, void *value)
 {
     Animation *animation = (Animation*)mGEffAnimationGetContext(handle);
-    if(animation) {
+    if (animation == NULL)
+        return;
+
+    if (animation->m_value_size == 0 || value == NULL) {
         animation->setProperty(id, value);
+        return;
+    }
+
+    // keep the last value only; it is set in the next frame
+    memcpy(animation->m_pending_value.bytes, value, animation->m_value_size);
+    animation->m_pending_id = id;
+    if (!animation->m_value_pending) {
+        animation->m_value_pending = true;
+        FrameScheduler::getInstance()->addClient(animation);
+    }
+}
+
+void Animation::applyPendingValue()
+{
+    if (m_value_pending) {
+        dropPendingValue();
+        setProperty(m_pending_id, m_pending_value.bytes);
     }
 }
 
+void Animation::dropPendingValue()
+{
+    if (m_value_pending) {
+        m_value_pending = false;
+        FrameScheduler::getInstance()->removeClient(this);
+    }
+}
+
+bool Animation::onFrame(Uint32 ticks)
+{
+    if (m_value_pending) {
+        m_value_pending = false;
+        setProperty(m_pending_id, m_pending_value.bytes);
+    }
+
+    // added again by the next value
+    return false;
+}
+
 void Animation::setAttribute(int id, int value)
 {
     mGEffAnimationSetProperty(m_animation, (enum EffAnimProperty)id, value);
@@ -155,6 +228,9 @@ void Animation::stop(void)
         m_stop_in_progress = true;
         mGEffAnimationStop(m_animation);
     }
+
+    // a value set by the caller after stop() is not overwritten later
+    dropPendingValue();
 }
 
 void Animation::pause(void)
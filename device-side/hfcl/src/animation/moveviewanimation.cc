@@ -33,6 +33,11 @@ MoveViewAnimation::MoveViewAnimation(View *view, Point pt)
     setPoint(pt);
 }
 
+MoveViewAnimation::~MoveViewAnimation()
+{
+    applyPendingValue();
+}
+
 void MoveViewAnimation::onStart()
 {
     Point oldPt;
@@ -23,112 +23,180 @@
 
 namespace hfcl {
 
-bool EventBroadcaster::raiseEvent (Event* event)
+EventListenerArray::EventListenerArray(bool refs, bool newestFirst)
+    : m_items(NULL)
+    , m_count(0)
+    , m_capacity(0)
+    , m_nrRemoved(0)
+    , m_released(NULL)
+    , m_nrReleased(0)
+    , m_releasedCapacity(0)
+    , m_raising(0)
+    , m_version(0)
+    , m_refs(refs)
+    , m_newestFirst(newestFirst)
 {
-    EventListenerList::iterator it, next;
+}
 
-    if(m_listeners.size() <= 0)
-        return true;
+EventListenerArray::~EventListenerArray()
+{
+    clear();
+    HFCL_FREE(m_items);
+    HFCL_FREE(m_released);
+}
 
-    for (it = m_listeners.begin(); it != m_listeners.end(); ){
-        m_current_raise = *it;
-        next = ++it;
+void EventListenerArray::add(EventListener* listener)
+{
+    if (m_count == m_capacity) {
+        int capacity = m_capacity ? m_capacity * 2 : 4;
+        EventListener** items = (EventListener**)HFCL_REALLOC(m_items,
+                sizeof(EventListener*) * capacity);
+        if (items == NULL) {
+            _ERR_PRINTF("EventListenerArray: failed to add a listener\n");
+            return;
+        }
+
+        m_items = items;
+        m_capacity = capacity;
+    }
 
-        // hal_HstSendEvent(0xcc9cFFFF);
-        if(m_current_raise) {
-             // hal_HstSendEvent((UINT32)(m_current_raise));
-            m_current_raise->handler(event);
+    if (m_refs)
+        listener->ref();
+    m_items[m_count++] = listener;
+    m_version++;
+}
+
+void EventListenerArray::remove(EventListener* listener)
+{
+    bool found = false;
+
+    for (int i = 0; i < m_count; i++) {
+        if (m_items[i] == listener) {
+            m_items[i] = NULL;
+            m_nrRemoved++;
+            found = true;
+            if (m_refs)
+                release(listener);
         }
+    }
 
-        // in handler, some may be removed, so we need to see.
-        if(m_want_to_remove) {
-            // 1. remove current one, we just remove it here
-            if(m_want_to_remove == m_current_raise) {
-                m_listeners.remove(m_want_to_remove);
-            }
-            // 2. remove next one, we just jump over "next", then remove "next"
-            // it now is next, we so
-            else if(m_want_to_remove == (*next)) {
-                // end? we are done, no need to remove
-                if(next == m_listeners.end())
-                    break;
-
-                // not end? we should move next->next
-                ++it;
-
-                // then real remove "next"
-                m_listeners.remove(*next);
-            }
-            // 3. remove other, we just remove here, everything is OK
-            else {
-                m_listeners.remove(m_want_to_remove);
-            }
-
-            m_want_to_remove = NULL;
+    if (found) {
+        m_version++;
+        if (m_raising == 0)
+            compact();
+    }
+}
+
+void EventListenerArray::clear()
+{
+    for (int i = 0; i < m_count; i++) {
+        EventListener* listener = m_items[i];
+        if (listener) {
+            m_items[i] = NULL;
+            m_nrRemoved++;
+            if (m_refs)
+                release(listener);
         }
     }
 
-    m_want_to_remove = NULL;
-    m_current_raise = NULL;
-    return true;
+    m_version++;
+    if (m_raising == 0)
+        compact();
 }
 
-void EventBroadcaster::addEventListener(EventListener* listener)
+void EventListenerArray::compact()
 {
-    if (NULL == listener) {
-        return;
+    int n = 0;
+
+    for (int i = 0; i < m_count; i++) {
+        if (m_items[i])
+            m_items[n++] = m_items[i];
     }
 
-    // we push back that if add when raiseEvent it is OK
-    m_listeners.push_back(listener);
+    m_count = n;
+    m_nrRemoved = 0;
+
+    // an unref may remove or add listeners again
+    while (m_nrReleased > 0)
+        m_released[--m_nrReleased]->unref();
 }
 
-void EventBroadcaster::removeEventListener(EventListener* listener)
+// a listener removed while raising may be the one being called, so its
+// reference is dropped by compact()
+void EventListenerArray::release(EventListener* listener)
 {
-    if (NULL == listener) {
+    if (m_raising == 0) {
+        listener->unref();
         return;
     }
 
-    // FIXME, remove when raiseEvent, we need to avoid abort
-    // 1. if we are in raiseEvent, we can NOT remove, we just mark the object
-    // we will remove in raiseEvent.
-    if (m_current_raise != NULL) {
-        m_want_to_remove = listener;
+    if (m_nrReleased == m_releasedCapacity) {
+        int capacity = m_releasedCapacity ? m_releasedCapacity * 2 : 4;
+        EventListener** released = (EventListener**)HFCL_REALLOC(m_released,
+                sizeof(EventListener*) * capacity);
+        if (released == NULL) {
+            _ERR_PRINTF("EventListenerArray: failed to defer an unref\n");
+            listener->unref();
+            return;
+        }
+
+        m_released = released;
+        m_releasedCapacity = capacity;
     }
-    // 2. if we are not in raiseEvent, we just remove it.
-    else {
-        m_listeners.remove(listener);
+
+    m_released[m_nrReleased++] = listener;
+}
+
+bool EventListenerArray::raise(Event* event, bool stopOnHandled)
+{
+    // the listeners added from now on are after n; and no listener
+    // moves until the outermost raise() ends
+    int n = m_count;
+    bool handled = false;
+
+    m_raising++;
+    for (int i = 0; i < n; i++) {
+        EventListener* listener = m_items[m_newestFirst ? n - 1 - i : i];
+        if (listener && listener->handler(event)) {
+            handled = true;
+            if (stopOnHandled)
+                break;
+        }
     }
+
+    if (--m_raising == 0 && m_nrRemoved > 0)
+        compact();
+    return handled;
 }
 
-void EventBroadcaster::releaseEventListeners()
+bool EventBroadcaster::raiseEvent(Event* event)
 {
-    EventListenerList::iterator _listener;
-    EventListenerList::iterator _temp;
+    m_listeners.raise(event, false);
+    return true;
+}
 
-    if (m_listeners.size() <= 0) {
+void EventBroadcaster::addEventListener(EventListener* listener)
+{
+    if (NULL == listener) {
         return;
     }
 
-    _listener = m_listeners.begin();
-    _temp = _listener;
-    do {
-        ++_listener;
-        EventListener* child = *_temp;
-        if (child != NULL) {
-            // child->unref();
-            m_listeners.erase(_temp);
-        }
-        _temp = _listener;
-        if (m_listeners.size() == 0) {
-            break;
-        }
+    m_listeners.add(listener);
+}
+
+void EventBroadcaster::removeEventListener(EventListener* listener)
+{
+    if (NULL == listener) {
+        return;
     }
-    while (true);
 
-    m_current_raise = NULL;
-    m_want_to_remove = NULL;
+    // the listeners being called are not moved; see EventListenerArray
+    m_listeners.remove(listener);
 }
 
-} // namespace hfcl
+void EventBroadcaster::releaseEventListeners()
+{
+    m_listeners.clear();
+}
 
+} // namespace hfcl
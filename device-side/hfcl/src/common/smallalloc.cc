@@ -0,0 +1,369 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "common/smallalloc.h"
+#include "common/log.h"
+
+#include <pthread.h>
+
+namespace hfcl {
+
+#ifdef _HFCL_SMALL_ALLOC
+static bool s_enabled = true;
+#else
+static bool s_enabled = false;
+#endif
+
+// TUNNING CONDITION: the object sizes of the size classes
+static const Uint16 class_sizes[] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512,
+    640, 768, 896, 1024,
+};
+
+#define NR_SIZE_CLASSES     ((int)(sizeof(class_sizes) / sizeof(class_sizes[0])))
+#define MAX_SMALL_SIZE      1024
+
+struct Slab {
+    // in the list of the slabs with free objects of the size class
+    Slab* prev;
+    Slab* next;
+    // the freed objects
+    void* freeList;
+    // the objects never allocated start here
+    Uint8* bump;
+    Uint16 sizeClass;
+    Uint16 live;
+    Uint16 capacity;
+};
+
+#define SLAB_HEADER_SIZE    ((sizeof(Slab) + 15) & ~(size_t)15)
+
+struct SizeClass {
+    Slab* partial;
+    Slab* spare;
+    int nrSpare;
+
+    unsigned int live;
+    unsigned int peak;
+    unsigned int slabs;
+    unsigned long long allocs;
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static SizeClass s_classes[NR_SIZE_CLASSES];
+// the objects from malloc
+static SizeClass s_large;
+
+// the size class for each 16 bytes of size
+static Uint8 s_class_index[MAX_SMALL_SIZE / 16 + 1];
+
+// the sorted addresses of all slabs, to tell the objects from malloc
+static Slab** s_slabs;
+static int s_nrSlabs;
+static int s_slabsCapacity;
+
+static void init_class_index()
+{
+    int c = 0;
+    for (int i = 0; i <= MAX_SMALL_SIZE / 16; i++) {
+        while (class_sizes[c] < i * 16)
+            c++;
+        s_class_index[i] = c;
+    }
+}
+
+static int find_slab(Slab* slab)
+{
+    int low = 0, high = s_nrSlabs - 1;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (s_slabs[mid] == slab)
+            return mid;
+        if (s_slabs[mid] < slab)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return -(low + 1);
+}
+
+static Slab* new_slab(int sizeClass)
+{
+    if (s_nrSlabs == s_slabsCapacity) {
+        int capacity = s_slabsCapacity ? s_slabsCapacity * 2 : 64;
+        Slab** slabs = (Slab**)HFCL_REALLOC(s_slabs, sizeof(Slab*) * capacity);
+        if (slabs == NULL)
+            return NULL;
+        s_slabs = slabs;
+        s_slabsCapacity = capacity;
+    }
+
+    void* mem = NULL;
+    if (posix_memalign(&mem, SMALLALLOC_SLAB_SIZE, SMALLALLOC_SLAB_SIZE))
+        return NULL;
+
+    Slab* slab = (Slab*)mem;
+    int pos = -(find_slab(slab) + 1);
+    memmove(s_slabs + pos + 1, s_slabs + pos,
+            sizeof(Slab*) * (s_nrSlabs - pos));
+    s_slabs[pos] = slab;
+    s_nrSlabs++;
+
+    slab->sizeClass = sizeClass;
+    slab->capacity = (SMALLALLOC_SLAB_SIZE - SLAB_HEADER_SIZE)
+        / class_sizes[sizeClass];
+    s_classes[sizeClass].slabs++;
+    return slab;
+}
+
+static void delete_slab(Slab* slab)
+{
+    int pos = find_slab(slab);
+
+    memmove(s_slabs + pos, s_slabs + pos + 1,
+            sizeof(Slab*) * (s_nrSlabs - pos - 1));
+    s_nrSlabs--;
+    s_classes[slab->sizeClass].slabs--;
+    ::free(slab);
+}
+
+static void reset_slab(Slab* slab)
+{
+    slab->prev = NULL;
+    slab->next = NULL;
+    slab->freeList = NULL;
+    slab->bump = (Uint8*)slab + SLAB_HEADER_SIZE;
+    slab->live = 0;
+}
+
+static void link_slab(SizeClass* cls, Slab* slab)
+{
+    slab->prev = NULL;
+    slab->next = cls->partial;
+    if (cls->partial)
+        cls->partial->prev = slab;
+    cls->partial = slab;
+}
+
+static void unlink_slab(SizeClass* cls, Slab* slab)
+{
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        cls->partial = slab->next;
+    if (slab->next)
+        slab->next->prev = slab->prev;
+    slab->prev = NULL;
+    slab->next = NULL;
+}
+
+static void count_alloc(SizeClass* cls)
+{
+    cls->live++;
+    cls->allocs++;
+    if (cls->live > cls->peak)
+        cls->peak = cls->live;
+}
+
+static void* alloc_large(size_t size)
+{
+    void* p = HFCL_MALLOC(size);
+
+    if (p) {
+        pthread_mutex_lock(&s_lock);
+        count_alloc(&s_large);
+        pthread_mutex_unlock(&s_lock);
+    }
+    return p;
+}
+
+void* SmallAllocator::alloc(size_t size)
+{
+    if (!s_enabled || size > MAX_SMALL_SIZE)
+        return alloc_large(size);
+
+    pthread_mutex_lock(&s_lock);
+
+    if (s_class_index[MAX_SMALL_SIZE / 16] == 0)
+        init_class_index();
+
+    int index = s_class_index[(size + 15) / 16];
+    SizeClass* cls = s_classes + index;
+    Slab* slab = cls->partial;
+
+    if (slab == NULL) {
+        if (cls->spare) {
+            slab = cls->spare;
+            cls->spare = slab->next;
+            cls->nrSpare--;
+        }
+        else {
+            slab = new_slab(index);
+            if (slab == NULL) {
+                pthread_mutex_unlock(&s_lock);
+                _ERR_PRINTF("SmallAllocator: failed to allocate a slab\n");
+                return alloc_large(size);
+            }
+        }
+
+        reset_slab(slab);
+        link_slab(cls, slab);
+    }
+
+    void* p;
+    if (slab->freeList) {
+        p = slab->freeList;
+        slab->freeList = *(void**)p;
+    }
+    else {
+        p = slab->bump;
+        slab->bump += class_sizes[index];
+    }
+
+    if (++slab->live == slab->capacity)
+        unlink_slab(cls, slab);
+    count_alloc(cls);
+
+    pthread_mutex_unlock(&s_lock);
+    return p;
+}
+
+void SmallAllocator::release(void* p)
+{
+    if (p == NULL)
+        return;
+
+    Slab* slab = (Slab*)((uintptr_t)p & ~(uintptr_t)(SMALLALLOC_SLAB_SIZE - 1));
+
+    pthread_mutex_lock(&s_lock);
+
+    if (find_slab(slab) < 0) {
+        s_large.live--;
+        pthread_mutex_unlock(&s_lock);
+        HFCL_FREE(p);
+        return;
+    }
+
+    SizeClass* cls = s_classes + slab->sizeClass;
+    *(void**)p = slab->freeList;
+    slab->freeList = p;
+    cls->live--;
+
+    if (slab->live-- == slab->capacity)
+        link_slab(cls, slab);
+
+    if (slab->live == 0) {
+        unlink_slab(cls, slab);
+        if (cls->nrSpare < SMALLALLOC_SPARE_SLABS) {
+            slab->next = cls->spare;
+            cls->spare = slab;
+            cls->nrSpare++;
+        }
+        else {
+            delete_slab(slab);
+        }
+    }
+
+    pthread_mutex_unlock(&s_lock);
+}
+
+bool SmallAllocator::isEnabled()
+{
+    return s_enabled;
+}
+
+void SmallAllocator::setEnabled(bool enabled)
+{
+    s_enabled = enabled;
+}
+
+int SmallAllocator::nrClasses()
+{
+    return NR_SIZE_CLASSES + 1;
+}
+
+bool SmallAllocator::getClassStats(int index, ClassStats* stats)
+{
+    if (index < 0 || index > NR_SIZE_CLASSES)
+        return false;
+
+    pthread_mutex_lock(&s_lock);
+
+    const SizeClass* cls;
+    if (index < NR_SIZE_CLASSES) {
+        cls = s_classes + index;
+        stats->size = class_sizes[index];
+    }
+    else {
+        cls = &s_large;
+        stats->size = 0;
+    }
+
+    stats->live = cls->live;
+    stats->peak = cls->peak;
+    stats->slabs = cls->slabs;
+    stats->allocs = cls->allocs;
+
+    size_t total = (size_t)cls->slabs * SMALLALLOC_SLAB_SIZE;
+    size_t used = (size_t)cls->live * stats->size;
+    stats->fragmentation = total ? (int)((total - used) * 100 / total) : 0;
+
+    pthread_mutex_unlock(&s_lock);
+    return true;
+}
+
+void SmallAllocator::dumpStats()
+{
+    Log* log = Log::getLog();
+    unsigned int slabs = 0;
+
+    log->logMemory("SmallAllocator: %s, slabs of %d bytes\n",
+            s_enabled ? "enabled" : "disabled", SMALLALLOC_SLAB_SIZE);
+    log->logMemory("%8s %8s %8s %6s %12s %6s\n",
+            "size", "live", "peak", "slabs", "allocs", "frag%");
+
+    for (int i = 0; i < nrClasses(); i++) {
+        ClassStats stats;
+        getClassStats(i, &stats);
+        if (stats.allocs == 0)
+            continue;
+
+        slabs += stats.slabs;
+        if (stats.size) {
+            log->logMemory("%8u %8u %8u %6u %12llu %6d\n",
+                    (unsigned int)stats.size, stats.live, stats.peak,
+                    stats.slabs, stats.allocs, stats.fragmentation);
+        }
+        else {
+            log->logMemory("%8s %8u %8u %6s %12llu %6s\n",
+                    "malloc", stats.live, stats.peak, "-",
+                    stats.allocs, "-");
+        }
+    }
+
+    log->logMemory("SmallAllocator: %u KB in slabs\n",
+            slabs * (SMALLALLOC_SLAB_SIZE / 1024));
+}
+
+} // namespace hfcl
@@ -0,0 +1,461 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "common/textbuffer.h"
+
+namespace hfcl {
+
+static inline bool is_char_start(char c)
+{
+    return (c & 0xC0) != 0x80;
+}
+
+TextBuffer::TextBuffer()
+    : m_buf(NULL)
+    , m_size(0)
+    , m_gapStart(0)
+    , m_gapEnd(0)
+    , m_length(0)
+    , m_nrChars(0)
+    , m_lines(NULL)
+    , m_lineSize(0)
+    , m_lineGapStart(0)
+    , m_lineGapEnd(0)
+    , m_nrLines(0)
+    , m_cacheByte(0)
+    , m_cacheChar(0)
+{
+    clear();
+}
+
+TextBuffer::~TextBuffer()
+{
+    if (m_buf)
+        HFCL_FREE(m_buf);
+    if (m_lines)
+        HFCL_FREE(m_lines);
+}
+
+void TextBuffer::clear()
+{
+    m_gapStart = 0;
+    m_gapEnd = m_size;
+    m_length = 0;
+    m_nrChars = 0;
+
+    m_lineGapStart = 0;
+    m_lineGapEnd = m_lineSize;
+    m_nrLines = 0;
+    m_cacheByte = 0;
+    m_cacheChar = 0;
+
+    // there is always the first line
+    if (reserveLines(1)) {
+        Line& first = m_lines[m_lineGapStart++];
+        first.byteStart = 0;
+        first.charStart = 0;
+        first.layout = -1;
+        m_nrLines = 1;
+    }
+}
+
+bool TextBuffer::setText(const char* text, int len)
+{
+    clear();
+    return insert(0, text, len);
+}
+
+void TextBuffer::getText(std::string& text) const
+{
+    text.assign(m_buf, m_gapStart);
+    text.append(m_buf + m_gapEnd, m_length - m_gapStart);
+}
+
+int TextBuffer::getText(int pos, int len, char* buf) const
+{
+    if (pos < 0 || pos >= m_length || len <= 0)
+        return 0;
+    if (len > m_length - pos)
+        len = m_length - pos;
+
+    int n = 0;
+    if (pos < m_gapStart) {
+        n = m_gapStart - pos;
+        if (n > len)
+            n = len;
+        memcpy(buf, m_buf + pos, n);
+    }
+
+    if (n < len)
+        memcpy(buf + n, m_buf + pos + n + gapSize(), len - n);
+
+    return len;
+}
+
+const char* TextBuffer::rangePtr(int pos, int len)
+{
+    if (pos < 0 || len < 0 || pos + len > m_length)
+        return NULL;
+
+    if (pos + len > m_gapStart && pos < m_gapStart) {
+        // move the fewer bytes out of the way
+        if (m_gapStart - pos < pos + len - m_gapStart)
+            moveGap(pos, 0);
+        else
+            moveGap(pos + len, 0);
+    }
+
+    return pos < m_gapStart ? m_buf + pos : m_buf + pos + gapSize();
+}
+
+bool TextBuffer::moveGap(int pos, int room)
+{
+    if (gapSize() < room) {
+        int size = m_size * 2;
+        if (size < m_length + room + TEXTBUFFER_MIN_GAP)
+            size = m_length + room + TEXTBUFFER_MIN_GAP;
+
+        char* buf = (char*)HFCL_REALLOC(m_buf, size);
+        if (buf == NULL) {
+            _ERR_PRINTF("TextBuffer: no memory for %d bytes\n", size);
+            return false;
+        }
+
+        int tail = m_size - m_gapEnd;
+        memmove(buf + size - tail, buf + m_gapEnd, tail);
+        m_buf = buf;
+        m_gapEnd = size - tail;
+        m_size = size;
+    }
+
+    if (pos < m_gapStart) {
+        int n = m_gapStart - pos;
+        memmove(m_buf + m_gapEnd - n, m_buf + pos, n);
+        m_gapStart -= n;
+        m_gapEnd -= n;
+    }
+    else if (pos > m_gapStart) {
+        int n = pos - m_gapStart;
+        memmove(m_buf + m_gapStart, m_buf + m_gapEnd, n);
+        m_gapStart += n;
+        m_gapEnd += n;
+    }
+
+    return true;
+}
+
+bool TextBuffer::reserveLines(int nr)
+{
+    if (m_lineGapEnd - m_lineGapStart >= nr)
+        return true;
+
+    int size = m_lineSize * 2;
+    if (size < m_nrLines + nr + TEXTBUFFER_MIN_LINE_GAP)
+        size = m_nrLines + nr + TEXTBUFFER_MIN_LINE_GAP;
+
+    Line* lines = (Line*)HFCL_REALLOC(m_lines, sizeof(Line) * size);
+    if (lines == NULL) {
+        _ERR_PRINTF("TextBuffer: no memory for %d lines\n", size);
+        return false;
+    }
+
+    int tail = m_lineSize - m_lineGapEnd;
+    memmove(lines + size - tail, lines + m_lineGapEnd, sizeof(Line) * tail);
+    m_lines = lines;
+    m_lineGapEnd = size - tail;
+    m_lineSize = size;
+    return true;
+}
+
+void TextBuffer::moveLineGap(int line)
+{
+    // the lines crossing the gap switch between absolute and relative
+    while (m_lineGapStart > line) {
+        Line& e = m_lines[--m_lineGapEnd];
+        e = m_lines[--m_lineGapStart];
+        e.byteStart = m_length - e.byteStart;
+        e.charStart = m_nrChars - e.charStart;
+    }
+
+    while (m_lineGapStart < line) {
+        Line& e = m_lines[m_lineGapStart++];
+        e = m_lines[m_lineGapEnd++];
+        e.byteStart = m_length - e.byteStart;
+        e.charStart = m_nrChars - e.charStart;
+    }
+}
+
+int TextBuffer::lineEntry(int line, bool chars) const
+{
+    if (line < m_lineGapStart) {
+        const Line& e = m_lines[line];
+        return chars ? e.charStart : e.byteStart;
+    }
+
+    const Line& e = m_lines[line + m_lineGapEnd - m_lineGapStart];
+    return chars ? m_nrChars - e.charStart : m_length - e.byteStart;
+}
+
+int TextBuffer::lineEnd(int line) const
+{
+    if (line + 1 < m_nrLines)
+        return lineStart(line + 1) - 1;
+    return m_length;
+}
+
+int TextBuffer::lineOfByte(int pos) const
+{
+    int low = 0, high = m_nrLines - 1;
+
+    // the last line starting at or before pos
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (lineStart(mid) <= pos)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+
+    return low;
+}
+
+int TextBuffer::lineOfChar(int charIndex) const
+{
+    int low = 0, high = m_nrLines - 1;
+
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (lineCharStart(mid) <= charIndex)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+
+    return low;
+}
+
+int TextBuffer::lineLayout(int line) const
+{
+    if (line < 0 || line >= m_nrLines)
+        return -1;
+
+    if (line < m_lineGapStart)
+        return m_lines[line].layout;
+    return m_lines[line + m_lineGapEnd - m_lineGapStart].layout;
+}
+
+void TextBuffer::setLineLayout(int line, int layout)
+{
+    if (line < 0 || line >= m_nrLines)
+        return;
+
+    if (line < m_lineGapStart)
+        m_lines[line].layout = layout;
+    else
+        m_lines[line + m_lineGapEnd - m_lineGapStart].layout = layout;
+}
+
+void TextBuffer::invalidateLayouts()
+{
+    for (int i = 0; i < m_lineGapStart; i++)
+        m_lines[i].layout = -1;
+    for (int i = m_lineGapEnd; i < m_lineSize; i++)
+        m_lines[i].layout = -1;
+}
+
+int TextBuffer::countChars(int pos, int len) const
+{
+    int n = 0;
+
+    for (int i = pos; i < pos + len; i++) {
+        if (is_char_start(byteAt(i)))
+            n++;
+    }
+
+    return n;
+}
+
+int TextBuffer::nextChar(int pos) const
+{
+    if (pos >= m_length)
+        return m_length;
+
+    pos++;
+    while (pos < m_length && !is_char_start(byteAt(pos)))
+        pos++;
+    return pos;
+}
+
+int TextBuffer::prevChar(int pos) const
+{
+    if (pos <= 0)
+        return 0;
+
+    pos--;
+    while (pos > 0 && !is_char_start(byteAt(pos)))
+        pos--;
+    return pos;
+}
+
+int TextBuffer::charToByte(int charIndex)
+{
+    if (charIndex <= 0)
+        return 0;
+    if (charIndex >= m_nrChars)
+        return m_length;
+
+    int line = lineOfChar(charIndex);
+    int pos = lineStart(line);
+    int chars = lineCharStart(line);
+
+    // walk from the last conversion if it is nearer
+    int d = m_cacheChar - charIndex;
+    if ((d < 0 ? -d : d) < charIndex - chars) {
+        pos = m_cacheByte;
+        chars = m_cacheChar;
+    }
+
+    for (; chars < charIndex; chars++)
+        pos = nextChar(pos);
+    for (; chars > charIndex; chars--)
+        pos = prevChar(pos);
+
+    m_cacheByte = pos;
+    m_cacheChar = chars;
+    return pos;
+}
+
+int TextBuffer::byteToChar(int pos)
+{
+    if (pos <= 0)
+        return 0;
+    if (pos >= m_length)
+        return m_nrChars;
+
+    int line = lineOfByte(pos);
+    int start = lineStart(line);
+    int chars = lineCharStart(line);
+
+    int d = m_cacheByte - pos;
+    if ((d < 0 ? -d : d) < pos - start) {
+        if (m_cacheByte <= pos)
+            chars = m_cacheChar + countChars(m_cacheByte, pos - m_cacheByte);
+        else
+            chars = m_cacheChar - countChars(pos, m_cacheByte - pos);
+    }
+    else {
+        chars += countChars(start, pos - start);
+    }
+
+    m_cacheByte = pos;
+    m_cacheChar = chars;
+    return chars;
+}
+
+bool TextBuffer::insert(int pos, const char* text, int len)
+{
+    if (pos < 0 || pos > m_length || text == NULL)
+        return false;
+
+    if (len < 0)
+        len = strlen(text);
+    if (len == 0)
+        return true;
+
+    int nrChars = 0, nrLines = 0;
+    for (int i = 0; i < len; i++) {
+        if (is_char_start(text[i]))
+            nrChars++;
+        if (text[i] == '\n')
+            nrLines++;
+    }
+
+    if (!moveGap(pos, len) || !reserveLines(nrLines))
+        return false;
+
+    int charPos = byteToChar(pos);
+    int line = lineOfByte(pos);
+    moveLineGap(line + 1);
+    m_lines[line].layout = -1;
+
+    memcpy(m_buf + m_gapStart, text, len);
+    m_gapStart += len;
+
+    // the new lines are before the line gap, with absolute offsets
+    int chars = charPos;
+    for (int i = 0; i < len; i++) {
+        if (is_char_start(text[i]))
+            chars++;
+
+        if (text[i] == '\n') {
+            Line& e = m_lines[m_lineGapStart++];
+            e.byteStart = pos + i + 1;
+            e.charStart = chars;
+            e.layout = -1;
+        }
+    }
+
+    m_length += len;
+    m_nrChars += nrChars;
+    m_nrLines += nrLines;
+
+    m_cacheByte = pos + len;
+    m_cacheChar = charPos + nrChars;
+    return true;
+}
+
+void TextBuffer::remove(int pos, int len)
+{
+    if (pos < 0 || pos >= m_length || len <= 0)
+        return;
+    if (len > m_length - pos)
+        len = m_length - pos;
+
+    int charPos = byteToChar(pos);
+    int nrChars = countChars(pos, len);
+    int line = lineOfByte(pos);
+    moveLineGap(line + 1);
+    m_lines[line].layout = -1;
+
+    // the lines starting in the removed bytes lost their '\n'
+    while (m_lineGapEnd < m_lineSize
+            && m_length - m_lines[m_lineGapEnd].byteStart <= pos + len) {
+        m_lineGapEnd++;
+        m_nrLines--;
+    }
+
+    moveGap(pos, 0);
+    m_gapEnd += len;
+
+    m_length -= len;
+    m_nrChars -= nrChars;
+
+    m_cacheByte = pos;
+    m_cacheChar = charPos;
+}
+
+bool TextBuffer::replace(int pos, int len, const char* text, int textLen)
+{
+    remove(pos, len);
+    return insert(pos, text, textLen);
+}
+
+} // namespace hfcl
@@ -1007,7 +1007,7 @@ void GifAnimate::restoreBkgColor(const IntRect &rect, GifAnimateFrame* frame)
 
     bg_color = GetWindowElementPixel(HWND_DESKTOP, WE_BGC_DESKTOP);
 
-    SetMemDCColorKey(m_mem_gc->context(), MEMDC_FLAG_SRCCOLORKEY, bg_color);
+    m_mem_gc->setMemDCColorKey(MEMDC_FLAG_SRCCOLORKEY, bg_color);
 
     old_color = SetBrushColor(m_mem_gc->context(), bg_color);
 
@@ -0,0 +1,734 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "graphics/glyphatlas.h"
+
+#include "common/log.h"
+
+namespace hfcl {
+
+#ifdef _HFCL_GLYPH_ATLAS
+bool GlyphAtlas::s_enabled = true;
+#else
+bool GlyphAtlas::s_enabled = false;
+#endif
+
+GlyphAtlas* GlyphAtlas::s_instance = NULL;
+
+#define SCRATCH_SIZE    (GLYPHATLAS_MAX_GLYPH_SIZE + 8)
+#define SCRATCH_PAD     4
+
+MAP(intptr_t, GlyphAtlas::Glyph, GlyphMap)
+
+class GlyphAtlasPage {
+public:
+    GlyphAtlasPage(GlyphAtlasFont* owner)
+        : m_owner(owner)
+        , m_shelf_x(0)
+        , m_shelf_y(0)
+        , m_shelf_h(0)
+        , m_pending(0)
+        , m_last_use(0)
+    {
+        m_mask = (Uint8*)HFCL_CALLOC(1,
+                GLYPHATLAS_PAGE_WIDTH * GLYPHATLAS_PAGE_HEIGHT);
+        memset(m_tints, 0, sizeof(m_tints));
+    }
+
+    ~GlyphAtlasPage() {
+        freeTints();
+        if (m_mask)
+            HFCL_FREE(m_mask);
+    }
+
+    // shelf packing: returns false if the page is full
+    bool alloc(int w, int h, short* x, short* y) {
+        if (w > GLYPHATLAS_PAGE_WIDTH || h > GLYPHATLAS_PAGE_HEIGHT)
+            return false;
+
+        if (m_shelf_x + w > GLYPHATLAS_PAGE_WIDTH) {
+            m_shelf_y += m_shelf_h;
+            m_shelf_x = 0;
+            m_shelf_h = 0;
+        }
+        if (m_shelf_y + h > GLYPHATLAS_PAGE_HEIGHT)
+            return false;
+
+        *x = m_shelf_x;
+        *y = m_shelf_y;
+        m_shelf_x += w + 1;
+        if (h > m_shelf_h)
+            m_shelf_h = h + 1;
+        return true;
+    }
+
+    struct Tint {
+        Bitmap bmp;
+        gal_pixel pixel;
+        int bpp;
+        unsigned int last_use;
+        size_t size;
+        bool valid;
+    };
+
+    // returns the bytes freed
+    static size_t freeTint(Tint* tint) {
+        if (!tint->valid)
+            return 0;
+
+        HFCL_FREE(tint->bmp.bmBits);
+        // the alpha mask is owned by the page
+        tint->bmp.bmAlphaMask = NULL;
+        tint->valid = false;
+        return tint->size;
+    }
+
+    size_t freeTints() {
+        size_t size = 0;
+        for (int i = 0; i < GLYPHATLAS_MAX_TINTS; i++) {
+            size += freeTint(&m_tints[i]);
+        }
+        return size;
+    }
+
+    GlyphAtlasFont* m_owner;
+    Uint8*          m_mask;
+    GlyphMap        m_glyphs;
+    Tint            m_tints[GLYPHATLAS_MAX_TINTS];
+
+    int m_shelf_x;
+    int m_shelf_y;
+    int m_shelf_h;
+    int m_pending;
+    unsigned int m_last_use;
+};
+
+class GlyphAtlasFont {
+public:
+    GlyphAtlasFont(Logfont* logfont)
+        : m_logfont(logfont)
+    {
+        m_key = *logfont;
+
+        FONTMETRICS metrics;
+        GetFontMetrics(logfont, &metrics);
+        m_line_height = metrics.font_height;
+    }
+
+    ~GlyphAtlasFont() {
+        PageList::iterator it;
+        for (it = m_pages.begin(); it != m_pages.end(); ++it) {
+            HFCL_DELETE(*it);
+        }
+        m_pages.clear();
+    }
+
+    // a Logfont object may be destroyed and its address reused later,
+    // so we compare the attributes which decide the glyph shapes.
+    bool matches(const Logfont* logfont) const {
+        return m_key.size == logfont->size
+            && m_key.style == logfont->style
+            && m_key.rotation == logfont->rotation
+            && strcmp(m_key.type, logfont->type) == 0
+            && strcmp(m_key.family, logfont->family) == 0
+            && strcmp(m_key.charset, logfont->charset) == 0;
+    }
+
+    const GlyphAtlas::Glyph* find(Uint32 code) {
+        PageList::iterator it;
+        for (it = m_pages.begin(); it != m_pages.end(); ++it) {
+            GlyphMap::iterator git = (*it)->m_glyphs.find((intptr_t)code);
+            if (git != (*it)->m_glyphs.end())
+                return &git->second;
+        }
+        return NULL;
+    }
+
+    LIST(GlyphAtlasPage*, PageList);
+
+    Logfont* m_logfont;
+    Logfont  m_key;
+    int      m_line_height;
+    PageList m_pages;
+};
+
+GlyphAtlas* GlyphAtlas::getInstance()
+{
+    if (NULL == s_instance) {
+        s_instance = HFCL_NEW(GlyphAtlas);
+    }
+    return s_instance;
+}
+
+void GlyphAtlas::releaseInstance()
+{
+    if (s_instance)
+        HFCL_DELETE(s_instance);
+    s_instance = NULL;
+}
+
+void GlyphAtlas::setEnabled(bool enabled)
+{
+    s_enabled = enabled;
+    if (!enabled && s_instance)
+        s_instance->purge();
+}
+
+GlyphAtlas::GlyphAtlas()
+    : m_nr_pages(0)
+    , m_tint_bytes(0)
+    , m_clock(0)
+{
+    resetStats();
+    m_scratch = CreateMemDC(SCRATCH_SIZE, SCRATCH_SIZE, 32,
+            MEMDC_FLAG_SWSURFACE,
+            0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000);
+    if (m_scratch == HDC_INVALID) {
+        _ERR_PRINTF("GlyphAtlas: failed to create the scratch DC\n");
+    }
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+    FontList::iterator it;
+    for (it = m_fonts.begin(); it != m_fonts.end(); ++it) {
+        HFCL_DELETE(*it);
+    }
+    m_fonts.clear();
+
+    if (m_scratch != HDC_INVALID)
+        DeleteMemDC(m_scratch);
+}
+
+GlyphAtlasFont* GlyphAtlas::findFont(Logfont* logfont, bool create)
+{
+    FontList::iterator it;
+    for (it = m_fonts.begin(); it != m_fonts.end(); ++it) {
+        if ((*it)->matches(logfont))
+            return *it;
+    }
+
+    if (!create)
+        return NULL;
+
+    GlyphAtlasFont* font = HFCL_NEW_EX(GlyphAtlasFont, (logfont));
+    m_fonts.push_back(font);
+    return font;
+}
+
+int GlyphAtlas::getLineHeight(Logfont* logfont)
+{
+    return findFont(logfont, true)->m_line_height;
+}
+
+bool GlyphAtlas::evictPage()
+{
+    GlyphAtlasFont* victim_font = NULL;
+    GlyphAtlasPage* victim = NULL;
+
+    FontList::iterator fit;
+    for (fit = m_fonts.begin(); fit != m_fonts.end(); ++fit) {
+        GlyphAtlasFont::PageList::iterator pit;
+        for (pit = (*fit)->m_pages.begin();
+                pit != (*fit)->m_pages.end(); ++pit) {
+            GlyphAtlasPage* page = *pit;
+            if (page->m_pending > 0)
+                continue;
+            if (victim == NULL || page->m_last_use < victim->m_last_use) {
+                victim = page;
+                victim_font = *fit;
+            }
+        }
+    }
+
+    if (victim == NULL)
+        return false;
+
+    victim_font->m_pages.remove(victim);
+    m_tint_bytes -= victim->freeTints();
+    HFCL_DELETE(victim);
+    m_nr_pages--;
+    m_stats.evictions++;
+    return true;
+}
+
+// frees the least recently used tinted page of all fonts; the coverage
+// of the page is kept
+bool GlyphAtlas::evictTint()
+{
+    GlyphAtlasPage::Tint* victim = NULL;
+
+    FontList::iterator fit;
+    for (fit = m_fonts.begin(); fit != m_fonts.end(); ++fit) {
+        GlyphAtlasFont::PageList::iterator pit;
+        for (pit = (*fit)->m_pages.begin();
+                pit != (*fit)->m_pages.end(); ++pit) {
+            for (int i = 0; i < GLYPHATLAS_MAX_TINTS; i++) {
+                GlyphAtlasPage::Tint* tint = &(*pit)->m_tints[i];
+                if (tint->valid && (victim == NULL
+                            || tint->last_use < victim->last_use))
+                    victim = tint;
+            }
+        }
+    }
+
+    if (victim == NULL)
+        return false;
+
+    m_tint_bytes -= GlyphAtlasPage::freeTint(victim);
+    m_stats.tint_evictions++;
+    return true;
+}
+
+GlyphAtlasPage* GlyphAtlas::newPage(GlyphAtlasFont* font)
+{
+    if (m_nr_pages >= GLYPHATLAS_MAX_PAGES && !evictPage())
+        return NULL;
+
+    GlyphAtlasPage* page = HFCL_NEW_EX(GlyphAtlasPage, (font));
+    if (page->m_mask == NULL) {
+        HFCL_DELETE(page);
+        return NULL;
+    }
+
+    font->m_pages.push_back(page);
+    m_nr_pages++;
+    return page;
+}
+
+bool GlyphAtlas::rasterize(Logfont* logfont, const char* mchar,
+        int mchar_len, Glyph* glyph, GlyphAtlasFont* font)
+{
+    if (m_scratch == HDC_INVALID)
+        return false;
+
+    SIZE size;
+    SelectFont(m_scratch, logfont);
+    GetTextExtent(m_scratch, mchar, mchar_len, &size);
+    if (size.cx + 2 * SCRATCH_PAD > SCRATCH_SIZE
+            || font->m_line_height > SCRATCH_SIZE)
+        return false;
+
+    // render the glyph in white on black, then take the coverage
+    SetBrushColor(m_scratch, RGB2Pixel(m_scratch, 0, 0, 0));
+    FillBox(m_scratch, 0, 0, SCRATCH_SIZE, SCRATCH_SIZE);
+    SetBkMode(m_scratch, BM_TRANSPARENT);
+    SetTextColor(m_scratch, RGB2Pixel(m_scratch, 0xFF, 0xFF, 0xFF));
+    TextOutLen(m_scratch, SCRATCH_PAD, 0, mchar, mchar_len);
+
+    int width, height, pitch;
+    RECT rc = {0, 0, SCRATCH_SIZE, font->m_line_height};
+    Uint8* bits = LockDC(m_scratch, &rc, &width, &height, &pitch);
+    if (bits == NULL)
+        return false;
+
+    // find the horizontal extent of the inked pixels
+    int min_x = width, max_x = -1;
+    for (int y = 0; y < height; y++) {
+        const Uint32* row = (const Uint32*)(bits + y * pitch);
+        for (int x = 0; x < width; x++) {
+            if (row[x] & 0x00FFFFFF) {
+                if (x < min_x) min_x = x;
+                if (x > max_x) max_x = x;
+            }
+        }
+    }
+
+    glyph->advance = size.cx;
+    if (max_x < 0) {
+        // a blank glyph, for example, the white space
+        glyph->page = NULL;
+        glyph->x = glyph->y = glyph->w = glyph->h = 0;
+        glyph->off_x = 0;
+        UnlockDC(m_scratch);
+        return true;
+    }
+
+    int w = max_x - min_x + 1;
+    int h = height;
+    GlyphAtlasPage* page = font->m_pages.size() > 0 ?
+            font->m_pages.back() : NULL;
+    if (page == NULL || !page->alloc(w, h, &glyph->x, &glyph->y)) {
+        page = newPage(font);
+        if (page == NULL || !page->alloc(w, h, &glyph->x, &glyph->y)) {
+            UnlockDC(m_scratch);
+            return false;
+        }
+    }
+
+    for (int y = 0; y < h; y++) {
+        const Uint32* row = (const Uint32*)(bits + y * pitch) + min_x;
+        Uint8* dst = page->m_mask
+                + (glyph->y + y) * GLYPHATLAS_PAGE_WIDTH + glyph->x;
+        for (int x = 0; x < w; x++) {
+            Uint8 r = (row[x] >> 16) & 0xFF;
+            Uint8 g = (row[x] >> 8) & 0xFF;
+            Uint8 b = row[x] & 0xFF;
+            Uint8 c = r > g ? r : g;
+            dst[x] = c > b ? c : b;
+        }
+    }
+    UnlockDC(m_scratch);
+
+    glyph->page = page;
+    glyph->w = w;
+    glyph->h = h;
+    glyph->off_x = min_x - SCRATCH_PAD;
+    return true;
+}
+
+const GlyphAtlas::Glyph* GlyphAtlas::getGlyph(Logfont* logfont, Uint32 code,
+        const char* mchar, int mchar_len)
+{
+    GlyphAtlasFont* font = findFont(logfont, true);
+    const Glyph* found = font->find(code);
+
+    m_clock++;
+    if (found) {
+        m_stats.hits++;
+        if (found->page)
+            found->page->m_last_use = m_clock;
+        return found;
+    }
+
+    m_stats.misses++;
+
+    Glyph glyph;
+    if (!rasterize(logfont, mchar, mchar_len, &glyph, font))
+        return NULL;
+
+    // blank glyphs are kept in the first page of the font
+    GlyphAtlasPage* page = glyph.page;
+    if (page == NULL) {
+        if (font->m_pages.size() == 0 && newPage(font) == NULL)
+            return NULL;
+        page = font->m_pages.front();
+    }
+
+    page->m_last_use = m_clock;
+    page->m_glyphs[(intptr_t)code] = glyph;
+    return &page->m_glyphs[(intptr_t)code];
+}
+
+const Bitmap* GlyphAtlas::getTintedPage(GlyphAtlasPage* page, HDC hdc,
+        gal_pixel pixel)
+{
+    int bpp = GetGDCapability(hdc, GDCAP_BPP);
+    GlyphAtlasPage::Tint* lru = &page->m_tints[0];
+
+    m_clock++;
+    for (int i = 0; i < GLYPHATLAS_MAX_TINTS; i++) {
+        GlyphAtlasPage::Tint* tint = &page->m_tints[i];
+        if (tint->valid && tint->pixel == pixel && tint->bpp == bpp) {
+            tint->last_use = m_clock;
+            return &tint->bmp;
+        }
+
+        if (!tint->valid || (lru->valid && tint->last_use < lru->last_use))
+            lru = tint;
+    }
+
+    m_tint_bytes -= GlyphAtlasPage::freeTint(lru);
+
+    // a solid color bitmap sharing the coverage of the page as alpha mask
+    Bitmap* bmp = &lru->bmp;
+    int pitch = (GLYPHATLAS_PAGE_WIDTH * bpp + 3) & ~3;
+    size_t size = (size_t)pitch * GLYPHATLAS_PAGE_HEIGHT;
+
+    // a flush blits with one tinted page at a time, and asks for the
+    // next one when it is done with the last, so any of them can go
+    while (m_tint_bytes + size > GLYPHATLAS_MAX_TINT_BYTES && evictTint())
+        ;
+
+    Uint8* bits = (Uint8*)HFCL_MALLOC(size);
+    if (bits == NULL)
+        return NULL;
+
+    memset(bmp, 0, sizeof(Bitmap));
+    if (!InitBitmap(hdc, GLYPHATLAS_PAGE_WIDTH, GLYPHATLAS_PAGE_HEIGHT,
+                pitch, bits, bmp)) {
+        HFCL_FREE(bits);
+        return NULL;
+    }
+
+    HDC memdc = CreateMemDCFromBitmap(hdc, bmp);
+    if (memdc == HDC_INVALID) {
+        HFCL_FREE(bits);
+        return NULL;
+    }
+    SetBrushColor(memdc, pixel);
+    FillBox(memdc, 0, 0, GLYPHATLAS_PAGE_WIDTH, GLYPHATLAS_PAGE_HEIGHT);
+    DeleteMemDC(memdc);
+
+    bmp->bmType = HFCL_BMP_TYPE_ALPHA_MASK;
+    bmp->bmAlpha = 0xFF;
+    bmp->bmAlphaMask = page->m_mask;
+    bmp->bmAlphaPitch = GLYPHATLAS_PAGE_WIDTH;
+
+    lru->pixel = pixel;
+    lru->bpp = bpp;
+    lru->last_use = m_clock;
+    lru->size = size;
+    lru->valid = true;
+    m_tint_bytes += size;
+    return bmp;
+}
+
+void GlyphAtlas::retainPage(GlyphAtlasPage* page)
+{
+    page->m_pending++;
+}
+
+void GlyphAtlas::releasePage(GlyphAtlasPage* page)
+{
+    if (page->m_pending > 0)
+        page->m_pending--;
+}
+
+void GlyphAtlas::purge()
+{
+    while (evictPage())
+        ;
+}
+
+void GlyphAtlas::dumpStats()
+{
+    _MG_PRINTF("GlyphAtlas: %d pages, %u hits, %u misses, %u evictions, "
+            "%lu tint bytes, %u tint evictions, "
+            "%u runs, %u blits, %u fallbacks\n",
+            m_nr_pages, m_stats.hits, m_stats.misses, m_stats.evictions,
+            (unsigned long)m_tint_bytes, m_stats.tint_evictions,
+            m_stats.runs, m_stats.blits, m_stats.fallbacks);
+}
+
+/////////////////////////////////////////////////////////
+
+GlyphRunBatch::GlyphRunBatch()
+{
+}
+
+GlyphRunBatch::~GlyphRunBatch()
+{
+    GlyphAtlas* atlas = GlyphAtlas::getInstance();
+    for (int i = 0; i < m_quads.size(); i++) {
+        atlas->releasePage(m_quads[i].page);
+    }
+    m_quads.clear();
+}
+
+int GlyphRunBatch::nextChar(const char* text, int len, Uint32* code)
+{
+    const Uint8* s = (const Uint8*)text;
+    int n;
+
+    if (s[0] < 0x80) {
+        *code = s[0];
+        return 1;
+    }
+    else if ((s[0] & 0xE0) == 0xC0) {
+        *code = s[0] & 0x1F;
+        n = 2;
+    }
+    else if ((s[0] & 0xF0) == 0xE0) {
+        *code = s[0] & 0x0F;
+        n = 3;
+    }
+    else if ((s[0] & 0xF8) == 0xF0) {
+        *code = s[0] & 0x07;
+        n = 4;
+    }
+    else {
+        return -1;
+    }
+
+    if (n > len)
+        return -1;
+
+    for (int i = 1; i < n; i++) {
+        if ((s[i] & 0xC0) != 0x80)
+            return -1;
+        *code = (*code << 6) | (s[i] & 0x3F);
+    }
+    return n;
+}
+
+bool GlyphRunBatch::isBatchable(Logfont* logfont, const char* text, int len)
+{
+    if (logfont == NULL || logfont->rotation != 0)
+        return false;
+
+    bool utf8 = strcasecmp(logfont->charset, "UTF-8") == 0;
+    for (int i = 0; i < len; i++) {
+        Uint8 c = (Uint8)text[i];
+        // control characters need the layout of DrawText
+        if (c < 0x20 || c == '&')
+            return false;
+        if (c >= 0x80 && !utf8)
+            return false;
+    }
+
+    return true;
+}
+
+// the code points of scripts which need BIDI reordering or shaping
+static inline bool need_shaping(Uint32 code)
+{
+    return (code >= 0x0590 && code < 0x1100)
+        || (code >= 0x1700 && code < 0x1A00)
+        || (code >= 0xFB1D && code < 0xFF00);
+}
+
+int GlyphRunBatch::measureRun(Logfont* logfont, const char* text, int len,
+        int* height)
+{
+    if (!isBatchable(logfont, text, len))
+        return -1;
+
+    GlyphAtlas* atlas = GlyphAtlas::getInstance();
+    int width = 0;
+    int pos = 0;
+
+    while (pos < len) {
+        Uint32 code;
+        int n = nextChar(text + pos, len - pos, &code);
+        if (n <= 0 || need_shaping(code))
+            return -1;
+
+        const GlyphAtlas::Glyph* glyph =
+            atlas->getGlyph(logfont, code, text + pos, n);
+        if (glyph == NULL)
+            return -1;
+
+        width += glyph->advance;
+        pos += n;
+    }
+
+    if (height)
+        *height = atlas->getLineHeight(logfont);
+    return width;
+}
+
+bool GlyphRunBatch::addRun(HDC hdc, int x, int y, const char* text, int len,
+        gal_pixel pixel, Logfont* logfont, const RECT* clip)
+{
+    GlyphAtlas* atlas = GlyphAtlas::getInstance();
+
+    if (!isBatchable(logfont, text, len)) {
+        atlas->stats().fallbacks++;
+        return false;
+    }
+
+    // the pages of the queued glyphs are retained as they are queued, so
+    // that getting the next glyph can not evict them; if a glyph is not
+    // available, the glyphs queued for this run are dropped again
+    int first = m_quads.size();
+    int pen_x = x;
+    int pos = 0;
+    while (pos < len) {
+        Uint32 code;
+        int n = nextChar(text + pos, len - pos, &code);
+        const GlyphAtlas::Glyph* glyph = NULL;
+        if (n > 0 && !need_shaping(code))
+            glyph = atlas->getGlyph(logfont, code, text + pos, n);
+        if (glyph == NULL) {
+            while (m_quads.size() > first) {
+                atlas->releasePage(m_quads[m_quads.size() - 1].page);
+                m_quads.pop_back();
+            }
+            atlas->stats().fallbacks++;
+            return false;
+        }
+        pos += n;
+
+        if (glyph->w == 0) {
+            pen_x += glyph->advance;
+            continue;
+        }
+
+        GlyphQuad quad;
+        quad.page = glyph->page;
+        quad.pixel = pixel;
+        quad.sx = glyph->x;
+        quad.sy = glyph->y;
+        quad.dx = pen_x + glyph->off_x;
+        quad.dy = y;
+        quad.w = glyph->w;
+        quad.h = glyph->h;
+        pen_x += glyph->advance;
+
+        if (clip) {
+            if (quad.dx < clip->left) {
+                quad.sx += clip->left - quad.dx;
+                quad.w -= clip->left - quad.dx;
+                quad.dx = clip->left;
+            }
+            if (quad.dy < clip->top) {
+                quad.sy += clip->top - quad.dy;
+                quad.h -= clip->top - quad.dy;
+                quad.dy = clip->top;
+            }
+            if (quad.dx + quad.w > clip->right)
+                quad.w = clip->right - quad.dx;
+            if (quad.dy + quad.h > clip->bottom)
+                quad.h = clip->bottom - quad.dy;
+            if (quad.w <= 0 || quad.h <= 0)
+                continue;
+        }
+
+        atlas->retainPage(quad.page);
+        m_quads.push_back(quad);
+    }
+
+    atlas->stats().runs++;
+    return true;
+}
+
+void GlyphRunBatch::flush(HDC hdc)
+{
+    if (m_quads.size() == 0)
+        return;
+
+    GlyphAtlas* atlas = GlyphAtlas::getInstance();
+    GlyphAtlasPage* cur_page = NULL;
+    gal_pixel cur_pixel = 0;
+    const Bitmap* bmp = NULL;
+
+    for (int i = 0; i < m_quads.size(); i++) {
+        GlyphQuad& quad = m_quads[i];
+
+        if (quad.page != cur_page || quad.pixel != cur_pixel) {
+            cur_page = quad.page;
+            cur_pixel = quad.pixel;
+            bmp = atlas->getTintedPage(cur_page, hdc, cur_pixel);
+        }
+
+        if (bmp) {
+            FillBoxWithBitmapPart(hdc, quad.dx, quad.dy, quad.w, quad.h,
+                    0, 0, bmp, quad.sx, quad.sy);
+            atlas->stats().blits++;
+        }
+        atlas->releasePage(quad.page);
+    }
+
+    m_quads.clear();
+}
+
+} // namespace hfcl
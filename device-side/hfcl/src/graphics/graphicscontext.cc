@@ -25,6 +25,8 @@
 #include "graphics/color.h"
 #include "graphics/image.h"
 #include "graphics/textmode.h"
+#include "graphics/glyphatlas.h"
+#include "graphics/rasterkernels.h"
 
 #include "view/view.h"
 
@@ -35,6 +37,7 @@ int GraphicsContext::screen_dpi = 0;
 
 VECTOR(HDC, DCVector);
 VECTOR(POINT*, PointVector);
+VECTOR(bool, ClipStateVector);
 
 class GraphicsContextPrivate {
 public:
@@ -45,15 +48,64 @@ public:
         m_dcAbsPos.y = 0;
         m_dcRelPos.x = 0;
         m_dcRelPos.y = 0;
+        m_glyphBatch = NULL;
+        m_isMemDC = false;
+        m_complexClip = false;
+        m_alphaFlags = 0;
+        m_alpha = 0xFF;
+        m_colorKeyFlags = 0;
+        m_colorKey = 0;
         initDC(hdc);
     }
 
     ~GraphicsContextPrivate() {
+        flushGlyphRuns();
+        if (m_glyphBatch)
+            HFCL_DELETE(m_glyphBatch);
         // FIXME,
         // delete memdc ....
     }
 
+    GlyphRunBatch* glyphBatch() {
+        if (m_glyphBatch == NULL)
+            m_glyphBatch = HFCL_NEW(GlyphRunBatch);
+        return m_glyphBatch;
+    }
+
+    // the batched glyphs must go out before any other drawing
+    void flushGlyphRuns() {
+        if (m_glyphBatch && !m_glyphBatch->empty())
+            m_glyphBatch->flush(m_context);
+    }
+
+    // whether the DC can be drawn by the raster kernels
+    bool canUseRaster() {
+        if (!RasterKernels::isEnabled() || !m_isMemDC || m_complexClip)
+            return false;
+
+        if (GetGDCapability(m_context, GDCAP_BPP) != 4)
+            return false;
+
+        Uint32 amask = GetGDCapability(m_context, GDCAP_AMASK);
+        return amask == 0 || amask == 0xFF000000;
+    }
+
+    // intersects the rect with the clipping box; the clipping region is
+    // a single rectangle as long as only clip() is used.
+    bool clipForRaster(RECT& rc) {
+        RECT rcClip;
+        GetClipBox(m_context, &rcClip);
+        return IntersectRect(&rc, &rc, &rcClip);
+    }
+
+    bool canBatchText(Logfont* logfont) {
+        return GlyphAtlas::isEnabled() && logfont != NULL
+            && !GetBIDIFlags(m_context)
+            && GetTextCharacterExtra(m_context) == 0;
+    }
+
     void initDC(HDC hdc) {
+        flushGlyphRuns();
         m_viewdc = m_context = hdc;
 
         if (m_context != HDC_INVALID) {
@@ -111,6 +163,19 @@ public:
 
 private:
     POINT       m_dcRelPos;
+    GlyphRunBatch* m_glyphBatch;
+
+public:
+    bool        m_isMemDC;
+    bool        m_complexClip;
+    // m_complexClip of each SaveDC, restored by RestoreDC
+    ClipStateVector m_savedClips;
+    DWORD       m_alphaFlags;
+    Uint8       m_alpha;
+    DWORD       m_colorKeyFlags;
+    Uint32      m_colorKey;
+
+private:
     DCVector    m_layers;
     PointVector m_points;
 };
@@ -180,8 +245,15 @@ void GraphicsContext::mapRect(RECT &rc)
     m_data->mapRect(rc);
 }
 
+void GraphicsContext::flush()
+{
+    m_data->flushGlyphRuns();
+}
+
 HDC GraphicsContext::context()
 {
+    // the caller may draw on the DC directly
+    m_data->flushGlyphRuns();
     return m_data->m_context;
 }
 
@@ -227,6 +299,7 @@ void GraphicsContext::textOutOmitted(int x, int y, const char * text, int len,
 
     int outx, outy;
     HDC hdc = m_data->m_context;
+    m_data->flushGlyphRuns();
     unsigned int oldBkMode = SetBkMode(hdc, BM_TRANSPARENT);
 
     map(x, y, outx, outy);
@@ -244,6 +317,7 @@ void GraphicsContext::textOutOmitted(int x, int y, const char * text,
     int outx, outy;
     HDC hdc = m_data->m_context;
     map(x, y, outx, outy);
+    m_data->flushGlyphRuns();
 
     SelectFont (m_data->m_context, logfont);
     SetBkMode (hdc, BM_TRANSPARENT);
@@ -261,6 +335,15 @@ void GraphicsContext::textOut(int x, int y, const char * text, int len,
     HDC hdc = m_data->m_context;
     map(x, y, outx, outy);
 
+    if (m_data->canBatchText(logfont)) {
+        if (len < 0)
+            len = strlen(text);
+        if (m_data->glyphBatch()->addRun(hdc, outx, outy, text, len,
+                    DWORD2Pixel(hdc, color), logfont, NULL))
+            return;
+    }
+    m_data->flushGlyphRuns();
+
     SelectFont (m_data->m_context, logfont);
     SetBkMode (hdc, BM_TRANSPARENT);
     SetTextColor (hdc, DWORD2Pixel (hdc, color));
@@ -374,6 +457,7 @@ void GraphicsContext::drawText(const std::string& text, const IntRect& rect)
     HDC hdc = m_data->m_context;
 
     mapRect(rc);
+    m_data->flushGlyphRuns();
     SetBkMode(hdc, BM_TRANSPARENT);
     DrawText(hdc, text.c_str(), -1, &rc,
         DT_SINGLELINE | DT_CENTER  | DT_VCENTER);
@@ -389,6 +473,10 @@ void GraphicsContext::drawText(const char * text, const IntRect& rect,
 
     mapRect(rc);
 
+    if (text && drawTextInBatch(text, rc, clr, logfont, format))
+        return;
+    m_data->flushGlyphRuns();
+
     SetBkMode(hdc, BM_TRANSPARENT);
     if (NULL != logfont)
         oldFont = SelectFont(hdc, logfont);
@@ -437,8 +525,46 @@ END:
         SelectFont(hdc, oldFont);
 }
 
+bool GraphicsContext::drawTextInBatch(const char* text, const RECT& rc,
+        Color& clr, Logfont* logfont, unsigned int format)
+{
+    HDC hdc = m_data->m_context;
+
+    if (!m_data->canBatchText(logfont) || !(format & TextMode::SingleLine)
+            || (format & (TextMode::CalcRect | TextMode::ExpandTabs
+                    | TextMode::TabStop | TextMode::OutLine)))
+        return false;
+
+    int len = strlen(text);
+    int h = 0;
+    int w = m_data->glyphBatch()->measureRun(logfont, text, len, &h);
+    if (w < 0)
+        return false;
+
+    // the omitted text needs the ellipsis drawn by MiniGUI
+    if ((format & TextMode::TextOutOmitted) && w > RECTW(rc))
+        return false;
+
+    int x = rc.left;
+    if (format & TextMode::AlignCenter)
+        x = (rc.left + rc.right - w) / 2;
+    else if (format & TextMode::AlignRight)
+        x = rc.right - w;
+
+    int y = rc.top;
+    if (format & TextMode::ValignMiddle)
+        y = (rc.top + rc.bottom - h) / 2;
+    else if (format & TextMode::ValignBottom)
+        y = rc.bottom - h;
+
+    return m_data->glyphBatch()->addRun(hdc, x, y, text, len,
+            RGB2Pixel(hdc, clr.r(), clr.g(), clr.b()), logfont,
+            (format & TextMode::NoClip) ? NULL : &rc);
+}
+
 void GraphicsContext::clip(const IntRect& rect)
 {
+    m_data->flushGlyphRuns();
     RECT rc = RECT(rect);
     mapRect(rc);
     ClipRectIntersect(m_data->m_context, &rc);
@@ -446,15 +572,19 @@ void GraphicsContext::clip(const IntRect& rect)
 
 void GraphicsContext::clipOut(const IntRect& rect)
 {
+    m_data->flushGlyphRuns();
     RECT rc = RECT(rect);
     mapRect(rc);
+    m_data->m_complexClip = true;
     ExcludeClipRect(m_data->m_context, &rc);
 }
 
 void GraphicsContext::clipIn(const IntRect& rect)
 {
+    m_data->flushGlyphRuns();
     RECT rc = RECT(rect);
     mapRect(rc);
+    m_data->m_complexClip = true;
     IncludeClipRect(m_data->m_context, &rc);
 }
 
@@ -468,38 +598,141 @@ bool GraphicsContext::rectVisible(IntRect &rect)
 
 void GraphicsContext::save()
 {
+    m_data->flushGlyphRuns();
     SaveDC(m_data->m_context);
+    m_data->m_savedClips.push_back(m_data->m_complexClip);
 }
 
 void GraphicsContext::restore()
 {
+    m_data->flushGlyphRuns();
     RestoreDC(m_data->m_context, -1);
+    if (!m_data->m_savedClips.empty()) {
+        m_data->m_complexClip = m_data->m_savedClips.back();
+        m_data->m_savedClips.pop_back();
+    }
 }
 
 GraphicsContext* GraphicsContext::createMemGc(int w, int h)
 {
     HDC memdc = CreateCompatibleDCEx(m_data->m_context, w, h);
 
-    if(memdc != HDC_INVALID)
-        return HFCL_NEW_EX(GraphicsContext, (memdc));
-    else
+    if (memdc == HDC_INVALID)
         return NULL;
+
+    GraphicsContext* gc = HFCL_NEW_EX(GraphicsContext, (memdc));
+    gc->m_data->m_isMemDC = true;
+    return gc;
 }
 
 void GraphicsContext::fillBox(int x, int y, int w, int h)
 {
+    m_data->flushGlyphRuns();
     FillBox(m_data->m_context, x, y, w, h);
 }
 
 void GraphicsContext::bitBlt(GraphicsContext* src, int sx, int sy,
         int sw, int sh, int dx, int dy, Uint32 op)
 {
+    m_data->flushGlyphRuns();
+    if (op == 0 && rasterBitBlt(src, sx, sy, sw, sh, dx, dy))
+        return;
+
     BitBlt(src->context(), sx, sy, sw, sh, m_data->m_context, dx, dy, op);
 }
 
+bool GraphicsContext::setMemDCAlpha(DWORD flags, Uint8 alpha)
+{
+    if (!SetMemDCAlpha(m_data->m_context, flags, alpha))
+        return false;
+
+    m_data->m_alphaFlags = flags;
+    m_data->m_alpha = alpha;
+    return true;
+}
+
+bool GraphicsContext::setMemDCColorKey(DWORD flags, Uint32 colorKey)
+{
+    if (!SetMemDCColorKey(m_data->m_context, flags, colorKey))
+        return false;
+
+    m_data->m_colorKeyFlags = flags;
+    m_data->m_colorKey = colorKey;
+    return true;
+}
+
+bool GraphicsContext::rasterBitBlt(GraphicsContext* src, int sx, int sy,
+        int sw, int sh, int dx, int dy)
+{
+    GraphicsContextPrivate* s = src->m_data;
+    if (src == this || !m_data->canUseRaster() || !s->canUseRaster())
+        return false;
+
+    if (GetGDCapability(s->m_context, GDCAP_AMASK)
+            != GetGDCapability(m_data->m_context, GDCAP_AMASK))
+        return false;
+
+    // MiniGUI blends a memory DC with one blit mode at a time
+    DWORD alphaFlags = s->m_alphaFlags
+            & (MEMDC_FLAG_SRCALPHA | MEMDC_FLAG_SRCPIXELALPHA);
+    DWORD keyFlags = s->m_colorKeyFlags & MEMDC_FLAG_SRCCOLORKEY;
+    if (alphaFlags && keyFlags)
+        return false;
+
+    RECT rcSrc = {0, 0, (int)GetGDCapability(s->m_context, GDCAP_MAXX) + 1,
+            (int)GetGDCapability(s->m_context, GDCAP_MAXY) + 1};
+    if (sw <= 0 || sh <= 0) {
+        sw = RECTW(rcSrc);
+        sh = RECTH(rcSrc);
+    }
+
+    RECT rcBlt = {sx, sy, sx + sw, sy + sh};
+    if (!IntersectRect(&rcBlt, &rcBlt, &rcSrc))
+        return true;
+
+    RECT rcDst = {dx + rcBlt.left - sx, dy + rcBlt.top - sy,
+            dx + rcBlt.right - sx, dy + rcBlt.bottom - sy};
+    RECT rcVis = rcDst;
+    if (!m_data->clipForRaster(rcVis))
+        return true;
+    OffsetRect(&rcBlt, rcVis.left - rcDst.left, rcVis.top - rcDst.top);
+
+    int w, h, dpitch, spitch;
+    Uint8* dbits = LockDC(m_data->m_context, &rcVis, &w, &h, &dpitch);
+    if (dbits == NULL)
+        return false;
+
+    RECT rcRead = {rcBlt.left, rcBlt.top, rcBlt.left + w, rcBlt.top + h};
+    Uint8* sbits = LockDC(s->m_context, &rcRead, &w, &h, &spitch);
+    if (sbits == NULL) {
+        UnlockDC(m_data->m_context);
+        return false;
+    }
+
+    const RasterKernels* k = RasterKernels::get();
+    for (int y = 0; y < h; y++) {
+        Uint32* d = (Uint32*)(dbits + y * dpitch);
+        const Uint32* p = (const Uint32*)(sbits + y * spitch);
+
+        if (alphaFlags & MEMDC_FLAG_SRCPIXELALPHA)
+            k->blend(d, p, w);
+        else if (alphaFlags & MEMDC_FLAG_SRCALPHA)
+            k->blendConst(d, p, w, s->m_alpha);
+        else if (keyFlags)
+            k->colorKey(d, p, w, s->m_colorKey, 0x00FFFFFF);
+        else
+            memcpy(d, p, w * sizeof(Uint32));
+    }
+
+    UnlockDC(s->m_context);
+    UnlockDC(m_data->m_context);
+    return true;
+}
+
 void GraphicsContext::fillRect(const IntRect& rc,
         Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
+    m_data->flushGlyphRuns();
     if (rc.width() <= 0 || rc.height() <= 0)
         return;
 
@@ -508,6 +741,9 @@ void GraphicsContext::fillRect(const IntRect& rc,
 
     mapRect(rect);
 
+    if (a != 0 && rasterFillRect(rect, RGBA2Pixel(hdc, r, g, b, 0xFF), a))
+        return;
+
     if (a == HFCL_DEFAULT_OPACITY) {
         unsigned int oldColor = SetBrushColor(hdc, RGBA2Pixel(hdc, r, g, b, a));
         FillBox(hdc, rect.left, rect.top, RECTW(rect), RECTH(rect));
@@ -558,8 +794,48 @@ void GraphicsContext::fillRect(const IntRect& rc,
     }
 }
 
+bool GraphicsContext::rasterFillRect(const RECT& rc, gal_pixel pixel, Uint8 a)
+{
+    if (!m_data->canUseRaster())
+        return false;
+
+    RECT rcVis = rc;
+    if (!m_data->clipForRaster(rcVis))
+        return true;
+
+    int w, h, pitch;
+    Uint8* bits = LockDC(m_data->m_context, &rcVis, &w, &h, &pitch);
+    if (bits == NULL)
+        return false;
+
+    const RasterKernels* k = RasterKernels::get();
+    Uint32* solid = NULL;
+    if (a != HFCL_DEFAULT_OPACITY) {
+        solid = (Uint32*)HFCL_MALLOC(w * sizeof(Uint32));
+        if (solid == NULL) {
+            UnlockDC(m_data->m_context);
+            return false;
+        }
+        k->fill(solid, w, pixel);
+    }
+
+    for (int y = 0; y < h; y++) {
+        Uint32* d = (Uint32*)(bits + y * pitch);
+        if (solid)
+            k->blendConst(d, solid, w, a);
+        else
+            k->fill(d, w, pixel);
+    }
+
+    if (solid)
+        HFCL_FREE(solid);
+    UnlockDC(m_data->m_context);
+    return true;
+}
+
 void GraphicsContext::rectangle(int x0, int y0, int x1, int y1)
 {
+    m_data->flushGlyphRuns();
     int out_x0, out_y0, out_x1, out_y1;
     map(x0, y0, out_x0, out_y0);
     map(x1, y1, out_x1, out_y1);
@@ -578,6 +854,7 @@ void GraphicsContext::rectangle(int x0, int y0, int x1, int y1,
 void GraphicsContext::drawLine(int x0, int y0, int x1, int y1,
         int width, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
+    m_data->flushGlyphRuns();
     int out_x0, out_y0, out_x1, out_y1;
     HDC hdc = m_data->m_context;
 
@@ -596,6 +873,7 @@ void GraphicsContext::drawLine(int x0, int y0, int x1, int y1,
 void GraphicsContext::drawHVDotLine(int x, int y, int wh, bool isHorz,
         Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
+    m_data->flushGlyphRuns();
     int out_x, out_y;
     HDC hdc = m_data->m_context;
 
@@ -610,6 +888,7 @@ void GraphicsContext::drawHVDotLine(int x, int y, int wh, bool isHorz,
 void GraphicsContext::drawPolygonLine(Point *pts, int nums, int width,
         Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
+    m_data->flushGlyphRuns();
     HDC hdc = m_data->m_context;
     Point* p = HFCL_NEW_ARR(Point, (sizeof(Point) * nums));
     if (NULL == p) {
@@ -637,6 +916,7 @@ void GraphicsContext::drawPolygonLine(Point *pts, int nums, int width,
 void GraphicsContext::fillPolygon(const Point* pts, int vertices,
         Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
+    m_data->flushGlyphRuns();
     HDC hdc = m_data->m_context;
     int c = 0;
     Point* p = HFCL_NEW_ARR(Point, (sizeof(Point) * vertices));
@@ -661,14 +941,97 @@ void GraphicsContext::fillPolygon(const Point* pts, int vertices,
 bool GraphicsContext::fillBoxWithBitmap(int x, int y, int w, int h,
         const Bitmap* pBitmap)
 {
+    m_data->flushGlyphRuns();
     int outx, outy;
     HDC hdc = m_data->m_context;
 
     map(x, y, outx, outy);
 
+    if (pBitmap && rasterFillBoxWithBitmap(outx, outy, w, h, pBitmap))
+        return true;
+
     return FillBoxWithBitmap(hdc, outx, outy, w, h, pBitmap);
 }
 
+bool GraphicsContext::rasterFillBoxWithBitmap(int x, int y, int w, int h,
+        const Bitmap* bmp)
+{
+    if (!m_data->canUseRaster() || bmp->bmBytesPerPixel != 4
+            || bmp->bmWidth == 0 || bmp->bmHeight == 0)
+        return false;
+
+    // one blit mode at a time, as the kernels do
+    Uint8 type = bmp->bmType & (HFCL_BMP_TYPE_RLE | HFCL_BMP_TYPE_ALPHA
+            | HFCL_BMP_TYPE_ALPHACHANNEL | HFCL_BMP_TYPE_COLORKEY
+            | HFCL_BMP_TYPE_ALPHA_MASK);
+    if (type != HFCL_BMP_TYPE_NORMAL && type != HFCL_BMP_TYPE_ALPHA
+            && type != HFCL_BMP_TYPE_ALPHACHANNEL
+            && type != HFCL_BMP_TYPE_COLORKEY)
+        return false;
+
+    int bw = bmp->bmWidth;
+    int bh = bmp->bmHeight;
+    // as FillBoxWithBitmap, the size of the bitmap for the missing sides
+    if (w <= 0)
+        w = bw;
+    if (h <= 0)
+        h = bh;
+
+    RECT rcVis = {x, y, x + w, y + h};
+    if (!m_data->clipForRaster(rcVis))
+        return true;
+
+    int vw, vh, pitch;
+    Uint8* bits = LockDC(m_data->m_context, &rcVis, &vw, &vh, &pitch);
+    if (bits == NULL)
+        return false;
+
+    const RasterKernels* k = RasterKernels::get();
+    bool scaled = (w != bw || h != bh);
+    int stepx = (bw << 16) / w;
+    int stepy = (bh << 16) / h;
+    Uint32* row = NULL;
+    if (scaled) {
+        row = (Uint32*)HFCL_MALLOC(vw * sizeof(Uint32));
+        if (row == NULL) {
+            UnlockDC(m_data->m_context);
+            return false;
+        }
+    }
+
+    for (int i = 0; i < vh; i++) {
+        int dy = rcVis.top + i - y;
+        int sy = scaled ? ((dy * stepy + (stepy >> 1)) >> 16) : dy;
+        if (sy >= bh)
+            sy = bh - 1;
+
+        const Uint32* s = (const Uint32*)(bmp->bmBits + sy * bmp->bmPitch);
+        Uint32* d = (Uint32*)(bits + i * pitch);
+        if (scaled) {
+            int fx0 = (rcVis.left - x) * stepx + (stepx >> 1);
+            k->scaleNearest(row, vw, s, bw, fx0, stepx);
+            s = row;
+        }
+        else {
+            s += rcVis.left - x;
+        }
+
+        if (type == HFCL_BMP_TYPE_ALPHACHANNEL)
+            k->blend(d, s, vw);
+        else if (type == HFCL_BMP_TYPE_ALPHA)
+            k->blendConst(d, s, vw, bmp->bmAlpha);
+        else if (type == HFCL_BMP_TYPE_COLORKEY)
+            k->colorKey(d, s, vw, bmp->bmColorKey, 0x00FFFFFF);
+        else
+            memcpy(d, s, vw * sizeof(Uint32));
+    }
+
+    if (row)
+        HFCL_FREE(row);
+    UnlockDC(m_data->m_context);
+    return true;
+}
+
 bool GraphicsContext::setReplaceColor(RGBCOLOR color)
 {
     return true;
@@ -677,6 +1040,7 @@ bool GraphicsContext::setReplaceColor(RGBCOLOR color)
 bool GraphicsContext::drawRotateBitmap(const Bitmap* pBitmap,
         int lx, int ty, int angle)
 {
+    m_data->flushGlyphRuns();
     HDC hdc = m_data->m_context;
 
     RotateBitmap(hdc,pBitmap, lx, ty, angle);
@@ -686,6 +1050,7 @@ bool GraphicsContext::drawRotateBitmap(const Bitmap* pBitmap,
 bool GraphicsContext::fillBoxWithBitmapPart(int x, int y, int w, int h,
         const Bitmap* pBitmap, int xo, int yo)
 {
+    m_data->flushGlyphRuns();
     int outx, outy;
     HDC hdc = m_data->m_context;
 
@@ -718,6 +1083,9 @@ void GraphicsContext::unloadBitmap(Bitmap* pBitmap)
 GraphicsContext* GraphicsContext::createGraphicsFromBitmap(Bitmap *pbmp)
 {
     m_data->initDC(CreateMemDCFromBitmap (m_data->m_context, pbmp));
+    m_data->m_isMemDC = true;
+    m_data->m_complexClip = false;
+    m_data->m_savedClips.clear();
     return this;
 }
 
@@ -728,6 +1096,7 @@ bool GraphicsContext::initBitmap(int w, int h, Bitmap* pbmp)
 
 bool GraphicsContext::captureScreen2Bitmap(Bitmap* pbmp)
 {
+    m_data->flushGlyphRuns();
     return GetBitmapFromDC (m_data->m_context, 0, 0,
             GetGDCapability (m_data->m_context, GDCAP_HPIXEL),
             GetGDCapability (m_data->m_context, GDCAP_VPIXEL),
@@ -765,6 +1134,7 @@ void GraphicsContext::deleteLogFont(Logfont* logfont)
 void GraphicsContext::rotateBitmap(const Bitmap *pBitmap, int lx, int ty,
         int angle)
 {
+    m_data->flushGlyphRuns();
     int outx, outy;
     map(lx, ty, outx, outy);
     RotateBitmap(context(), pBitmap, outx, outy, angle);
@@ -40,6 +40,10 @@ NinePatchImage::~NinePatchImage()
 void NinePatchImage::paint(GraphicsContext* context, const IntRect& rc,
         ImageFormat format, int xo, int yo)
 {
+    // a cached size needs neither the bitmap nor the slices
+    if (m_cache.paintComposed(context, rc, 0))
+        return;
+
     if (m_bLoadOnPainting) {
         setImageBitmap(ResLoader::getInstance()->getBitmap(m_filePath.c_str()));
     }
@@ -54,10 +58,7 @@ void NinePatchImage::paint(GraphicsContext* context, const IntRect& rc,
         return;
     }
 
-    for (int i = 0; i < PATCH_COUNT; i++) {
-        context->fillBoxWithBitmap(m_subRc[i].left(), m_subRc[i].top(),
-                m_subRc[i].width(), m_subRc[i].height(), &m_subBmp[i]);
-    }
+    m_cache.paint(context, rc, 0, m_subBmp, m_subRc, PATCH_COUNT);
 
     if (m_bLoadOnPainting && NULL != m_pBitmap) {
         GraphicsContext::screenGraphics()->unloadBitmap(m_pBitmap);
@@ -207,6 +208,10 @@ bool NinePatchImage::setSubBmp()
         return false;
     }
 
+    // the bitmap loaded on painting is the same one each time
+    if (!m_bLoadOnPainting)
+        m_cache.reset();
+
     Uint8* ams = NULL;
     Bitmap* pSubBmp = NULL;
 
@@ -262,6 +267,7 @@ void NinePatchImage::clean()
 bool NinePatchImage::setImage(const char *image_file)
 {
     clean();
+    m_cache.reset();
 
     if (!Image::setImage(image_file)) {
         LOGERROR("Image::setImage\n");
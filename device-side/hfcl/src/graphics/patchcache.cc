@@ -0,0 +1,449 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "graphics/patchcache.h"
+
+#include "graphics/rasterkernels.h"
+
+namespace hfcl {
+
+PatchCache* PatchCache::s_first = NULL;
+unsigned int PatchCache::s_age = 0;
+size_t PatchCache::s_bytes = 0;
+PatchCache::Stats PatchCache::s_stats;
+bool PatchCache::s_enabled = true;
+
+PatchCache::PatchCache()
+    : m_missW(0)
+    , m_missH(0)
+    , m_missKey(0)
+    , m_prev(NULL)
+    , m_next(s_first)
+{
+    memset(m_composed, 0, sizeof(m_composed));
+    memset(m_strips, 0, sizeof(m_strips));
+
+    if (s_first)
+        s_first->m_prev = this;
+    s_first = this;
+}
+
+PatchCache::~PatchCache()
+{
+    reset();
+
+    if (m_prev)
+        m_prev->m_next = m_next;
+    else
+        s_first = m_next;
+    if (m_next)
+        m_next->m_prev = m_prev;
+}
+
+void PatchCache::reset()
+{
+    for (int i = 0; i < PATCHCACHE_MAX_SIZES; i++) {
+        freeBitmap(&m_composed[i].bmp);
+        m_composed[i].w = 0;
+        m_composed[i].h = 0;
+    }
+
+    for (int i = 0; i < PATCHCACHE_MAX_SLICES; i++) {
+        freeBitmap(&m_strips[i].bmp);
+        m_strips[i].checked = false;
+    }
+
+    m_missW = m_missH = 0;
+}
+
+PatchCache::Composed* PatchCache::find(int w, int h, int key)
+{
+    for (int i = 0; i < PATCHCACHE_MAX_SIZES; i++) {
+        Composed* c = &m_composed[i];
+        if (c->bmp.bmBits && c->w == w && c->h == h && c->key == key)
+            return c;
+    }
+
+    return NULL;
+}
+
+bool PatchCache::paintComposed(GraphicsContext* gc, const IntRect& rc, int key)
+{
+    if (!s_enabled)
+        return false;
+
+    Composed* c = find(rc.width(), rc.height(), key);
+    if (c == NULL)
+        return false;
+
+    s_stats.hits++;
+    c->age = ++s_age;
+    return gc->fillBoxWithBitmap(rc.left() + c->xo, rc.top() + c->yo,
+            c->bmp.bmWidth, c->bmp.bmHeight, &c->bmp);
+}
+
+void PatchCache::paint(GraphicsContext* gc, const IntRect& rc, int key,
+        const Bitmap* slices, const IntRect* subRc, int nr_slices)
+{
+    if (s_enabled) {
+        s_stats.misses++;
+
+        // compose the size only if it is asked for again
+        if (m_missW == rc.width() && m_missH == rc.height()
+                && m_missKey == key
+                && compose(gc, rc, key, slices, subRc, nr_slices)
+                && paintComposed(gc, rc, key))
+            return;
+
+        m_missW = rc.width();
+        m_missH = rc.height();
+        m_missKey = key;
+    }
+
+    for (int i = 0; i < nr_slices; i++) {
+        paintSlice(gc, i, subRc[i], &slices[i]);
+    }
+}
+
+bool PatchCache::compose(GraphicsContext* gc, const IntRect& rc, int key,
+        const Bitmap* slices, const IntRect* subRc, int nr_slices)
+{
+    for (int i = 0; i < nr_slices; i++) {
+        if (((slices[i].bmType & HFCL_BMP_TYPE_ALPHA_MASK)
+                    && slices[i].bmAlphaMask)
+                || slices[i].bmBytesPerPixel != slices[0].bmBytesPerPixel)
+            return false;
+    }
+
+    IntRect bounds(subRc[0]);
+    for (int i = 1; i < nr_slices; i++) {
+        bounds.setRect(MIN(bounds.left(), subRc[i].left()),
+                MIN(bounds.top(), subRc[i].top()),
+                MAX(bounds.right(), subRc[i].right()),
+                MAX(bounds.bottom(), subRc[i].bottom()));
+    }
+
+    if (bounds.isEmpty())
+        return false;
+
+    // an empty slot, or the least recently used one
+    Composed* c = &m_composed[0];
+    for (int i = 1; i < PATCHCACHE_MAX_SIZES && c->bmp.bmBits; i++) {
+        if (m_composed[i].bmp.bmBits == NULL
+                || m_composed[i].age < c->age)
+            c = &m_composed[i];
+    }
+
+    if (c->bmp.bmBits) {
+        s_stats.evictions++;
+        freeBitmap(&c->bmp);
+    }
+
+    if (!initBitmap(&c->bmp, &slices[0], bounds.width(), bounds.height(),
+                false))
+        return false;
+
+    HDC memdc = CreateMemDCFromBitmap(gc->context(), &c->bmp);
+    if (memdc == HDC_INVALID) {
+        freeBitmap(&c->bmp);
+        return false;
+    }
+
+    // the pixels of the slices are copied with their alpha, not blended,
+    // so the composition is blended as the slices are
+    for (int i = 0; i < nr_slices; i++) {
+        if (subRc[i].width() <= 0 || subRc[i].height() <= 0)
+            continue;
+
+        Bitmap slice = slices[i];
+        slice.bmType &= ~(HFCL_BMP_TYPE_ALPHA | HFCL_BMP_TYPE_ALPHACHANNEL
+                | HFCL_BMP_TYPE_COLORKEY);
+        FillBoxWithBitmap(memdc, subRc[i].left() - bounds.left(),
+                subRc[i].top() - bounds.top(),
+                subRc[i].width(), subRc[i].height(), &slice);
+    }
+    DeleteMemDC(memdc);
+
+    c->w = rc.width();
+    c->h = rc.height();
+    c->key = key;
+    c->xo = bounds.left() - rc.left();
+    c->yo = bounds.top() - rc.top();
+    c->age = ++s_age;
+    s_stats.composes++;
+    return true;
+}
+
+static bool is_uniform_x(const Bitmap* bmp)
+{
+    int bpp = bmp->bmBytesPerPixel;
+
+    for (unsigned int y = 0; y < bmp->bmHeight; y++) {
+        const Uint8* row = bmp->bmBits + y * bmp->bmPitch;
+        for (unsigned int x = 1; x < bmp->bmWidth; x++) {
+            if (memcmp(row, row + x * bpp, bpp))
+                return false;
+        }
+
+        if (bmp->bmAlphaMask) {
+            row = bmp->bmAlphaMask + y * bmp->bmAlphaPitch;
+            for (unsigned int x = 1; x < bmp->bmWidth; x++) {
+                if (row[x] != row[0])
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool is_uniform_y(const Bitmap* bmp)
+{
+    for (unsigned int y = 1; y < bmp->bmHeight; y++) {
+        if (memcmp(bmp->bmBits, bmp->bmBits + y * bmp->bmPitch,
+                    bmp->bmWidth * bmp->bmBytesPerPixel))
+            return false;
+
+        if (bmp->bmAlphaMask && memcmp(bmp->bmAlphaMask,
+                    bmp->bmAlphaMask + y * bmp->bmAlphaPitch, bmp->bmWidth))
+            return false;
+    }
+
+    return true;
+}
+
+void PatchCache::paintSlice(GraphicsContext* gc, int idx, const IntRect& rc,
+        const Bitmap* slice)
+{
+    int w = rc.width();
+    int h = rc.height();
+    int sw = slice->bmWidth;
+    int sh = slice->bmHeight;
+
+    if (w <= 0 || h <= 0 || sw <= 0 || sh <= 0)
+        return;
+
+    if (!s_enabled || idx >= PATCHCACHE_MAX_SLICES || (w == sw && h == sh)) {
+        gc->fillBoxWithBitmap(rc.left(), rc.top(), w, h, slice);
+        return;
+    }
+
+    Strip* strip = &m_strips[idx];
+    if (!strip->checked) {
+        strip->uniformX = is_uniform_x(slice);
+        strip->uniformY = is_uniform_y(slice);
+        strip->checked = true;
+    }
+
+    if ((w != sw && !strip->uniformX) || (h != sh && !strip->uniformY)) {
+        s_stats.fallbacks++;
+        gc->fillBoxWithBitmap(rc.left(), rc.top(), w, h, slice);
+        return;
+    }
+
+    if (strip->bmp.bmBits == NULL || (int)strip->bmp.bmWidth < w
+            || (int)strip->bmp.bmHeight < h) {
+        int stripW = sw;
+        int stripH = sh;
+        if (strip->uniformX)
+            stripW = MAX(w, (int)strip->bmp.bmWidth);
+        if (strip->uniformY)
+            stripH = MAX(h, (int)strip->bmp.bmHeight);
+        stripW = (stripW + PATCHCACHE_STRIP_STEP - 1)
+            / PATCHCACHE_STRIP_STEP * PATCHCACHE_STRIP_STEP;
+        stripH = (stripH + PATCHCACHE_STRIP_STEP - 1)
+            / PATCHCACHE_STRIP_STEP * PATCHCACHE_STRIP_STEP;
+        if (!strip->uniformX)
+            stripW = sw;
+        if (!strip->uniformY)
+            stripH = sh;
+
+        freeBitmap(&strip->bmp);
+        if (!initBitmap(&strip->bmp, slice, stripW, stripH, true)) {
+            gc->fillBoxWithBitmap(rc.left(), rc.top(), w, h, slice);
+            return;
+        }
+
+        // stretching a uniform slice gives the same pixels at any length
+        stretch(&strip->bmp, 0, 0, stripW, stripH, slice);
+        s_stats.strips++;
+    }
+
+    strip->age = ++s_age;
+    gc->fillBoxWithBitmapPart(rc.left(), rc.top(), w, h, &strip->bmp, 0, 0);
+}
+
+// makes room for size bytes in the bitmaps of all the caches
+bool PatchCache::reserve(size_t size)
+{
+    while (s_bytes + size > PATCHCACHE_MAX_BYTES) {
+        if (!evictOldest())
+            return size <= PATCHCACHE_MAX_BYTES;
+    }
+
+    return true;
+}
+
+// frees the least recently used bitmap of all the caches
+bool PatchCache::evictOldest()
+{
+    Bitmap* victim = NULL;
+    unsigned int age = 0;
+
+    for (PatchCache* cache = s_first; cache; cache = cache->m_next) {
+        for (int i = 0; i < PATCHCACHE_MAX_SIZES; i++) {
+            Composed* c = &cache->m_composed[i];
+            if (c->bmp.bmBits && (victim == NULL || c->age < age)) {
+                victim = &c->bmp;
+                age = c->age;
+            }
+        }
+
+        for (int i = 0; i < PATCHCACHE_MAX_SLICES; i++) {
+            Strip* strip = &cache->m_strips[i];
+            if (strip->bmp.bmBits && (victim == NULL || strip->age < age)) {
+                victim = &strip->bmp;
+                age = strip->age;
+            }
+        }
+    }
+
+    if (victim == NULL)
+        return false;
+
+    // a freed composition is not found any more; a freed strip is made
+    // again when it is needed
+    freeBitmap(victim);
+    s_stats.evictions++;
+    return true;
+}
+
+// the bitmap is zeroed, so the pixels not covered by a slice are the
+// same each time
+bool PatchCache::initBitmap(Bitmap* bmp, const Bitmap* tmpl, int w, int h,
+        bool withMask)
+{
+    memcpy(bmp, tmpl, sizeof(Bitmap));
+    bmp->bmWidth = w;
+    bmp->bmHeight = h;
+    bmp->bmPitch = (w * tmpl->bmBytesPerPixel + 3) & ~3;
+    bmp->bmBits = NULL;
+    bmp->bmAlphaMask = NULL;
+    bmp->bmAlphaPitch = 0;
+    if (withMask && (tmpl->bmType & HFCL_BMP_TYPE_ALPHA_MASK)
+            && tmpl->bmAlphaMask)
+        bmp->bmAlphaPitch = (w + 3) & ~3;
+    else
+        bmp->bmType &= ~HFCL_BMP_TYPE_ALPHA_MASK;
+
+    if (!reserve(bitmapSize(bmp))) {
+        _ERR_PRINTF("PatchCache: %dx%d bitmap is larger than the cache\n",
+                w, h);
+        return false;
+    }
+
+    bmp->bmBits = (Uint8*)HFCL_CALLOC(1, bmp->bmPitch * h);
+    if (bmp->bmAlphaPitch)
+        bmp->bmAlphaMask = (Uint8*)HFCL_CALLOC(1, bmp->bmAlphaPitch * h);
+    if (bmp->bmBits == NULL || (bmp->bmAlphaPitch && !bmp->bmAlphaMask)) {
+        _ERR_PRINTF("PatchCache: no memory for %dx%d bitmap\n", w, h);
+        if (bmp->bmBits)
+            HFCL_FREE(bmp->bmBits);
+        if (bmp->bmAlphaMask)
+            HFCL_FREE(bmp->bmAlphaMask);
+        bmp->bmBits = NULL;
+        bmp->bmAlphaMask = NULL;
+        return false;
+    }
+
+    s_bytes += bitmapSize(bmp);
+    return true;
+}
+
+void PatchCache::freeBitmap(Bitmap* bmp)
+{
+    if (bmp->bmBits) {
+        s_bytes -= bitmapSize(bmp);
+        HFCL_FREE(bmp->bmBits);
+    }
+    if (bmp->bmAlphaMask)
+        HFCL_FREE(bmp->bmAlphaMask);
+
+    bmp->bmBits = NULL;
+    bmp->bmAlphaMask = NULL;
+}
+
+size_t PatchCache::bitmapSize(const Bitmap* bmp)
+{
+    return (size_t)(bmp->bmPitch + bmp->bmAlphaPitch) * bmp->bmHeight;
+}
+
+// stretches src to (x, y, w, h) of dst with the nearest pixels; it is used
+// for the strips, which are uniform along the stretched axis, so it gives
+// the same pixels as FillBoxWithBitmap, and it keeps the alpha mask
+void PatchCache::stretch(Bitmap* dst, int x, int y, int w, int h,
+        const Bitmap* src)
+{
+    int sw = src->bmWidth;
+    int sh = src->bmHeight;
+    int bpp = dst->bmBytesPerPixel;
+
+    if (w <= 0 || h <= 0 || sw <= 0 || sh <= 0)
+        return;
+
+    int stepx = (sw << 16) / w;
+    const RasterKernels* k = RasterKernels::get();
+
+    for (int i = 0; i < h; i++) {
+        int sy = i * sh / h;
+        const Uint8* s = src->bmBits + sy * src->bmPitch;
+        Uint8* d = dst->bmBits + (y + i) * dst->bmPitch + x * bpp;
+
+        if (w == sw) {
+            memcpy(d, s, w * bpp);
+        }
+        else if (bpp == 4) {
+            k->scaleNearest((Uint32*)d, w, (const Uint32*)s, sw, 0, stepx);
+        }
+        else {
+            for (int j = 0; j < w; j++)
+                memcpy(d + j * bpp, s + ((j * stepx) >> 16) * bpp, bpp);
+        }
+
+        if (dst->bmAlphaMask && src->bmAlphaMask) {
+            s = src->bmAlphaMask + sy * src->bmAlphaPitch;
+            d = dst->bmAlphaMask + (y + i) * dst->bmAlphaPitch + x;
+            for (int j = 0; j < w; j++)
+                d[j] = s[(j * stepx) >> 16];
+        }
+    }
+}
+
+void PatchCache::dumpStats()
+{
+    _MG_PRINTF("PatchCache: %u hits, %u misses, %u composes, %u evictions, "
+            "%u strips, %u fallbacks, %lu bytes\n",
+            s_stats.hits, s_stats.misses, s_stats.composes,
+            s_stats.evictions, s_stats.strips, s_stats.fallbacks,
+            (unsigned long)s_bytes);
+}
+
+} // namespace hfcl
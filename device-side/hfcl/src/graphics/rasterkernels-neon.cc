@@ -0,0 +1,140 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "graphics/rasterkernels.h"
+
+/*
+ * The NEON kernels are built only if the compiler targets NEON, for
+ * example, AArch64, or 32-bit ARM with the NEON_CFLAGS found by
+ * configure; RasterKernels::get() picks them only if the CPU has NEON.
+ */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+namespace hfcl {
+
+// rounded x / 255 on 16-bit lanes, the same as the scalar kernels
+static inline uint16x8_t div255_u16(uint16x8_t x)
+{
+    x = vaddq_u16(x, vdupq_n_u16(128));
+    return vshrq_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+}
+
+// blends two pixels; the alpha of each pixel is in all of its lanes
+static inline uint8x8_t blend_u8(uint8x8_t d, uint8x8_t s, uint8x8_t a)
+{
+    uint8x8_t ia = vsub_u8(vdup_n_u8(255), a);
+    uint16x8_t x = vmlal_u8(vmull_u8(s, a), d, ia);
+    return vmovn_u16(div255_u16(x));
+}
+
+static void fill_neon(Uint32* dst, int n, Uint32 pixel)
+{
+    uint32x4_t p = vdupq_n_u32(pixel);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        vst1q_u32(dst + i, p);
+    for (; i < n; i++)
+        dst[i] = pixel;
+}
+
+static void blend_neon(Uint32* dst, const Uint32* src, int n)
+{
+    // spreads the alpha byte of each pixel to its four bytes
+    static const uint8_t alpha_index[8] = { 3, 3, 3, 3, 7, 7, 7, 7 };
+    const uint8x8_t index = vld1_u8(alpha_index);
+    const uint32x2_t opaque = vdup_n_u32(0xFF000000);
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        uint32x2_t s = vld1_u32(src + i);
+        uint32x2_t d = vld1_u32(dst + i);
+        uint8x8_t a = vtbl1_u8(vreinterpret_u8_u32(s), index);
+
+        s = vorr_u32(s, opaque);
+        uint8x8_t r = blend_u8(vreinterpret_u8_u32(d),
+                vreinterpret_u8_u32(s), a);
+        vst1_u32(dst + i, vreinterpret_u32_u8(r));
+    }
+
+    if (i < n)
+        RasterKernels::scalar()->blend(dst + i, src + i, n - i);
+}
+
+static void blend_const_neon(Uint32* dst, const Uint32* src, int n,
+        Uint8 alpha)
+{
+    const uint32x2_t opaque = vdup_n_u32(0xFF000000);
+    const uint8x8_t a = vdup_n_u8(alpha);
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        uint32x2_t s = vorr_u32(vld1_u32(src + i), opaque);
+        uint32x2_t d = vld1_u32(dst + i);
+
+        uint8x8_t r = blend_u8(vreinterpret_u8_u32(d),
+                vreinterpret_u8_u32(s), a);
+        vst1_u32(dst + i, vreinterpret_u32_u8(r));
+    }
+
+    if (i < n)
+        RasterKernels::scalar()->blendConst(dst + i, src + i, n - i, alpha);
+}
+
+static void color_key_neon(Uint32* dst, const Uint32* src, int n,
+        Uint32 key, Uint32 mask)
+{
+    const uint32x4_t k = vdupq_n_u32(key & mask);
+    const uint32x4_t m = vdupq_n_u32(mask);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t s = vld1q_u32(src + i);
+        uint32x4_t d = vld1q_u32(dst + i);
+        uint32x4_t keyed = vceqq_u32(vandq_u32(s, m), k);
+
+        vst1q_u32(dst + i, vbslq_u32(keyed, d, s));
+    }
+
+    if (i < n)
+        RasterKernels::scalar()->colorKey(dst + i, src + i, n - i, key, mask);
+}
+
+static void scale_nearest_neon(Uint32* dst, int n, const Uint32* src,
+        int sw, int fx0, int step)
+{
+    RasterKernels::scalar()->scaleNearest(dst, n, src, sw, fx0, step);
+}
+
+const RasterKernels raster_kernels_neon = {
+    "neon",
+    fill_neon,
+    blend_neon,
+    blend_const_neon,
+    color_key_neon,
+    scale_nearest_neon,
+};
+
+} // namespace hfcl
+
+#endif /* __ARM_NEON */
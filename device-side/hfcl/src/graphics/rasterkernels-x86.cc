@@ -0,0 +1,317 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "graphics/rasterkernels.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+/*
+ * The SSE2 and AVX2 kernels are compiled with the target attribute, so
+ * this file needs no special compiler flags; RasterKernels::get() picks
+ * them only if the CPU supports the instructions.
+ */
+#define SSE2_FUNC   __attribute__((target("sse2")))
+#define AVX2_FUNC   __attribute__((target("avx2")))
+
+namespace hfcl {
+
+/////////////////////////////////////////////////////////
+// SSE2
+
+// (x + 128 + ((x + 128) >> 8)) >> 8 on 16-bit lanes
+static SSE2_FUNC inline __m128i div255_epu16(__m128i x)
+{
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// blends two pixels unpacked to 16-bit lanes with the alpha in a16
+static SSE2_FUNC inline __m128i blend_epu16(__m128i d16, __m128i s16,
+        __m128i a16)
+{
+    __m128i ia16 = _mm_sub_epi16(_mm_set1_epi16(255), a16);
+    return div255_epu16(_mm_add_epi16(_mm_mullo_epi16(s16, a16),
+                _mm_mullo_epi16(d16, ia16)));
+}
+
+static SSE2_FUNC inline __m128i alpha_epu16(__m128i s16)
+{
+    s16 = _mm_shufflelo_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_shufflehi_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static SSE2_FUNC void fill_sse2(Uint32* dst, int n, Uint32 pixel)
+{
+    __m128i p = _mm_set1_epi32((int)pixel);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_si128((__m128i*)(dst + i), p);
+    for (; i < n; i++)
+        dst[i] = pixel;
+}
+
+static SSE2_FUNC void blend_sse2(Uint32* dst, const Uint32* src, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+
+        __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+        __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+        __m128i a_lo = alpha_epu16(s_lo);
+        __m128i a_hi = alpha_epu16(s_hi);
+
+        s = _mm_or_si128(s, opaque);
+        s_lo = _mm_unpacklo_epi8(s, zero);
+        s_hi = _mm_unpackhi_epi8(s, zero);
+
+        __m128i r_lo = blend_epu16(_mm_unpacklo_epi8(d, zero), s_lo, a_lo);
+        __m128i r_hi = blend_epu16(_mm_unpackhi_epi8(d, zero), s_hi, a_hi);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(r_lo, r_hi));
+    }
+
+    if (i < n)
+        RasterKernels::scalar()->blend(dst + i, src + i, n - i);
+}
+
+static SSE2_FUNC void blend_const_sse2(Uint32* dst, const Uint32* src, int n,
+        Uint8 alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+    const __m128i a16 = _mm_set1_epi16(alpha);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_or_si128(
+                _mm_loadu_si128((const __m128i*)(src + i)), opaque);
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+
+        __m128i r_lo = blend_epu16(_mm_unpacklo_epi8(d, zero),
+                _mm_unpacklo_epi8(s, zero), a16);
+        __m128i r_hi = blend_epu16(_mm_unpackhi_epi8(d, zero),
+                _mm_unpackhi_epi8(s, zero), a16);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(r_lo, r_hi));
+    }
+
+    if (i < n)
+        RasterKernels::scalar()->blendConst(dst + i, src + i, n - i, alpha);
+}
+
+static SSE2_FUNC void color_key_sse2(Uint32* dst, const Uint32* src, int n,
+        Uint32 key, Uint32 mask)
+{
+    const __m128i k = _mm_set1_epi32((int)(key & mask));
+    const __m128i m = _mm_set1_epi32((int)mask);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i keyed = _mm_cmpeq_epi32(_mm_and_si128(s, m), k);
+
+        d = _mm_or_si128(_mm_and_si128(keyed, d), _mm_andnot_si128(keyed, s));
+        _mm_storeu_si128((__m128i*)(dst + i), d);
+    }
+
+    if (i < n)
+        RasterKernels::scalar()->colorKey(dst + i, src + i, n - i, key, mask);
+}
+
+// SSE2 has no gather, so only the index math is done four pixels a time
+static SSE2_FUNC void scale_nearest_sse2(Uint32* dst, int n,
+        const Uint32* src, int sw, int fx0, int step)
+{
+    const __m128i steps = _mm_setr_epi32(0, step, step * 2, step * 3);
+    int fx = fx0;
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        int idx[4];
+        __m128i vfx = _mm_add_epi32(_mm_set1_epi32(fx), steps);
+        _mm_storeu_si128((__m128i*)idx, _mm_srai_epi32(vfx, 16));
+        for (int j = 0; j < 4; j++)
+            dst[i + j] = src[idx[j] < sw ? idx[j] : sw - 1];
+        fx += step * 4;
+    }
+
+    if (i < n)
+        RasterKernels::scalar()->scaleNearest(dst + i, n - i, src, sw,
+                fx, step);
+}
+
+const RasterKernels raster_kernels_sse2 = {
+    "sse2",
+    fill_sse2,
+    blend_sse2,
+    blend_const_sse2,
+    color_key_sse2,
+    scale_nearest_sse2,
+};
+
+/////////////////////////////////////////////////////////
+// AVX2
+
+static AVX2_FUNC inline __m256i div255_epu16_avx2(__m256i x)
+{
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+static AVX2_FUNC inline __m256i blend_epu16_avx2(__m256i d16, __m256i s16,
+        __m256i a16)
+{
+    __m256i ia16 = _mm256_sub_epi16(_mm256_set1_epi16(255), a16);
+    return div255_epu16_avx2(_mm256_add_epi16(_mm256_mullo_epi16(s16, a16),
+                _mm256_mullo_epi16(d16, ia16)));
+}
+
+static AVX2_FUNC inline __m256i alpha_epu16_avx2(__m256i s16)
+{
+    s16 = _mm256_shufflelo_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm256_shufflehi_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static AVX2_FUNC void fill_avx2(Uint32* dst, int n, Uint32 pixel)
+{
+    __m256i p = _mm256_set1_epi32((int)pixel);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_si256((__m256i*)(dst + i), p);
+    for (; i < n; i++)
+        dst[i] = pixel;
+}
+
+static AVX2_FUNC void blend_avx2(Uint32* dst, const Uint32* src, int n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+
+        // the unpacks and the pack work within the 128-bit lanes,
+        // so the pixel order is kept
+        __m256i a_lo = alpha_epu16_avx2(_mm256_unpacklo_epi8(s, zero));
+        __m256i a_hi = alpha_epu16_avx2(_mm256_unpackhi_epi8(s, zero));
+
+        s = _mm256_or_si256(s, opaque);
+        __m256i r_lo = blend_epu16_avx2(_mm256_unpacklo_epi8(d, zero),
+                _mm256_unpacklo_epi8(s, zero), a_lo);
+        __m256i r_hi = blend_epu16_avx2(_mm256_unpackhi_epi8(d, zero),
+                _mm256_unpackhi_epi8(s, zero), a_hi);
+        _mm256_storeu_si256((__m256i*)(dst + i),
+                _mm256_packus_epi16(r_lo, r_hi));
+    }
+
+    if (i < n)
+        blend_sse2(dst + i, src + i, n - i);
+}
+
+static AVX2_FUNC void blend_const_avx2(Uint32* dst, const Uint32* src, int n,
+        Uint8 alpha)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+    const __m256i a16 = _mm256_set1_epi16(alpha);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = _mm256_or_si256(
+                _mm256_loadu_si256((const __m256i*)(src + i)), opaque);
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+
+        __m256i r_lo = blend_epu16_avx2(_mm256_unpacklo_epi8(d, zero),
+                _mm256_unpacklo_epi8(s, zero), a16);
+        __m256i r_hi = blend_epu16_avx2(_mm256_unpackhi_epi8(d, zero),
+                _mm256_unpackhi_epi8(s, zero), a16);
+        _mm256_storeu_si256((__m256i*)(dst + i),
+                _mm256_packus_epi16(r_lo, r_hi));
+    }
+
+    if (i < n)
+        blend_const_sse2(dst + i, src + i, n - i, alpha);
+}
+
+static AVX2_FUNC void color_key_avx2(Uint32* dst, const Uint32* src, int n,
+        Uint32 key, Uint32 mask)
+{
+    const __m256i k = _mm256_set1_epi32((int)(key & mask));
+    const __m256i m = _mm256_set1_epi32((int)mask);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i keyed = _mm256_cmpeq_epi32(_mm256_and_si256(s, m), k);
+
+        _mm256_storeu_si256((__m256i*)(dst + i),
+                _mm256_blendv_epi8(s, d, keyed));
+    }
+
+    if (i < n)
+        color_key_sse2(dst + i, src + i, n - i, key, mask);
+}
+
+static AVX2_FUNC void scale_nearest_avx2(Uint32* dst, int n,
+        const Uint32* src, int sw, int fx0, int step)
+{
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i steps = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(step));
+    const __m256i last = _mm256_set1_epi32(sw - 1);
+    int fx = fx0;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i vfx = _mm256_add_epi32(_mm256_set1_epi32(fx), steps);
+        __m256i idx = _mm256_min_epi32(_mm256_srai_epi32(vfx, 16), last);
+        _mm256_storeu_si256((__m256i*)(dst + i),
+                _mm256_i32gather_epi32((const int*)src, idx, 4));
+        fx += step * 8;
+    }
+
+    if (i < n)
+        RasterKernels::scalar()->scaleNearest(dst + i, n - i, src, sw,
+                fx, step);
+}
+
+const RasterKernels raster_kernels_avx2 = {
+    "avx2",
+    fill_avx2,
+    blend_avx2,
+    blend_const_avx2,
+    color_key_avx2,
+    scale_nearest_avx2,
+};
+
+} // namespace hfcl
+
+#endif /* __i386__ || __x86_64__ */
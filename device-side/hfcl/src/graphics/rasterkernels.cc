@@ -0,0 +1,168 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "graphics/rasterkernels.h"
+
+#if defined(__linux__) && defined(__arm__)
+#   include <sys/auxv.h>
+#   include <asm/hwcap.h>
+#endif
+
+namespace hfcl {
+
+#ifdef _HFCL_RASTER_KERNELS
+bool RasterKernels::s_enabled = true;
+#else
+bool RasterKernels::s_enabled = false;
+#endif
+
+// rounded x / 255 for x in [0, 65535 - 128]
+static inline Uint32 div255(Uint32 x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline Uint32 blend_pixel(Uint32 d, Uint32 s, Uint32 a)
+{
+    Uint32 ia = 255 - a;
+    Uint32 r = 0;
+
+    s |= 0xFF000000;
+    for (int shift = 0; shift < 32; shift += 8) {
+        Uint32 sc = (s >> shift) & 0xFF;
+        Uint32 dc = (d >> shift) & 0xFF;
+        r |= div255(sc * a + dc * ia) << shift;
+    }
+
+    return r;
+}
+
+static void fill_scalar(Uint32* dst, int n, Uint32 pixel)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = pixel;
+}
+
+static void blend_scalar(Uint32* dst, const Uint32* src, int n)
+{
+    for (int i = 0; i < n; i++) {
+        Uint32 a = src[i] >> 24;
+        if (a == 0xFF)
+            dst[i] = src[i];
+        else if (a)
+            dst[i] = blend_pixel(dst[i], src[i], a);
+    }
+}
+
+static void blend_const_scalar(Uint32* dst, const Uint32* src, int n,
+        Uint8 alpha)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = blend_pixel(dst[i], src[i], alpha);
+}
+
+static void color_key_scalar(Uint32* dst, const Uint32* src, int n,
+        Uint32 key, Uint32 mask)
+{
+    key &= mask;
+    for (int i = 0; i < n; i++) {
+        if ((src[i] & mask) != key)
+            dst[i] = src[i];
+    }
+}
+
+static void scale_nearest_scalar(Uint32* dst, int n, const Uint32* src,
+        int sw, int fx0, int step)
+{
+    int fx = fx0;
+    for (int i = 0; i < n; i++) {
+        int sx = fx >> 16;
+        if (sx >= sw)
+            sx = sw - 1;
+        dst[i] = src[sx];
+        fx += step;
+    }
+}
+
+static const RasterKernels raster_kernels_scalar = {
+    "scalar",
+    fill_scalar,
+    blend_scalar,
+    blend_const_scalar,
+    color_key_scalar,
+    scale_nearest_scalar,
+};
+
+const RasterKernels* RasterKernels::scalar()
+{
+    return &raster_kernels_scalar;
+}
+
+const RasterKernels* RasterKernels::byName(const char* name)
+{
+    if (strcmp(name, "scalar") == 0)
+        return &raster_kernels_scalar;
+
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+        return &raster_kernels_avx2;
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2"))
+        return &raster_kernels_sse2;
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_HFCL_HAVE_NEON)
+    if (strcmp(name, "neon") == 0) {
+#   if defined(__linux__) && defined(__arm__)
+        if (!(getauxval(AT_HWCAP) & HWCAP_NEON))
+            return NULL;
+#   endif
+        return &raster_kernels_neon;
+    }
+#endif
+
+    return NULL;
+}
+
+const RasterKernels* RasterKernels::get()
+{
+    static const RasterKernels* selected = NULL;
+
+    if (selected)
+        return selected;
+
+    const char* env = getenv("HFCL_RASTER_KERNELS");
+    if (env)
+        selected = byName(env);
+
+    static const char* preferred[] = { "avx2", "sse2", "neon", NULL };
+    for (int i = 0; selected == NULL && preferred[i]; i++)
+        selected = byName(preferred[i]);
+
+    if (selected == NULL)
+        selected = &raster_kernels_scalar;
+
+    _DBG_PRINTF("RasterKernels: use the %s kernels\n", selected->name);
+    return selected;
+}
+
+} // namespace hfcl
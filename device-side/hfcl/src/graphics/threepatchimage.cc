@@ -25,6 +25,11 @@
 
 namespace hfcl {
 
+static inline int formatKey(const ImageFormat& format)
+{
+    return (format.align << 8) | format.valign;
+}
+
 ThreePatchImage::ThreePatchImage(bool b_typeHoriz)
     : Image(), m_typeHoriz(b_typeHoriz)
 {
@@ -38,6 +43,10 @@ ThreePatchImage::~ThreePatchImage()
 
 void ThreePatchImage::paint(GraphicsContext* context, const IntRect& rc, ImageFormat format, int xo, int yo)
 {
+    // a cached size needs neither the bitmap nor the slices
+    if (m_cache.paintComposed(context, rc, formatKey(format)))
+        return;
+
     if (m_bLoadOnPainting) {
         setImageBitmap(ResLoader::getInstance()->getBitmap(m_filePath.c_str()));
     }
@@ -50,10 +59,7 @@ void ThreePatchImage::paint(GraphicsContext* context, const IntRect& rc, ImageFo
         return;
     }
 
-    for (int i = 0; i < THREEH_PATCH_COUNT; i++) {
-        context->fillBoxWithBitmap(m_subRc[i].left(), m_subRc[i].top(),
-                m_subRc[i].width(), m_subRc[i].height(), &m_subBmp[i]);
-    }
+    m_cache.paint(context, rc, formatKey(format), m_subBmp, m_subRc, THREEH_PATCH_COUNT);
 
     if (m_bLoadOnPainting && NULL != m_pBitmap) {
         GraphicsContext::screenGraphics()->unloadBitmap(m_pBitmap);
@@ -238,6 +244,10 @@ bool ThreePatchImage::setSubBmp()
         return false;
     }
 
+    // the bitmap loaded on painting is the same one each time
+    if (!m_bLoadOnPainting)
+        m_cache.reset();
+
     Uint8* ams = NULL;
     Bitmap* pSubBmp = NULL;
 
@@ -309,6 +319,7 @@ bool ThreePatchImage::setImage(const char* image_file)
         }
 
         clean();
+        m_cache.reset();
         return Image::setImage(image_file);
     }
     return false;
@@ -0,0 +1,227 @@
+#!/usr/bin/python3
+
+#
+# HFCL - HybridOS Foundation Class Library
+#
+# Copyright (C) 2019 Beijing FMSoft Technologies Co., Ltd.
+#
+# This file is part of HFCL.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""
+Make a compiled view template:
+    1. Parse the HVML markup of one view tree; it must have one root.
+    2. Map the tags to nodes in document order; the type, class, name,
+       and id attributes go to the node fields, other attributes to the
+       attribute table, and the text directly in an element to its
+       content.
+    3. Write the template in the layout described in
+       include/view/viewtemplate.h, as a binary file or as a C array
+       which can be compiled in.
+
+The CSS rules are not matched here: ViewTemplate matches them once for
+the CSS group in use, on the first instance.
+
+Usage:
+    make_view_template.py [--cssg ID] [--c-array NAME] input.hvml output
+"""
+
+import sys
+import struct
+import argparse
+from html.parser import HTMLParser
+
+TOOL_NAME="make_view_template.py"
+
+MAGIC = 0x4C545648
+VERSION = 1
+NONE = 0xFFFF
+
+HEADER_FORMAT = "<IIIHHHHIIIIII"
+NODE_FORMAT = "<HHHHHHiHHHH"
+ATTR_FORMAT = "<HH"
+RULE_FORMAT = "<HHI"
+
+VOID_TAGS = ("br", "hr", "img", "input", "meta", "link", )
+
+class TemplateNode:
+    def __init__(self, parent, tag):
+        self.parent = parent
+        self.tag = tag
+        self.type = None
+        self.cls = None
+        self.name = None
+        self.id = 0
+        self.attrs = []
+        self.content = ""
+
+class TemplateParser(HTMLParser):
+    def __init__(self):
+        HTMLParser.__init__(self, convert_charrefs=True)
+        self.nodes = []
+        self.stack = []
+
+    def handle_starttag(self, tag, attrs):
+        if len(self.stack) == 0 and len(self.nodes) > 0:
+            raise ValueError("more than one root element: <%s>" % tag)
+
+        parent = self.stack[-1] if len(self.stack) > 0 else NONE
+        node = TemplateNode(parent, tag)
+        for key, value in attrs:
+            if key == "type":
+                node.type = value
+            elif key == "class":
+                node.cls = value
+            elif key == "name":
+                node.name = value
+            elif key == "id" and value is not None and value.isdigit():
+                node.id = int(value)
+            else:
+                node.attrs.append((key, value, ))
+
+        self.nodes.append(node)
+        if tag not in VOID_TAGS:
+            self.stack.append(len(self.nodes) - 1)
+
+    def handle_startendtag(self, tag, attrs):
+        self.handle_starttag(tag, attrs)
+        if tag not in VOID_TAGS:
+            self.stack.pop()
+
+    def handle_endtag(self, tag):
+        if tag in VOID_TAGS:
+            return
+        if len(self.stack) == 0 or self.nodes[self.stack[-1]].tag != tag:
+            raise ValueError("unexpected end tag: </%s>" % tag)
+        self.stack.pop()
+
+    def handle_data(self, data):
+        if len(self.stack) > 0:
+            self.nodes[self.stack[-1]].content += data
+
+class AtomTable:
+    def __init__(self):
+        self.atoms = {}
+        self.strings = bytearray()
+        self.offsets = []
+
+    def get(self, s):
+        if s is None:
+            return NONE
+        if s not in self.atoms:
+            if len(self.offsets) >= NONE:
+                raise ValueError("too many atoms")
+            self.atoms[s] = len(self.offsets)
+            self.offsets.append(len(self.strings))
+            self.strings += s.encode("utf-8") + b"\0"
+        return self.atoms[s]
+
+def compile_template(nodes, cssg_id):
+    atoms = AtomTable()
+    node_data = bytearray()
+    attr_data = bytearray()
+    nr_attrs = 0
+
+    for node in nodes:
+        content = " ".join(node.content.split())
+        node_data += struct.pack(NODE_FORMAT,
+                node.parent, atoms.get(node.tag), atoms.get(node.type),
+                atoms.get(node.cls), atoms.get(node.name),
+                atoms.get(content if len(content) > 0 else None),
+                node.id, nr_attrs, len(node.attrs), 0, 0)
+        for key, value in node.attrs:
+            attr_data += struct.pack(ATTR_FORMAT,
+                    atoms.get(key), atoms.get(value))
+            nr_attrs += 1
+
+    if len(atoms.strings) == 0:
+        atoms.strings += b"\0"
+
+    atom_data = bytearray()
+    for offset in atoms.offsets:
+        atom_data += struct.pack("<I", offset)
+
+    nodes_offset = struct.calcsize(HEADER_FORMAT)
+    attrs_offset = nodes_offset + len(node_data)
+    rules_offset = attrs_offset + len(attr_data)
+    atoms_offset = rules_offset
+    strings_offset = atoms_offset + len(atom_data)
+
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, cssg_id,
+            len(nodes), nr_attrs, 0, len(atoms.offsets),
+            nodes_offset, attrs_offset, rules_offset, atoms_offset,
+            strings_offset, len(atoms.strings))
+
+    return header + node_data + attr_data + atom_data + atoms.strings
+
+def write_c_array(fdst, name, data, src_file):
+    fdst.write("/*\n** This file is generated by %s from %s.\n** Do not edit it.\n*/\n\n"
+            % (TOOL_NAME, src_file, ))
+    # ViewTemplate::open() reads the tables in place
+    fdst.write("static const unsigned char %s[] __attribute__((aligned(4))) = {"
+            % name)
+    for i in range(len(data)):
+        if i % 12 == 0:
+            fdst.write("\n   ")
+        fdst.write(" 0x%02x," % data[i])
+    fdst.write("\n};\n")
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(prog=TOOL_NAME,
+            description="Make a compiled view template from HVML markup.")
+    parser.add_argument("--cssg", type=int, default=0,
+            help="the resource identifier of the CSS group")
+    parser.add_argument("--c-array", metavar="NAME",
+            help="write a C array with the name instead of a binary file")
+    parser.add_argument("input")
+    parser.add_argument("output")
+    args = parser.parse_args()
+
+    try:
+        with open(args.input, "r", encoding="utf-8") as fsrc:
+            hvml = TemplateParser()
+            hvml.feed(fsrc.read())
+            hvml.close()
+    except (OSError, ValueError) as e:
+        print("%s: failed to parse %s: %s" % (TOOL_NAME, args.input, e, ))
+        sys.exit(1)
+
+    if len(hvml.nodes) == 0:
+        print("%s: no element in %s" % (TOOL_NAME, args.input, ))
+        sys.exit(2)
+    if len(hvml.nodes) >= NONE:
+        print("%s: too many elements in %s" % (TOOL_NAME, args.input, ))
+        sys.exit(2)
+
+    try:
+        data = compile_template(hvml.nodes, args.cssg)
+    except ValueError as e:
+        print("%s: %s" % (TOOL_NAME, e, ))
+        sys.exit(3)
+
+    try:
+        if args.c_array:
+            with open(args.output, "w") as fdst:
+                write_c_array(fdst, args.c_array, data, args.input)
+        else:
+            with open(args.output, "wb") as fdst:
+                fdst.write(data)
+    except OSError as e:
+        print("%s: failed to write %s: %s" % (TOOL_NAME, args.output, e, ))
+        sys.exit(4)
+
+    print("DONE > %d nodes, %d bytes" % (len(hvml.nodes), len(data), ))
+    sys.exit(0)
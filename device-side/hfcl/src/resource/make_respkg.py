@@ -0,0 +1,365 @@
+#!/usr/bin/python3
+
+#
+# HFCL - HybridOS Foundation Class Library
+#
+# Copyright (C) 2019 Beijing FMSoft Technologies Co., Ltd.
+#
+# This file is part of HFCL.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+"""
+Make a resource package file:
+    1. Read the manifest; each line describes one entry:
+
+           TYPE KEY NAME FILE [zlib]
+
+       TYPE is a resource type in lower case without R_TYPE_, such as
+       image or text_raw. KEY is the index of the entry in its type
+       (1, 2, ...), the RESINDEX of its HTResId, or LANG.ENC for a text
+       entry, such as zh_CN.utf8. NAME is the name the entry is looked up
+       by, such as the file name used in code. FILE is relative to the
+       directory of the manifest. Empty lines and lines starting with #
+       are ignored.
+    2. Group the entries by type; the indices of a type must be 1 to the
+       number of the entries of the type.
+    3. Write the package in the layout described in
+       include/resource/respkgfile.h: the header with the type table, the
+       index, the name table sorted by strcmp, the names, and the data of
+       the entries, each one page aligned. An entry marked zlib (or all
+       the entries with --zlib) is compressed if that makes it smaller.
+
+With --zip-strings N, the FILE of a text_zipped entry is a list of
+strings, one per line, in which \\n stands for a new line and \\\\ for a
+backslash; it is written as an HFCL_ZIPPED_STRINGS (see
+include/resource/restypes.h) compressed in blocks of N strings, so that
+TextResZipped inflates only the blocks used. N 0 makes one zlib stream
+of all the strings. Without the option, the FILE is taken as it is.
+
+Usage:
+    make_respkg.py [--pkg-id ID] [--page-size SIZE] [--zlib]
+            [--zip-strings N] manifest output
+"""
+
+import os
+import sys
+import zlib
+import struct
+import argparse
+
+TOOL_NAME="make_respkg.py"
+
+MAGIC = 0x4B505248
+VERSION = 1
+NR_TYPES = 16
+F_ZLIB = 0x0001
+
+HEADER_FORMAT = "<IIIIIIII" + "HH" * NR_TYPES
+ENTRY_FORMAT = "<IIIIIIII"
+ZIPPED_STRINGS_FORMAT = "<IIIIII"
+ZIPPED_BLOCK_FORMAT = "<III"
+
+# in the order of HIDResType in include/resource/restypes.h
+RES_TYPES = ("void", "text_raw", "text_zipped", "text_gnumsg", "image",
+        "font", "css", "cssgroup", "client", "menu", "binary",
+        "style", "drawable", "drawableset", "drsetgroup", "theme", )
+TEXT_TYPES = ("text_raw", "text_zipped", "text_gnumsg", )
+
+# in the order of HIDLanguage in include/resource/restypes.h
+LANGUAGES = ("na_NA", "zh_CN", "zh_TW", "zh_HK", "en_HK", "en_US", "en_GB",
+        "en_WW", "en_CA", "en_AU", "en_IE", "en_FI", "en_DK", "en_IL",
+        "en_ZA", "en_IN", "en_NO", "en_SG", "en_NZ", "en_ID", "en_PH",
+        "en_TH", "en_MY", "en_XA", "ko_KR", "ja_JP", "nl_NL", "nl_BE",
+        "pt_PT", "pt_BR", "fr_FR", "fr_LU", "fr_CH", "fr_BE", "fr_CA",
+        "es_LA", "es_ES", "es_AR", "es_US", "es_MX", "es_CO", "es_PR",
+        "es_CL", "de_DE", "de_AT", "de_CH", "ru_RU", "it_IT", "el_GR",
+        "no_NO", "fi_FI", "da_DK", "he_IL", "hu_HU", "tr_TR", "cs_CZ",
+        "sl_SL", "pl_PL", "sv_SE", )
+
+# in the order of HIDEncoding in include/resource/restypes.h
+ENCODINGS = ("unknown", "utf8", "ascii", "latin1", "latin2", "latin3",
+        "latin4", "cyrillic", "araic", "greek", "hebrew", "latin5", "latin6",
+        "thai", "latin7", "latin8", "latin9", "latin10", "big5", "gb2312",
+        "gbk", "gb18030", "eucjp", "euckr", "shiftjis", "utf16le",
+        "utf16be", )
+
+class PackageEntry:
+    def __init__(self, res_type, key, name, path, compress):
+        self.type = res_type
+        self.key = key
+        self.name = name
+        self.path = path
+        self.compress = compress
+        self.id = 0
+        self.flags = 0
+        self.data = b""
+        self.origin_size = 0
+
+def make_res_id(pkg_id, res_type, idx):
+    return ((pkg_id << 20) & 0xFFF00000) | ((res_type << 16) & 0x000F0000) \
+            | (idx & 0x0000FFFF)
+
+def make_text_key(key):
+    try:
+        lang, enc = key.split(".")
+        return (LANGUAGES.index(lang) << 16) | ENCODINGS.index(enc)
+    except ValueError:
+        raise ValueError("bad language and encoding: %s" % key)
+
+def read_manifest(manifest, compress_all):
+    entries = []
+    names = set()
+    base_dir = os.path.dirname(manifest)
+
+    with open(manifest, "r", encoding="utf-8") as fsrc:
+        for line_no, line in enumerate(fsrc, 1):
+            fields = line.split()
+            if len(fields) == 0 or fields[0].startswith("#"):
+                continue
+
+            where = "%s:%d" % (manifest, line_no, )
+            if len(fields) not in (4, 5) \
+                    or (len(fields) == 5 and fields[4] != "zlib"):
+                raise ValueError("%s: expected TYPE KEY NAME FILE [zlib]"
+                        % where)
+            if fields[0] not in RES_TYPES or fields[0] == "void":
+                raise ValueError("%s: unknown resource type: %s"
+                        % (where, fields[0], ))
+            if fields[2] in names:
+                raise ValueError("%s: duplicate name: %s"
+                        % (where, fields[2], ))
+            names.add(fields[2])
+
+            entry = PackageEntry(RES_TYPES.index(fields[0]), fields[1],
+                    fields[2], os.path.join(base_dir, fields[3]),
+                    compress_all or len(fields) == 5)
+            if fields[0] in TEXT_TYPES:
+                try:
+                    entry.id = make_text_key(entry.key)
+                except ValueError as e:
+                    raise ValueError("%s: %s" % (where, e, ))
+            elif entry.key.isdigit() and int(entry.key) > 0:
+                entry.id = int(entry.key)
+            else:
+                raise ValueError("%s: bad index: %s" % (where, entry.key, ))
+
+            entries.append(entry)
+
+    return entries
+
+# sorts the entries by type; the entries of a type with indices by index
+def group_entries(entries, pkg_id):
+    grouped = []
+    types = []
+
+    for res_type in range(NR_TYPES):
+        group = [e for e in entries if e.type == res_type]
+        if len(group) > 0xFFFF:
+            raise ValueError("too many entries of %s" % RES_TYPES[res_type])
+
+        if RES_TYPES[res_type] in TEXT_TYPES:
+            keys = [e.id for e in group]
+            if len(set(keys)) != len(keys):
+                raise ValueError("duplicate language of %s"
+                        % RES_TYPES[res_type])
+        else:
+            group.sort(key=lambda e: e.id)
+            for i in range(len(group)):
+                if i > 0 and group[i].id == group[i - 1].id:
+                    raise ValueError("duplicate index of %s: %d"
+                            % (RES_TYPES[res_type], group[i].id, ))
+                if group[i].id != i + 1:
+                    raise ValueError("%s %d is missing; the indices must "
+                            "be 1 to %d" % (RES_TYPES[res_type], i + 1,
+                                len(group), ))
+            for i in range(len(group)):
+                group[i].id = make_res_id(pkg_id, res_type, i + 1)
+
+        types.append((len(grouped), len(group), ))
+        grouped += group
+
+    return grouped, types
+
+def read_strings(data):
+    strings = []
+    for line in data.split(b"\n"):
+        if line.endswith(b"\r"):
+            line = line[:-1]
+        strings.append(line.replace(b"\\\\", b"\0").replace(b"\\n", b"\n")
+                .replace(b"\0", b"\\"))
+
+    # the new line ending the last string does not start another one
+    if len(strings) > 0 and strings[-1] == b"":
+        strings.pop()
+    return strings
+
+def zip_strings(strings, lang_id, enc_id, block_strings):
+    if block_strings == 0:
+        origin = b"".join(s + b"\0" for s in strings)
+        zipped = zlib.compress(origin, 9)
+        origin_size = len(origin)
+    else:
+        index = bytearray()
+        blocks = bytearray()
+        nr_blocks = (len(strings) + block_strings - 1) // block_strings
+        origin_size = 0
+        for i in range(nr_blocks):
+            block = strings[i * block_strings:(i + 1) * block_strings]
+            origin = b"".join(s + b"\0" for s in block)
+            data = zlib.compress(origin, 9)
+            index += struct.pack(ZIPPED_BLOCK_FORMAT,
+                    struct.calcsize(ZIPPED_BLOCK_FORMAT) * nr_blocks
+                        + len(blocks),
+                    len(data), len(origin))
+            blocks += data
+            origin_size += len(origin)
+        zipped = index + blocks
+
+    return struct.pack(ZIPPED_STRINGS_FORMAT, lang_id, enc_id, len(zipped),
+            origin_size, len(strings), block_strings) + zipped
+
+def load_entry(entry, block_strings):
+    with open(entry.path, "rb") as fsrc:
+        data = fsrc.read()
+
+    # the strings are compressed already; zlib would not make them smaller
+    if block_strings is not None and RES_TYPES[entry.type] == "text_zipped":
+        entry.data = zip_strings(read_strings(data), entry.id >> 16,
+                entry.id & 0xFFFF, block_strings)
+        entry.origin_size = len(entry.data)
+        return
+
+    entry.origin_size = len(data)
+    entry.data = data
+    if entry.compress:
+        zipped = zlib.compress(data, 9)
+        if len(zipped) < len(data):
+            entry.flags |= F_ZLIB
+            entry.data = zipped
+
+def page_align(offset, page_size):
+    return (offset + page_size - 1) & ~(page_size - 1)
+
+def make_package(entries, types, page_size):
+    strings = bytearray()
+    name_offsets = []
+    for entry in entries:
+        name_offsets.append(len(strings))
+        strings += entry.name.encode("utf-8") + b"\0"
+
+    # strcmp() compares the bytes as unsigned char, as bytes do
+    sorted_names = sorted(range(len(entries)),
+            key=lambda i: entries[i].name.encode("utf-8"))
+
+    index_offset = struct.calcsize(HEADER_FORMAT)
+    names_offset = index_offset + struct.calcsize(ENTRY_FORMAT) * len(entries)
+    strings_offset = names_offset + 4 * len(entries)
+    data_offset = page_align(strings_offset + len(strings), page_size)
+
+    index_data = bytearray()
+    entry_data = bytearray()
+    for i, entry in enumerate(entries):
+        offset = data_offset + len(entry_data)
+        index_data += struct.pack(ENTRY_FORMAT, entry.id, entry.type,
+                entry.flags, offset, len(entry.data), entry.origin_size,
+                name_offsets[i], 0)
+        entry_data += entry.data
+        if i < len(entries) - 1:
+            entry_data += bytes(page_align(len(entry_data), page_size)
+                    - len(entry_data))
+
+    type_table = []
+    for first, count in types:
+        type_table += [first, count]
+
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, page_size,
+            len(entries), index_offset, names_offset, strings_offset, 0,
+            *type_table)
+
+    names_data = bytearray()
+    for i in sorted_names:
+        names_data += struct.pack("<I", i)
+
+    data = header + index_data + names_data + strings
+    data += bytes(data_offset - len(data))
+    data += entry_data
+    if len(data) > 0xFFFFFFFF:
+        raise ValueError("the package is larger than 4 GiB")
+
+    return data
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(prog=TOOL_NAME,
+            description="Make a resource package file from a manifest.")
+    parser.add_argument("--pkg-id", type=int, default=0,
+            help="the identifier of the ResPackage using the package")
+    parser.add_argument("--page-size", type=int, default=4096,
+            help="the page size to align the entries to")
+    parser.add_argument("--zlib", action="store_true",
+            help="compress all the entries which zlib makes smaller")
+    parser.add_argument("--zip-strings", type=int, metavar="N",
+            help="make the text_zipped entries from lists of strings, "
+                "compressed in blocks of N strings")
+    parser.add_argument("manifest")
+    parser.add_argument("output")
+    args = parser.parse_args()
+
+    if args.page_size < 16 or args.page_size & (args.page_size - 1):
+        print("%s: the page size must be a power of two: %d"
+                % (TOOL_NAME, args.page_size, ))
+        sys.exit(1)
+
+    if args.zip_strings is not None and args.zip_strings < 0:
+        print("%s: bad number of strings per block: %d"
+                % (TOOL_NAME, args.zip_strings, ))
+        sys.exit(1)
+
+    try:
+        entries = read_manifest(args.manifest, args.zlib)
+    except (OSError, ValueError) as e:
+        print("%s: failed to read %s: %s" % (TOOL_NAME, args.manifest, e, ))
+        sys.exit(1)
+
+    try:
+        entries, types = group_entries(entries, args.pkg_id)
+    except ValueError as e:
+        print("%s: %s" % (TOOL_NAME, e, ))
+        sys.exit(2)
+
+    try:
+        for entry in entries:
+            load_entry(entry, args.zip_strings)
+    except OSError as e:
+        print("%s: failed to read %s: %s" % (TOOL_NAME, entry.path, e, ))
+        sys.exit(2)
+
+    try:
+        data = make_package(entries, types, args.page_size)
+    except ValueError as e:
+        print("%s: %s" % (TOOL_NAME, e, ))
+        sys.exit(3)
+
+    try:
+        with open(args.output, "wb") as fdst:
+            fdst.write(data)
+    except OSError as e:
+        print("%s: failed to write %s: %s" % (TOOL_NAME, args.output, e, ))
+        sys.exit(4)
+
+    nr_zipped = len([e for e in entries if e.flags & F_ZLIB])
+    print("DONE > %d entries (%d compressed), %d bytes"
+            % (len(entries), nr_zipped, len(data), ))
+    sys.exit(0)
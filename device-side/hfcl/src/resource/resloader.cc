@@ -79,6 +79,9 @@ GifAnimate* ResLoader::getGifAnimate(const char* filepath)
 {
     GifAnimate* gif = NULL;
     const HFCL_INCORE_RES* info = NULL;
+    void* data;
+    unsigned int size;
+    bool mapped;
 
     // GifAnimate : avoid mem leak TODO
     gif = HFCL_NEW_EX(GifAnimate, ());
@@ -87,6 +90,11 @@ GifAnimate* ResLoader::getGifAnimate(const char* filepath)
     if (info != NULL) {
         gif->createGifAnimateFromMem((const char*)info->data, info->size);
     }
+    else if ((data = loadPackageData(filepath, &size, &mapped))) {
+        gif->createGifAnimateFromMem((const char*)data, size);
+        if (!mapped)
+            free(data);
+    }
     else {
         // 2. file system
         gif->createGifAnimateFromFile(filepath);
@@ -117,8 +125,17 @@ Bitmap* ResLoader::getBitmap(const char* filename)
 {
     Bitmap *pbmp = NULL;
     const HFCL_INCORE_RES* info = NULL;
+    HFCL_INCORE_RES pkg_info;
+    bool mapped = true;
 
     info = getIncoreData (filename);
+    if (info == NULL) {
+        pkg_info.data = (unsigned char*)loadPackageData(filename,
+                &pkg_info.size, &mapped);
+        if (pkg_info.data)
+            info = &pkg_info;
+    }
+
     if (NULL != (pbmp = HFCL_NEW_EX(Bitmap, ()))) {
         if (NULL != info) {
             const char * externs_name = NULL;
@@ -126,16 +143,13 @@ Bitmap* ResLoader::getBitmap(const char* filename)
             externs_name = strrchr(filename, '.');
             if (!externs_name) {
                 HFCL_DELETE(pbmp);
-                return NULL;
+                pbmp = NULL;
             }
-
-            externs_name ++;
-
-            if (GraphicsContext::screenGraphics()->loadBitmap(&pbmp,
-                    info->data, info->size, externs_name)) {
+            else if (GraphicsContext::screenGraphics()->loadBitmap(&pbmp,
+                    info->data, info->size, externs_name + 1)) {
                 _DBG_PRINTF ("ResLoader::getBitmap: Failed to load image from memory: %s", filename);
                 HFCL_DELETE(pbmp);
-                return NULL;
+                pbmp = NULL;
             }
         }
         else {
@@ -147,6 +161,9 @@ Bitmap* ResLoader::getBitmap(const char* filename)
         }
     }
 
+    if (info == &pkg_info && !mapped)
+        free(pkg_info.data);
+
     return pbmp;
 }
 
@@ -183,16 +200,17 @@ bool ResLoader::releaseBitmap(Bitmap* pbmp)
 void* ResLoader::loadData (const char* filepath, bool *fromincore)
 {
     NameIncoresMap::iterator it = m_nameIncores.find ((HTData)filepath);
-    if (it == m_nameIncores.end()) {
-        return NULL;
-    }
-
-    const HFCL_INCORE_RES* incores = (const HFCL_INCORE_RES*)it->second;
-    if (incores) {
+    if (it != m_nameIncores.end() && it->second) {
+        const HFCL_INCORE_RES* incores = (const HFCL_INCORE_RES*)it->second;
         *fromincore = true;
         return incores->data;
     }
 
+    /* the mapped data of a package must not be freed either */
+    void* pkg_data = loadPackageData (filepath, NULL, fromincore);
+    if (pkg_data)
+        return pkg_data;
+
     /* try to load from file */
     *fromincore = false;
 
@@ -244,6 +262,48 @@ void ResLoader::registerIncoreRes (const char* resname,
     }
 }
 
+ResPkgFile* ResLoader::mountPackage (const char* path)
+{
+    for (int i = 0; i < m_pkgFiles.size(); i++) {
+        if (strcmp (m_pkgFiles[i]->path(), path) == 0)
+            return m_pkgFiles[i];
+    }
+
+    ResPkgFile* pkg = ResPkgFile::open (path);
+    if (pkg == NULL)
+        return NULL;
+
+    m_pkgFiles.push_back (pkg);
+    return pkg;
+}
+
+bool ResLoader::unmountPackage (const char* path)
+{
+    ResPkgFileVec::iterator it;
+    for (it = m_pkgFiles.begin(); it != m_pkgFiles.end(); ++it) {
+        if (strcmp ((*it)->path(), path) == 0) {
+            ResPkgFile* pkg = *it;
+            m_pkgFiles.erase (it);
+            pkg->unref ();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void* ResLoader::loadPackageData (const char* name, unsigned int* size,
+        bool* mapped)
+{
+    for (int i = 0; i < m_pkgFiles.size(); i++) {
+        const HFCL_RESPKG_ENTRY* entry = m_pkgFiles[i]->find (name);
+        if (entry)
+            return m_pkgFiles[i]->getData (entry, size, mapped);
+    }
+
+    return NULL;
+}
+
 void RegisterIncoreRes (const char* resname,
         const HFCL_INCORE_RES *incores, int count)
 {
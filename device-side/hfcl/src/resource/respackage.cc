@@ -292,6 +292,7 @@ ResPackage::ResPackage(const char *name, int id,
     m_id = id;
     m_name= utf8string(name);
     m_packagePath = "";
+    m_pkgFile = NULL;
 
     /*
      * init res package entry
@@ -322,6 +323,34 @@ ResPackage::~ResPackage()
     if (m_textRes) {
         HFCL_DELETE (m_textRes);
     }
+
+    // after the text resource, which may use the mapped data of the file
+    if (m_pkgFile)
+        m_pkgFile->unref();
+}
+
+bool ResPackage::setPackageFile(const char* path)
+{
+    ResPkgFile* pkg = ResLoader::getInstance()->mountPackage(path);
+    if (pkg)
+        pkg->ref();
+
+    if (m_pkgFile)
+        m_pkgFile->unref();
+    m_pkgFile = pkg;
+    return m_pkgFile != NULL;
+}
+
+const char* ResPackage::getPackageFileName(HTResId id)
+{
+    if (m_pkgFile == NULL)
+        return NULL;
+
+    const HFCL_RESPKG_ENTRY* entry = m_pkgFile->find(id);
+    if (entry == NULL)
+        return NULL;
+
+    return m_pkgFile->name(entry);
 }
 
 const utf8string &ResPackage::getPackagePath(void)
@@ -580,31 +609,50 @@ void ResPackage::addTextResGnuMsg(HIDLanguage lang, HIDEncoding enc,
 
 bool ResPackage::setCurrentLang(HIDLanguage lang, HIDEncoding enc)
 {
+    static const HIDResType text_types[] = {
+        R_TYPE_TEXT_RAW, R_TYPE_TEXT_ZIPPED, R_TYPE_TEXT_GNUMSG,
+    };
+
     if (m_textRes) {
         HFCL_DELETE (m_textRes);
         m_textRes = NULL;
     }
 
-    TextResMap &res = m_resBuckets[R_TYPE_TEXT_RAW].textRes();
-    TextResMap::iterator it = res.find(MAKELONG(enc, lang));
-    if (it != res.end() && it->second) {
-        m_textRes = HFCL_NEW_EX (TextResRaw, (it->second));
-        return true;
-    }
+    for (unsigned i = 0; i < TABLESIZE(text_types); i++) {
+        HIDResType type = text_types[i];
+        const char* name = NULL;
 
-    res = m_resBuckets[R_TYPE_TEXT_ZIPPED].textRes();
-    it = res.find(MAKELONG(enc, lang));
-    if (it != res.end() && it->second) {
-        m_textResType = R_TYPE_TEXT_ZIPPED;
-        m_textRes = HFCL_NEW_EX (TextResZipped, (it->second));
-        return true;
-    }
+        TextResMap &res = m_resBuckets[type].textRes();
+        TextResMap::iterator it = res.find(MAKELONG(enc, lang));
+        if (it != res.end() && it->second) {
+            name = it->second;
+        }
+        else if (m_pkgFile) {
+            const HFCL_RESPKG_ENTRY* entry
+                = m_pkgFile->findText(type, lang, enc);
+            if (entry)
+                name = m_pkgFile->name(entry);
+        }
+
+        if (name == NULL)
+            continue;
+
+        if (type == R_TYPE_TEXT_RAW)
+            m_textRes = HFCL_NEW_EX (TextResRaw, (name));
+        else if (type == R_TYPE_TEXT_ZIPPED)
+            m_textRes = HFCL_NEW_EX (TextResZipped, (name));
+        else
+            m_textRes = HFCL_NEW_EX (TextResGnuMsg, (name));
+
+        m_textResType = type;
+        if (!m_textRes->load()) {
+            HFCL_DELETE (m_textRes);
+            m_textRes = NULL;
+            return false;
+        }
 
-    res = m_resBuckets[R_TYPE_TEXT_GNUMSG].textRes();
-    it = res.find(MAKELONG(enc, lang));
-    if (it != res.end() && it->second) {
-        m_textResType = R_TYPE_TEXT_GNUMSG;
-        m_textRes = HFCL_NEW_EX (TextResGnuMsg, (it->second));
+        m_languageId = lang;
+        m_encodingId = enc;
         return true;
     }
 
@@ -635,6 +683,11 @@ GifAnimate *ResPackage::getGifAnimate(HTResId id)
 {
     unsigned int idx = RESINDEX(id) - 1;
 
+    if (R_TYPE_IMAGE == RESTYPE(id) && idx >= m_ImagReseSize) {
+        const char* name = getPackageFileName(id);
+        return name ? ResLoader::getInstance()->getGifAnimate(name) : NULL;
+    }
+
     if (R_TYPE_IMAGE != RESTYPE(id) || idx < 0
             || idx >= m_ImagReseSize)
         return (GifAnimate *)NULL;
@@ -646,6 +699,11 @@ Image *ResPackage::getImage(HTResId id)
 {
     unsigned int idx = RESINDEX(id) - 1;
 
+    if (R_TYPE_IMAGE == RESTYPE(id) && idx >= m_ImagReseSize) {
+        const char* name = getPackageFileName(id);
+        return name ? ResLoader::getInstance()->getImage(name) : NULL;
+    }
+
     if (R_TYPE_IMAGE != RESTYPE(id) || idx < 0
             || idx >= m_ImagReseSize)
         return (Image *)NULL;
@@ -657,6 +715,11 @@ Bitmap *ResPackage::getBitmap(HTResId id)
 {
     unsigned int idx = RESINDEX(id) - 1;
 
+    if (R_TYPE_IMAGE == RESTYPE(id) && idx >= m_ImagReseSize) {
+        const char* name = getPackageFileName(id);
+        return name ? ResLoader::getInstance()->getBitmap(name) : NULL;
+    }
+
     if (R_TYPE_IMAGE != RESTYPE(id) || idx < 0
             || idx >= m_ImagReseSize)
         return NULL;
@@ -0,0 +1,232 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "resource/respkgfile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace hfcl {
+
+ResPkgFile::ResPkgFile()
+    : m_base(NULL)
+    , m_size(0)
+    , m_header(NULL)
+    , m_entries(NULL)
+    , m_names(NULL)
+{
+}
+
+ResPkgFile::~ResPkgFile()
+{
+    if (m_base)
+        munmap(m_base, m_size);
+}
+
+ResPkgFile* ResPkgFile::open(const char* path)
+{
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        _ERR_PRINTF("ResPkgFile::open: failed to open %s\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(HFCL_RESPKG_HEADER)) {
+        _ERR_PRINTF("ResPkgFile::open: bad package file %s\n", path);
+        ::close(fd);
+        return NULL;
+    }
+
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        _ERR_PRINTF("ResPkgFile::open: failed to map %s\n", path);
+        return NULL;
+    }
+
+    // the entries are used one by one; do not read ahead the others
+    madvise(base, st.st_size, MADV_RANDOM);
+
+    ResPkgFile* pkg = HFCL_NEW_EX(ResPkgFile, ());
+    pkg->m_path = path;
+    pkg->m_base = (Uint8*)base;
+    pkg->m_size = st.st_size;
+    pkg->m_header = (const HFCL_RESPKG_HEADER*)base;
+    pkg->m_entries = (const HFCL_RESPKG_ENTRY*)
+            (pkg->m_base + pkg->m_header->index_offset);
+    pkg->m_names = (const Uint32*)(pkg->m_base + pkg->m_header->names_offset);
+
+    if (!pkg->check()) {
+        _ERR_PRINTF("ResPkgFile::open: corrupted package file %s\n", path);
+        HFCL_DELETE(pkg);
+        return NULL;
+    }
+
+    return pkg;
+}
+
+// checks the header and the bounds of the tables only; an entry is
+// checked when it is looked up, so opening a package does not touch the
+// pages of the whole index and of the names
+bool ResPkgFile::check() const
+{
+    const HFCL_RESPKG_HEADER* h = m_header;
+
+    if (h->magic != HFCL_RESPKG_MAGIC || h->version != HFCL_RESPKG_VERSION)
+        return false;
+
+    size_t index_size = (size_t)h->nr_entries * sizeof(HFCL_RESPKG_ENTRY);
+    if (h->index_offset > m_size || index_size > m_size - h->index_offset)
+        return false;
+    if (h->names_offset > m_size
+            || (size_t)h->nr_entries * 4 > m_size - h->names_offset)
+        return false;
+    if (h->strings_offset > m_size)
+        return false;
+
+    for (int t = 0; t < HFCL_RESPKG_NR_TYPES; t++) {
+        if ((Uint32)h->types[t].first + h->types[t].count > h->nr_entries)
+            return false;
+    }
+
+    return true;
+}
+
+// checks the data and the name of an entry
+bool ResPkgFile::checkEntry(const HFCL_RESPKG_ENTRY* e) const
+{
+    size_t strings_size = m_size - m_header->strings_offset;
+
+    if (e->offset > m_size || e->size > m_size - e->offset
+            || e->name >= strings_size
+            || memchr((const char*)m_base + m_header->strings_offset + e->name,
+                '\0', strings_size - e->name) == NULL) {
+        _ERR_PRINTF("ResPkgFile::checkEntry: bad entry %d in %s\n",
+                (int)(e - m_entries), m_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+const HFCL_RESPKG_ENTRY* ResPkgFile::find(HTResId id) const
+{
+    unsigned int type = RESTYPE(id);
+    unsigned int idx = RESINDEX(id) - 1;
+
+    if (type >= HFCL_RESPKG_NR_TYPES || idx >= m_header->types[type].count)
+        return NULL;
+
+    const HFCL_RESPKG_ENTRY* e = m_entries + m_header->types[type].first + idx;
+    return (e->id == id && checkEntry(e)) ? e : NULL;
+}
+
+const HFCL_RESPKG_ENTRY* ResPkgFile::find(const char* name) const
+{
+    int low = 0;
+    int high = (int)m_header->nr_entries - 1;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (m_names[mid] >= m_header->nr_entries)
+            return NULL;
+
+        const HFCL_RESPKG_ENTRY* e = m_entries + m_names[mid];
+        if (!checkEntry(e))
+            return NULL;
+
+        int cmp = strcmp(name, this->name(e));
+
+        if (cmp == 0)
+            return e;
+        if (cmp < 0)
+            high = mid - 1;
+        else
+            low = mid + 1;
+    }
+
+    return NULL;
+}
+
+const HFCL_RESPKG_ENTRY* ResPkgFile::findText(HIDResType type,
+        HIDLanguage lang, HIDEncoding enc) const
+{
+    if (type >= HFCL_RESPKG_NR_TYPES)
+        return NULL;
+
+    // a package has a few languages only
+    Uint32 key = MAKELONG(enc, lang);
+    const HFCL_RESPKG_ENTRY* e = m_entries + m_header->types[type].first;
+    for (int i = 0; i < m_header->types[type].count; i++, e++) {
+        if (e->id == key)
+            return checkEntry(e) ? e : NULL;
+    }
+
+    return NULL;
+}
+
+const char* ResPkgFile::name(const HFCL_RESPKG_ENTRY* entry) const
+{
+    if (!checkEntry(entry))
+        return NULL;
+
+    return (const char*)m_base + m_header->strings_offset + entry->name;
+}
+
+void* ResPkgFile::getData(const HFCL_RESPKG_ENTRY* entry, unsigned int* size,
+        bool* mapped) const
+{
+    Uint8* data = m_base + entry->offset;
+
+    if (!(entry->flags & HFCL_RESPKG_F_ZLIB)) {
+        *mapped = true;
+        if (size)
+            *size = entry->size;
+        return data;
+    }
+
+    *mapped = false;
+    uLongf len = entry->origin_size;
+    void* buff = malloc(len ? len : 1);
+    if (buff == NULL) {
+        _ERR_PRINTF("ResPkgFile::getData: failed to allocate %u bytes\n",
+                entry->origin_size);
+        return NULL;
+    }
+
+    int ret = uncompress((Bytef*)buff, &len, (Bytef*)data, entry->size);
+    if (ret != Z_OK || len != entry->origin_size) {
+        _ERR_PRINTF("ResPkgFile::getData: failed to uncompress %s: %d\n",
+                name(entry), ret);
+        free(buff);
+        return NULL;
+    }
+
+    if (size)
+        *size = len;
+    return buff;
+}
+
+} // namespace hfcl
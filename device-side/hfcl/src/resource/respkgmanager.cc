@@ -22,7 +22,6 @@
 #include "resource/respkgmanager.h"
 
 #include <string.h>
-#include <zlib.h>
 
 #include "resource/respackage.h"
 #include "drawable/drawable.h"
@@ -382,126 +381,5 @@ const char *GetText(const char* txt, int pkgId)
     return NULL;
 }
 
-#if 0
-void ResPkgManager::registerRawStringTable (LANGUAGE_RAW_STRINGS* table,
-        HTResId maxId)
-{
-    m_l10n_raw_str_table = table;
-    m_max_text_id = maxId;
-
-    if (m_raw_strings) {
-        free (m_raw_strings);
-        m_raw_strings = NULL;
-    }
-}
-
-void ResPkgManager::registerZippedStringTable (LANGUAGE_ZIPPED_STRINGS* table,
-        HTResId maxId)
-{
-    m_l10n_zipped_str_table = table;
-    m_max_text_id = maxId;
-
-    if (m_raw_strings) {
-        free (m_raw_strings);
-        m_raw_strings = NULL;
-    }
-}
-
-const char* ResPkgManager::getTextRes (HTResId id)
-{
-    if (id >= m_max_text_id || m_raw_strings == NULL) {
-        _DBG_PRINTF ("ResPkgManager::getTextRes: invalid text id or not initialized\n");
-        return NULL;
-    }
-
-    const char* text = m_raw_strings [id];
-    if (text == NULL) {
-        return "";
-    }
-
-    return text;
-}
-
-bool ResPkgManager::setCurrentLang (int langId)
-{
-    if (langId < 0 || langId >= MAX_LANGID)
-        return false;
-
-    if (m_l10n_raw_str_table &&
-            m_l10n_raw_str_table [langId].raw_strings) {
-        m_raw_strings = m_l10n_raw_str_table [langId].raw_strings;
-        m_lang_id = langId;
-        return true;
-    }
-
-    if (m_l10n_zipped_str_table == NULL ||
-            m_l10n_zipped_str_table [langId].zipped_bytes == NULL) {
-        _ERR_PRINTF ("ResPkgManager::setCurrentLang: no strings for language: %d.\n", langId);
-        return false;
-    }
-
-    if (m_string_bucket == NULL) {
-        size_t max_bucket_size = 0;
-        for (int i = 0; i < MAX_LANGID; i++) {
-            size_t current_size = m_l10n_zipped_str_table [i].origin_size;
-            if (current_size > max_bucket_size) {
-                max_bucket_size = current_size;
-            }
-        }
-
-        if (max_bucket_size == 0) {
-            _ERR_PRINTF ("ResPkgManager::setCurrentLang: no any language defined.\n");
-            return false;
-        }
-
-        m_string_bucket = (char*)malloc (max_bucket_size);
-        if (m_string_bucket == NULL) {
-            _ERR_PRINTF ("ResPkgManager::setCurrentLang: failed to allocate memory for bucket.\n");
-            return false;
-        }
-
-        m_raw_strings = (const char**)malloc (sizeof (char*) * (m_max_text_id + 1));
-        if (m_string_bucket == NULL) {
-            _ERR_PRINTF ("ResPkgManager::setCurrentLang: failed to allocate memory for utf8string table.\n");
-            return false;
-        }
-    }
-
-    uLongf len_uncompressed = m_l10n_zipped_str_table [langId].origin_size;
-    int ret = uncompress ((Bytef*)m_string_bucket, &len_uncompressed,
-            (Bytef*)m_l10n_zipped_str_table [langId].zipped_bytes,
-            m_l10n_zipped_str_table [langId].zipped_size);
-    if (ret != Z_OK) {
-        _ERR_PRINTF ("ResPkgManager::setCurrentLang: failed when calling uncompress: %d.\n", ret);
-        return false;
-    }
-
-#ifdef _DEBUG
-    if (len_uncompressed != m_l10n_zipped_str_table [langId].origin_size) {
-        _DBG_PRINTF ("ResPkgManager::setCurrentLang: length not matched: %lu, %u.\n",
-            len_uncompressed, m_l10n_zipped_str_table [langId].origin_size);
-        return false;
-    }
-#endif
-
-    size_t offset = 0;
-    for (HTResId i = 0; i < m_max_text_id; i++) {
-        m_raw_strings [i] = m_string_bucket + offset;
-        offset += strlen (m_raw_strings [i]);
-        offset += 1;
-    }
-
-#ifdef _DEBUG
-    if (offset > len_uncompressed) {
-        _DBG_PRINTF ("ResPkgManager::setCurrentLang: buffer overflow: %lu, %u.\n",
-            len_uncompressed, offset);
-        return false;
-    }
-#endif
-    m_lang_id = langId;
-    return true;
-}
-#endif
-
 } // namespace hfcl
 
@@ -53,29 +53,62 @@ void TextResRaw::release ()
 
 bool TextResZipped::load ()
 {
-    bool is_incore = false;
-    HFCL_ZIPPED_STRINGS* zipped_str
-        = (HFCL_ZIPPED_STRINGS*)ResLoader::getInstance()->loadData (
-            m_res_name, &is_incore);
+    release ();
 
-    if (zipped_str == NULL) {
+    m_zipped_str = (HFCL_ZIPPED_STRINGS*)ResLoader::getInstance()->loadData (
+            m_res_name, &m_from_incore);
+
+    if (m_zipped_str == NULL) {
         _ERR_PRINTF ("TextResZipped::load: "
                 "failed to load zipped text resource\n");
         return false;
     }
 
+    if (m_zipped_str->block_strings == 0) {
+        bool ok = loadAll ();
+        if (!m_from_incore)
+            free (m_zipped_str);
+        m_zipped_str = NULL;
+
+        if (!ok)
+            release ();
+        return ok;
+    }
+
+    /* a blocked string table: only allocate the table of blocks here */
+    m_nr_blocks = (m_zipped_str->nr_strings + m_zipped_str->block_strings - 1)
+        / m_zipped_str->block_strings;
+    if (m_nr_blocks * sizeof (HFCL_ZIPPED_BLOCK)
+            > m_zipped_str->zipped_size) {
+        _ERR_PRINTF ("TextResZipped::load: bad block index\n");
+        release ();
+        return false;
+    }
+
+    m_blocks = (Block*)calloc (m_nr_blocks, sizeof (Block));
+    if (m_blocks == NULL) {
+        _ERR_PRINTF ("TextResZipped::load: "
+                "failed to allocate memory for blocks\n");
+        release ();
+        return false;
+    }
+
+    m_nr_inflated = 0;
+    return true;
+}
+
+bool TextResZipped::loadAll ()
+{
+    HFCL_ZIPPED_STRINGS* zipped_str = m_zipped_str;
     uLongf len_uncompressed = zipped_str->origin_size;
     size_t offset = 0;
     int ret;
 
-    if (m_string_bucket)
-        free (m_string_bucket);
-
     m_string_bucket = (char*)malloc (zipped_str->origin_size);
     if (m_string_bucket == NULL) {
         _ERR_PRINTF ("TextResZipped::load: "
                 "failed to allocate memory for bucket\n");
-        goto error;
+        return false;
     }
 
     m_raw_strings
@@ -83,7 +116,7 @@ bool TextResZipped::load ()
     if (m_raw_strings == NULL) {
         _ERR_PRINTF ("TextResZipped::load: "
                 "failed to allocate memory for string table\n");
-        goto error;
+        return false;
     }
 
     ret = uncompress ((Bytef*)m_string_bucket, &len_uncompressed,
@@ -91,7 +124,7 @@ bool TextResZipped::load ()
     if (ret != Z_OK) {
         _ERR_PRINTF ("TextResZipped::load: "
                 "failed when calling uncompress: %d\n", ret);
-        goto error;
+        return false;
     }
 
 #ifdef _DEBUG
@@ -99,7 +132,7 @@ bool TextResZipped::load ()
         _DBG_PRINTF ("TextResZipped::load: "
                 "length not matched: %lu, %u\n",
                 len_uncompressed, zipped_str->origin_size);
-        goto error;
+        return false;
     }
 #endif
 
@@ -113,20 +146,86 @@ bool TextResZipped::load ()
     if (offset > len_uncompressed) {
         _DBG_PRINTF ("TextResZipped::load: buffer overflow: %lu, %u\n",
             len_uncompressed, offset);
-        goto error;
+        return false;
     }
 #endif
 
-    if (!is_incore)
-        free (zipped_str);
+    m_nr_strings = zipped_str->nr_strings;
+    return true;
+}
+
+bool TextResZipped::inflateBlock (Uint32 idx)
+{
+    const HFCL_ZIPPED_BLOCK* info
+        = (const HFCL_ZIPPED_BLOCK*)m_zipped_str->zipped_bytes + idx;
+    Block* block = m_blocks + idx;
+
+    if (info->offset > m_zipped_str->zipped_size
+            || info->zipped_size > m_zipped_str->zipped_size - info->offset) {
+        _ERR_PRINTF ("TextResZipped::inflateBlock: bad block: %u\n", idx);
+        return false;
+    }
+
+    Uint32 first = idx * m_zipped_str->block_strings;
+    Uint32 count = m_zipped_str->nr_strings - first;
+    if (count > m_zipped_str->block_strings)
+        count = m_zipped_str->block_strings;
+
+    uLongf len_uncompressed = info->origin_size;
+    char* bucket = (char*)malloc (info->origin_size + 1);
+    const char** strings = (const char**)malloc (sizeof (char*) * count);
+    if (bucket == NULL || strings == NULL) {
+        _ERR_PRINTF ("TextResZipped::inflateBlock: "
+                "failed to allocate memory for block %u\n", idx);
+        goto error;
+    }
+
+    if (uncompress ((Bytef*)bucket, &len_uncompressed,
+            (Bytef*)m_zipped_str->zipped_bytes + info->offset,
+            info->zipped_size) != Z_OK) {
+        _ERR_PRINTF ("TextResZipped::inflateBlock: "
+                "failed to uncompress block %u\n", idx);
+        goto error;
+    }
+
+    /* a broken block must not make the strings run out of the bucket */
+    bucket [len_uncompressed] = '\0';
+    for (Uint32 i = 0, offset = 0; i < count; i++) {
+        strings [i] = bucket + offset;
+        if (offset < len_uncompressed)
+            offset += strlen (strings [i]) + 1;
+    }
+
+    block->bucket = bucket;
+    block->strings = strings;
+    m_nr_inflated++;
     return true;
 
 error:
-    if (!is_incore)
-        free (zipped_str);
+    free (bucket);
+    free (strings);
     return false;
 }
 
+const char* TextResZipped::getText (HTStrId strId)
+{
+    if (m_raw_strings) {
+        if (strId < 0 || (Uint32)strId >= m_nr_strings)
+            return "";
+        return m_raw_strings [strId];
+    }
+
+    if (m_blocks == NULL || strId < 0
+            || (Uint32)strId >= m_zipped_str->nr_strings)
+        return "";
+
+    Uint32 idx = strId / m_zipped_str->block_strings;
+    if (m_blocks [idx].strings == NULL && !inflateBlock (idx))
+        return "";
+
+    return m_blocks [idx].strings [strId % m_zipped_str->block_strings];
+}
+
 void TextResZipped::release ()
 {
     if (m_string_bucket) {
@@ -137,8 +236,26 @@ void TextResZipped::release ()
         free (m_raw_strings);
     }
 
+    if (m_blocks) {
+        for (Uint32 i = 0; i < m_nr_blocks; i++) {
+            free (m_blocks [i].bucket);
+            free (m_blocks [i].strings);
+        }
+        free (m_blocks);
+    }
+
+    if (m_zipped_str && !m_from_incore) {
+        free (m_zipped_str);
+    }
+
     m_string_bucket = NULL;
     m_raw_strings = NULL;
+    m_nr_strings = 0;
+    m_zipped_str = NULL;
+    m_from_incore = false;
+    m_blocks = NULL;
+    m_nr_blocks = 0;
+    m_nr_inflated = 0;
 }
 
 const char* TextResGnuMsg::getText (const char* msgid)
@@ -328,9 +445,17 @@ bool TextResGnuMsg::load ()
     const HFCL_INCORE_RES* res_info
         = ResLoader::getInstance()->getIncoreData (mo_file);
 
+    void* pkg_data = NULL;
+    unsigned int pkg_size;
+    bool mapped = true;
+
     if (res_info) {
         src = MGUI_RWFromMem (res_info->data, res_info->size);
     }
+    else if ((pkg_data = ResLoader::getInstance()->loadPackageData (mo_file,
+                    &pkg_size, &mapped))) {
+        src = MGUI_RWFromMem (pkg_data, pkg_size);
+    }
     else {
         src = MGUI_RWFromFile (mo_file, "r");
     }
@@ -344,6 +469,8 @@ bool TextResGnuMsg::load ()
     doLoad (src);
 
     MGUI_FreeRW (src);
+    if (pkg_data && !mapped)
+        free (pkg_data);
 
     return true;
 }
@@ -0,0 +1,241 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "services/framescheduler.h"
+#include "activity/window.h"
+
+#include <time.h>
+
+namespace hfcl {
+
+static unsigned long long now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+FrameScheduler* FrameScheduler::getInstance()
+{
+    static FrameScheduler* s_scheduler = NULL;
+
+    if (s_scheduler == NULL)
+        s_scheduler = HFCL_NEW_EX(FrameScheduler, ());
+    return s_scheduler;
+}
+
+FrameScheduler::FrameScheduler()
+    : m_rate(FRAMESCHEDULER_DEFAULT_RATE)
+    , m_timerId(0)
+    , m_inFrame(false)
+    , m_stopped(false)
+    , m_lastFrame(0)
+{
+    resetStats();
+}
+
+FrameScheduler::~FrameScheduler()
+{
+    stop();
+}
+
+void FrameScheduler::start()
+{
+    m_stopped = false;
+    updateTimer();
+}
+
+void FrameScheduler::stop()
+{
+    m_stopped = true;
+    for (int i = 0; i < m_clients.size(); i++)
+        m_clients[i] = NULL;
+    if (!m_inFrame)
+        m_clients.clear();
+    updateTimer();
+}
+
+int FrameScheduler::frameInterval() const
+{
+    int interval = 1000 / m_rate;
+
+    // round to the ticks of TimerService
+    interval = (interval + SERVICE_TIMER_INTERVAL / 2)
+        / SERVICE_TIMER_INTERVAL * SERVICE_TIMER_INTERVAL;
+    return interval > 0 ? interval : SERVICE_TIMER_INTERVAL;
+}
+
+void FrameScheduler::setTargetRate(int fps)
+{
+    if (fps <= 0 || fps == m_rate)
+        return;
+
+    m_rate = fps;
+    if (m_timerId) {
+        removeTimer(m_timerId);
+        m_timerId = 0;
+        updateTimer();
+    }
+}
+
+void FrameScheduler::updateTimer()
+{
+    bool run = !m_stopped && m_clients.size() > 0;
+
+    if (run && m_timerId == 0) {
+        m_timerId = registerTimer(frameInterval(), "FrameScheduler",
+                TIMER_PRIORITY_HIGH);
+    }
+    else if (!run && m_timerId) {
+        removeTimer(m_timerId);
+        m_timerId = 0;
+        // the time asleep is not a dropped frame
+        m_lastFrame = 0;
+    }
+}
+
+bool FrameScheduler::hasClient(const FrameClient* client) const
+{
+    for (int i = 0; i < m_clients.size(); i++) {
+        if (m_clients[i] == client)
+            return true;
+    }
+
+    return false;
+}
+
+void FrameScheduler::addClient(FrameClient* client)
+{
+    if (client == NULL || m_stopped || hasClient(client))
+        return;
+
+    m_clients.push_back(client);
+    updateTimer();
+}
+
+void FrameScheduler::removeClient(FrameClient* client)
+{
+    for (int i = 0; i < m_clients.size(); i++) {
+        if (m_clients[i] == client) {
+            // keep the order; a client removed in a frame is skipped
+            m_clients[i] = NULL;
+            break;
+        }
+    }
+
+    if (!m_inFrame) {
+        for (int i = m_clients.size() - 1; i >= 0; i--) {
+            if (m_clients[i] == NULL)
+                m_clients.erase(m_clients.begin() + i);
+        }
+        updateTimer();
+    }
+}
+
+void FrameScheduler::requestPaint(Window* window)
+{
+    if (!m_inFrame)
+        return;
+
+    for (int i = 0; i < m_dirtyWindows.size(); i++) {
+        if (m_dirtyWindows[i] == window)
+            return;
+    }
+
+    m_dirtyWindows.push_back(window);
+}
+
+void FrameScheduler::cancelPaint(Window* window)
+{
+    for (int i = 0; i < m_dirtyWindows.size(); i++) {
+        if (m_dirtyWindows[i] == window)
+            m_dirtyWindows[i] = NULL;
+    }
+}
+
+void FrameScheduler::runFrame()
+{
+    Uint32 now = ticks();
+    int interval = frameInterval();
+
+    if (m_lastFrame && (int)(now - m_lastFrame) >= interval * 2)
+        m_stats.dropped += (now - m_lastFrame) / interval - 1;
+    m_lastFrame = now;
+
+    unsigned long long start = now_us();
+    m_inFrame = true;
+
+    // the clients added in this frame get their first frame next time
+    int n = m_clients.size();
+    for (int i = 0; i < n; i++) {
+        FrameClient* client = m_clients[i];
+        if (client && !client->onFrame(now)) {
+            // the client may have removed itself
+            if (m_clients[i] == client)
+                m_clients[i] = NULL;
+        }
+    }
+
+    // one paint for all changes of the frame in a window
+    m_inFrame = false;
+    for (int i = 0; i < m_dirtyWindows.size(); i++) {
+        if (m_dirtyWindows[i]) {
+            m_dirtyWindows[i]->flushUpdates();
+            m_stats.paints++;
+        }
+    }
+    m_dirtyWindows.clear();
+
+    for (int i = m_clients.size() - 1; i >= 0; i--) {
+        if (m_clients[i] == NULL)
+            m_clients.erase(m_clients.begin() + i);
+    }
+
+    unsigned int time = (unsigned int)(now_us() - start);
+    m_stats.frames++;
+    m_stats.lastFrameTime = time;
+    m_stats.totalFrameTime += time;
+    if (time > m_stats.maxFrameTime)
+        m_stats.maxFrameTime = time;
+
+    updateTimer();
+}
+
+bool FrameScheduler::handler(Event* event)
+{
+    if (event->eventType() == Event::ET_TIMER)
+        runFrame();
+
+    return GOON_DISPATCH;
+}
+
+void FrameScheduler::dumpStats()
+{
+    unsigned int average = m_stats.frames ?
+        (unsigned int)(m_stats.totalFrameTime / m_stats.frames) : 0;
+
+    _MG_PRINTF("FrameScheduler: %u frames, %u dropped, %u paints, "
+            "frame time %u us (average), %u us (max)\n",
+            m_stats.frames, m_stats.dropped, m_stats.paints,
+            average, m_stats.maxFrameTime);
+}
+
+} // namespace hfcl
@@ -23,112 +23,403 @@
 
 namespace hfcl {
 
+// the low 16 bits of an id are the index of the node plus 1, the next
+// 15 bits the generation of the node, so the ids are always positive
+#define TIMER_INDEX_MASK    0xFFFF
+#define TIMER_ID_STEP       0x10000
+#define TIMER_GEN_SHIFT     16
+#define TIMER_GEN_MASK      0x7FFF
+
+static inline void link_init(TimerLink* head)
+{
+    head->next = head->prev = head;
+}
+
+static inline bool link_empty(const TimerLink* head)
+{
+    return head->next == head;
+}
+
+static inline void link_add_tail(TimerLink* head, TimerLink* link)
+{
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+static inline void link_add_head(TimerLink* head, TimerLink* link)
+{
+    link->next = head->next;
+    link->prev = head;
+    head->next->prev = link;
+    head->next = link;
+}
+
+static inline void link_del(TimerLink* link)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->next = link->prev = link;
+}
+
+// moves all links of from to the tail of to
+static inline void link_splice(TimerLink* from, TimerLink* to)
+{
+    if (link_empty(from))
+        return;
+
+    from->next->prev = to->prev;
+    to->prev->next = from->next;
+    from->prev->next = to;
+    to->prev = from->prev;
+    link_init(from);
+}
+
 TimerService::TimerService()
+    : m_bPause(FALSE)
+    , m_now(0)
+    , m_pausedTicks(0)
+    , m_pauseStart(0)
+    , m_driving(false)
+    , m_nodes(NULL)
+    , m_nrNodes(0)
+    , m_freeNodes(NULL)
 {
+    for (int i = 0; i < ROOT_SIZE; i++)
+        link_init(&m_root[i]);
+    for (int l = 0; l < NR_LEVELS - 1; l++) {
+        for (int i = 0; i < LEVEL_SIZE; i++)
+            link_init(&m_levels[l][i]);
+    }
+    link_init(&m_expiring);
+
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_now = currentTick();
 }
 
 TimerService::~TimerService()
 {
     stop();
+
+    for (int i = 0; i < m_nrNodes; i++)
+        HFCL_FREE(m_nodes[i]);
+    if (m_nodes)
+        HFCL_FREE(m_nodes);
+}
+
+Uint32 TimerService::currentTick() const
+{
+    // GetTickCount() counts in 10 ms
+    Uint32 ticks = (Uint32)GetTickCount() * 10 / SERVICE_TIMER_INTERVAL;
+    return ticks - m_pausedTicks;
 }
 
-BOOL TimerService::TimerProc (HWND listener, LINT id, DWORD data)
+BOOL TimerService::TimerProc(HWND listener, LINT id, DWORD data)
 {
-    TimerEvent event(id);
-    if (listener != 0)
-        ((TimerEventListener *)(listener))->handler(&event);
+    TimerService* service = (TimerService*)listener;
+
+    Uint32 now = service->currentTick();
+    while (service->m_driving && (Sint32)(now - service->m_now) >= 0)
+        service->runTick(now);
 
+    // the timer is killed in updateDriver() once there is no timer
     return TRUE;
 }
 
-BOOL TimerService::OneShotTimerProc (HWND listener, LINT id, DWORD data)
+void TimerService::updateDriver()
 {
-    TimerEvent event(id);
+    bool drive = m_stats.timers > 0 && !m_bPause;
+    if (drive == m_driving)
+        return;
 
-    if(listener != 0)
-        ((TimerEventListener *)(listener))->handler(&event);
+    if (drive) {
+        if (!SetTimerEx((HWND)this, SERVICE_TIMER_ID,
+                SERVICE_TIMER_INTERVAL / 10, TimerService::TimerProc)) {
+            _ERR_PRINTF("TimerService::updateDriver: Failed to call SetTimerEx SOS\n");
+            return;
+        }
+    }
+    else {
+        KillTimer((HWND)this, SERVICE_TIMER_ID);
+    }
 
-    return FALSE;
+    m_driving = drive;
 }
 
-int TimerService::addTimerListener (int interval, TimerEventListener* listener,
-        TimerPriority priority, const char *listenername)
+TimerService::TimerNode* TimerService::nodeOfId(int id) const
 {
-    if (interval <= 0)
-        return 0;
+    int index = (id & TIMER_INDEX_MASK) - 1;
+    if (index < 0 || index >= m_nrNodes)
+        return NULL;
 
-    if (NULL != listener) {
-#ifdef __TIMER_DEBUG__
-        _DBG_PRINTF ("TimerService::addTimerListener: %p, %p, %s\n",
-                this, listener, listenername);
-#endif
-        LINT id = (LINT)listenername;
-        if (SetTimerEx ((HWND)listener, id, interval/10,
-                TimerService::TimerProc)) {
-            return id;
+    TimerNode* node = m_nodes[index];
+    return node->id == id && node->listener ? node : NULL;
+}
+
+void TimerService::freeNode(TimerNode* node)
+{
+    link_del(&node->link);
+    link_del(&node->owner);
+    node->listener = NULL;
+
+    // a stale id does not match the node once it is used again; the
+    // generation wraps from the largest one to 1 in unsigned arithmetic
+    unsigned int gen = ((unsigned int)node->id >> TIMER_GEN_SHIFT) + 1;
+    gen &= TIMER_GEN_MASK;
+    if (gen == 0)
+        gen = 1;
+    node->id = (int)((gen << TIMER_GEN_SHIFT)
+            | ((unsigned int)node->id & TIMER_INDEX_MASK));
+
+    node->link.next = (TimerLink*)m_freeNodes;
+    m_freeNodes = node;
+    m_stats.timers--;
+}
+
+void TimerService::schedule(TimerNode* node)
+{
+    Sint32 delta = (Sint32)(node->expires - m_now);
+    TimerLink* slot;
+
+    if (delta < 0) {
+        // due already: fire it in the next tick
+        node->expires = m_now;
+        delta = 0;
+    }
+    else if (delta > MAX_TICKS) {
+        node->expires = m_now + MAX_TICKS;
+        delta = MAX_TICKS;
+    }
+
+    if (delta < ROOT_SIZE) {
+        slot = &m_root[node->expires & (ROOT_SIZE - 1)];
+    }
+    else {
+        int level = 0;
+        while (delta >= (1 << (ROOT_BITS + LEVEL_BITS * (level + 1))))
+            level++;
+
+        int shift = ROOT_BITS + LEVEL_BITS * level;
+        slot = &m_levels[level][(node->expires >> shift) & (LEVEL_SIZE - 1)];
+    }
+
+    if (node->priority >= TIMER_PRIORITY_HIGH)
+        link_add_head(slot, &node->link);
+    else
+        link_add_tail(slot, &node->link);
+}
+
+void TimerService::cascade(int level, int index)
+{
+    TimerLink list;
+    link_init(&list);
+    link_splice(&m_levels[level][index], &list);
+
+    while (!link_empty(&list)) {
+        TimerNode* node = (TimerNode*)list.next;
+        link_del(&node->link);
+        schedule(node);
+        m_stats.cascaded++;
+    }
+}
+
+void TimerService::runTick(Uint32 now)
+{
+    int index = m_now & (ROOT_SIZE - 1);
+
+    // spread the next slot of each level which wraps
+    if (index == 0) {
+        for (int level = 0; level < NR_LEVELS - 1; level++) {
+            int shift = ROOT_BITS + LEVEL_BITS * level;
+            int slot = (m_now >> shift) & (LEVEL_SIZE - 1);
+            cascade(level, slot);
+            if (slot != 0)
+                break;
         }
-        else {
-            _ERR_PRINTF ("TimerService::addTimerListener: Failed to call SetTimerEx SOS\n");
+    }
+
+    link_splice(&m_root[index], &m_expiring);
+    Uint32 tick = m_now++;
+    m_stats.ticks++;
+
+    // a handler may add or remove any timer, including this one
+    while (!link_empty(&m_expiring)) {
+        TimerNode* node = (TimerNode*)m_expiring.next;
+        TimerEventListener* listener = node->listener;
+        int id = node->id;
+
+        listener->m_nrFired++;
+        m_stats.fired++;
+        if (now - tick >= SERVICE_TIMER_LATE_TICKS) {
+            listener->m_nrLateFired++;
+            m_stats.lateFired++;
         }
+
+        link_del(&node->link);
+        if (node->interval) {
+            // skip the periods missed
+            node->expires = tick + node->interval;
+            if ((Sint32)(node->expires - now) <= 0)
+                node->expires = now + node->interval;
+            schedule(node);
+        }
+
+        TimerEvent event(id);
+        listener->handler(&event);
+
+        // a one-shot timer is freed unless the handler did it
+        node = nodeOfId(id);
+        if (node && node->interval == 0)
+            freeNode(node);
     }
 
-    return 0;
+    updateDriver();
 }
 
-int TimerService::addTimerListenerSingle(int interval,
-        TimerEventListener* listener,
-        TimerPriority priority, const char *listenername)
+int TimerService::addTimer(int interval, TimerEventListener* listener,
+        TimerPriority priority, const char* name, bool oneShot)
 {
-    if (interval <= 0)
+    if (interval <= 0 || listener == NULL)
         return 0;
 
-    if (NULL != listener) {
 #ifdef __TIMER_DEBUG__
-        _DBG_PRINTF ("TimerService::addTimerListener: %p, %p, %s\n",
-                this, listener, listenername);
+    _DBG_PRINTF ("TimerService::addTimer: %p, %p, %s\n",
+            this, listener, name);
 #endif
-        LINT id = (LINT)listenername;
-        if (SetTimerEx ((HWND)listener, id, interval/10,
-                TimerService::OneShotTimerProc))
-            return id;
-        else {
-            _ERR_PRINTF ("TimerService::addTimerListenerSingle: Failed to call SetTimerEx SOS\n");
+
+    TimerNode* node = m_freeNodes;
+    if (node) {
+        m_freeNodes = (TimerNode*)node->link.next;
+    }
+    else {
+        if (m_nrNodes >= TIMER_INDEX_MASK) {
+            _ERR_PRINTF ("TimerService::addTimer: too many timers\n");
+            return 0;
         }
+
+        // grow the table by doubling
+        if ((m_nrNodes & (m_nrNodes - 1)) == 0) {
+            int size = m_nrNodes ? m_nrNodes * 2 : 16;
+            TimerNode** nodes = (TimerNode**)HFCL_REALLOC(m_nodes,
+                    sizeof(TimerNode*) * size);
+            if (nodes == NULL)
+                return 0;
+            m_nodes = nodes;
+        }
+
+        node = (TimerNode*)HFCL_MALLOC(sizeof(TimerNode));
+        if (node == NULL)
+            return 0;
+
+        node->id = TIMER_ID_STEP | (m_nrNodes + 1);
+        m_nodes[m_nrNodes++] = node;
     }
 
-    return 0;
+    // round up to ticks
+    Uint32 ticks = (interval + SERVICE_TIMER_INTERVAL - 1) / SERVICE_TIMER_INTERVAL;
+
+    node->listener = listener;
+    node->name = name;
+    node->interval = oneShot ? 0 : ticks;
+    node->priority = priority;
+    link_init(&node->link);
+    link_add_tail(&listener->m_timers, &node->owner);
+
+    // the wheel may stand still; start counting from now
+    if (!m_driving && !m_bPause)
+        m_now = currentTick();
+    node->expires = m_now + ticks;
+    schedule(node);
+
+    m_stats.timers++;
+    updateDriver();
+    return node->id;
+}
+
+int TimerService::addTimerListener (int interval, TimerEventListener* listener,
+        TimerPriority priority, const char *listenername)
+{
+    return addTimer(interval, listener, priority, listenername, false);
+}
+
+int TimerService::addTimerListenerSingle(int interval,
+        TimerEventListener* listener,
+        TimerPriority priority, const char *listenername)
+{
+    return addTimer(interval, listener, priority, listenername, true);
 }
 
 void TimerService::removeTimerListener(TimerEventListener* listener, int id)
 {
-    if (id != 0)
-        KillTimer((HWND)listener, id);
+    TimerNode* node = nodeOfId(id);
+    if (node == NULL || node->listener != listener)
+        return;
+
+    freeNode(node);
+    updateDriver();
+}
+
+void TimerService::removeTimerListeners(TimerEventListener* listener)
+{
+    TimerLink* head = &listener->m_timers;
+
+    while (!link_empty(head)) {
+        TimerNode* node = (TimerNode*)((char*)head->next
+                - offsetof(TimerNode, owner));
+        freeNode(node);
+    }
+
+    updateDriver();
 }
 
 void TimerService::pause()
 {
-    //TODO
+    if (m_bPause)
+        return;
+
+    m_pauseStart = currentTick();
+    m_bPause = TRUE;
+    updateDriver();
 }
 
 void TimerService::resume()
 {
-    //TODO
+    if (!m_bPause)
+        return;
+
+    // the clock of the timers does not count the paused ticks
+    m_bPause = FALSE;
+    m_pausedTicks += currentTick() - m_pauseStart;
+    updateDriver();
 }
 
 void TimerService::start(void)
 {
-    //TODO
+    resume();
 }
 
 void TimerService::stop(void)
 {
-    //TODO
+    for (int i = 0; i < m_nrNodes; i++) {
+        if (m_nodes[i]->listener)
+            freeNode(m_nodes[i]);
+    }
+
+    updateDriver();
 }
 
 bool TimerService::canStop(void)
 {
-    return true;
+    return m_stats.timers == 0;
 }
 
-} // namespace hfcl
+void TimerService::dumpStats()
+{
+    _MG_PRINTF("TimerService: %u timers, %u ticks, %u fired, %u late, "
+            "%u cascaded\n",
+            m_stats.timers, m_stats.ticks, m_stats.fired,
+            m_stats.lateFired, m_stats.cascaded);
+}
 
+} // namespace hfcl
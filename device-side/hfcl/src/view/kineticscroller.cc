@@ -0,0 +1,213 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "view/kineticscroller.h"
+
+#include <math.h>
+
+namespace hfcl {
+
+KineticScroller::KineticScroller()
+    : m_state(IDLE)
+    , m_min(0)
+    , m_max(0)
+    , m_offset(0)
+    , m_velocity(0)
+    , m_lastTicks(0)
+    , m_dragPos(0)
+    , m_dragOffset(0)
+    , m_nrSamples(0)
+{
+}
+
+void KineticScroller::setRange(int minOffset, int maxOffset)
+{
+    m_min = minOffset;
+    m_max = maxOffset < minOffset ? minOffset : maxOffset;
+}
+
+float KineticScroller::overscroll() const
+{
+    if (m_offset < m_min)
+        return m_offset - m_min;
+    if (m_offset > m_max)
+        return m_offset - m_max;
+    return 0;
+}
+
+void KineticScroller::abort()
+{
+    m_state = IDLE;
+    m_velocity = 0;
+}
+
+void KineticScroller::beginDrag(int pos, Uint32 ticks)
+{
+    m_state = DRAGGING;
+    m_velocity = 0;
+    m_dragPos = pos;
+    m_dragOffset = m_offset;
+
+    m_nrSamples = 1;
+    m_samplePos[0] = pos;
+    m_sampleTicks[0] = ticks;
+}
+
+void KineticScroller::dragTo(int pos, Uint32 ticks)
+{
+    if (m_state != DRAGGING)
+        return;
+
+    float offset = m_dragOffset - (pos - m_dragPos);
+
+    // rubber band: half speed beyond the edges
+    float edge = offset < m_min ? m_min : (offset > m_max ? m_max : offset);
+    float over = (offset - edge) / 2;
+    if (over > KINETIC_MAX_OVERSCROLL)
+        over = KINETIC_MAX_OVERSCROLL;
+    else if (over < -KINETIC_MAX_OVERSCROLL)
+        over = -KINETIC_MAX_OVERSCROLL;
+    m_offset = edge + over;
+
+    if (m_nrSamples == NR_SAMPLES) {
+        memmove(m_samplePos, m_samplePos + 1, sizeof(int) * (NR_SAMPLES - 1));
+        memmove(m_sampleTicks, m_sampleTicks + 1,
+                sizeof(Uint32) * (NR_SAMPLES - 1));
+        m_nrSamples--;
+    }
+    m_samplePos[m_nrSamples] = pos;
+    m_sampleTicks[m_nrSamples] = ticks;
+    m_nrSamples++;
+}
+
+bool KineticScroller::endDrag(Uint32 ticks)
+{
+    if (m_state != DRAGGING)
+        return false;
+
+    // the velocity between the oldest recent sample and the last one
+    int last = m_nrSamples - 1;
+    int first = last;
+    while (first > 0
+            && ticks - m_sampleTicks[first - 1] <= KINETIC_VELOCITY_WINDOW)
+        first--;
+
+    float velocity = 0;
+    Uint32 dt = m_sampleTicks[last] - m_sampleTicks[first];
+    if (dt > 0 && ticks - m_sampleTicks[last] <= KINETIC_VELOCITY_WINDOW)
+        velocity = -(m_samplePos[last] - m_samplePos[first]) * 1000.0f / dt;
+
+    m_state = IDLE;
+    if (overscroll() != 0)
+        return startBounce(ticks);
+    return fling(velocity, ticks);
+}
+
+bool KineticScroller::fling(float velocity, Uint32 ticks)
+{
+    if (fabsf(velocity) < KINETIC_MIN_VELOCITY) {
+        if (overscroll() != 0)
+            return startBounce(ticks);
+
+        abort();
+        return false;
+    }
+
+    m_state = FLINGING;
+    m_velocity = velocity;
+    m_lastTicks = ticks;
+    return true;
+}
+
+bool KineticScroller::flingBy(int distance, Uint32 ticks)
+{
+    // add to the running fling, so that quick wheel turns speed it up
+    float velocity = distance * 1000.0f / KINETIC_FLING_TAU;
+    if (m_state == FLINGING && (velocity > 0) == (m_velocity > 0))
+        velocity += m_velocity;
+
+    return fling(velocity, ticks);
+}
+
+bool KineticScroller::startBounce(Uint32 ticks)
+{
+    m_state = BOUNCING;
+    m_velocity = 0;
+    m_lastTicks = ticks;
+    return true;
+}
+
+bool KineticScroller::computeOffset(Uint32 ticks)
+{
+    if (m_state == IDLE || m_state == DRAGGING)
+        return m_state == DRAGGING;
+
+    float dt = (float)(Uint32)(ticks - m_lastTicks);
+    m_lastTicks = ticks;
+    if (dt <= 0)
+        return true;
+
+    if (m_state == FLINGING) {
+        // stop much sooner beyond the edges
+        float tau = overscroll() != 0 ?
+                KINETIC_OVERSCROLL_TAU : KINETIC_FLING_TAU;
+        float decay = expf(-dt / tau);
+
+        // the integral of v * exp(-t / tau) over dt
+        m_offset += m_velocity * tau * (1 - decay) / 1000;
+        m_velocity *= decay;
+
+        float over = overscroll();
+        if (over > KINETIC_MAX_OVERSCROLL) {
+            m_offset = m_max + KINETIC_MAX_OVERSCROLL;
+            m_velocity = 0;
+        }
+        else if (over < -KINETIC_MAX_OVERSCROLL) {
+            m_offset = m_min - KINETIC_MAX_OVERSCROLL;
+            m_velocity = 0;
+        }
+
+        if (fabsf(m_velocity) >= KINETIC_MIN_VELOCITY)
+            return true;
+
+        if (over == 0) {
+            abort();
+            return false;
+        }
+
+        m_state = BOUNCING;
+        m_velocity = 0;
+    }
+
+    // BOUNCING: approach the edge exponentially
+    float over = overscroll();
+    over *= expf(-dt / KINETIC_BOUNCE_TAU);
+    if (fabsf(over) < 0.5f) {
+        m_offset = m_offset < m_min ? m_min : (m_offset > m_max ? m_max : m_offset);
+        abort();
+        return false;
+    }
+
+    m_offset = (over < 0 ? m_min : m_max) + over;
+    return true;
+}
+
+} // namespace hfcl
@@ -103,6 +103,14 @@ bool RootView::detachFromSysWindow()
     return true;
 }
 
+void RootView::onChildUpdateView(View *child,
+        int x, int y, int w, int h, bool upBackGnd)
+{
+    // the rect is in the root coordinates, the same as the window ones
+    if (m_window)
+        m_window->asyncUpdateRect(x, y, w, h, upBackGnd);
+}
+
 bool RootView::applyCssGroup(HTResId cssgId)
 {
     CssDeclaredGroup* cssdg = GetCssGroupRes(cssgId);
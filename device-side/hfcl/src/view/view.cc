@@ -74,6 +74,7 @@ View::View(const char* vtag, const char* vtype,
     , m_next(0)
     , m_css_computed(0)
     , m_cssbox_principal(0)
+    , m_listeners(true, true)
 {
     if (vtag != NULL && vtag[0] != 0)
         m_tag = strdup(vtag);
@@ -699,8 +700,7 @@ void View::addEventListener(EventListener* listener)
     if (NULL == listener) {
         return;
     }
-    listener->ref();
-    m_listeners.push_front(listener);
+    m_listeners.add(listener);
 }
 
 void View::removeEventListener(EventListener* listener)
@@ -709,33 +709,11 @@ void View::removeEventListener(EventListener* listener)
         return;
     }
     m_listeners.remove(listener);
-    listener->unref();
 }
 
 void View::releaseEventListeners()
 {
-    EventListenerList::iterator _listener;
-    EventListenerList::iterator _temp;
-
-    if (m_listeners.size() <= 0) {
-        return;
-    }
-
-    _listener = m_listeners.begin();
-    _temp = _listener;
-    do {
-        ++_listener;
-        EventListener* child = *_temp;
-          if (child != NULL) {
-              child->unref();
-              m_listeners.erase(_temp);
-          }
-        _temp = _listener;
-        if (m_listeners.size() == 0) {
-            break;
-        }
-    }
-    while (true);
+    m_listeners.clear();
 }
 
 bool View::setFocus(View * view)
@@ -818,14 +796,7 @@ bool View::dispatchEvent(Event* event)
 
 bool View::raiseViewEvent(ViewEvent *event)
 {
-    EventListenerList::iterator i;
-
-    for (i = m_listeners.begin(); i != m_listeners.end(); ++i) {
-        if ((*i)->handler(event))
-            return true;
-    }
-
-    return false;
+    return m_listeners.raise(event, true);
 }
 
 void View::viewToWindow(int *x, int *y)
@@ -944,6 +915,14 @@ void View::applyCss(CssDeclared* css, const CssSelectorGroup& selector)
     }
 }
 
+void View::appendMatchedCss(CssDeclared* css, DWORD specif, bool dynamic)
+{
+    if (dynamic)
+        m_cssdg_dynamic.append(css, specif);
+    else
+        m_cssdg_static.append(css, specif);
+}
+
 void View::computeCss()
 {
     if (m_css_computed) {
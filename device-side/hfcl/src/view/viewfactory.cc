@@ -50,8 +50,7 @@ bool ViewFactory::registerView(const char *vtag, const char* vtype,
     return false;
 }
 
-View *ViewFactory::create(const char* vtag, const char* vtype,
-        const char* vclass, const char* vname, int vid)
+CB_VIEW_CREATOR ViewFactory::getCreator(const char* vtag, const char* vtype)
 {
     std::string tag_type(vtag);
     if (vtype) {
@@ -60,12 +59,22 @@ View *ViewFactory::create(const char* vtag, const char* vtype,
         tag_type.append("]");
     }
 
-    TagViewMap::iterator it = m_map.find(tag_type.c_str());
+    TagViewMap::iterator it = m_map.find(tag_type);
     if (it == m_map.end ()) {
         return NULL;
     }
 
-    CB_VIEW_CREATOR creator = m_map [tag_type.c_str()];
+    return it->second;
+}
+
+View *ViewFactory::create(const char* vtag, const char* vtype,
+        const char* vclass, const char* vname, int vid)
+{
+    CB_VIEW_CREATOR creator = getCreator(vtag, vtype);
+    if (creator == NULL) {
+        return NULL;
+    }
+
     return creator(vtag, vtype, vclass, vname, vid);
 }
 
@@ -0,0 +1,348 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+** viewtemplate.cc: The implementation of ViewTemplate class.
+*/
+
+#include "view/viewtemplate.h"
+#include "view/viewcontainer.h"
+
+#include "resource/respkgmanager.h"
+#include "css/cssdeclaredgroup.h"
+#include "css/cssselector.h"
+
+namespace hfcl {
+
+ViewTemplate::ViewTemplate()
+    : m_header(NULL)
+    , m_nodes(NULL)
+    , m_attrs(NULL)
+    , m_rules(NULL)
+    , m_atoms(NULL)
+    , m_strings(NULL)
+    , m_creators(NULL)
+    , m_views(NULL)
+    , m_cssgId(0)
+    , m_cssg(NULL)
+    , m_matched(NULL)
+    , m_firstMatched(NULL)
+{
+}
+
+ViewTemplate::~ViewTemplate()
+{
+    if (m_creators)
+        HFCL_DELETE_ARR(m_creators);
+    if (m_views)
+        HFCL_DELETE_ARR(m_views);
+    if (m_matched)
+        HFCL_DELETE_ARR(m_matched);
+    if (m_firstMatched)
+        HFCL_DELETE_ARR(m_firstMatched);
+}
+
+static inline bool check_table(size_t size, Uint32 offset, size_t length)
+{
+    return offset >= sizeof(HFCL_VIEWTMPL_HEADER) && offset <= size
+        && length <= size - offset;
+}
+
+bool ViewTemplate::check(size_t size) const
+{
+    const HFCL_VIEWTMPL_HEADER* h = m_header;
+
+    if (h->magic != HFCL_VIEWTMPL_MAGIC
+            || h->version != HFCL_VIEWTMPL_VERSION || h->nr_nodes == 0)
+        return false;
+
+    if (!check_table(size, h->nodes_offset,
+                h->nr_nodes * sizeof(HFCL_VIEWTMPL_NODE))
+            || !check_table(size, h->attrs_offset,
+                h->nr_attrs * sizeof(HFCL_VIEWTMPL_ATTR))
+            || !check_table(size, h->rules_offset,
+                h->nr_rules * sizeof(HFCL_VIEWTMPL_RULE))
+            || !check_table(size, h->atoms_offset,
+                h->nr_atoms * sizeof(Uint32))
+            || !check_table(size, h->strings_offset, h->strings_size))
+        return false;
+
+    if (((h->nodes_offset | h->attrs_offset | h->rules_offset
+                    | h->atoms_offset) & 3) != 0)
+        return false;
+
+    // the string area must end with a NUL for the atoms to be safe
+    if (h->strings_size == 0 || m_strings[h->strings_size - 1] != '\0')
+        return false;
+
+    for (int i = 0; i < h->nr_atoms; i++) {
+        if (m_atoms[i] >= h->strings_size)
+            return false;
+    }
+
+    for (int i = 0; i < h->nr_nodes; i++) {
+        const HFCL_VIEWTMPL_NODE& node = m_nodes[i];
+        const Uint16 atoms[] = { node.tag, node.type, node.cls,
+            node.name, node.content };
+
+        if (i > 0 && node.parent >= i)
+            return false;
+        if (node.tag == HFCL_VIEWTMPL_NONE)
+            return false;
+        for (size_t j = 0; j < TABLESIZE(atoms); j++) {
+            if (atoms[j] != HFCL_VIEWTMPL_NONE && atoms[j] >= h->nr_atoms)
+                return false;
+        }
+
+        if (node.first_attr + node.nr_attrs > h->nr_attrs
+                || node.first_rule + node.nr_rules > h->nr_rules)
+            return false;
+    }
+
+    for (int i = 0; i < h->nr_attrs; i++) {
+        if (m_attrs[i].key >= h->nr_atoms
+                || (m_attrs[i].value != HFCL_VIEWTMPL_NONE
+                    && m_attrs[i].value >= h->nr_atoms))
+            return false;
+    }
+
+    return true;
+}
+
+ViewTemplate* ViewTemplate::open(const void* data, size_t size)
+{
+    if (data == NULL || size < sizeof(HFCL_VIEWTMPL_HEADER))
+        return NULL;
+
+    // the tables are read in place as Uint16 and Uint32 fields
+    if (((uintptr_t)data & 3) != 0) {
+        _ERR_PRINTF("ViewTemplate::open: the data is not 4-byte aligned\n");
+        return NULL;
+    }
+
+    const Uint8* bytes = (const Uint8*)data;
+    ViewTemplate* tmpl = HFCL_NEW(ViewTemplate);
+
+    tmpl->m_header = (const HFCL_VIEWTMPL_HEADER*)bytes;
+    tmpl->m_nodes = (const HFCL_VIEWTMPL_NODE*)
+        (bytes + tmpl->m_header->nodes_offset);
+    tmpl->m_attrs = (const HFCL_VIEWTMPL_ATTR*)
+        (bytes + tmpl->m_header->attrs_offset);
+    tmpl->m_rules = (const HFCL_VIEWTMPL_RULE*)
+        (bytes + tmpl->m_header->rules_offset);
+    tmpl->m_atoms = (const Uint32*)(bytes + tmpl->m_header->atoms_offset);
+    tmpl->m_strings = (const char*)(bytes + tmpl->m_header->strings_offset);
+
+    if (!tmpl->check(size)) {
+        _ERR_PRINTF("ViewTemplate::open: bad view template data\n");
+        HFCL_DELETE(tmpl);
+        return NULL;
+    }
+
+    int nr_nodes = tmpl->m_header->nr_nodes;
+    tmpl->m_creators = HFCL_NEW_ARR(CB_VIEW_CREATOR, nr_nodes);
+    tmpl->m_views = HFCL_NEW_ARR(View*, nr_nodes);
+    for (int i = 0; i < nr_nodes; i++) {
+        const HFCL_VIEWTMPL_NODE& node = tmpl->m_nodes[i];
+
+        tmpl->m_creators[i] = ViewFactory::singleton()->getCreator(
+                tmpl->atom(node.tag), tmpl->atom(node.type));
+        if (tmpl->m_creators[i] == NULL) {
+            _ERR_PRINTF("ViewTemplate::open: no view for tag %s\n",
+                    tmpl->atom(node.tag));
+            HFCL_DELETE(tmpl);
+            return NULL;
+        }
+    }
+
+    if (tmpl->m_header->cssg_id)
+        tmpl->setCssGroup(tmpl->m_header->cssg_id);
+
+    return tmpl;
+}
+
+bool ViewTemplate::setCssGroup(HTResId cssgId)
+{
+    if (m_matched) {
+        HFCL_DELETE_ARR(m_matched);
+        m_matched = NULL;
+    }
+    if (m_firstMatched) {
+        HFCL_DELETE_ARR(m_firstMatched);
+        m_firstMatched = NULL;
+    }
+
+    m_cssgId = cssgId;
+    m_cssg = NULL;
+    if (cssgId == 0)
+        return true;
+
+    m_cssg = GetCssGroupRes(cssgId);
+    if (m_cssg == NULL)
+        return false;
+
+    if (cssgId == m_header->cssg_id && m_header->nr_rules > 0)
+        return loadRules();
+
+    // matched on the first instance
+    return true;
+}
+
+bool ViewTemplate::loadRules()
+{
+    int nr_nodes = m_header->nr_nodes;
+    int nr_css = m_cssg->m_css_vec.size();
+
+    m_matched = HFCL_NEW_ARR(MatchedCss, m_header->nr_rules);
+    m_firstMatched = HFCL_NEW_ARR(int, nr_nodes + 1);
+
+    int n = 0;
+    for (int i = 0; i < nr_nodes; i++) {
+        const HFCL_VIEWTMPL_NODE& node = m_nodes[i];
+
+        m_firstMatched[i] = n;
+        for (int j = 0; j < node.nr_rules; j++) {
+            const HFCL_VIEWTMPL_RULE& rule = m_rules[node.first_rule + j];
+
+            if (rule.css >= nr_css) {
+                _ERR_PRINTF("ViewTemplate::loadRules: "
+                        "the template does not match CSS group %u\n",
+                        (unsigned)m_cssgId);
+                HFCL_DELETE_ARR(m_matched);
+                HFCL_DELETE_ARR(m_firstMatched);
+                m_matched = NULL;
+                m_firstMatched = NULL;
+                return false;
+            }
+
+            m_matched[n].css = m_cssg->m_css_vec[rule.css];
+            m_matched[n].specif = rule.specif;
+            m_matched[n].dynamic = rule.flags & HFCL_VIEWTMPL_RULE_DYNAMIC;
+            n++;
+        }
+    }
+    m_firstMatched[nr_nodes] = n;
+
+    return true;
+}
+
+void ViewTemplate::matchRules(View** views)
+{
+    int nr_nodes = m_header->nr_nodes;
+    int nr_css = m_cssg->m_css_vec.size();
+    std::vector<MatchedCss> matched;
+
+    CssSelectorGroup* selectors = HFCL_NEW_ARR(CssSelectorGroup, nr_css);
+    for (int j = 0; j < nr_css; j++) {
+        selectors[j].compile(m_cssg->m_css_vec[j]->getSelector());
+    }
+
+    m_firstMatched = HFCL_NEW_ARR(int, nr_nodes + 1);
+    for (int i = 0; i < nr_nodes; i++) {
+        m_firstMatched[i] = matched.size();
+        if (views[i] == NULL)
+            continue;
+
+        for (int j = 0; j < nr_css; j++) {
+            MatchedCss one;
+            int ret = selectors[j].match(views[i], one.specif);
+
+            if (ret == CssSelectorGroup::CSS_NOT_MATCHED)
+                continue;
+
+            one.css = m_cssg->m_css_vec[j];
+            one.dynamic = (ret == CssSelectorGroup::CSS_DYNAMIC);
+            matched.push_back(one);
+        }
+    }
+    m_firstMatched[nr_nodes] = matched.size();
+
+    HFCL_DELETE_ARR(selectors);
+
+    // one more entry so that m_matched is not NULL without rules
+    m_matched = HFCL_NEW_ARR(MatchedCss, matched.size() + 1);
+    for (size_t k = 0; k < matched.size(); k++) {
+        m_matched[k] = matched[k];
+    }
+}
+
+View* ViewTemplate::instantiate(ViewContainer* parent)
+{
+    int nr_nodes = m_header->nr_nodes;
+
+    for (int i = 0; i < nr_nodes; i++) {
+        const HFCL_VIEWTMPL_NODE& node = m_nodes[i];
+        ViewContainer* container = parent;
+
+        m_views[i] = NULL;
+        if (i > 0) {
+            View* p = m_views[node.parent];
+            if (p == NULL)
+                continue;
+            if (!p->isContainer()) {
+                _ERR_PRINTF("ViewTemplate::instantiate: "
+                        "%s can not have children\n",
+                        atom(m_nodes[node.parent].tag));
+                continue;
+            }
+            container = (ViewContainer*)p;
+        }
+
+        View* view = m_creators[i](atom(node.tag), atom(node.type),
+                atom(node.cls), atom(node.name), node.id);
+        if (view == NULL)
+            continue;
+
+        for (int j = 0; j < node.nr_attrs; j++) {
+            const HFCL_VIEWTMPL_ATTR& attr = m_attrs[node.first_attr + j];
+            view->setAttribute(atom(attr.key), atom(attr.value));
+        }
+
+        if (node.content != HFCL_VIEWTMPL_NONE)
+            view->setTextContent(atom(node.content));
+
+        if (container)
+            container->addChild(view);
+        m_views[i] = view;
+    }
+
+    if (m_views[0] == NULL)
+        return NULL;
+
+    if (m_cssg) {
+        if (m_matched == NULL)
+            matchRules(m_views);
+
+        for (int i = 0; i < nr_nodes; i++) {
+            if (m_views[i] == NULL)
+                continue;
+
+            for (int k = m_firstMatched[i]; k < m_firstMatched[i + 1]; k++) {
+                const MatchedCss& one = m_matched[k];
+                m_views[i]->appendMatchedCss(one.css, one.specif, one.dynamic);
+            }
+        }
+    }
+
+    return m_views[0];
+}
+
+} // namespace hfcl
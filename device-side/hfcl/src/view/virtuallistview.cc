@@ -0,0 +1,546 @@
+/*
+** HFCL - HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "view/virtuallistview.h"
+#include "view/rootview.h"
+#include "activity/window.h"
+
+#include <stdlib.h>
+
+namespace hfcl {
+
+VirtualListView::VirtualListView(const char* vtag, const char* vtype,
+            const char* vclass, const char* vname, int vid)
+    : ViewContainer(vtag, vtype, vclass, vname, vid)
+    , m_adapter(NULL)
+    , m_rowCount(0)
+    , m_defaultHeight(32)
+    , m_scrollY(0)
+    , m_overscroll(0)
+    , m_scrollBlit(true)
+    , m_heightTree(NULL)
+    , m_treeMask(0)
+    , m_firstRow(0)
+    , m_nrActive(0)
+{
+}
+
+VirtualListView::~VirtualListView()
+{
+    stopFrames();
+
+    if (m_heightTree)
+        HFCL_FREE(m_heightTree);
+
+    if (m_adapter)
+        m_adapter->unref();
+}
+
+void VirtualListView::setAdapter(ListAdapter* adapter)
+{
+    if (adapter == m_adapter)
+        return;
+
+    if (adapter)
+        adapter->ref();
+    if (m_adapter)
+        m_adapter->unref();
+    m_adapter = adapter;
+
+    // the views of the old adapter can not be bound by the new one
+    m_active.clear();
+    m_spare.clear();
+    m_nrActive = 0;
+    removeAll();
+
+    stopFrames();
+    m_scrollY = 0;
+    m_overscroll = 0;
+    notifyDataSetChanged();
+}
+
+void VirtualListView::notifyDataSetChanged()
+{
+    m_rowCount = m_adapter ? m_adapter->getCount() : 0;
+
+    // the heights are learned again when the rows are bound
+    if (m_heightTree) {
+        HFCL_FREE(m_heightTree);
+        m_heightTree = NULL;
+    }
+
+    recycleAll();
+    layoutRows();
+    updateView();
+}
+
+void VirtualListView::notifyRowChanged(int row)
+{
+    int idx = row - m_firstRow;
+    if (idx < 0 || idx >= m_nrActive)
+        return;
+
+    bindRow(row, &m_active[idx]);
+    layoutRows();
+    updateView();
+}
+
+void VirtualListView::setDefaultRowHeight(int height)
+{
+    if (height <= 0 || height == m_defaultHeight)
+        return;
+
+    m_defaultHeight = height;
+    notifyDataSetChanged();
+}
+
+void VirtualListView::buildHeightTree()
+{
+    int n = m_rowCount;
+
+    m_heightTree = (int*)HFCL_MALLOC(sizeof(int) * (n + 1));
+    if (m_heightTree == NULL)
+        return;
+
+    m_heightTree[0] = 0;
+    for (int i = 1; i <= n; i++)
+        m_heightTree[i] = m_defaultHeight;
+
+    for (int i = 1; i <= n; i++) {
+        int j = i + (i & -i);
+        if (j <= n)
+            m_heightTree[j] += m_heightTree[i];
+    }
+
+    for (m_treeMask = 1; m_treeMask * 2 <= n; m_treeMask *= 2)
+        ;
+}
+
+int VirtualListView::rowOffset(int row) const
+{
+    if (row > m_rowCount)
+        row = m_rowCount;
+
+    if (m_heightTree == NULL)
+        return row * m_defaultHeight;
+
+    int sum = 0;
+    for (int i = row; i > 0; i -= i & -i)
+        sum += m_heightTree[i];
+    return sum;
+}
+
+int VirtualListView::rowHeight(int row) const
+{
+    if (row < 0 || row >= m_rowCount)
+        return 0;
+
+    if (m_heightTree == NULL)
+        return m_defaultHeight;
+
+    return rowOffset(row + 1) - rowOffset(row);
+}
+
+int VirtualListView::contentHeight() const
+{
+    return rowOffset(m_rowCount);
+}
+
+int VirtualListView::rowAtOffset(int y) const
+{
+    if (y < 0 || y >= contentHeight())
+        return -1;
+
+    if (m_heightTree == NULL)
+        return y / m_defaultHeight;
+
+    // the last row whose offset is not greater than y
+    int pos = 0;
+    for (int step = m_treeMask; step; step >>= 1) {
+        if (pos + step <= m_rowCount && m_heightTree[pos + step] <= y) {
+            pos += step;
+            y -= m_heightTree[pos];
+        }
+    }
+
+    return pos;
+}
+
+void VirtualListView::setRowHeight(int row, int height)
+{
+    int old = rowHeight(row);
+    if (height == old)
+        return;
+
+    if (m_heightTree == NULL) {
+        buildHeightTree();
+        if (m_heightTree == NULL) {
+            _ERR_PRINTF("VirtualListView: no memory for %d row heights\n",
+                    m_rowCount);
+            return;
+        }
+    }
+
+    for (int i = row + 1; i <= m_rowCount; i += i & -i)
+        m_heightTree[i] += height - old;
+}
+
+int VirtualListView::rowAt(int x, int y) const
+{
+    if (x < 0 || x >= getRect().width() || y < 0 || y >= getRect().height())
+        return -1;
+
+    return rowAtOffset(m_scrollY + y);
+}
+
+View* VirtualListView::viewOfRow(int row)
+{
+    int idx = row - m_firstRow;
+    if (idx < 0 || idx >= m_nrActive)
+        return NULL;
+
+    return m_active[idx].view;
+}
+
+void VirtualListView::scrollTo(int y)
+{
+    stopFrames();
+
+    int max = contentHeight() - getRect().height();
+    if (y > max)
+        y = max;
+    if (y < 0)
+        y = 0;
+
+    if (y == m_scrollY && m_overscroll == 0)
+        return;
+
+    moveContent(y, 0);
+}
+
+void VirtualListView::moveContent(int scrollY, int overscroll)
+{
+    // a row on screen both before and after tells how far the pixels move
+    int ref = rowAtOffset(scrollY < 0 ? 0 : scrollY);
+    if (ref < m_firstRow)
+        ref = m_firstRow;
+    else if (ref > lastVisibleRow())
+        ref = lastVisibleRow();
+
+    View* refView = viewOfRow(ref);
+    int refTop = refView ? refView->getRect().top() : 0;
+
+    m_scrollY = scrollY;
+    m_overscroll = overscroll;
+    layoutRows();
+
+    if (refView == NULL || viewOfRow(ref) != refView) {
+        updateView();
+        return;
+    }
+
+    int dy = refView->getRect().top() - refTop;
+    if (dy == 0)
+        return;
+
+    int w = getRect().width();
+    int h = getRect().height();
+    RootView* root = getRoot();
+    Window* window = root ? root->getSysWindow() : NULL;
+    if (!m_scrollBlit || window == NULL || abs(dy) >= h) {
+        updateView();
+        return;
+    }
+
+    int x = 0, y = 0;
+    viewToWindow(&x, &y);
+    window->scrollRect(IntRect(x, y, x + w, y + h), 0, dy);
+}
+
+void VirtualListView::startFrames()
+{
+    // the scheduler keeps no client twice
+    FrameScheduler::getInstance()->addClient(this);
+}
+
+void VirtualListView::stopFrames()
+{
+    m_scroller.abort();
+    FrameScheduler::getInstance()->removeClient(this);
+}
+
+void VirtualListView::fling(int velocity)
+{
+    if (!isScrolling())
+        m_scroller.setOffset(m_scrollY + m_overscroll);
+    m_scroller.setRange(0, contentHeight() - getRect().height());
+    if (m_scroller.fling(velocity, FrameScheduler::ticks()))
+        startFrames();
+}
+
+bool VirtualListView::onFrame(Uint32 ticks)
+{
+    m_scroller.setRange(0, contentHeight() - getRect().height());
+    bool running = m_scroller.computeOffset(ticks);
+
+    int offset = m_scroller.offset();
+    int scrollY = offset;
+    if (scrollY > m_scroller.maxOffset())
+        scrollY = m_scroller.maxOffset();
+    if (scrollY < 0)
+        scrollY = 0;
+
+    if (offset != m_scrollY + m_overscroll)
+        moveContent(scrollY, offset - scrollY);
+
+    // layoutRows() moves the offset when a row above changes its height
+    if (m_scrollY != scrollY)
+        m_scroller.offsetBy(m_scrollY - scrollY);
+
+    return running;
+}
+
+void VirtualListView::scrollToRow(int row)
+{
+    if (row < 0 || row >= m_rowCount)
+        return;
+
+    int top = rowOffset(row);
+    int bottom = top + rowHeight(row);
+
+    if (top < m_scrollY)
+        scrollTo(top);
+    else if (bottom > m_scrollY + getRect().height())
+        scrollTo(bottom - getRect().height());
+}
+
+View* VirtualListView::obtainView(int type)
+{
+    for (int i = m_spare.size() - 1; i >= 0; i--) {
+        if (m_spare[i].type == type) {
+            View* view = m_spare[i].view;
+            m_spare.erase(m_spare.begin() + i);
+            return view;
+        }
+    }
+
+    View* view = m_adapter->createView(type);
+    if (view)
+        addChild(view);
+    return view;
+}
+
+void VirtualListView::recycle(const ItemSlot& slot)
+{
+    // the spare views stay children, but they are neither drawn nor hit
+    slot.view->setRectNoUpdate(0, 0, 0, 0);
+
+    ItemSlot spare = slot;
+    m_spare.push_back(spare);
+}
+
+void VirtualListView::recycleAll()
+{
+    for (int i = 0; i < m_nrActive; i++)
+        recycle(m_active[i]);
+
+    m_active.clear();
+    m_nrActive = 0;
+    m_firstRow = 0;
+}
+
+int VirtualListView::bindRow(int row, ItemSlot* slot)
+{
+    m_adapter->bindView(row, slot->view);
+
+    int height = m_adapter->getRowHeight(row);
+    if (height < 0)
+        height = m_defaultHeight;
+
+    int old = rowHeight(row);
+    setRowHeight(row, height);
+    return height - old;
+}
+
+void VirtualListView::layoutRows()
+{
+    int vh = getRect().height();
+
+    if (m_adapter == NULL || m_rowCount == 0 || vh <= 0) {
+        recycleAll();
+        return;
+    }
+
+    int max = contentHeight() - vh;
+    if (m_scrollY > max)
+        m_scrollY = max;
+    if (m_scrollY < 0)
+        m_scrollY = 0;
+
+    int anchor = rowAtOffset(m_scrollY);
+    int first = anchor - VLIST_OVERSCAN_ROWS;
+    if (first < 0)
+        first = 0;
+
+    ItemSlotVec next;
+    int y = rowOffset(first);
+    int overscan = VLIST_OVERSCAN_ROWS;
+    for (int row = first; row < m_rowCount; row++) {
+        if (y >= m_scrollY + vh && overscan-- <= 0)
+            break;
+
+        ItemSlot slot;
+        int old = row - m_firstRow;
+        if (old >= 0 && old < m_nrActive && m_active[old].view) {
+            slot = m_active[old];
+            m_active[old].view = NULL;
+        }
+        else {
+            slot.type = m_adapter->getViewType(row);
+            slot.view = obtainView(slot.type);
+            if (slot.view == NULL) {
+                _ERR_PRINTF("VirtualListView: no view for row %d\n", row);
+                break;
+            }
+
+            // keep the anchor row still when a row above it changes
+            int delta = bindRow(row, &slot);
+            if (row < anchor)
+                m_scrollY += delta;
+        }
+
+        y += rowHeight(row);
+        next.push_back(slot);
+    }
+
+    for (int i = 0; i < m_nrActive; i++) {
+        if (m_active[i].view)
+            recycle(m_active[i]);
+    }
+
+    // the assignment of VECTOR leaks, so copy the slots one by one
+    m_active.clear();
+    for (int i = 0; i < (int)next.size(); i++)
+        m_active.push_back(next[i]);
+    m_firstRow = first;
+    m_nrActive = next.size();
+
+    int w = getRect().width();
+    y = rowOffset(first) - m_scrollY - m_overscroll;
+    for (int i = 0; i < m_nrActive; i++) {
+        int h = rowHeight(first + i);
+        m_active[i].view->setRectNoUpdate(0, y, w, y + h);
+        y += h;
+    }
+}
+
+bool VirtualListView::setRect(const IntRect& irc)
+{
+    bool resized = irc.width() != getRect().width()
+        || irc.height() != getRect().height();
+
+    bool ret = View::setRect(irc);
+    if (resized)
+        layoutRows();
+    return ret;
+}
+
+void VirtualListView::layOut(CssBox* ctnBlock)
+{
+    // the item views are placed by the list view, not by CSS
+    View::layOut(ctnBlock);
+    layoutRows();
+}
+
+void VirtualListView::drawContent(GraphicsContext* context, IntRect &rc)
+{
+    for (int i = 0; i < m_nrActive; i++) {
+        View* view = m_active[i].view;
+        if (view->isVisible())
+            view->onPaint(context);
+    }
+}
+
+bool VirtualListView::onKeyEvent(const KeyEvent& evt)
+{
+    switch (evt.keyCode()) {
+    case KeyEvent::KEYCODE_CURSOR_UP:
+        scrollBy(-m_defaultHeight);
+        return true;
+
+    case KeyEvent::KEYCODE_CURSOR_DOWN:
+        scrollBy(m_defaultHeight);
+        return true;
+
+    default:
+        break;
+    }
+
+    return false;
+}
+
+bool VirtualListView::onMouseEvent(const MouseEvent& evt)
+{
+    switch (evt.subType()) {
+    case MouseEvent::MOUSE_L_DOWN:
+        if (!isScrolling())
+            m_scroller.setOffset(m_scrollY + m_overscroll);
+        m_scroller.setRange(0, contentHeight() - getRect().height());
+        m_scroller.beginDrag(evt.y(), FrameScheduler::ticks());
+        startFrames();
+        return true;
+
+    case MouseEvent::MOUSE_MOVE:
+        if (!m_scroller.isDragging())
+            break;
+
+        // applied in the next frame, so the moves in a frame are merged
+        m_scroller.dragTo(evt.y(), FrameScheduler::ticks());
+        return true;
+
+    case MouseEvent::MOUSE_L_UP:
+        if (!m_scroller.isDragging())
+            break;
+
+        // the frame after the drag leaves the scheduler if nothing to animate
+        m_scroller.endDrag(FrameScheduler::ticks());
+        return true;
+
+    default:
+        break;
+    }
+
+    return false;
+}
+
+bool VirtualListView::onMouseWheelEvent(const MouseWheelEvent& evt)
+{
+    int distance = -evt.delta() * m_defaultHeight;
+
+    if (!isScrolling())
+        m_scroller.setOffset(m_scrollY + m_overscroll);
+    m_scroller.setRange(0, contentHeight() - getRect().height());
+    if (m_scroller.flingBy(distance, FrameScheduler::ticks()))
+        startFrames();
+    return true;
+}
+
+} // namespace hfcl
@@ -0,0 +1,133 @@
+/*
+** HFCL Samples - Samples for HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL Samples.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * eventbench: raises events to many listeners of an EventBroadcaster,
+ * and checks that listeners added and removed while dispatching are
+ * handled as documented by EventListenerArray.
+ *
+ * Usage: eventbench [number of events]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+#include <hfcl/hfcl.h>
+#include <hfcl/common.h>
+
+using namespace hfcl;
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+class CountListener : public EventListener {
+public:
+    CountListener() : m_count(0) { }
+    virtual bool handler(Event* event) { m_count++; return false; }
+
+    unsigned int m_count;
+};
+
+// removes itself and the next listener, and adds a new one
+class ChurnListener : public EventListener {
+public:
+    ChurnListener(EventBroadcaster* b, EventListener* next, EventListener* add)
+        : m_broadcaster(b), m_next(next), m_add(add), m_count(0) { }
+
+    virtual bool handler(Event* event) {
+        m_count++;
+        m_broadcaster->removeEventListener(this);
+        m_broadcaster->removeEventListener(m_next);
+        m_broadcaster->addEventListener(m_add);
+        return false;
+    }
+
+    EventBroadcaster* m_broadcaster;
+    EventListener* m_next;
+    EventListener* m_add;
+    unsigned int m_count;
+};
+
+static void bench(int nrListeners, int nrEvents)
+{
+    EventBroadcaster broadcaster;
+    CountListener* listeners = new CountListener[nrListeners];
+    UserEvent event(0, 0);
+
+    for (int i = 0; i < nrListeners; i++)
+        broadcaster.addEventListener(listeners + i);
+
+    unsigned long long t = now_ns();
+    for (int i = 0; i < nrEvents; i++)
+        broadcaster.raiseEvent(&event);
+    t = now_ns() - t;
+
+    printf("%5d listeners: %8.1f ns per event, %6.2f ns per call\n",
+            nrListeners, (double)t / nrEvents,
+            (double)t / nrEvents / nrListeners);
+
+    delete [] listeners;
+}
+
+static bool check_churn()
+{
+    EventBroadcaster broadcaster;
+    CountListener first, skipped, added, last;
+    ChurnListener churn(&broadcaster, &skipped, &added);
+    UserEvent event(0, 0);
+
+    broadcaster.addEventListener(&first);
+    broadcaster.addEventListener(&churn);
+    broadcaster.addEventListener(&skipped);
+    broadcaster.addEventListener(&last);
+
+    // skipped is removed before its turn; added gets the next event only
+    broadcaster.raiseEvent(&event);
+    broadcaster.raiseEvent(&event);
+
+    return first.m_count == 2 && churn.m_count == 1 && skipped.m_count == 0
+        && last.m_count == 2 && added.m_count == 1;
+}
+
+int main(int argc, const char* argv[])
+{
+    int nrEvents = argc > 1 ? atoi(argv[1]) : 100000;
+    static const int sizes[] = { 1, 4, 16, 64, 256, 1024 };
+
+    if (nrEvents <= 0)
+        nrEvents = 100000;
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        bench(sizes[i], nrEvents);
+
+    if (!check_churn()) {
+        printf("add/remove while dispatching: FAILED\n");
+        return 1;
+    }
+
+    printf("add/remove while dispatching: OK\n");
+    return 0;
+}
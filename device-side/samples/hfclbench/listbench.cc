@@ -0,0 +1,164 @@
+/*
+** HFCL Samples - Samples for HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL Samples.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * listbench: scrolls a VirtualListView of 50 rows of text up and down
+ * on a memory DC, repainting the whole viewport for each frame, and
+ * reports the frame time with the glyph atlas enabled and disabled.
+ *
+ * ListView is not built into libhfcl any more (src/view/Makefile.am
+ * builds neither it nor ScrollView), so the list of the library,
+ * VirtualListView, is scrolled instead. Its rows draw their text through
+ * GraphicsContext the same way the ItemViews of ListView did.
+ *
+ * Usage: listbench [number of frames]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+#include <hfcl/hfcl.h>
+#include <hfcl/common.h>
+#include <hfcl/graphics.h>
+#include <hfcl/view.h>
+
+using namespace hfcl;
+
+#define NR_ROWS         50
+#define ROW_HEIGHT      32
+#define VIEW_WIDTH      240
+#define VIEW_HEIGHT     320
+// the pixels scrolled per frame
+#define SCROLL_STEP     7
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// one line of text, drawn the way the list items of an app do
+class RowView : public View {
+public:
+    RowView() : View("hvrow", "row", NULL, NULL, 0) { m_text[0] = '\0'; }
+
+    void setRow(int row) {
+        snprintf(m_text, sizeof(m_text),
+                "%02d  The quick brown fox jumps over", row);
+    }
+
+    virtual void drawContent(GraphicsContext* context, IntRect& rc) {
+        context->textOut(4, (ROW_HEIGHT - 16) / 2, m_text, -1,
+                MakeRGB(0x20, 0x20, 0x20),
+                GetSystemFont(SYSLOGFONT_WCHAR_DEF));
+    }
+
+private:
+    char m_text[64];
+};
+
+class RowAdapter : public ListAdapter {
+public:
+    virtual int getCount() { return NR_ROWS; }
+    virtual View* createView(int viewType) { return HFCL_NEW(RowView); }
+    virtual void bindView(int row, View* view) {
+        ((RowView*)view)->setRow(row);
+    }
+};
+
+// returns the average time of a frame in microseconds
+static double bench(VirtualListView* list, GraphicsContext* gc,
+        int nrFrames, bool atlas)
+{
+    IntRect rc(0, 0, VIEW_WIDTH, VIEW_HEIGHT);
+    int range = list->contentHeight() - VIEW_HEIGHT;
+    int y = 0;
+    int step = SCROLL_STEP;
+
+    GlyphAtlas::setEnabled(atlas);
+
+    unsigned long long start = now_ns();
+    for (int i = 0; i < nrFrames; i++) {
+        y += step;
+        if (y >= range || y <= 0) {
+            y = y <= 0 ? 0 : range;
+            step = -step;
+        }
+
+        list->scrollTo(y);
+        gc->fillRect(rc, 0xFF, 0xFF, 0xFF);
+        list->onPaint(gc);
+        gc->flush();
+    }
+
+    return (now_ns() - start) / 1000.0 / nrFrames;
+}
+
+int main(int argc, const char* argv[])
+{
+    int nrFrames = argc > 1 ? atoi(argv[1]) : 1000;
+
+    if (nrFrames <= 0)
+        nrFrames = 1000;
+
+    Initialize(argc, argv);
+
+    HDC memdc = CreateCompatibleDCEx(HDC_SCREEN, VIEW_WIDTH, VIEW_HEIGHT);
+    if (memdc == HDC_INVALID) {
+        printf("listbench: failed to create the memory DC\n");
+        Terminate(1);
+        return 1;
+    }
+
+    GraphicsContext* gc = HFCL_NEW_EX(GraphicsContext, (memdc));
+    VirtualListView* list = HFCL_NEW_EX(VirtualListView,
+            ("hvlist", "virtuallist", NULL, NULL, 0));
+    RowAdapter* adapter = HFCL_NEW(RowAdapter);
+
+    // the frames are painted here, not by blitting the DC
+    list->setScrollBlit(false);
+    list->setDefaultRowHeight(ROW_HEIGHT);
+    list->setAdapter(adapter);
+    adapter->unref();
+    list->setRect(IntRect(0, 0, VIEW_WIDTH, VIEW_HEIGHT));
+
+    // the first pass fills the atlas, as the first screens of an app do
+    bench(list, gc, 2 * (NR_ROWS * ROW_HEIGHT / SCROLL_STEP), true);
+    GlyphAtlas::getInstance()->resetStats();
+
+    double on = bench(list, gc, nrFrames, true);
+    GlyphAtlas::getInstance()->dumpStats();
+    double off = bench(list, gc, nrFrames, false);
+
+    printf("%d rows, %d frames of %dx%d: atlas on %.1f us/frame, "
+            "off %.1f us/frame (%.2fx)\n", NR_ROWS, nrFrames,
+            VIEW_WIDTH, VIEW_HEIGHT, on, off, off / on);
+
+    HFCL_DELETE(list);
+    HFCL_DELETE(gc);
+    DeleteMemDC(memdc);
+    GlyphAtlas::releaseInstance();
+
+    Terminate(0);
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+** HFCL Samples - Samples for HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL Samples.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * rastertest: runs the SIMD raster kernels (SSE2, AVX2 and NEON, those
+ * supported by the CPU) on random rows and checks that they give exactly
+ * the same pixels as the scalar kernels, and write no pixel past the end
+ * of the row. The lengths and the offsets of the rows are random too, so
+ * the vector loops and the tails are both covered.
+ *
+ * Usage: rastertest [seed] [number of rounds]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+
+#include <hfcl/graphics/rasterkernels.h>
+
+using namespace hfcl;
+
+// the longest row tested, and the guard pixels around it
+#define MAX_PIXELS      259
+#define GUARD           8
+#define GUARD_PIXEL     0xDEADBEEF
+
+static const char* simd_names[] = { "sse2", "avx2", "neon", NULL };
+
+static Uint32 rand_state;
+
+// xorshift32, so that a seed reproduces a failure on any libc
+static Uint32 rand32()
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static int rand_range(int lo, int hi)
+{
+    return lo + (int)(rand32() % (Uint32)(hi - lo + 1));
+}
+
+// mostly the alpha values the blenders handle specially
+static Uint32 rand_pixel()
+{
+    Uint32 rgb = rand32() & 0x00FFFFFF;
+
+    switch (rand32() % 4) {
+    case 0:
+        return rgb;
+    case 1:
+        return rgb | 0xFF000000;
+    default:
+        return rgb | (rand32() << 24);
+    }
+}
+
+static void rand_row(Uint32* row, int n)
+{
+    for (int i = 0; i < n; i++)
+        row[i] = rand_pixel();
+}
+
+struct Row {
+    Uint32 pixels[GUARD + MAX_PIXELS + 8 + GUARD];
+    Uint32* dst;
+
+    // places the row at a random offset, to test unaligned rows
+    void init() {
+        dst = pixels + GUARD + rand_range(0, 7);
+        for (size_t i = 0; i < sizeof(pixels) / sizeof(pixels[0]); i++)
+            pixels[i] = GUARD_PIXEL;
+    }
+};
+
+static int nr_failures;
+
+static bool check(const char* kernels, const char* kernel, int n,
+        const Row& expected, const Row& got)
+{
+    if (memcmp(expected.pixels, got.pixels, sizeof(got.pixels)) == 0)
+        return true;
+
+    for (size_t i = 0; i < sizeof(got.pixels) / sizeof(got.pixels[0]); i++) {
+        if (expected.pixels[i] != got.pixels[i]) {
+            int x = (int)(&got.pixels[i] - got.dst);
+            printf("%s %s (n = %d): pixel %d is 0x%08X, "
+                    "the scalar kernel gives 0x%08X%s\n",
+                    kernels, kernel, n, x, got.pixels[i], expected.pixels[i],
+                    (x < 0 || x >= n) ? " (out of the row)" : "");
+            break;
+        }
+    }
+
+    nr_failures++;
+    return false;
+}
+
+// runs a kernel of ref and of k on the same random input
+static void test_round(const RasterKernels* ref, const RasterKernels* k)
+{
+    Uint32 src[MAX_PIXELS + 8];
+    Uint32 dst[MAX_PIXELS];
+    Row expected, got;
+    int n = rand_range(0, MAX_PIXELS);
+
+    // the source of the blenders and the destination are both random
+    int off = rand_range(0, 7);
+    rand_row(src + off, n);
+    rand_row(dst, n);
+
+    expected.init();
+    got.dst = expected.dst - expected.pixels + got.pixels;
+    memcpy(got.pixels, expected.pixels, sizeof(got.pixels));
+
+    Uint32 pixel = rand_pixel();
+    ref->fill(expected.dst, n, pixel);
+    k->fill(got.dst, n, pixel);
+    check(k->name, "fill", n, expected, got);
+
+    memcpy(expected.dst, dst, n * sizeof(Uint32));
+    memcpy(got.dst, dst, n * sizeof(Uint32));
+    ref->blend(expected.dst, src + off, n);
+    k->blend(got.dst, src + off, n);
+    check(k->name, "blend", n, expected, got);
+
+    Uint8 alpha = (Uint8)rand_range(0, 255);
+    memcpy(expected.dst, dst, n * sizeof(Uint32));
+    memcpy(got.dst, dst, n * sizeof(Uint32));
+    ref->blendConst(expected.dst, src + off, n, alpha);
+    k->blendConst(got.dst, src + off, n, alpha);
+    check(k->name, "blendConst", n, expected, got);
+
+    // a key taken from the source, so that some pixels match it
+    Uint32 mask = (rand32() & 1) ? 0x00FFFFFF : 0xFFFFFFFF;
+    Uint32 key = n ? src[off + rand_range(0, n - 1)] : rand_pixel();
+    for (int i = 0; i < n; i++) {
+        if (rand32() % 3 == 0)
+            src[off + i] = (key & mask) | (src[off + i] & ~mask);
+    }
+    memcpy(expected.dst, dst, n * sizeof(Uint32));
+    memcpy(got.dst, dst, n * sizeof(Uint32));
+    ref->colorKey(expected.dst, src + off, n, key, mask);
+    k->colorKey(got.dst, src + off, n, key, mask);
+    check(k->name, "colorKey", n, expected, got);
+
+    // the scaler: shrinking, enlarging, and the half step offsets
+    int sw = rand_range(1, MAX_PIXELS);
+    int step = rand_range(1, 4 << 16);
+    rand_row(src, sw);
+
+    int fx0 = rand_range(0, step >> 1);
+    ref->scaleNearest(expected.dst, n, src, sw, fx0, step);
+    k->scaleNearest(got.dst, n, src, sw, fx0, step);
+    check(k->name, "scaleNearest", n, expected, got);
+}
+
+int main(int argc, const char* argv[])
+{
+    Uint32 seed = argc > 1 ? (Uint32)strtoul(argv[1], NULL, 0)
+        : (Uint32)time(NULL);
+    int nrRounds = argc > 2 ? atoi(argv[2]) : 100000;
+
+    if (seed == 0)
+        seed = 1;
+    if (nrRounds <= 0)
+        nrRounds = 100000;
+
+    const RasterKernels* ref = RasterKernels::scalar();
+    int nrTested = 0;
+
+    for (int i = 0; simd_names[i]; i++) {
+        const RasterKernels* k = RasterKernels::byName(simd_names[i]);
+        if (k == NULL) {
+            printf("%s: not supported, skipped\n", simd_names[i]);
+            continue;
+        }
+
+        int failures = nr_failures;
+        rand_state = seed;
+        for (int r = 0; r < nrRounds && nr_failures - failures < 10; r++)
+            test_round(ref, k);
+
+        printf("%s: %d rounds, %s\n", k->name, nrRounds,
+                nr_failures == failures ? "passed" : "FAILED");
+        nrTested++;
+    }
+
+    printf("seed %u: %d kernel sets tested, %d failures\n",
+            seed, nrTested, nr_failures);
+    return nr_failures ? 1 : 0;
+}
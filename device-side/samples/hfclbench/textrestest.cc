@@ -0,0 +1,156 @@
+/*
+** HFCL Samples - Samples for HybridOS Foundation Class Library
+**
+** Copyright (C) 2018 Beijing FMSoft Technologies Co., Ltd.
+**
+** This file is part of HFCL Samples.
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * textrestest: loads a zipped string table from a resource package made
+ * by make_respkg.py --zip-strings, and checks that the strings are the
+ * ones of the list of strings the table was made from. It samples every
+ * STEP-th string first, and reports how many blocks that inflated, then
+ * checks all the strings and the ids out of the table.
+ *
+ * For example:
+ *
+ *     $ echo "text_zipped zh_CN.utf8 zh_CN.txt strings.txt" > res.manifest
+ *     $ make_respkg.py --zip-strings 32 res.manifest test.pkg
+ *     $ textrestest test.pkg zh_CN.txt strings.txt
+ *
+ * Usage: textrestest package name strings [step]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <hfcl/common.h>
+#include <hfcl/resource/resloader.h>
+#include <hfcl/resource/textres.h>
+
+using namespace hfcl;
+
+#define MAX_STRINGS     65536
+#define MAX_LINE        4096
+
+// reads the strings as make_respkg.py does: one per line, with the
+// escapes \n and \\ ; the strings are from malloc()
+static int read_strings(const char* path, char** strings)
+{
+    FILE* fp = fopen(path, "r");
+    char line[MAX_LINE];
+    int n = 0;
+
+    if (fp == NULL)
+        return -1;
+
+    while (n < MAX_STRINGS && fgets(line, sizeof(line), fp)) {
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\n')
+            line[--len] = '\0';
+        if (len > 0 && line[len - 1] == '\r')
+            line[--len] = '\0';
+
+        char* s = (char*)malloc(len + 1);
+        char* d = s;
+        for (size_t i = 0; i < len; i++) {
+            if (line[i] == '\\' && line[i + 1] == 'n') {
+                *d++ = '\n';
+                i++;
+            }
+            else if (line[i] == '\\' && line[i + 1] == '\\') {
+                *d++ = '\\';
+                i++;
+            }
+            else
+                *d++ = line[i];
+        }
+        *d = '\0';
+        strings[n++] = s;
+    }
+
+    fclose(fp);
+    return n;
+}
+
+static int check(TextResZipped* text, char** strings, int nrStrings,
+        int step)
+{
+    int nrFailures = 0;
+
+    for (int i = 0; i < nrStrings; i += step) {
+        const char* s = text->getText(i);
+        if (strcmp(s, strings[i])) {
+            printf("string %d is \"%s\", expected \"%s\"\n",
+                    i, s, strings[i]);
+            nrFailures++;
+        }
+    }
+
+    return nrFailures;
+}
+
+int main(int argc, const char* argv[])
+{
+    if (argc < 4) {
+        printf("usage: textrestest package name strings [step]\n");
+        return 2;
+    }
+
+    int step = argc > 4 ? atoi(argv[4]) : 100;
+    if (step <= 0)
+        step = 100;
+
+    static char* strings[MAX_STRINGS];
+    int nrStrings = read_strings(argv[3], strings);
+    if (nrStrings < 0) {
+        printf("textrestest: failed to read %s\n", argv[3]);
+        return 2;
+    }
+
+    if (ResLoader::getInstance()->mountPackage(argv[1]) == NULL) {
+        printf("textrestest: failed to mount %s\n", argv[1]);
+        return 2;
+    }
+
+    TextResZipped* text = HFCL_NEW_EX(TextResZipped, (argv[2]));
+    if (!text->load()) {
+        printf("textrestest: failed to load %s\n", argv[2]);
+        HFCL_DELETE(text);
+        return 2;
+    }
+
+    int nrFailures = check(text, strings, nrStrings, step);
+    printf("every %dth of %d strings: %d blocks inflated\n",
+            step, nrStrings, text->nrInflatedBlocks());
+
+    nrFailures += check(text, strings, nrStrings, 1);
+    if (*text->getText(-1) || *text->getText(nrStrings)) {
+        printf("the ids out of the table do not give empty strings\n");
+        nrFailures++;
+    }
+
+    printf("%d strings, %d blocks inflated, %d failures\n",
+            nrStrings, text->nrInflatedBlocks(), nrFailures);
+
+    HFCL_DELETE(text);
+    ResLoader::getInstance()->unmountPackage(argv[1]);
+    for (int i = 0; i < nrStrings; i++)
+        free(strings[i]);
+    return nrFailures ? 1 : 0;
+}
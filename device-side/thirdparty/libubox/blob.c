@@ -18,11 +18,26 @@
 
 #include "blob.h"
 
+#define BLOB_BUF_MIN_LEN	256
+
 static bool
 blob_buffer_grow(struct blob_buf *buf, int minlen)
 {
 	struct blob_buf *new;
-	int delta = ((minlen / 256) + 1) * 256;
+	int delta = ((minlen / BLOB_BUF_MIN_LEN) + 1) * BLOB_BUF_MIN_LEN;
+
+	/*
+	 * double the capacity, so that building a large message reallocs
+	 * and copies it O(log n) times instead of once per 256 bytes
+	 */
+	if (delta < buf->buflen)
+		delta = buf->buflen;
+	if (buf->buflen + delta > BLOB_ATTR_LEN_MASK) {
+		delta = BLOB_ATTR_LEN_MASK - buf->buflen;
+		if (delta < minlen)
+			return false;
+	}
+
 	new = realloc(buf->buf, buf->buflen + delta);
 	if (new) {
 		buf->buf = new;
@@ -98,6 +113,36 @@ blob_buf_init(struct blob_buf *buf, int id)
 	return 0;
 }
 
+bool
+blob_buf_reserve(struct blob_buf *buf, int len)
+{
+	int offset = attr_to_offset(buf, blob_next(buf->head));
+	int required = offset - BLOB_COOKIE + len - buf->buflen;
+
+	if (required <= 0)
+		return true;
+
+	return blob_buf_grow(buf, required);
+}
+
+static __thread struct blob_buf arena;
+
+struct blob_buf *
+blob_buf_arena(int id)
+{
+	if (blob_buf_init(&arena, id) < 0)
+		return NULL;
+
+	return &arena;
+}
+
+void
+blob_buf_arena_trim(int max_len)
+{
+	if (arena.buflen > max_len)
+		blob_buf_free(&arena);
+}
+
 void
 blob_buf_free(struct blob_buf *buf)
 {
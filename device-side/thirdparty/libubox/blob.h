@@ -193,6 +193,18 @@ extern bool blob_attr_equal(const struct blob_attr *a1, const struct blob_attr *
 extern int blob_buf_init(struct blob_buf *buf, int id);
 extern void blob_buf_free(struct blob_buf *buf);
 extern bool blob_buf_grow(struct blob_buf *buf, int required);
+/* blob_buf_reserve: make room for len more bytes after the current data */
+extern bool blob_buf_reserve(struct blob_buf *buf, int len);
+/*
+ * blob_buf_arena: a per-thread blob_buf, initialized with id, which keeps
+ * its memory from one call to the next, so that building similar
+ * messages over and over does not allocate. It is valid until the next
+ * call in the same thread and must not be freed; blob_buf_arena_trim
+ * frees its memory if that is larger than max_len (0 before a thread
+ * exits).
+ */
+extern struct blob_buf *blob_buf_arena(int id);
+extern void blob_buf_arena_trim(int max_len);
 extern struct blob_attr *blob_new(struct blob_buf *buf, int id, int payload);
 extern void *blob_nest_start(struct blob_buf *buf, int id);
 extern void blob_nest_end(struct blob_buf *buf, void *cookie);
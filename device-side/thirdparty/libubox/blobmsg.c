@@ -174,6 +174,179 @@ int blobmsg_parse(const struct blobmsg_policy *policy, int policy_len,
 	return 0;
 }
 
+struct blobmsg_policy_slot {
+	uint32_t hash;
+	uint16_t namelen;
+	/* first policy entry with this name, -1 if the slot is free */
+	int16_t index;
+};
+
+struct blobmsg_policy_table {
+	unsigned int hash_mask;
+	struct blobmsg_policy_slot slots[];
+};
+
+static uint32_t
+blobmsg_name_hash(const uint8_t *name, unsigned int len)
+{
+	uint32_t hash = 2166136261u;
+
+	while (len--) {
+		hash ^= *name++;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+/* the next policy entry with the same name, -1 for the last one */
+static int16_t *
+blobmsg_policy_next(struct blobmsg_policy_table *table)
+{
+	return (int16_t *) &table->slots[table->hash_mask + 1];
+}
+
+static struct blobmsg_policy_slot *
+blobmsg_policy_lookup(const struct blobmsg_policy *policy,
+		      struct blobmsg_policy_table *table,
+		      const uint8_t *name, unsigned int len, uint32_t hash)
+{
+	struct blobmsg_policy_slot *slot;
+	unsigned int i = hash;
+
+	for (;; i++) {
+		slot = &table->slots[i & table->hash_mask];
+		if (slot->index < 0)
+			return slot;
+
+		if (slot->hash == hash && slot->namelen == len &&
+		    !memcmp(policy[slot->index].name, name, len))
+			return slot;
+	}
+}
+
+int blobmsg_policy_compile(struct blobmsg_policy_index *index)
+{
+	const struct blobmsg_policy *policy = index->policy;
+	struct blobmsg_policy_table *table, *old = NULL;
+	struct blobmsg_policy_slot *slot;
+	unsigned int size = 4;
+	int16_t *next, *last;
+	int i, len;
+
+	if (__atomic_load_n(&index->table, __ATOMIC_ACQUIRE))
+		return 0;
+
+	if (index->policy_len < 0 || index->policy_len > INT16_MAX)
+		return -EINVAL;
+
+	/* keep the table at most half full */
+	while (size < 2 * index->policy_len)
+		size *= 2;
+
+	table = calloc(1, sizeof(*table) + size * sizeof(*slot) +
+		       index->policy_len * (sizeof(*next) + sizeof(*last)));
+	if (!table)
+		return -ENOMEM;
+
+	table->hash_mask = size - 1;
+	for (i = 0; i < size; i++)
+		table->slots[i].index = -1;
+
+	next = blobmsg_policy_next(table);
+	last = next + index->policy_len;
+	for (i = 0; i < index->policy_len; i++) {
+		uint32_t hash;
+
+		next[i] = -1;
+		if (!policy[i].name)
+			continue;
+
+		len = strlen(policy[i].name);
+		if (len > UINT16_MAX)
+			continue;
+
+		hash = blobmsg_name_hash((const uint8_t *) policy[i].name, len);
+		slot = blobmsg_policy_lookup(policy, table,
+					     (const uint8_t *) policy[i].name,
+					     len, hash);
+		if (slot->index < 0) {
+			slot->hash = hash;
+			slot->namelen = len;
+			slot->index = i;
+		} else {
+			next[last[slot->index]] = i;
+		}
+		last[slot->index] = i;
+	}
+
+	/* another thread may have compiled the same index meanwhile */
+	if (!__atomic_compare_exchange_n(&index->table, &old, table, false,
+					 __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+		free(table);
+
+	return 0;
+}
+
+void blobmsg_policy_index_free(struct blobmsg_policy_index *index)
+{
+	free(__atomic_exchange_n(&index->table, NULL, __ATOMIC_ACQUIRE));
+}
+
+int blobmsg_parse_compiled(struct blobmsg_policy_index *index,
+			   struct blob_attr **tb, void *data, unsigned int len)
+{
+	const struct blobmsg_policy *policy = index->policy;
+	struct blobmsg_policy_table *table;
+	struct blobmsg_policy_slot *slot;
+	struct blobmsg_hdr *hdr;
+	struct blob_attr *attr;
+	unsigned int namelen;
+	int16_t *next;
+	bool checked;
+	int i;
+
+	table = __atomic_load_n(&index->table, __ATOMIC_ACQUIRE);
+	if (!table) {
+		if (blobmsg_policy_compile(index) < 0)
+			return blobmsg_parse(policy, index->policy_len, tb,
+					     data, len);
+		table = __atomic_load_n(&index->table, __ATOMIC_ACQUIRE);
+	}
+
+	memset(tb, 0, index->policy_len * sizeof(*tb));
+	if (!data || !len)
+		return -EINVAL;
+
+	next = blobmsg_policy_next(table);
+	__blob_for_each_attr(attr, data, len) {
+		if (blob_len(attr) < sizeof(struct blobmsg_hdr))
+			continue;
+
+		hdr = blob_data(attr);
+		namelen = blobmsg_namelen(hdr);
+		if (namelen > blob_len(attr) - sizeof(struct blobmsg_hdr))
+			continue;
+
+		slot = blobmsg_policy_lookup(policy, table, hdr->name, namelen,
+					     blobmsg_name_hash(hdr->name, namelen));
+		checked = false;
+		for (i = slot->index; i >= 0; i = next[i]) {
+			if (policy[i].type != BLOBMSG_TYPE_UNSPEC &&
+			    blob_id(attr) != policy[i].type)
+				continue;
+
+			if (!checked && !blobmsg_check_attr(attr, true))
+				return -1;
+
+			checked = true;
+			if (!tb[i])
+				tb[i] = attr;
+		}
+	}
+
+	return 0;
+}
 
 static struct blob_attr *
 blobmsg_new(struct blob_buf *buf, int type, const char *name, int payload_len, void **data)
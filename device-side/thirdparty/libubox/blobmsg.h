@@ -120,6 +120,40 @@ int blobmsg_parse(const struct blobmsg_policy *policy, int policy_len,
 int blobmsg_parse_array(const struct blobmsg_policy *policy, int policy_len,
 			struct blob_attr **tb, void *data, unsigned int len);
 
+/*
+ * blobmsg_policy_index: a policy with a hash table from the attribute
+ * names to the policy entries, built on first use
+ *
+ * Declare one next to a static policy array:
+ *
+ *	static struct blobmsg_policy_index iface_index =
+ *		BLOBMSG_POLICY_INDEX(iface_attrs, IFACE_ATTR_MAX);
+ *
+ * and parse with blobmsg_parse_compiled(&iface_index, ...), which takes
+ * time linear in the number of attributes instead of attributes x policy
+ * entries, with the same results as blobmsg_parse for valid messages.
+ * Only the attributes that match a policy entry are validated.
+ *
+ * The table is built privately and published atomically, so an index can
+ * be shared by loops running in different threads.
+ */
+struct blobmsg_policy_table;
+
+struct blobmsg_policy_index {
+	const struct blobmsg_policy *policy;
+	int policy_len;
+
+	struct blobmsg_policy_table *table;
+};
+
+#define BLOBMSG_POLICY_INDEX(_policy, _len) \
+	{ .policy = (_policy), .policy_len = (_len) }
+
+int blobmsg_policy_compile(struct blobmsg_policy_index *index);
+void blobmsg_policy_index_free(struct blobmsg_policy_index *index);
+int blobmsg_parse_compiled(struct blobmsg_policy_index *index,
+			   struct blob_attr **tb, void *data, unsigned int len);
+
 int blobmsg_add_field(struct blob_buf *buf, int type, const char *name,
                       const void *data, unsigned int len);
 
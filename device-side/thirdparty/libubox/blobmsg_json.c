@@ -16,6 +16,7 @@
 #include <inttypes.h>
 #include "blobmsg.h"
 #include "blobmsg_json.h"
+#include "ustream.h"
 
 #ifdef JSONC
 	#include <json.h>
@@ -109,17 +110,37 @@ bool blobmsg_add_json_from_string(struct blob_buf *b, const char *str)
 }
 
 
+/* the size of the chunks passed to a blobmsg_json_write_t */
+#define BLOBMSG_JSON_CHUNK	4096
+
 struct strbuf {
 	int len;
 	int pos;
 	char *buf;
 
+	/* if set, buf is a chunk flushed to write whenever it fills up */
+	blobmsg_json_write_t write;
+	void *write_priv;
+	bool error;
+
 	blobmsg_json_format_t custom_format;
 	void *priv;
 	bool indent;
 	int indent_level;
 };
 
+static bool blobmsg_flush(struct strbuf *s, bool more)
+{
+	if (s->error)
+		return false;
+
+	if (s->pos && !s->write(s->write_priv, s->buf, s->pos, more))
+		s->error = true;
+
+	s->pos = 0;
+	return !s->error;
+}
+
 static bool blobmsg_puts(struct strbuf *s, const char *c, int len)
 {
 	size_t new_len;
@@ -128,8 +149,28 @@ static bool blobmsg_puts(struct strbuf *s, const char *c, int len)
 	if (len <= 0)
 		return true;
 
-	if (s->pos + len >= s->len) {
-		new_len = s->len + 16 + len;
+	if (s->pos + len >= s->len && s->write) {
+		if (!blobmsg_flush(s, true))
+			return false;
+
+		/*
+		 * pass long runs on without copying them, but for the last
+		 * byte: the final flush then always has data to pass with
+		 * more set to false
+		 */
+		if (len >= s->len) {
+			if (!s->write(s->write_priv, c, len - 1, true)) {
+				s->error = true;
+				return false;
+			}
+			c += len - 1;
+			len = 1;
+		}
+	} else if (s->pos + len >= s->len) {
+		new_len = s->len * 2;
+		if (new_len < s->pos + len + 16)
+			new_len = s->pos + len + 16;
+
 		new_buf = realloc(s->buf, new_len);
 		if (!new_buf)
 			return false;
@@ -159,6 +200,24 @@ static void add_separator(struct strbuf *s)
 }
 
 
+#define ONES	(~0UL / 255)
+
+/* whether any byte of w is below ' ' or one of '"', '\\' and '/' */
+static inline bool needs_escape(unsigned long w)
+{
+	unsigned long quote = w ^ (ONES * '"');
+	unsigned long backslash = w ^ (ONES * '\\');
+	unsigned long slash = w ^ (ONES * '/');
+	unsigned long found;
+
+	found = (w - ONES * ' ') & ~w;
+	found |= (quote - ONES) & ~quote;
+	found |= (backslash - ONES) & ~backslash;
+	found |= (slash - ONES) & ~slash;
+
+	return found & (ONES * 0x80);
+}
+
 static void blobmsg_format_string(struct strbuf *s, const char *str)
 {
 	const unsigned char *p, *last, *end;
@@ -166,10 +225,24 @@ static void blobmsg_format_string(struct strbuf *s, const char *str)
 
 	end = (unsigned char *) str + strlen(str);
 	blobmsg_puts(s, "\"", 1);
-	for (p = (unsigned char *) str, last = p; *p; p++) {
+	for (p = (unsigned char *) str, last = p; p < end; p++) {
 		char escape = '\0';
 		int len;
 
+		/* skip a word at a time over the characters left as they are */
+		while (end - p >= sizeof(unsigned long)) {
+			unsigned long w;
+
+			memcpy(&w, p, sizeof(w));
+			if (needs_escape(w))
+				break;
+
+			p += sizeof(w);
+		}
+
+		if (p == end)
+			break;
+
 		switch(*p) {
 		case '\b':
 			escape = 'b';
@@ -301,9 +374,9 @@ static void blobmsg_format_json_list(struct strbuf *s, struct blob_attr *attr, i
 
 static void setup_strbuf(struct strbuf *s, struct blob_attr *attr, blobmsg_json_format_t cb, void *priv, int indent)
 {
+	memset(s, 0, sizeof(*s));
 	s->len = blob_len(attr);
 	s->buf = malloc(s->len);
-	s->pos = 0;
 	s->custom_format = cb;
 	s->priv = priv;
 	s->indent = false;
@@ -314,23 +387,29 @@ static void setup_strbuf(struct strbuf *s, struct blob_attr *attr, blobmsg_json_
 	}
 }
 
+static void blobmsg_format_json_top(struct strbuf *s, struct blob_attr *attr, bool list)
+{
+	bool array;
+
+	array = blob_is_extended(attr) &&
+		blobmsg_type(attr) == BLOBMSG_TYPE_ARRAY;
+
+	if (list)
+		blobmsg_format_json_list(s, blobmsg_data(attr), blobmsg_data_len(attr), array);
+	else
+		blobmsg_format_element(s, attr, false, false);
+}
+
 char *blobmsg_format_json_with_cb(struct blob_attr *attr, bool list, blobmsg_json_format_t cb, void *priv, int indent)
 {
 	struct strbuf s;
-	bool array;
 	char *ret;
 
 	setup_strbuf(&s, attr, cb, priv, indent);
 	if (!s.buf)
 		return NULL;
 
-	array = blob_is_extended(attr) &&
-		blobmsg_type(attr) == BLOBMSG_TYPE_ARRAY;
-
-	if (list)
-		blobmsg_format_json_list(&s, blobmsg_data(attr), blobmsg_data_len(attr), array);
-	else
-		blobmsg_format_element(&s, attr, false, false);
+	blobmsg_format_json_top(&s, attr, list);
 
 	if (!s.len) {
 		free(s.buf);
@@ -374,3 +453,40 @@ char *blobmsg_format_json_value_with_cb(struct blob_attr *attr, blobmsg_json_for
 
 	return ret;
 }
+
+bool blobmsg_format_json_write(struct blob_attr *attr, bool list,
+			       blobmsg_json_write_t write, void *write_priv,
+			       blobmsg_json_format_t cb, void *priv, int indent)
+{
+	char chunk[BLOBMSG_JSON_CHUNK];
+	struct strbuf s = {
+		.len = sizeof(chunk),
+		.buf = chunk,
+		.write = write,
+		.write_priv = write_priv,
+		.custom_format = cb,
+		.priv = priv,
+	};
+
+	if (indent >= 0) {
+		s.indent = true;
+		s.indent_level = indent;
+	}
+
+	blobmsg_format_json_top(&s, attr, list);
+
+	return blobmsg_flush(&s, false);
+}
+
+static bool blobmsg_ustream_write(void *priv, const char *data, int len,
+				  bool more)
+{
+	return ustream_write(priv, data, len, more) == len;
+}
+
+bool blobmsg_format_json_ustream(struct ustream *s, struct blob_attr *attr,
+				 bool list, int indent)
+{
+	return blobmsg_format_json_write(attr, list, blobmsg_ustream_write, s,
+					 NULL, NULL, indent);
+}
@@ -56,4 +56,72 @@ static inline char *blobmsg_format_json_value_indent(struct blob_attr *attr, int
 	return blobmsg_format_json_value_with_cb(attr, NULL, NULL, indent);
 }
 
+/*
+ * blobmsg_format_json_write: format attr as blobmsg_format_json_with_cb
+ * does, but pass the text on to write in chunks of a few kilobytes
+ * instead of building it in memory. write returns false to stop; more
+ * is false for the last chunk only, as for ustream_write.
+ */
+typedef bool (*blobmsg_json_write_t)(void *priv, const char *data, int len,
+				     bool more);
+
+bool blobmsg_format_json_write(struct blob_attr *attr, bool list,
+			       blobmsg_json_write_t write, void *write_priv,
+			       blobmsg_json_format_t cb, void *priv,
+			       int indent);
+
+/*
+ * blobmsg_json_parser: parse a JSON object into a blob_buf in one pass,
+ * without building json-c objects first
+ *
+ * The members of the object are added to the blob_buf as
+ * blobmsg_add_json_from_string adds them. The text may be fed in chunks
+ * of any size; blobmsg_json_parser_finish returns true if it was one
+ * complete object, and frees the parser. On errors, the blob_buf is left
+ * as it was before blobmsg_json_parser_init.
+ *
+ * Unlike json-c, the parser takes strict JSON only, and keeps all the
+ * members of an object that have the same name.
+ */
+#define BLOBMSG_JSON_MAX_DEPTH	32
+
+struct blobmsg_json_parser {
+	struct blob_buf *buf;
+	int state;
+
+	int depth;
+	void *cookie[BLOBMSG_JSON_MAX_DEPTH + 1];
+	bool array[BLOBMSG_JSON_MAX_DEPTH + 1];
+
+	/* the string, number or literal being parsed */
+	bool key;
+	char *tok;
+	int tok_len, tok_size;
+	const char *literal;
+	int literal_pos;
+	uint32_t hex;
+	int hex_len;
+	uint32_t surrogate;
+
+	/* the name of the member being parsed */
+	char *name;
+	int name_size;
+
+	int head_offset;
+	uint32_t head_id_len;
+};
+
+void blobmsg_json_parser_init(struct blobmsg_json_parser *p, struct blob_buf *buf);
+bool blobmsg_json_parser_feed(struct blobmsg_json_parser *p, const char *data, int len);
+bool blobmsg_json_parser_finish(struct blobmsg_json_parser *p);
+
+bool blobmsg_add_json_from_string_direct(struct blob_buf *b, const char *str);
+bool blobmsg_add_json_from_file_direct(struct blob_buf *b, const char *file);
+
+struct ustream;
+
+/* blobmsg_format_json_ustream: format attr straight into a ustream */
+bool blobmsg_format_json_ustream(struct ustream *s, struct blob_attr *attr,
+				 bool list, int indent);
+
 #endif
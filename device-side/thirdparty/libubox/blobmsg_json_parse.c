@@ -0,0 +1,568 @@
+/*
+ * blobmsg_json_parse.c - parse JSON straight into a blob_buf
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "blobmsg.h"
+#include "blobmsg_json.h"
+
+enum {
+	JP_START,		/* before the top level object */
+	JP_VALUE,		/* after ':' or ',' in an array */
+	JP_MEMBER_FIRST,	/* after '{': a name or '}' */
+	JP_MEMBER,		/* after ',' in an object: a name */
+	JP_COLON,
+	JP_ELEMENT_FIRST,	/* after '[': a value or ']' */
+	JP_NEXT,		/* after a value: ',' or the end of the container */
+	JP_STRING,
+	JP_ESCAPE,
+	JP_UNICODE,
+	JP_NUMBER,
+	JP_LITERAL,
+	JP_DONE,
+	JP_ERROR,
+};
+
+static bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool jp_grow(struct blobmsg_json_parser *p, int len)
+{
+	int size = p->tok_size ? p->tok_size : 64;
+	char *tok;
+
+	/* keep room for the terminating NUL */
+	while (size <= p->tok_len + len)
+		size *= 2;
+
+	if (size == p->tok_size)
+		return true;
+
+	tok = realloc(p->tok, size);
+	if (!tok)
+		return false;
+
+	p->tok = tok;
+	p->tok_size = size;
+	return true;
+}
+
+static bool jp_append(struct blobmsg_json_parser *p, const char *data, int len)
+{
+	if (p->tok_len + len >= p->tok_size && !jp_grow(p, len))
+		return false;
+
+	memcpy(p->tok + p->tok_len, data, len);
+	p->tok_len += len;
+	p->tok[p->tok_len] = 0;
+	return true;
+}
+
+static bool jp_append_utf8(struct blobmsg_json_parser *p, uint32_t c)
+{
+	char buf[4];
+	int len;
+
+	if (c < 0x80) {
+		buf[0] = c;
+		len = 1;
+	} else if (c < 0x800) {
+		buf[0] = 0xc0 | (c >> 6);
+		buf[1] = 0x80 | (c & 0x3f);
+		len = 2;
+	} else if (c < 0x10000) {
+		buf[0] = 0xe0 | (c >> 12);
+		buf[1] = 0x80 | ((c >> 6) & 0x3f);
+		buf[2] = 0x80 | (c & 0x3f);
+		len = 3;
+	} else {
+		buf[0] = 0xf0 | (c >> 18);
+		buf[1] = 0x80 | ((c >> 12) & 0x3f);
+		buf[2] = 0x80 | ((c >> 6) & 0x3f);
+		buf[3] = 0x80 | (c & 0x3f);
+		len = 4;
+	}
+
+	return jp_append(p, buf, len);
+}
+
+/* a high surrogate not followed by a low one is kept as it is */
+static bool jp_flush_surrogate(struct blobmsg_json_parser *p)
+{
+	uint32_t c = p->surrogate;
+
+	if (!c)
+		return true;
+
+	p->surrogate = 0;
+	return jp_append_utf8(p, c);
+}
+
+static bool jp_unicode(struct blobmsg_json_parser *p, uint32_t c)
+{
+	if (p->surrogate && c >= 0xdc00 && c <= 0xdfff) {
+		c = 0x10000 + ((p->surrogate - 0xd800) << 10) + (c - 0xdc00);
+		p->surrogate = 0;
+		return jp_append_utf8(p, c);
+	}
+
+	if (!jp_flush_surrogate(p))
+		return false;
+
+	if (c >= 0xd800 && c <= 0xdbff) {
+		p->surrogate = c;
+		return true;
+	}
+
+	return jp_append_utf8(p, c);
+}
+
+/* the name of the value being parsed, NULL in an array */
+static const char *jp_name(struct blobmsg_json_parser *p)
+{
+	return p->array[p->depth] ? NULL : p->name;
+}
+
+static bool jp_push(struct blobmsg_json_parser *p, bool array)
+{
+	void *cookie;
+
+	if (p->depth == BLOBMSG_JSON_MAX_DEPTH)
+		return false;
+
+	cookie = blobmsg_open_nested(p->buf, jp_name(p), array);
+	if (!cookie)
+		return false;
+
+	p->depth++;
+	p->cookie[p->depth] = cookie;
+	p->array[p->depth] = array;
+	p->state = array ? JP_ELEMENT_FIRST : JP_MEMBER_FIRST;
+	return true;
+}
+
+static void jp_pop(struct blobmsg_json_parser *p)
+{
+	/* the top level object adds its members to the blob_buf itself */
+	if (p->depth > 1)
+		blob_nest_end(p->buf, p->cookie[p->depth]);
+
+	p->depth--;
+	p->state = p->depth ? JP_NEXT : JP_DONE;
+}
+
+static bool jp_check_number(const char *s)
+{
+	if (*s == '-')
+		s++;
+
+	if (*s == '0')
+		s++;
+	else if (*s >= '1' && *s <= '9')
+		while (*s >= '0' && *s <= '9')
+			s++;
+	else
+		return false;
+
+	if (*s == '.') {
+		s++;
+		if (*s < '0' || *s > '9')
+			return false;
+		while (*s >= '0' && *s <= '9')
+			s++;
+	}
+
+	if (*s == 'e' || *s == 'E') {
+		s++;
+		if (*s == '+' || *s == '-')
+			s++;
+		if (*s < '0' || *s > '9')
+			return false;
+		while (*s >= '0' && *s <= '9')
+			s++;
+	}
+
+	return !*s;
+}
+
+/* numbers are added as blobmsg_add_json_element does with json-c */
+static bool jp_number(struct blobmsg_json_parser *p)
+{
+	long long val;
+
+	if (!jp_check_number(p->tok))
+		return false;
+
+	if (strpbrk(p->tok, ".eE"))
+		return !blobmsg_add_double(p->buf, jp_name(p), strtod(p->tok, NULL));
+
+	val = strtoll(p->tok, NULL, 10);
+	if (val > INT32_MAX)
+		val = INT32_MAX;
+	else if (val < INT32_MIN)
+		val = INT32_MIN;
+
+	return !blobmsg_add_u32(p->buf, jp_name(p), (uint32_t) val);
+}
+
+static bool jp_literal(struct blobmsg_json_parser *p)
+{
+	const char *name = jp_name(p);
+
+	switch (p->literal[0]) {
+	case 't':
+		return !blobmsg_add_u8(p->buf, name, 1);
+	case 'f':
+		return !blobmsg_add_u8(p->buf, name, 0);
+	default:
+		return !blobmsg_add_field(p->buf, BLOBMSG_TYPE_UNSPEC, name, NULL, 0);
+	}
+}
+
+static bool jp_string_end(struct blobmsg_json_parser *p)
+{
+	char *tmp;
+	int size;
+
+	/* the empty string has no buffer yet */
+	if (!jp_flush_surrogate(p) || !jp_append(p, "", 0))
+		return false;
+
+	if (!p->key) {
+		p->state = JP_NEXT;
+		return !blobmsg_add_string(p->buf, jp_name(p), p->tok);
+	}
+
+	/* keep the name until its value is added */
+	tmp = p->name;
+	size = p->name_size;
+	p->name = p->tok;
+	p->name_size = p->tok_size;
+	p->tok = tmp;
+	p->tok_size = size;
+	p->state = JP_COLON;
+	return true;
+}
+
+static void jp_string_start(struct blobmsg_json_parser *p, bool key)
+{
+	p->key = key;
+	p->tok_len = 0;
+	p->state = JP_STRING;
+}
+
+static bool jp_value_start(struct blobmsg_json_parser *p, char c)
+{
+	switch (c) {
+	case '{':
+		return jp_push(p, false);
+	case '[':
+		return jp_push(p, true);
+	case '"':
+		jp_string_start(p, false);
+		return true;
+	case 't':
+		p->literal = "true";
+		break;
+	case 'f':
+		p->literal = "false";
+		break;
+	case 'n':
+		p->literal = "null";
+		break;
+	default:
+		if (c != '-' && (c < '0' || c > '9'))
+			return false;
+
+		p->tok_len = 0;
+		p->state = JP_NUMBER;
+		return jp_append(p, &c, 1);
+	}
+
+	p->literal_pos = 1;
+	p->state = JP_LITERAL;
+	return true;
+}
+
+static int jp_hex(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* parses the characters of a string up to the next quote or backslash */
+static int jp_string_run(struct blobmsg_json_parser *p, const char *data, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (data[i] == '"' || data[i] == '\\')
+			break;
+	}
+
+	if (i && (!jp_flush_surrogate(p) || !jp_append(p, data, i)))
+		return -1;
+
+	return i;
+}
+
+static bool jp_char(struct blobmsg_json_parser *p, char c)
+{
+	static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+	const char *e;
+	int h;
+
+	switch (p->state) {
+	case JP_START:
+		if (is_space(c))
+			return true;
+		if (c != '{')
+			return false;
+
+		p->depth = 1;
+		p->array[1] = false;
+		p->state = JP_MEMBER_FIRST;
+		return true;
+
+	case JP_VALUE:
+		if (is_space(c))
+			return true;
+		return jp_value_start(p, c);
+
+	case JP_MEMBER_FIRST:
+	case JP_MEMBER:
+		if (is_space(c))
+			return true;
+		if (c == '}' && p->state == JP_MEMBER_FIRST) {
+			jp_pop(p);
+			return true;
+		}
+		if (c != '"')
+			return false;
+
+		jp_string_start(p, true);
+		return true;
+
+	case JP_COLON:
+		if (is_space(c))
+			return true;
+		if (c != ':')
+			return false;
+
+		p->state = JP_VALUE;
+		return true;
+
+	case JP_ELEMENT_FIRST:
+		if (is_space(c))
+			return true;
+		if (c == ']') {
+			jp_pop(p);
+			return true;
+		}
+		return jp_value_start(p, c);
+
+	case JP_NEXT:
+		if (is_space(c))
+			return true;
+		if (c == ',') {
+			p->state = p->array[p->depth] ? JP_VALUE : JP_MEMBER;
+			return true;
+		}
+		if (c != (p->array[p->depth] ? ']' : '}'))
+			return false;
+
+		jp_pop(p);
+		return true;
+
+	case JP_STRING:
+		if (c == '"')
+			return jp_string_end(p);
+		if (c == '\\') {
+			p->state = JP_ESCAPE;
+			return true;
+		}
+		return jp_flush_surrogate(p) && jp_append(p, &c, 1);
+
+	case JP_ESCAPE:
+		if (c == 'u') {
+			p->hex = 0;
+			p->hex_len = 0;
+			p->state = JP_UNICODE;
+			return true;
+		}
+
+		for (e = escapes; *e; e += 2) {
+			if (*e == c)
+				break;
+		}
+		if (!*e || !jp_flush_surrogate(p))
+			return false;
+
+		p->state = JP_STRING;
+		return jp_append(p, e + 1, 1);
+
+	case JP_UNICODE:
+		h = jp_hex(c);
+		if (h < 0)
+			return false;
+
+		p->hex = (p->hex << 4) | h;
+		if (++p->hex_len < 4)
+			return true;
+
+		p->state = JP_STRING;
+		return jp_unicode(p, p->hex);
+
+	case JP_NUMBER:
+		if ((c >= '0' && c <= '9') || c == '-' || c == '+' ||
+		    c == '.' || c == 'e' || c == 'E')
+			return jp_append(p, &c, 1);
+
+		if (!jp_number(p))
+			return false;
+
+		p->state = JP_NEXT;
+		return jp_char(p, c);
+
+	case JP_LITERAL:
+		if (c != p->literal[p->literal_pos++])
+			return false;
+		if (p->literal[p->literal_pos])
+			return true;
+
+		p->state = JP_NEXT;
+		return jp_literal(p);
+
+	case JP_DONE:
+		return is_space(c);
+
+	default:
+		return false;
+	}
+}
+
+static void jp_rollback(struct blobmsg_json_parser *p)
+{
+	struct blob_buf *buf = p->buf;
+
+	buf->head = (struct blob_attr *) ((char *) buf->buf + p->head_offset);
+	buf->head->id_len = p->head_id_len;
+}
+
+void blobmsg_json_parser_init(struct blobmsg_json_parser *p, struct blob_buf *buf)
+{
+	memset(p, 0, sizeof(*p));
+	p->buf = buf;
+	p->state = JP_START;
+	p->head_offset = (char *) buf->head - (char *) buf->buf;
+	p->head_id_len = buf->head->id_len;
+}
+
+bool blobmsg_json_parser_feed(struct blobmsg_json_parser *p, const char *data, int len)
+{
+	int i, run;
+
+	for (i = 0; i < len && p->state != JP_ERROR; i++) {
+		/* copy the plain characters of a string in one go */
+		if (p->state == JP_STRING) {
+			run = jp_string_run(p, data + i, len - i);
+			if (run < 0) {
+				p->state = JP_ERROR;
+				break;
+			}
+
+			i += run;
+			if (i == len)
+				break;
+		}
+
+		if (!jp_char(p, data[i]))
+			p->state = JP_ERROR;
+	}
+
+	if (p->state != JP_ERROR)
+		return true;
+
+	jp_rollback(p);
+	return false;
+}
+
+bool blobmsg_json_parser_finish(struct blobmsg_json_parser *p)
+{
+	bool ret = p->state == JP_DONE;
+
+	if (!ret && p->state != JP_ERROR)
+		jp_rollback(p);
+
+	free(p->tok);
+	free(p->name);
+	p->tok = p->name = NULL;
+	p->tok_size = p->name_size = 0;
+	p->state = JP_ERROR;
+
+	return ret;
+}
+
+bool blobmsg_add_json_from_string_direct(struct blob_buf *b, const char *str)
+{
+	struct blobmsg_json_parser p;
+
+	blobmsg_json_parser_init(&p, b);
+	blobmsg_json_parser_feed(&p, str, strlen(str));
+	return blobmsg_json_parser_finish(&p);
+}
+
+bool blobmsg_add_json_from_file_direct(struct blob_buf *b, const char *file)
+{
+	struct blobmsg_json_parser p;
+	char buf[4096];
+	ssize_t len;
+	int fd;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	blobmsg_json_parser_init(&p, b);
+	do {
+		len = read(fd, buf, sizeof(buf));
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0) {
+			jp_rollback(&p);
+			p.state = JP_ERROR;
+			break;
+		}
+		if (!blobmsg_json_parser_feed(&p, buf, len))
+			break;
+	} while (len > 0);
+	close(fd);
+
+	return blobmsg_json_parser_finish(&p);
+}
@@ -0,0 +1,247 @@
+/*
+ * blob-buf-bench.c - blob_buf growth microbenchmark
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Builds the interface dump of netifd (netifd_handle_dump with the device
+ * statistics of system_if_dump_stats) for a number of interfaces (500 by
+ * default), over and over, with:
+ *
+ *  - 256-byte steps: the growth of blob_buf before it doubled,
+ *  - doubling: a blob_buf freed after each dump,
+ *  - reserve: the same, with blob_buf_reserve for the size of the dump,
+ *  - arena: blob_buf_arena, which keeps its memory between dumps.
+ *
+ * usage: blob-buf-bench [interfaces] [dumps]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "blobmsg.h"
+#include "utils.h"
+
+static int nr_reallocs;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool step_grow(struct blob_buf *buf, int minlen)
+{
+	int delta = ((minlen / 256) + 1) * 256;
+	void *new;
+
+	new = realloc(buf->buf, buf->buflen + delta);
+	if (!new)
+		return false;
+
+	buf->buf = new;
+	memset((char *)buf->buf + buf->buflen, 0, delta);
+	buf->buflen += delta;
+	nr_reallocs++;
+	return true;
+}
+
+static bool counting_grow(struct blob_buf *buf, int minlen)
+{
+	static bool (*grow)(struct blob_buf *buf, int minlen);
+	static struct blob_buf dummy;
+
+	if (!grow) {
+		blob_buf_init(&dummy, 0);
+		grow = dummy.grow;
+		blob_buf_free(&dummy);
+	}
+
+	nr_reallocs++;
+	return grow(buf, minlen);
+}
+
+static void dump_stats(struct blob_buf *b, int i)
+{
+	static const char * const names[] = {
+		"collisions", "rx_frame_errors", "tx_compressed",
+		"multicast", "rx_fifo_errors", "rx_missed_errors",
+		"tx_heartbeat_errors", "rx_bytes", "rx_packets",
+		"rx_errors", "rx_dropped", "rx_over_errors",
+		"rx_crc_errors", "rx_compressed", "tx_bytes",
+		"tx_packets", "tx_errors", "tx_dropped",
+		"tx_aborted_errors", "tx_carrier_errors",
+		"tx_fifo_errors", "tx_window_errors",
+	};
+	void *c;
+	int j;
+
+	c = blobmsg_open_table(b, "statistics");
+	for (j = 0; j < ARRAY_SIZE(names); j++)
+		blobmsg_add_u64(b, names[j], (uint64_t)i * 1000003 + j);
+	blobmsg_close_table(b, c);
+}
+
+static void dump_address(struct blob_buf *b, const char *addr, int mask)
+{
+	void *c;
+
+	c = blobmsg_open_table(b, NULL);
+	blobmsg_add_string(b, "address", addr);
+	blobmsg_add_u32(b, "mask", mask);
+	blobmsg_close_table(b, c);
+}
+
+static void dump_route(struct blob_buf *b, const char *target, int mask,
+		       const char *nexthop)
+{
+	void *c;
+
+	c = blobmsg_open_table(b, NULL);
+	blobmsg_add_string(b, "target", target);
+	blobmsg_add_u32(b, "mask", mask);
+	blobmsg_add_string(b, "nexthop", nexthop);
+	blobmsg_add_string(b, "source", "0.0.0.0/0");
+	blobmsg_close_table(b, c);
+}
+
+static void dump_interface(struct blob_buf *b, int i)
+{
+	char name[16], addr[48];
+	void *iface, *c;
+
+	snprintf(name, sizeof(name), "lan%d", i);
+	iface = blobmsg_open_table(b, NULL);
+	blobmsg_add_string(b, "interface", name);
+	blobmsg_add_u8(b, "up", 1);
+	blobmsg_add_u8(b, "pending", 0);
+	blobmsg_add_u8(b, "available", 1);
+	blobmsg_add_u8(b, "autostart", 1);
+	blobmsg_add_u8(b, "dynamic", 0);
+	blobmsg_add_u32(b, "uptime", 1000 + i);
+	blobmsg_add_string(b, "l3_device", name);
+	blobmsg_add_string(b, "proto", "static");
+	blobmsg_add_string(b, "device", name);
+	blobmsg_add_u32(b, "metric", 0);
+
+	c = blobmsg_open_array(b, "ipv4-address");
+	snprintf(addr, sizeof(addr), "10.%d.%d.1", i >> 8, i & 0xff);
+	dump_address(b, addr, 24);
+	blobmsg_close_array(b, c);
+
+	c = blobmsg_open_array(b, "ipv6-address");
+	snprintf(addr, sizeof(addr), "fd00:%x::1", i);
+	dump_address(b, addr, 64);
+	blobmsg_close_array(b, c);
+
+	c = blobmsg_open_array(b, "route");
+	snprintf(addr, sizeof(addr), "10.%d.%d.254", i >> 8, i & 0xff);
+	dump_route(b, "0.0.0.0", 0, addr);
+	blobmsg_close_array(b, c);
+
+	c = blobmsg_open_array(b, "dns-server");
+	blobmsg_add_string(b, NULL, "8.8.8.8");
+	blobmsg_add_string(b, NULL, "8.8.4.4");
+	blobmsg_close_array(b, c);
+
+	c = blobmsg_open_array(b, "dns-search");
+	blobmsg_close_array(b, c);
+
+	c = blobmsg_open_table(b, "data");
+	blobmsg_close_table(b, c);
+
+	dump_stats(b, i);
+	blobmsg_close_table(b, iface);
+}
+
+static void dump(struct blob_buf *b, int nr_ifaces)
+{
+	void *c;
+	int i;
+
+	c = blobmsg_open_array(b, "interface");
+	for (i = 0; i < nr_ifaces; i++)
+		dump_interface(b, i);
+	blobmsg_close_array(b, c);
+}
+
+static void report(const char *name, double start, int nr_dumps, int len)
+{
+	double t = now_sec() - start;
+
+	printf("%-16s %8.1f us/dump %8.1f reallocs/dump %8d bytes\n", name,
+	       t * 1e6 / nr_dumps, (double)nr_reallocs / nr_dumps, len);
+	nr_reallocs = 0;
+}
+
+int main(int argc, char **argv)
+{
+	int nr_ifaces = argc > 1 ? atoi(argv[1]) : 500;
+	int nr_dumps = argc > 2 ? atoi(argv[2]) : 200;
+	struct blob_buf b;
+	double start;
+	int i, len = 0;
+
+	start = now_sec();
+	for (i = 0; i < nr_dumps; i++) {
+		memset(&b, 0, sizeof(b));
+		b.grow = step_grow;
+		blob_buf_init(&b, 0);
+		dump(&b, nr_ifaces);
+		len = blob_pad_len(b.head);
+		blob_buf_free(&b);
+	}
+	report("256-byte steps", start, nr_dumps, len);
+
+	start = now_sec();
+	for (i = 0; i < nr_dumps; i++) {
+		memset(&b, 0, sizeof(b));
+		b.grow = counting_grow;
+		blob_buf_init(&b, 0);
+		dump(&b, nr_ifaces);
+		len = blob_pad_len(b.head);
+		blob_buf_free(&b);
+	}
+	report("doubling", start, nr_dumps, len);
+
+	start = now_sec();
+	for (i = 0; i < nr_dumps; i++) {
+		memset(&b, 0, sizeof(b));
+		b.grow = counting_grow;
+		blob_buf_init(&b, 0);
+		blob_buf_reserve(&b, len);
+		dump(&b, nr_ifaces);
+		blob_buf_free(&b);
+	}
+	report("reserve", start, nr_dumps, len);
+
+	blob_buf_arena(0)->grow = counting_grow;
+	blob_buf_arena_trim(0);
+
+	start = now_sec();
+	for (i = 0; i < nr_dumps; i++) {
+		struct blob_buf *a = blob_buf_arena(0);
+
+		dump(a, nr_ifaces);
+		len = blob_pad_len(a->head);
+	}
+	report("arena", start, nr_dumps, len);
+	blob_buf_arena_trim(0);
+
+	return 0;
+}
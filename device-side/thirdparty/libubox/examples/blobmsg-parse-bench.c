@@ -0,0 +1,180 @@
+/*
+ * blobmsg-parse-bench.c - blobmsg_parse microbenchmark
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Parses interface and device sections with the interface and device
+ * policies of netifd, with blobmsg_parse and with blobmsg_parse_compiled,
+ * and checks that both give the same attributes.
+ *
+ * usage: blobmsg-parse-bench [parses]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "blobmsg.h"
+#include "utils.h"
+
+static const struct blobmsg_policy iface_attrs[] = {
+	{ .name = "ifname", .type = BLOBMSG_TYPE_STRING },
+	{ .name = "proto", .type = BLOBMSG_TYPE_STRING },
+	{ .name = "auto", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "defaultroute", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "peerdns", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "dns", .type = BLOBMSG_TYPE_ARRAY },
+	{ .name = "dns_search", .type = BLOBMSG_TYPE_ARRAY },
+	{ .name = "dns_metric", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "metric", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "interface", .type = BLOBMSG_TYPE_STRING },
+	{ .name = "ip6assign", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "ip6hint", .type = BLOBMSG_TYPE_STRING },
+	{ .name = "ip4table", .type = BLOBMSG_TYPE_STRING },
+	{ .name = "ip6table", .type = BLOBMSG_TYPE_STRING },
+	{ .name = "ip6class", .type = BLOBMSG_TYPE_ARRAY },
+	{ .name = "delegate", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "ip6ifaceid", .type = BLOBMSG_TYPE_STRING },
+	{ .name = "force_link", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "ip6weight", .type = BLOBMSG_TYPE_INT32 },
+};
+
+static const struct blobmsg_policy dev_attrs[] = {
+	{ .name = "type", .type = BLOBMSG_TYPE_STRING },
+	{ .name = "mtu", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "mtu6", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "macaddr", .type = BLOBMSG_TYPE_STRING },
+	{ .name = "txqueuelen", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "enabled", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "ipv6", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "promisc", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "rpfilter", .type = BLOBMSG_TYPE_STRING },
+	{ .name = "acceptlocal", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "igmpversion", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "mldversion", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "neighreachabletime", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "neighgcstaletime", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "dadtransmits", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "multicast_to_unicast", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "multicast_router", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "multicast_fast_leave", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "multicast", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "learning", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "unicast_flood", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "sendredirects", .type = BLOBMSG_TYPE_BOOL },
+	{ .name = "neighlocktime", .type = BLOBMSG_TYPE_INT32 },
+	{ .name = "isolate", .type = BLOBMSG_TYPE_BOOL },
+};
+
+static struct blobmsg_policy_index iface_index =
+	BLOBMSG_POLICY_INDEX(iface_attrs, ARRAY_SIZE(iface_attrs));
+static struct blobmsg_policy_index dev_index =
+	BLOBMSG_POLICY_INDEX(dev_attrs, ARRAY_SIZE(dev_attrs));
+
+static struct blob_buf iface_buf, dev_buf;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* a section as the uci config of netifd has it, with a few unknown options */
+static void fill_iface(struct blob_buf *b)
+{
+	void *c;
+
+	blob_buf_init(b, 0);
+	blobmsg_add_string(b, "ifname", "eth0.1");
+	blobmsg_add_string(b, "proto", "static");
+	blobmsg_add_string(b, "ipaddr", "192.168.1.1");
+	blobmsg_add_string(b, "netmask", "255.255.255.0");
+	blobmsg_add_u8(b, "auto", 1);
+	blobmsg_add_u8(b, "defaultroute", 1);
+	blobmsg_add_u32(b, "metric", 10);
+	c = blobmsg_open_array(b, "dns");
+	blobmsg_add_string(b, NULL, "8.8.8.8");
+	blobmsg_close_array(b, c);
+	blobmsg_add_u32(b, "ip6assign", 60);
+	blobmsg_add_string(b, "ip6hint", "10");
+	blobmsg_add_u8(b, "force_link", 1);
+	blobmsg_add_string(b, "comment", "lan");
+}
+
+static void fill_dev(struct blob_buf *b)
+{
+	blob_buf_init(b, 0);
+	blobmsg_add_string(b, "name", "br-lan");
+	blobmsg_add_string(b, "type", "bridge");
+	blobmsg_add_u32(b, "mtu", 1500);
+	blobmsg_add_string(b, "macaddr", "00:11:22:33:44:55");
+	blobmsg_add_u8(b, "ipv6", 1);
+	blobmsg_add_u8(b, "promisc", 0);
+	blobmsg_add_u32(b, "igmpversion", 3);
+	blobmsg_add_u8(b, "multicast_to_unicast", 1);
+	blobmsg_add_u8(b, "isolate", 0);
+}
+
+static int bench(const char *name, struct blobmsg_policy_index *index,
+		 struct blob_buf *b, int nr_parses)
+{
+	struct blob_attr *tb[32], *tb_compiled[32];
+	double start, t_parse, t_compiled;
+	int i;
+
+	start = now_sec();
+	for (i = 0; i < nr_parses; i++)
+		blobmsg_parse(index->policy, index->policy_len, tb,
+			      blob_data(b->head), blob_len(b->head));
+	t_parse = now_sec() - start;
+
+	start = now_sec();
+	for (i = 0; i < nr_parses; i++)
+		blobmsg_parse_compiled(index, tb_compiled,
+				       blob_data(b->head), blob_len(b->head));
+	t_compiled = now_sec() - start;
+
+	printf("%-6s blobmsg_parse %6.1f ns, blobmsg_parse_compiled %6.1f ns\n",
+	       name, t_parse * 1e9 / nr_parses, t_compiled * 1e9 / nr_parses);
+
+	if (memcmp(tb, tb_compiled, index->policy_len * sizeof(*tb)) != 0) {
+		fprintf(stderr, "%s: the results differ\n", name);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int nr_parses = argc > 1 ? atoi(argv[1]) : 1000000;
+	int ret = 0;
+
+	fill_iface(&iface_buf);
+	fill_dev(&dev_buf);
+
+	ret |= bench("iface", &iface_index, &iface_buf, nr_parses);
+	ret |= bench("device", &dev_index, &dev_buf, nr_parses);
+
+	blobmsg_policy_index_free(&iface_index);
+	blobmsg_policy_index_free(&dev_index);
+	blob_buf_free(&iface_buf);
+	blob_buf_free(&dev_buf);
+
+	return ret;
+}
@@ -0,0 +1,164 @@
+/*
+ * json-parse-bench.c - JSON to blobmsg parser microbenchmark
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Parses the JSON of an interface dump of netifd for a number of
+ * interfaces (500 by default) into a blob_buf through json-c
+ * (blobmsg_add_json_from_string), in one pass
+ * (blobmsg_add_json_from_string_direct), and in one pass fed in 1500-byte
+ * chunks as they come from a socket, and checks that all give the same
+ * blob.
+ *
+ * usage: json-parse-bench [interfaces] [parses]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "blobmsg.h"
+#include "blobmsg_json.h"
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void dump_interface(struct blob_buf *b, int i)
+{
+	char name[16], addr[48];
+	void *iface, *c, *a;
+
+	snprintf(name, sizeof(name), "lan%d", i);
+	iface = blobmsg_open_table(b, NULL);
+	blobmsg_add_string(b, "interface", name);
+	blobmsg_add_u8(b, "up", 1);
+	blobmsg_add_u8(b, "pending", 0);
+	blobmsg_add_u8(b, "available", 1);
+	blobmsg_add_u8(b, "autostart", 1);
+	blobmsg_add_u32(b, "uptime", 1000 + i);
+	blobmsg_add_string(b, "l3_device", name);
+	blobmsg_add_string(b, "proto", "static");
+	blobmsg_add_string(b, "device", name);
+	blobmsg_add_u32(b, "metric", 0);
+
+	c = blobmsg_open_array(b, "ipv4-address");
+	a = blobmsg_open_table(b, NULL);
+	snprintf(addr, sizeof(addr), "10.%d.%d.1", i >> 8, i & 0xff);
+	blobmsg_add_string(b, "address", addr);
+	blobmsg_add_u32(b, "mask", 24);
+	blobmsg_close_table(b, a);
+	blobmsg_close_array(b, c);
+
+	c = blobmsg_open_array(b, "route");
+	a = blobmsg_open_table(b, NULL);
+	blobmsg_add_string(b, "target", "0.0.0.0");
+	blobmsg_add_u32(b, "mask", 0);
+	snprintf(addr, sizeof(addr), "10.%d.%d.254", i >> 8, i & 0xff);
+	blobmsg_add_string(b, "nexthop", addr);
+	blobmsg_close_table(b, a);
+	blobmsg_close_array(b, c);
+
+	c = blobmsg_open_array(b, "dns-server");
+	blobmsg_add_string(b, NULL, "8.8.8.8");
+	blobmsg_add_string(b, NULL, "8.8.4.4");
+	blobmsg_close_array(b, c);
+
+	c = blobmsg_open_table(b, "data");
+	blobmsg_add_string(b, "hostname", "router \"main\"\n");
+	blobmsg_close_table(b, c);
+	blobmsg_close_table(b, iface);
+}
+
+static bool parse_chunked(struct blob_buf *b, const char *str, int len)
+{
+	struct blobmsg_json_parser p;
+	int off, n;
+
+	blobmsg_json_parser_init(&p, b);
+	for (off = 0; off < len; off += n) {
+		n = len - off < 1500 ? len - off : 1500;
+		if (!blobmsg_json_parser_feed(&p, str + off, n))
+			break;
+	}
+
+	return blobmsg_json_parser_finish(&p);
+}
+
+static bool same_blob(struct blob_buf *a, struct blob_buf *b)
+{
+	return blob_raw_len(a->head) == blob_raw_len(b->head) &&
+	       !memcmp(a->head, b->head, blob_raw_len(a->head));
+}
+
+int main(int argc, char **argv)
+{
+	int nr_ifaces = argc > 1 ? atoi(argv[1]) : 500;
+	int nr_parses = argc > 2 ? atoi(argv[2]) : 50;
+	static struct blob_buf b, ref;
+	double start;
+	char *json;
+	void *c;
+	int i, len;
+
+	blob_buf_init(&b, 0);
+	c = blobmsg_open_array(&b, "interface");
+	for (i = 0; i < nr_ifaces; i++)
+		dump_interface(&b, i);
+	blobmsg_close_array(&b, c);
+
+	json = blobmsg_format_json(b.head, true);
+	if (!json)
+		return 1;
+
+	len = strlen(json);
+	printf("%d bytes of JSON\n", len);
+
+	start = now_sec();
+	for (i = 0; i < nr_parses; i++) {
+		blob_buf_init(&ref, 0);
+		blobmsg_add_json_from_string(&ref, json);
+	}
+	printf("json-c           %8.1f us\n", (now_sec() - start) * 1e6 / nr_parses);
+
+	start = now_sec();
+	for (i = 0; i < nr_parses; i++) {
+		blob_buf_init(&b, 0);
+		blobmsg_add_json_from_string_direct(&b, json);
+	}
+	printf("direct           %8.1f us\n", (now_sec() - start) * 1e6 / nr_parses);
+	if (!same_blob(&ref, &b))
+		fprintf(stderr, "direct: the blobs differ\n");
+
+	start = now_sec();
+	for (i = 0; i < nr_parses; i++) {
+		blob_buf_init(&b, 0);
+		parse_chunked(&b, json, len);
+	}
+	printf("direct, chunked  %8.1f us\n", (now_sec() - start) * 1e6 / nr_parses);
+	if (!same_blob(&ref, &b))
+		fprintf(stderr, "chunked: the blobs differ\n");
+
+	free(json);
+	blob_buf_free(&b);
+	blob_buf_free(&ref);
+
+	return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * runqueue-thread-bench.c - runqueue worker thread benchmark
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Hashes a buffer with md5 a number of times (4 MB, 32 times by default),
+ * as a firmware upgrade does with its image, while a 10 ms timer measures
+ * how late the loop runs it. The hashes run inline in runqueue tasks,
+ * in forked processes and in thread tasks. A last round queues low and
+ * high priority thread tasks together to check the order they finish in.
+ *
+ * usage: runqueue-thread-bench [tasks] [buffer size in KB]
+ */
+
+#include <sys/wait.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "md5.h"
+#include "runqueue.h"
+#include "uloop.h"
+
+struct hash_task {
+	struct runqueue_thread t;
+	struct runqueue_process proc;
+	int id;
+	unsigned char sum[16];
+};
+
+static struct runqueue q;
+static struct uloop_timeout tick;
+static unsigned char *data;
+static size_t data_len;
+static double last_tick, worst_delay;
+static int64_t cpu_time;
+static int low_done, high_before_low;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void hash_data(unsigned char *sum)
+{
+	md5_ctx_t ctx;
+
+	md5_begin(&ctx);
+	md5_hash(data, data_len, &ctx);
+	md5_end(sum, &ctx);
+}
+
+static void tick_cb(struct uloop_timeout *t)
+{
+	double now = now_sec();
+
+	if (now - last_tick - 0.01 > worst_delay)
+		worst_delay = now - last_tick - 0.01;
+	last_tick = now;
+	uloop_timeout_set(t, 10);
+}
+
+static void q_empty(struct runqueue *q)
+{
+	uloop_end();
+}
+
+static void inline_run(struct runqueue *q, struct runqueue_task *t)
+{
+	struct hash_task *h = container_of(t, struct hash_task, t.task);
+
+	hash_data(h->sum);
+	runqueue_task_complete(t);
+}
+
+static void proc_run(struct runqueue *q, struct runqueue_task *t)
+{
+	struct hash_task *h = container_of(t, struct hash_task, proc.task);
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		runqueue_task_complete(t);
+		return;
+	}
+
+	if (pid) {
+		runqueue_process_add(q, &h->proc, pid);
+		return;
+	}
+
+	hash_data(h->sum);
+	_exit(0);
+}
+
+static void thread_run(struct runqueue_thread *t)
+{
+	struct hash_task *h = container_of(t, struct hash_task, t);
+
+	hash_data(h->sum);
+}
+
+static void thread_complete(struct runqueue *q, struct runqueue_task *t)
+{
+	struct hash_task *h = container_of(t, struct hash_task, t.task);
+
+	cpu_time += h->t.cpu_time;
+	if (h->t.prio == RUNQUEUE_PRIO_LOW)
+		low_done++;
+	else if (!low_done)
+		high_before_low++;
+}
+
+static void run_round(const char *name, struct hash_task *tasks, int n,
+		      int max_running, int mode)
+{
+	static const struct runqueue_task_type inline_type = {
+		.name = "inline",
+		.run = inline_run,
+	};
+	static const struct runqueue_task_type proc_type = {
+		.name = "process",
+		.run = proc_run,
+		.cancel = runqueue_process_cancel_cb,
+		.kill = runqueue_process_kill_cb,
+	};
+	double start;
+	int i;
+
+	memset(tasks, 0, n * sizeof(*tasks));
+	q.max_running_tasks = max_running;
+	q.empty = false;
+	worst_delay = 0;
+	cpu_time = 0;
+
+	start = last_tick = now_sec();
+	uloop_timeout_set(&tick, 10);
+
+	for (i = 0; i < n; i++) {
+		struct hash_task *h = &tasks[i];
+
+		h->id = i;
+		switch (mode) {
+		case 0:
+			h->t.task.type = &inline_type;
+			runqueue_task_add(&q, &h->t.task, false);
+			break;
+		case 1:
+			h->proc.task.type = &proc_type;
+			runqueue_task_add(&q, &h->proc.task, false);
+			break;
+		default:
+			/* the high priority tasks are queued last */
+			h->t.prio = mode == 3 && i < n / 2 ?
+				    RUNQUEUE_PRIO_LOW : RUNQUEUE_PRIO_HIGH;
+			h->t.run = thread_run;
+			h->t.task.complete = thread_complete;
+			runqueue_thread_add(&q, &h->t);
+			break;
+		}
+	}
+
+	uloop_run();
+	uloop_timeout_cancel(&tick);
+
+	printf("%-10s %8.1f ms, worst loop delay %7.1f ms", name,
+	       (now_sec() - start) * 1000, worst_delay * 1000);
+	if (mode >= 2)
+		printf(", %7.1f ms CPU in tasks", cpu_time / 1000.0);
+	printf("\n");
+	/* the processes of the next round must not inherit the output */
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	int n = argc > 1 ? atoi(argv[1]) : 32;
+	int kb = argc > 2 ? atoi(argv[2]) : 4096;
+	int nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	struct hash_task *tasks;
+	size_t i;
+
+	if (n <= 0 || kb <= 0)
+		return 1;
+
+	if (nr_cpus < 1)
+		nr_cpus = 1;
+
+	data_len = (size_t)kb << 10;
+	data = malloc(data_len);
+	tasks = calloc(n, sizeof(*tasks));
+	if (!data || !tasks)
+		return 1;
+
+	for (i = 0; i < data_len; i++)
+		data[i] = i * 31;
+
+	uloop_init();
+	runqueue_init(&q);
+	q.empty_cb = q_empty;
+	tick.cb = tick_cb;
+
+	run_round("inline", tasks, n, 1, 0);
+	run_round("process", tasks, n, nr_cpus, 1);
+	run_round("thread", tasks, n, nr_cpus, 2);
+
+	/* more running tasks than workers, so that tasks wait for one */
+	runqueue_thread_pool_size(1);
+	low_done = high_before_low = 0;
+	run_round("priority", tasks, n, n, 3);
+	printf("%d of %d high priority tasks finished before the first low one\n",
+	       high_before_low, n - n / 2);
+
+	runqueue_thread_pool_done();
+	uloop_done();
+	free(tasks);
+	free(data);
+
+	return 0;
+}
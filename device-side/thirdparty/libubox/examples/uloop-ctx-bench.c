@@ -0,0 +1,197 @@
+/*
+ * uloop-ctx-bench.c - uloop context scaling benchmark
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Runs the echo pairs of uloop-echo-bench on a number of worker threads,
+ * each with its own uloop context. The main loop stops the workers with
+ * uloop_ctx_end after the given time, and each worker reports its round
+ * trips back to the main loop with uloop_ctx_call.
+ *
+ * usage: uloop-ctx-bench [threads] [pairs per thread] [seconds]
+ */
+
+#include <sys/socket.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "uloop.h"
+#include "ustream.h"
+#include "utils.h"
+
+#define MSG_LEN 32
+
+struct echo_pair {
+	struct ustream_fd client;
+	struct ustream_fd server;
+	int received;
+	unsigned long *round_trips;
+};
+
+struct worker {
+	pthread_t thread;
+	struct uloop_ctx *ctx;
+	int nr_pairs;
+	unsigned long round_trips;
+	struct uloop_call done;
+};
+
+static const char msg[MSG_LEN] = "0123456789abcdef0123456789abcde";
+static struct worker *workers;
+static int nr_workers, nr_running;
+static unsigned long total_round_trips;
+
+static void server_read_cb(struct ustream *s, int bytes)
+{
+	char *data;
+	int len;
+
+	while ((data = ustream_get_read_buf(s, &len)) != NULL) {
+		ustream_write(s, data, len, false);
+		ustream_consume(s, len);
+	}
+}
+
+static void client_read_cb(struct ustream *s, int bytes)
+{
+	struct echo_pair *p = container_of(s, struct echo_pair, client.stream);
+	int len;
+
+	while (ustream_get_read_buf(s, &len) != NULL) {
+		ustream_consume(s, len);
+		p->received += len;
+	}
+
+	while (p->received >= MSG_LEN) {
+		p->received -= MSG_LEN;
+		(*p->round_trips)++;
+		ustream_write(s, msg, MSG_LEN, false);
+	}
+}
+
+/* runs in the main loop */
+static void worker_done_cb(struct uloop_call *c)
+{
+	struct worker *w = container_of(c, struct worker, done);
+
+	total_round_trips += w->round_trips;
+	if (!--nr_running)
+		uloop_end();
+}
+
+static void *worker_run(void *arg)
+{
+	struct worker *w = arg;
+	struct echo_pair *pairs;
+	int i;
+
+	pairs = calloc(w->nr_pairs, sizeof(*pairs));
+	if (!pairs)
+		goto out;
+
+	/* the streams register their fds in the context of the thread */
+	uloop_ctx_bind(w->ctx);
+	uloop_set_dispatch(ULOOP_DISPATCH_EDGE, 0);
+
+	for (i = 0; i < w->nr_pairs; i++) {
+		int fds[2];
+
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+			perror("socketpair");
+			break;
+		}
+
+		pairs[i].round_trips = &w->round_trips;
+		pairs[i].client.stream.notify_read = client_read_cb;
+		pairs[i].server.stream.notify_read = server_read_cb;
+		ustream_fd_init(&pairs[i].client, fds[0]);
+		ustream_fd_init(&pairs[i].server, fds[1]);
+		ustream_write(&pairs[i].client.stream, msg, MSG_LEN, false);
+	}
+
+	uloop_ctx_run(w->ctx, -1);
+
+	while (i-- > 0) {
+		ustream_free(&pairs[i].client.stream);
+		ustream_free(&pairs[i].server.stream);
+		close(pairs[i].client.fd.fd);
+		close(pairs[i].server.fd.fd);
+	}
+	free(pairs);
+	ustream_pool_flush();
+
+out:
+	uloop_ctx_call(uloop_ctx_default(), &w->done);
+	return NULL;
+}
+
+static void end_cb(struct uloop_timeout *t)
+{
+	int i;
+
+	for (i = 0; i < nr_workers; i++)
+		uloop_ctx_end(workers[i].ctx);
+}
+
+int main(int argc, char **argv)
+{
+	int nr_threads = argc > 1 ? atoi(argv[1]) : 4;
+	int nr_pairs = argc > 2 ? atoi(argv[2]) : 64;
+	int seconds = argc > 3 ? atoi(argv[3]) : 3;
+	struct uloop_timeout end = { .cb = end_cb };
+	int i;
+
+	if (nr_threads <= 0 || nr_pairs <= 0 || seconds <= 0)
+		return 1;
+
+	workers = calloc(nr_threads, sizeof(*workers));
+	if (!workers)
+		return 1;
+
+	uloop_init();
+
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].ctx = uloop_ctx_new();
+		workers[i].nr_pairs = nr_pairs;
+		workers[i].done.cb = worker_done_cb;
+		if (!workers[i].ctx ||
+		    pthread_create(&workers[i].thread, NULL, worker_run,
+				   &workers[i]) != 0) {
+			fprintf(stderr, "failed to start worker %d\n", i);
+			return 1;
+		}
+		nr_workers++;
+		nr_running++;
+	}
+
+	uloop_timeout_set(&end, seconds * 1000);
+	uloop_run();
+
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		uloop_ctx_free(workers[i].ctx);
+	}
+
+	printf("%d threads x %d pairs: %10.0f round trips/s\n", nr_threads,
+	       nr_pairs, (double)total_round_trips / seconds);
+
+	uloop_done();
+	free(workers);
+
+	return 0;
+}
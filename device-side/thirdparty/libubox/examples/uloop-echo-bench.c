@@ -0,0 +1,158 @@
+/*
+ * uloop-echo-bench.c - uloop fd dispatch benchmark
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Connects pairs of ustream-fd sockets over AF_UNIX socketpairs; the
+ * client of each pair sends a small message, the server echoes it, and
+ * the client sends the next one when the echo is back. Reports the
+ * round trips and the fd events per second for each dispatch mode.
+ *
+ * usage: uloop-echo-bench [pairs] [seconds] [one|edge|all]
+ */
+
+#include <sys/socket.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "uloop.h"
+#include "ustream.h"
+#include "utils.h"
+
+#define MSG_LEN 32
+
+struct echo_pair {
+	struct ustream_fd client;
+	struct ustream_fd server;
+	int received;
+};
+
+static const char msg[MSG_LEN] = "0123456789abcdef0123456789abcde";
+static unsigned long round_trips, reads;
+
+static void server_read_cb(struct ustream *s, int bytes)
+{
+	char *data;
+	int len;
+
+	reads++;
+	while ((data = ustream_get_read_buf(s, &len)) != NULL) {
+		ustream_write(s, data, len, false);
+		ustream_consume(s, len);
+	}
+}
+
+static void client_read_cb(struct ustream *s, int bytes)
+{
+	struct echo_pair *p = container_of(s, struct echo_pair, client.stream);
+	int len;
+
+	reads++;
+	while (ustream_get_read_buf(s, &len) != NULL) {
+		ustream_consume(s, len);
+		p->received += len;
+	}
+
+	while (p->received >= MSG_LEN) {
+		p->received -= MSG_LEN;
+		round_trips++;
+		ustream_write(s, msg, MSG_LEN, false);
+	}
+}
+
+static void end_cb(struct uloop_timeout *t)
+{
+	uloop_end();
+}
+
+static int run(const char *name, enum uloop_dispatch_mode mode,
+	       int nr_pairs, int seconds)
+{
+	struct uloop_timeout end = { .cb = end_cb };
+	struct echo_pair *pairs;
+	int i;
+
+	pairs = calloc(nr_pairs, sizeof(*pairs));
+	if (!pairs)
+		return -1;
+
+	uloop_init();
+	uloop_set_dispatch(mode, 0);
+
+	for (i = 0; i < nr_pairs; i++) {
+		int fds[2];
+
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+			perror("socketpair");
+			return -1;
+		}
+
+		pairs[i].client.stream.notify_read = client_read_cb;
+		pairs[i].server.stream.notify_read = server_read_cb;
+		ustream_fd_init(&pairs[i].client, fds[0]);
+		ustream_fd_init(&pairs[i].server, fds[1]);
+		ustream_write(&pairs[i].client.stream, msg, MSG_LEN, false);
+	}
+
+	round_trips = reads = 0;
+	uloop_timeout_set(&end, seconds * 1000);
+	uloop_run();
+
+	printf("%-4s %5d pairs: %10.0f round trips/s %10.0f fd events/s\n",
+	       name, nr_pairs, (double)round_trips / seconds,
+	       (double)reads / seconds);
+
+	for (i = 0; i < nr_pairs; i++) {
+		ustream_free(&pairs[i].client.stream);
+		ustream_free(&pairs[i].server.stream);
+		close(pairs[i].client.fd.fd);
+		close(pairs[i].server.fd.fd);
+	}
+	uloop_done();
+	free(pairs);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct {
+		const char *name;
+		enum uloop_dispatch_mode mode;
+	} modes[] = {
+		{ "one", ULOOP_DISPATCH_ONE },
+		{ "edge", ULOOP_DISPATCH_EDGE },
+		{ "all", ULOOP_DISPATCH_ALL },
+	};
+	int nr_pairs = argc > 1 ? atoi(argv[1]) : 256;
+	int seconds = argc > 2 ? atoi(argv[2]) : 3;
+	int i;
+
+	if (nr_pairs <= 0 || seconds <= 0)
+		return 1;
+
+	for (i = 0; i < ARRAY_SIZE(modes); i++) {
+		if (argc > 3 && strcmp(argv[3], modes[i].name) != 0)
+			continue;
+
+		if (run(modes[i].name, modes[i].mode, nr_pairs, seconds) < 0)
+			return 1;
+	}
+
+	return 0;
+}
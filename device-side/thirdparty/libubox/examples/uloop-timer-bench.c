@@ -0,0 +1,107 @@
+/*
+ * uloop-timer-bench.c - uloop timeout microbenchmark
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Keeps a number of long timeouts pending (100000 by default) and
+ * measures arming them, re-arming random ones as netifd does with its
+ * lifetime and retry timers, and cancelling them. A few short timeouts
+ * are then run through uloop to check that they fire in order.
+ *
+ * usage: uloop-timer-bench [timers] [re-arms]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "uloop.h"
+#include "utils.h"
+
+static struct uloop_timeout *timers;
+static int fired, nr_short, out_of_order;
+static int64_t last_expires;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void timer_cb(struct uloop_timeout *t)
+{
+	if (t->expires < last_expires)
+		out_of_order++;
+
+	last_expires = t->expires;
+	if (++fired == nr_short)
+		uloop_end();
+}
+
+int main(int argc, char **argv)
+{
+	int nr_timers = argc > 1 ? atoi(argv[1]) : 100000;
+	int nr_rearms = argc > 2 ? atoi(argv[2]) : 1000000;
+	double start;
+	int i;
+
+	timers = calloc(nr_timers, sizeof(*timers));
+	if (!timers)
+		return 1;
+
+	uloop_init();
+	srand(1);
+
+	start = now_sec();
+	for (i = 0; i < nr_timers; i++) {
+		timers[i].cb = timer_cb;
+		uloop_timeout_set(&timers[i], 60000 + rand() % 3600000);
+	}
+	printf("arm %d timers:\t%8.1f ns/op\n", nr_timers,
+	       (now_sec() - start) * 1e9 / nr_timers);
+
+	start = now_sec();
+	for (i = 0; i < nr_rearms; i++)
+		uloop_timeout_set(&timers[rand() % nr_timers],
+				  60000 + rand() % 3600000);
+	printf("re-arm %d times:\t%8.1f ns/op\n", nr_rearms,
+	       (now_sec() - start) * 1e9 / nr_rearms);
+
+	start = now_sec();
+	for (i = 0; i < nr_rearms; i++)
+		uloop_timeout_remaining(&timers[rand() % nr_timers]);
+	printf("remaining:\t\t%8.1f ns/op\n",
+	       (now_sec() - start) * 1e9 / nr_rearms);
+
+	start = now_sec();
+	for (i = 0; i < nr_timers; i++)
+		uloop_timeout_cancel(&timers[i]);
+	printf("cancel:\t\t\t%8.1f ns/op\n",
+	       (now_sec() - start) * 1e9 / nr_timers);
+
+	nr_short = nr_timers < 1000 ? nr_timers : 1000;
+	for (i = 0; i < nr_short; i++)
+		uloop_timeout_set(&timers[i], rand() % 50);
+
+	uloop_run();
+	printf("fired %d short timeouts, %d out of order\n", fired, out_of_order);
+
+	uloop_done();
+	free(timers);
+
+	return out_of_order ? 1 : 0;
+}
@@ -16,10 +16,40 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
 #include "runqueue.h"
 
+/* the worker threads, shared by all runqueues and loops */
+struct runqueue_pool {
+	pthread_mutex_t lock;
+	/* signalled when a task is queued or the pool is stopped */
+	pthread_cond_t work;
+	/* signalled when a worker has returned from run() */
+	pthread_cond_t idle;
+
+	struct runqueue_thread *head[__RUNQUEUE_PRIO_MAX];
+	struct runqueue_thread **tail[__RUNQUEUE_PRIO_MAX];
+	int queued;
+
+	pthread_t *threads;
+	int nr_threads;
+	int nr_idle;
+	int max_threads;
+	bool stopping;
+};
+
+static struct runqueue_pool pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.idle = PTHREAD_COND_INITIALIZER,
+};
+
 static void
 __runqueue_empty_cb(struct uloop_timeout *timeout)
 {
@@ -280,3 +310,250 @@ void runqueue_process_add(struct runqueue *q, struct runqueue_process *p, pid_t
 	if (!p->task.running)
 		runqueue_task_add(q, &p->task, true);
 }
+
+static int64_t runqueue_thread_cpu_time(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+		return 0;
+
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/* called with the pool lock held */
+static struct runqueue_thread *runqueue_pool_next(void)
+{
+	struct runqueue_thread *t;
+	int i;
+
+	for (i = 0; i < __RUNQUEUE_PRIO_MAX; i++) {
+		t = pool.head[i];
+		if (!t)
+			continue;
+
+		pool.head[i] = t->next;
+		if (!t->next)
+			pool.tail[i] = &pool.head[i];
+		pool.queued--;
+		return t;
+	}
+
+	return NULL;
+}
+
+/* called with the pool lock held */
+static bool runqueue_pool_unlink(struct runqueue_thread *t)
+{
+	struct runqueue_thread **cur;
+	int prio = t->prio;
+
+	for (cur = &pool.head[prio]; *cur; cur = &(*cur)->next) {
+		if (*cur != t)
+			continue;
+
+		*cur = t->next;
+		if (!t->next)
+			pool.tail[prio] = cur;
+		pool.queued--;
+		return true;
+	}
+
+	return false;
+}
+
+static void *runqueue_pool_worker(void *arg)
+{
+	struct runqueue_thread *t;
+	unsigned int gen;
+	int64_t start;
+
+	pthread_mutex_lock(&pool.lock);
+	while (1) {
+		t = runqueue_pool_next();
+		if (!t) {
+			if (pool.stopping)
+				break;
+
+			pool.nr_idle++;
+			pthread_cond_wait(&pool.work, &pool.lock);
+			pool.nr_idle--;
+			continue;
+		}
+
+		t->started = true;
+		gen = t->gen;
+		pthread_mutex_unlock(&pool.lock);
+
+		start = runqueue_thread_cpu_time();
+		t->run(t);
+		t->cpu_time = runqueue_thread_cpu_time() - start;
+
+		pthread_mutex_lock(&pool.lock);
+		t->started = false;
+		if (t->gen != gen) {
+			/* killed, runqueue_thread_kill_cb is waiting */
+			pthread_cond_broadcast(&pool.idle);
+		} else {
+			t->done_gen = gen;
+			uloop_ctx_call(t->ctx, &t->done);
+		}
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return NULL;
+}
+
+/* called with the pool lock held */
+static void runqueue_pool_start_worker(void)
+{
+	pthread_t *threads;
+
+	if (!pool.max_threads) {
+		pool.max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+		if (pool.max_threads < 1)
+			pool.max_threads = 1;
+	}
+
+	if (pool.nr_threads >= pool.max_threads || pool.queued <= pool.nr_idle)
+		return;
+
+	threads = realloc(pool.threads, (pool.nr_threads + 1) * sizeof(*threads));
+	if (!threads)
+		return;
+
+	pool.threads = threads;
+	if (pthread_create(&threads[pool.nr_threads], NULL,
+			   runqueue_pool_worker, NULL) == 0)
+		pool.nr_threads++;
+}
+
+static void runqueue_thread_done_cb(struct uloop_call *c)
+{
+	struct runqueue_thread *t = container_of(c, struct runqueue_thread, done);
+
+	/* posted for a run that has been killed since */
+	if (t->done_gen != t->gen)
+		return;
+
+	runqueue_task_complete(&t->task);
+}
+
+void runqueue_thread_run_cb(struct runqueue *q, struct runqueue_task *t)
+{
+	struct runqueue_thread *th = container_of(t, struct runqueue_thread, task);
+	int prio = th->prio;
+	int64_t start;
+
+	if (prio < 0 || prio >= __RUNQUEUE_PRIO_MAX)
+		prio = th->prio = RUNQUEUE_PRIO_NORMAL;
+
+	th->ctx = uloop_ctx_current();
+	th->done.cb = runqueue_thread_done_cb;
+	th->next = NULL;
+	th->cpu_time = 0;
+	th->started = false;
+	th->gen++;
+	__atomic_store_n(&th->cancelled, false, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock(&pool.lock);
+	if (!pool.tail[prio])
+		pool.tail[prio] = &pool.head[prio];
+	*pool.tail[prio] = th;
+	pool.tail[prio] = &th->next;
+	pool.queued++;
+
+	runqueue_pool_start_worker();
+	if (!pool.nr_threads) {
+		/* no worker could be started, run it here */
+		runqueue_pool_unlink(th);
+		pthread_mutex_unlock(&pool.lock);
+
+		start = runqueue_thread_cpu_time();
+		th->run(th);
+		th->cpu_time = runqueue_thread_cpu_time() - start;
+		th->done_gen = th->gen;
+		uloop_ctx_call(th->ctx, &th->done);
+		return;
+	}
+	pthread_cond_signal(&pool.work);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+bool runqueue_thread_cancelled(struct runqueue_thread *t)
+{
+	return __atomic_load_n(&t->cancelled, __ATOMIC_RELAXED);
+}
+
+void runqueue_thread_cancel_cb(struct runqueue *q, struct runqueue_task *t, int type)
+{
+	struct runqueue_thread *th = container_of(t, struct runqueue_thread, task);
+	bool waiting;
+
+	__atomic_store_n(&th->cancelled, true, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock(&pool.lock);
+	waiting = runqueue_pool_unlink(th);
+	pthread_mutex_unlock(&pool.lock);
+
+	/* otherwise it completes when run() returns */
+	if (waiting)
+		runqueue_task_complete(t);
+}
+
+void runqueue_thread_kill_cb(struct runqueue *q, struct runqueue_task *t)
+{
+	struct runqueue_thread *th = container_of(t, struct runqueue_thread, task);
+
+	__atomic_store_n(&th->cancelled, true, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock(&pool.lock);
+	th->gen++;
+	if (!runqueue_pool_unlink(th)) {
+		while (th->started)
+			pthread_cond_wait(&pool.idle, &pool.lock);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	/* run() may have returned and queued its completion already */
+	uloop_ctx_call_cancel(th->ctx, &th->done);
+}
+
+static const struct runqueue_task_type runqueue_thread_type = {
+	.name = "thread",
+	.run = runqueue_thread_run_cb,
+	.cancel = runqueue_thread_cancel_cb,
+	.kill = runqueue_thread_kill_cb,
+};
+
+void runqueue_thread_add(struct runqueue *q, struct runqueue_thread *t)
+{
+	if (!t->task.type)
+		t->task.type = &runqueue_thread_type;
+	runqueue_task_add(q, &t->task, false);
+}
+
+void runqueue_thread_pool_size(int max_threads)
+{
+	pthread_mutex_lock(&pool.lock);
+	pool.max_threads = max_threads;
+	pthread_mutex_unlock(&pool.lock);
+}
+
+void runqueue_thread_pool_done(void)
+{
+	int i;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.stopping = true;
+	pthread_cond_broadcast(&pool.work);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (i = 0; i < pool.nr_threads; i++)
+		pthread_join(pool.threads[i], NULL);
+
+	free(pool.threads);
+	pool.threads = NULL;
+	pool.nr_threads = 0;
+	pool.stopping = false;
+}
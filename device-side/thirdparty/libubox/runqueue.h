@@ -90,6 +90,46 @@ struct runqueue_process {
 	struct uloop_process proc;
 };
 
+enum runqueue_thread_prio {
+	RUNQUEUE_PRIO_HIGH,
+	RUNQUEUE_PRIO_NORMAL,
+	RUNQUEUE_PRIO_LOW,
+	__RUNQUEUE_PRIO_MAX
+};
+
+/*
+ * runqueue_thread: a task that runs a function on a worker thread
+ *
+ * The workers are shared by all runqueues; a worker takes the waiting
+ * task of the highest priority first. The task completes in the loop it
+ * was started from once run() has returned.
+ *
+ * run() cannot be interrupted. Cancelling the task only sets a flag that
+ * run() can check with runqueue_thread_cancelled. Killing it waits for
+ * run() to return and drops a completion that is already queued, so the
+ * task can be freed or added again once runqueue_task_kill returns.
+ * Tasks must be killed from the loop they were started from.
+ */
+struct runqueue_thread {
+	struct runqueue_task task;
+
+	/* called on a worker thread, must not use uloop or the runqueue */
+	void (*run)(struct runqueue_thread *t);
+	enum runqueue_thread_prio prio;
+
+	/* CPU time spent in run() in microseconds, set on completion */
+	int64_t cpu_time;
+
+	struct runqueue_thread *next;
+	struct uloop_ctx *ctx;
+	struct uloop_call done;
+	/* bumped for each run and on kill, tells stale completions apart */
+	unsigned int gen;
+	unsigned int done_gen;
+	bool started;
+	bool cancelled;
+};
+
 #define RUNQUEUE_INIT(_name, _max_running) { \
 		.tasks_active = SAFE_LIST_INIT(_name.tasks_active), \
 		.tasks_inactive = SAFE_LIST_INIT(_name.tasks_inactive), \
@@ -121,4 +161,23 @@ void runqueue_process_add(struct runqueue *q, struct runqueue_process *p, pid_t
 void runqueue_process_cancel_cb(struct runqueue *q, struct runqueue_task *t, int type);
 void runqueue_process_kill_cb(struct runqueue *q, struct runqueue_task *t);
 
+void runqueue_thread_add(struct runqueue *q, struct runqueue_thread *t);
+bool runqueue_thread_cancelled(struct runqueue_thread *t);
+
+/* to be used only from runqueue_thread callbacks */
+void runqueue_thread_run_cb(struct runqueue *q, struct runqueue_task *t);
+void runqueue_thread_cancel_cb(struct runqueue *q, struct runqueue_task *t, int type);
+void runqueue_thread_kill_cb(struct runqueue *q, struct runqueue_task *t);
+
+/*
+ * runqueue_thread_pool_size: limit the number of worker threads
+ *
+ * 0 selects the number of online CPUs, the default. Workers are started
+ * when tasks are waiting for them and stay around until
+ * runqueue_thread_pool_done.
+ */
+void runqueue_thread_pool_size(int max_threads);
+/* stop the workers; no thread task may be queued */
+void runqueue_thread_pool_done(void);
+
 #endif
@@ -23,24 +23,47 @@
 #define EPOLLRDHUP 0x2000
 #endif
 
-static int uloop_init_pollfd(void)
+static int uloop_init_pollfd(struct uloop_ctx *ctx)
 {
-	if (poll_fd >= 0)
+	if (ctx->poll_fd >= 0)
 		return 0;
 
-	poll_fd = epoll_create(32);
-	if (poll_fd < 0)
+#ifdef USE_IO_URING
+	if (ctx->uring || uring_init(ctx) == 0)
+		return 0;
+#endif
+
+	ctx->poll_fd = epoll_create(32);
+	if (ctx->poll_fd < 0)
 		return -1;
 
-	fcntl(poll_fd, F_SETFD, fcntl(poll_fd, F_GETFD) | FD_CLOEXEC);
+	fcntl(ctx->poll_fd, F_SETFD, fcntl(ctx->poll_fd, F_GETFD) | FD_CLOEXEC);
 	return 0;
 }
 
-static int register_poll(struct uloop_fd *fd, unsigned int flags)
+static void uloop_done_pollfd(struct uloop_ctx *ctx)
+{
+#ifdef USE_IO_URING
+	uring_done(ctx);
+#endif
+
+	if (ctx->poll_fd >= 0) {
+		close(ctx->poll_fd);
+		ctx->poll_fd = -1;
+	}
+}
+
+static int register_poll(struct uloop_ctx *ctx, struct uloop_fd *fd,
+			 unsigned int flags)
 {
 	struct epoll_event ev;
 	int op = fd->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
 
+#ifdef USE_IO_URING
+	if (ctx->uring)
+		return uring_register_poll(ctx->uring, fd, flags);
+#endif
+
 	memset(&ev, 0, sizeof(struct epoll_event));
 
 	if (flags & ULOOP_READ)
@@ -55,24 +78,33 @@ static int register_poll(struct uloop_fd *fd, unsigned int flags)
 	ev.data.ptr = fd;
 	fd->flags = flags;
 
-	return epoll_ctl(poll_fd, op, fd->fd, &ev);
+	return epoll_ctl(ctx->poll_fd, op, fd->fd, &ev);
 }
 
-static struct epoll_event events[ULOOP_MAX_EVENTS];
-
-static int __uloop_fd_delete(struct uloop_fd *sock)
+static int __uloop_fd_delete(struct uloop_ctx *ctx, struct uloop_fd *sock)
 {
+#ifdef USE_IO_URING
+	if (ctx->uring)
+		return uring_delete_poll(ctx->uring, sock);
+#endif
+
 	sock->flags = 0;
-	return epoll_ctl(poll_fd, EPOLL_CTL_DEL, sock->fd, 0);
+	return epoll_ctl(ctx->poll_fd, EPOLL_CTL_DEL, sock->fd, 0);
 }
 
-static int uloop_fetch_events(int timeout)
+static int uloop_fetch_events(struct uloop_ctx *ctx, int timeout)
 {
+	struct epoll_event *events = ctx->events;
 	int n, nfds;
 
-	nfds = epoll_wait(poll_fd, events, ARRAY_SIZE(events), timeout);
+#ifdef USE_IO_URING
+	if (ctx->uring)
+		return uring_fetch_events(ctx, timeout);
+#endif
+
+	nfds = epoll_wait(ctx->poll_fd, events, ctx->poll_max_events, timeout);
 	for (n = 0; n < nfds; ++n) {
-		struct uloop_fd_event *cur = &cur_fds[n];
+		struct uloop_fd_event *cur = &ctx->cur_fds[n];
 		struct uloop_fd *u = events[n].data.ptr;
 		unsigned int ev = 0;
 
@@ -0,0 +1,810 @@
+/*
+ * uloop - event loop implementation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * io_uring backend, used instead of epoll when the kernel supports it
+ * (5.17 or later); set ULOOP_BACKEND=epoll in the environment to keep
+ * using epoll.
+ *
+ * Every fd has a poll request in the ring: a multishot one for
+ * edge-triggered fds, which keeps posting completions as the fd gets
+ * ready, and a oneshot one for level-triggered fds, which is armed again
+ * after the callback has run, so that it completes at once if the fd is
+ * still ready. Adding, changing and deleting fds only queues requests;
+ * they are submitted by the same io_uring_enter() that waits for the
+ * completions, so a loop iteration costs one syscall where epoll needs
+ * one epoll_ctl() per change as well as epoll_wait().
+ *
+ * The requests are tagged with the fd number and a sequence number of
+ * the fd, so that the completions of a deleted or changed fd, which may
+ * still be in the ring, are dropped.
+ *
+ * The reads and writes of struct uloop_io are tagged with the address of
+ * the request and the top bit, which no poll tag has. Their callbacks
+ * run after the completions have been reaped, so that they can queue new
+ * requests. The read buffers of a group go into a ring registered with
+ * the kernel (5.19 or later), so that giving one back is a store to the
+ * ring rather than a request; older kernels take them with requests.
+ */
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <endian.h>
+
+#define ULOOP_URING_ENTRIES	256
+#define ULOOP_URING_INTERNAL	UINT64_MAX
+#define ULOOP_URING_IO		(1ULL << 63)
+/* the sequence numbers of the poll tags stay clear of ULOOP_URING_IO */
+#define ULOOP_URING_SEQ_MASK	0x7fffffff
+#define ULOOP_URING_IO_BATCH	64
+/* how long uloop_done() waits for cancelled requests, in msecs */
+#define ULOOP_URING_DRAIN_TIME	1000
+#define ULOOP_URING_BUF_ENTRIES	1024
+
+struct uloop_uring_slot {
+	struct uloop_fd *fd;
+	uint32_t seq;
+	uint32_t events;
+	unsigned int batch_id;
+	int batch_pos;
+	int next_dirty;
+	bool armed;
+	bool dirty;
+	bool multishot;
+};
+
+struct uloop_uring {
+	int fd;
+
+	/* the SQ and CQ rings share one mapping */
+	void *ring;
+	size_t ring_size;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+
+	unsigned int *sq_head, *sq_tail, *sq_array;
+	unsigned int *cq_head, *cq_tail;
+	unsigned int sq_mask, cq_mask, sq_entries;
+	unsigned int to_submit;
+
+	struct uloop_uring_slot *slots;
+	int nr_slots;
+	int dirty;
+	unsigned int batch_id;
+
+	/* the pending struct uloop_io requests */
+	struct list_head ios;
+
+	struct uloop_uring_bufs *bufs;
+	bool no_buf_ring;
+
+	unsigned int id;
+};
+
+struct uloop_uring_bufs {
+	struct uloop_uring_bufs *next;
+	struct io_uring_buf_ring *ring;
+	unsigned int group;
+	unsigned short tail;
+	/* the buffers in the ring that no read has picked yet */
+	unsigned int avail;
+};
+
+struct uloop_uring_io_done {
+	struct uloop_io *io;
+	int res;
+	int buf_id;
+};
+
+static int uring_enter(struct uloop_uring *u, unsigned int to_submit,
+		       unsigned int min_complete, unsigned int flags,
+		       void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, u->fd, to_submit, min_complete,
+		       flags, arg, argsz);
+}
+
+static void uring_submit(struct uloop_uring *u)
+{
+	int ret;
+
+	while (u->to_submit) {
+		ret = uring_enter(u, u->to_submit, 0, 0, NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		u->to_submit -= ret;
+	}
+}
+
+static struct io_uring_sqe *uring_get_sqe(struct uloop_uring *u)
+{
+	unsigned int tail = *u->sq_tail;
+	struct io_uring_sqe *sqe;
+
+	if (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >=
+	    u->sq_entries) {
+		uring_submit(u);
+		if (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >=
+		    u->sq_entries)
+			return NULL;
+	}
+
+	sqe = &u->sqes[tail & u->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	u->sq_array[tail & u->sq_mask] = tail & u->sq_mask;
+	__atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	u->to_submit++;
+
+	return sqe;
+}
+
+static uint64_t uring_tag(int fd, struct uloop_uring_slot *slot)
+{
+	return ((uint64_t)slot->seq << 32) | (uint32_t)fd;
+}
+
+static struct uloop_uring_slot *uring_slot(struct uloop_uring *u, int fd,
+					   bool create)
+{
+	struct uloop_uring_slot *slots;
+	int i, nr = u->nr_slots;
+
+	if (fd < 0)
+		return NULL;
+
+	if (fd < u->nr_slots)
+		return &u->slots[fd];
+
+	if (!create)
+		return NULL;
+
+	while (nr <= fd)
+		nr = nr ? nr * 2 : 64;
+
+	slots = realloc(u->slots, nr * sizeof(*slots));
+	if (!slots)
+		return NULL;
+
+	for (i = u->nr_slots; i < nr; i++) {
+		memset(&slots[i], 0, sizeof(slots[i]));
+		slots[i].seq = 1;
+		slots[i].next_dirty = -1;
+	}
+
+	u->slots = slots;
+	u->nr_slots = nr;
+
+	return &u->slots[fd];
+}
+
+static void uring_mark_dirty(struct uloop_uring *u, int fd,
+			     struct uloop_uring_slot *slot)
+{
+	if (slot->dirty)
+		return;
+
+	slot->dirty = true;
+	slot->next_dirty = u->dirty;
+	u->dirty = fd;
+}
+
+/* drops the poll request of the slot; its late completions are ignored */
+static void uring_cancel(struct uloop_uring *u, struct uloop_uring_slot *slot,
+			 int fd)
+{
+	struct io_uring_sqe *sqe;
+
+	if (slot->armed) {
+		sqe = uring_get_sqe(u);
+		if (sqe) {
+			sqe->opcode = IORING_OP_POLL_REMOVE;
+			sqe->fd = -1;
+			sqe->addr = uring_tag(fd, slot);
+			sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+			sqe->user_data = ULOOP_URING_INTERNAL;
+		}
+		slot->armed = false;
+	}
+
+	slot->seq = (slot->seq + 1) & ULOOP_URING_SEQ_MASK;
+	if (!slot->seq)
+		slot->seq = 1;
+}
+
+static void uring_arm(struct uloop_uring *u, int fd,
+		      struct uloop_uring_slot *slot)
+{
+	struct io_uring_sqe *sqe;
+	uint32_t events = slot->events;
+
+	sqe = uring_get_sqe(u);
+	if (!sqe) {
+		/* try again on the next iteration */
+		uring_mark_dirty(u, fd, slot);
+		return;
+	}
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+	events = (events << 16) | (events >> 16);
+#endif
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = events;
+	if (slot->multishot)
+		sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = uring_tag(fd, slot);
+	slot->armed = true;
+}
+
+static void uring_flush_dirty(struct uloop_uring *u)
+{
+	struct uloop_uring_slot *slot;
+	int fd = u->dirty;
+
+	u->dirty = -1;
+	while (fd >= 0) {
+		slot = &u->slots[fd];
+		fd = slot->next_dirty;
+
+		slot->dirty = false;
+		slot->next_dirty = -1;
+		if (slot->fd && !slot->armed)
+			uring_arm(u, slot - u->slots, slot);
+	}
+}
+
+static int uring_register_poll(struct uloop_uring *u, struct uloop_fd *fd,
+			       unsigned int flags)
+{
+	struct uloop_uring_slot *slot = uring_slot(u, fd->fd, true);
+	uint32_t events = 0;
+
+	if (!slot) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (flags & ULOOP_READ)
+		events |= EPOLLIN | EPOLLRDHUP;
+
+	if (flags & ULOOP_WRITE)
+		events |= EPOLLOUT;
+
+	/*
+	 * re-arm as EPOLL_CTL_MOD does, so that a ready fd is reported; an
+	 * fd number still held by another uloop_fd was closed without
+	 * deleting it, which epoll does not notice either
+	 */
+	uring_cancel(u, slot, fd->fd);
+	slot->fd = fd;
+	slot->events = events;
+	slot->multishot = !!(flags & ULOOP_EDGE_TRIGGER);
+	uring_mark_dirty(u, fd->fd, slot);
+
+	fd->flags = flags;
+	return 0;
+}
+
+static int uring_delete_poll(struct uloop_uring *u, struct uloop_fd *sock)
+{
+	struct uloop_uring_slot *slot = uring_slot(u, sock->fd, false);
+
+	sock->flags = 0;
+	if (!slot || slot->fd != sock)
+		return -1;
+
+	uring_cancel(u, slot, sock->fd);
+	slot->fd = NULL;
+
+	return 0;
+}
+
+static uint64_t uring_io_tag(struct uloop_io *io)
+{
+	return ULOOP_URING_IO | (uintptr_t)io;
+}
+
+static struct io_uring_sqe *uring_io_sqe(struct uloop_uring *u,
+					 struct uloop_io *io, int opcode,
+					 int fd)
+{
+	struct io_uring_sqe *sqe;
+
+	if (io->pending) {
+		errno = EBUSY;
+		return NULL;
+	}
+
+	sqe = uring_get_sqe(u);
+	if (!sqe) {
+		errno = EAGAIN;
+		return NULL;
+	}
+
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	/* the current position, which is all that streams have */
+	sqe->off = -1ULL;
+	sqe->user_data = uring_io_tag(io);
+
+	io->pending = true;
+	list_add_tail(&io->list, &u->ios);
+
+	return sqe;
+}
+
+static int uring_io_read(struct uloop_uring *u, struct uloop_io *io, int fd,
+			 unsigned int buf_group, int len, bool recv)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_io_sqe(u, io, recv ? IORING_OP_RECV : IORING_OP_READ, fd);
+	if (!sqe)
+		return -1;
+
+	/*
+	 * a read is tried once when it is submitted, before the kernel waits
+	 * for the fd; a receive can skip that, where the kernel takes buffer
+	 * rings (both came with 5.19)
+	 */
+	if (recv) {
+		sqe->off = 0;
+		if (!u->no_buf_ring && u->bufs)
+			sqe->ioprio = IORING_RECVSEND_POLL_FIRST;
+	}
+
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = buf_group;
+	sqe->len = len;
+	io->buf_group = buf_group;
+
+	return 0;
+}
+
+static int uring_io_writev(struct uloop_uring *u, struct uloop_io *io, int fd,
+			   const struct iovec *iov, int iovcnt)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_io_sqe(u, io, IORING_OP_WRITEV, fd);
+	if (!sqe)
+		return -1;
+
+	sqe->addr = (uintptr_t)iov;
+	sqe->len = iovcnt;
+
+	return 0;
+}
+
+static int uring_io_cancel(struct uloop_uring *u, struct uloop_io *io)
+{
+	struct io_uring_sqe *sqe;
+
+	if (!io->pending)
+		return -1;
+
+	sqe = uring_get_sqe(u);
+	if (!sqe) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = uring_io_tag(io);
+	sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+	sqe->user_data = ULOOP_URING_INTERNAL;
+
+	return 0;
+}
+
+static int uring_buf_ring_register(struct uloop_uring *u, int opcode,
+				   struct uloop_uring_bufs *b)
+{
+	struct io_uring_buf_reg reg = {
+		.ring_addr = (uintptr_t)b->ring,
+		.ring_entries = ULOOP_URING_BUF_ENTRIES,
+		.bgid = b->group,
+	};
+
+	return syscall(__NR_io_uring_register, u->fd, opcode, &reg, 1);
+}
+
+static struct uloop_uring_bufs *uring_buf_ring(struct uloop_uring *u,
+					       unsigned int buf_group,
+					       bool create)
+{
+	struct uloop_uring_bufs *b;
+
+	for (b = u->bufs; b; b = b->next)
+		if (b->group == buf_group)
+			return b;
+
+	if (!create || u->no_buf_ring)
+		return NULL;
+
+	b = calloc(1, sizeof(*b));
+	if (!b)
+		return NULL;
+
+	b->group = buf_group;
+	b->ring = mmap(NULL, ULOOP_URING_BUF_ENTRIES * sizeof(struct io_uring_buf),
+		       PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (b->ring == MAP_FAILED)
+		goto free;
+
+	if (uring_buf_ring_register(u, IORING_REGISTER_PBUF_RING, b) < 0) {
+		if (errno == EINVAL)
+			u->no_buf_ring = true;
+		goto unmap;
+	}
+
+	b->next = u->bufs;
+	u->bufs = b;
+
+	return b;
+
+unmap:
+	munmap(b->ring, ULOOP_URING_BUF_ENTRIES * sizeof(struct io_uring_buf));
+free:
+	free(b);
+	return NULL;
+}
+
+static void uring_buf_ring_free(struct uloop_uring *u,
+				struct uloop_uring_bufs *b)
+{
+	struct uloop_uring_bufs **prev;
+
+	for (prev = &u->bufs; *prev != b; prev = &(*prev)->next)
+		;
+	*prev = b->next;
+
+	uring_buf_ring_register(u, IORING_UNREGISTER_PBUF_RING, b);
+	munmap(b->ring, ULOOP_URING_BUF_ENTRIES * sizeof(struct io_uring_buf));
+	free(b);
+}
+
+static int uring_buf_ring_add(struct uloop_uring_bufs *b, void *buf, int len,
+			      int buf_id)
+{
+	struct io_uring_buf *entry;
+
+	if (b->avail >= ULOOP_URING_BUF_ENTRIES) {
+		errno = ENOSPC;
+		return -1;
+	}
+
+	entry = &b->ring->bufs[b->tail & (ULOOP_URING_BUF_ENTRIES - 1)];
+	entry->addr = (uintptr_t)buf;
+	entry->len = len;
+	entry->bid = buf_id;
+	b->avail++;
+	__atomic_store_n(&b->ring->tail, ++b->tail, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static int uring_io_buffers(struct uloop_uring *u, int opcode,
+			    unsigned int buf_group, void *buf, int len,
+			    int nr, int buf_id)
+{
+	struct io_uring_sqe *sqe;
+	struct uloop_uring_bufs *b;
+
+	b = uring_buf_ring(u, buf_group, opcode == IORING_OP_PROVIDE_BUFFERS);
+	if (b && opcode == IORING_OP_PROVIDE_BUFFERS)
+		return uring_buf_ring_add(b, buf, len, buf_id);
+
+	/* the unused buffers of a ring all go back at once */
+	if (b) {
+		uring_buf_ring_free(u, b);
+		return 0;
+	}
+
+	sqe = uring_get_sqe(u);
+	if (!sqe) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	sqe->opcode = opcode;
+	sqe->fd = nr;
+	sqe->addr = (uintptr_t)buf;
+	sqe->len = len;
+	sqe->off = buf_id;
+	sqe->buf_group = buf_group;
+	sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+	sqe->user_data = ULOOP_URING_INTERNAL;
+
+	return 0;
+}
+
+static void uring_io_complete(struct uloop_uring_io_done *done, int n)
+{
+	struct uloop_io *io;
+	int i;
+
+	/*
+	 * each request stays pending until its own callback runs, which may
+	 * free or queue it again, so that an earlier callback can tell that
+	 * it is still in use
+	 */
+	for (i = 0; i < n; i++) {
+		io = done[i].io;
+		list_del(&io->list);
+		io->pending = false;
+		io->cb(io, done[i].res, done[i].buf_id);
+	}
+}
+
+static void uring_io_reap(struct uloop_uring *u, struct io_uring_cqe *cqe,
+			  struct uloop_uring_io_done *done)
+{
+	struct uloop_uring_bufs *b;
+
+	done->io = (struct uloop_io *)(uintptr_t)(cqe->user_data &
+						  ~ULOOP_URING_IO);
+	done->res = cqe->res;
+	done->buf_id = -1;
+	if (!(cqe->flags & IORING_CQE_F_BUFFER))
+		return;
+
+	done->buf_id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+	b = uring_buf_ring(u, done->io->buf_group, false);
+	if (b)
+		b->avail--;
+}
+
+static int uring_fetch_events(struct uloop_ctx *ctx, int timeout)
+{
+	struct uloop_uring *u = ctx->uring;
+	struct io_uring_getevents_arg arg = {};
+	struct __kernel_timespec ts;
+	struct uloop_uring_io_done done[ULOOP_URING_IO_BATCH];
+	unsigned int head, tail, flags = IORING_ENTER_GETEVENTS;
+	int ret, nfds = 0, nio = 0;
+
+	uring_flush_dirty(u);
+
+	if (timeout >= 0) {
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
+		arg.ts = (uint64_t)(uintptr_t)&ts;
+		flags |= IORING_ENTER_EXT_ARG;
+	}
+
+	head = *u->cq_head;
+	if (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+		ret = uring_enter(u, u->to_submit, timeout ? 1 : 0, flags,
+				  timeout >= 0 ? &arg : NULL,
+				  timeout >= 0 ? sizeof(arg) : 0);
+		if (ret < 0 && errno != ETIME && errno != EINTR &&
+		    errno != EBUSY)
+			return -1;
+		if (ret > 0)
+			u->to_submit -= ret;
+	} else if (u->to_submit) {
+		uring_submit(u);
+	}
+
+	u->batch_id++;
+	tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+	while (head != tail && nfds < ctx->poll_max_events &&
+	       nio < ULOOP_URING_IO_BATCH) {
+		struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mask];
+		struct uloop_uring_slot *slot;
+		struct uloop_fd_event *cur;
+		struct uloop_fd *sock;
+		unsigned int ev = 0;
+		uint32_t res;
+
+		head++;
+		if (cqe->user_data == ULOOP_URING_INTERNAL)
+			continue;
+
+		if (cqe->user_data & ULOOP_URING_IO) {
+			uring_io_reap(u, cqe, &done[nio++]);
+			continue;
+		}
+
+		slot = uring_slot(u, (uint32_t)cqe->user_data, false);
+		if (!slot || !slot->fd || slot->seq != cqe->user_data >> 32)
+			continue;
+
+		sock = slot->fd;
+		if (!(cqe->flags & IORING_CQE_F_MORE)) {
+			slot->armed = false;
+			uring_mark_dirty(u, sock->fd, slot);
+		}
+
+		if (cqe->res == -ECANCELED)
+			continue;
+
+		res = cqe->res < 0 ? EPOLLERR : (uint32_t)cqe->res;
+
+		if (slot->batch_id == u->batch_id) {
+			cur = &ctx->cur_fds[slot->batch_pos];
+		} else {
+			slot->batch_id = u->batch_id;
+			slot->batch_pos = nfds;
+			cur = &ctx->cur_fds[nfds++];
+			cur->fd = sock;
+			cur->events = 0;
+		}
+
+		if (res & (EPOLLERR | EPOLLHUP)) {
+			sock->error = true;
+			if (!(sock->flags & ULOOP_ERROR_CB))
+				uloop_fd_delete(sock);
+		}
+
+		if (res & EPOLLRDHUP)
+			sock->eof = true;
+
+		if (res & EPOLLIN)
+			ev |= ULOOP_READ;
+
+		if (res & EPOLLOUT)
+			ev |= ULOOP_WRITE;
+
+		cur->events |= ev;
+	}
+	__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+	uring_io_complete(done, nio);
+
+	return nfds;
+}
+
+/* cancels the pending requests and runs their callbacks */
+static void uring_io_drain(struct uloop_uring *u)
+{
+	struct uloop_uring_io_done done[ULOOP_URING_IO_BATCH];
+	struct io_uring_getevents_arg arg = {};
+	struct __kernel_timespec ts = { .tv_nsec = 10 * 1000000 };
+	struct uloop_io *io;
+	unsigned int head, tail;
+	int i, nio;
+
+	list_for_each_entry(io, &u->ios, list)
+		uring_io_cancel(u, io);
+
+	arg.ts = (uint64_t)(uintptr_t)&ts;
+	for (i = 0; i < ULOOP_URING_DRAIN_TIME / 10 && !list_empty(&u->ios); i++) {
+		uring_enter(u, u->to_submit, 1,
+			    IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+			    &arg, sizeof(arg));
+		u->to_submit = 0;
+
+		nio = 0;
+		head = *u->cq_head;
+		tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+		while (head != tail && nio < ULOOP_URING_IO_BATCH) {
+			struct io_uring_cqe *cqe = &u->cqes[head++ & u->cq_mask];
+
+			if (cqe->user_data != ULOOP_URING_INTERNAL &&
+			    (cqe->user_data & ULOOP_URING_IO))
+				uring_io_reap(u, cqe, &done[nio++]);
+		}
+		__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+		uring_io_complete(done, nio);
+	}
+}
+
+static void uring_done(struct uloop_ctx *ctx)
+{
+	struct uloop_uring *u = ctx->uring;
+
+	if (!u)
+		return;
+
+	uring_io_drain(u);
+	while (u->bufs)
+		uring_buf_ring_free(u, u->bufs);
+
+	munmap(u->sqes, u->sq_entries * sizeof(struct io_uring_sqe));
+	munmap(u->ring, u->ring_size);
+	close(u->fd);
+
+	free(u->slots);
+	free(u);
+	ctx->uring = NULL;
+}
+
+static unsigned int uring_ids;
+
+static int uring_init(struct uloop_ctx *ctx)
+{
+	struct io_uring_params p;
+	const char *backend = getenv("ULOOP_BACKEND");
+	unsigned int features = IORING_FEAT_EXT_ARG | IORING_FEAT_CQE_SKIP;
+	struct uloop_uring *u;
+	char *sq;
+
+	if (backend && strcmp(backend, "io_uring") != 0)
+		return -1;
+
+	u = calloc(1, sizeof(*u));
+	if (!u)
+		return -1;
+
+	u->dirty = -1;
+	INIT_LIST_HEAD(&u->ios);
+	do {
+		u->id = __atomic_add_fetch(&uring_ids, 1, __ATOMIC_RELAXED);
+	} while (!u->id);
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_COOP_TASKRUN;
+	u->fd = syscall(__NR_io_uring_setup, ULOOP_URING_ENTRIES, &p);
+	if (u->fd < 0 && errno == EINVAL) {
+		memset(&p, 0, sizeof(p));
+		u->fd = syscall(__NR_io_uring_setup, ULOOP_URING_ENTRIES, &p);
+	}
+	if (u->fd < 0)
+		goto free;
+	/* the CQE skip feature came with 5.17, after multishot polls */
+	if ((p.features & features) != features ||
+	    !(p.features & IORING_FEAT_SINGLE_MMAP))
+		goto error;
+
+	u->ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	if (u->ring_size < p.cq_off.cqes +
+			      p.cq_entries * sizeof(struct io_uring_cqe))
+		u->ring_size = p.cq_off.cqes +
+				  p.cq_entries * sizeof(struct io_uring_cqe);
+
+	u->ring = mmap(NULL, u->ring_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, u->fd,
+			  IORING_OFF_SQ_RING);
+	if (u->ring == MAP_FAILED)
+		goto error;
+
+	u->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+			  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			  u->fd, IORING_OFF_SQES);
+	if (u->sqes == MAP_FAILED) {
+		munmap(u->ring, u->ring_size);
+		goto error;
+	}
+
+	sq = u->ring;
+	u->sq_head = (unsigned int *)(sq + p.sq_off.head);
+	u->sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+	u->sq_array = (unsigned int *)(sq + p.sq_off.array);
+	u->sq_mask = *(unsigned int *)(sq + p.sq_off.ring_mask);
+	u->sq_entries = p.sq_entries;
+	u->cq_head = (unsigned int *)(sq + p.cq_off.head);
+	u->cq_tail = (unsigned int *)(sq + p.cq_off.tail);
+	u->cq_mask = *(unsigned int *)(sq + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *)(sq + p.cq_off.cqes);
+
+	ctx->uring = u;
+	return 0;
+
+error:
+	close(u->fd);
+free:
+	free(u);
+	return -1;
+}
@@ -15,24 +15,32 @@
  * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
-static int uloop_init_pollfd(void)
+static int uloop_init_pollfd(struct uloop_ctx *ctx)
 {
 	struct timespec timeout = { 0, 0 };
 	struct kevent ev = {};
 
-	if (poll_fd >= 0)
+	if (ctx->poll_fd >= 0)
 		return 0;
 
-	poll_fd = kqueue();
-	if (poll_fd < 0)
+	ctx->poll_fd = kqueue();
+	if (ctx->poll_fd < 0)
 		return -1;
 
 	EV_SET(&ev, SIGCHLD, EVFILT_SIGNAL, EV_ADD, 0, 0, 0);
-	kevent(poll_fd, &ev, 1, NULL, 0, &timeout);
+	kevent(ctx->poll_fd, &ev, 1, NULL, 0, &timeout);
 
 	return 0;
 }
 
+static void uloop_done_pollfd(struct uloop_ctx *ctx)
+{
+	if (ctx->poll_fd >= 0) {
+		close(ctx->poll_fd);
+		ctx->poll_fd = -1;
+	}
+}
+
 
 static uint16_t get_flags(unsigned int flags, unsigned int mask)
 {
@@ -48,9 +56,8 @@ static uint16_t get_flags(unsigned int flags, unsigned int mask)
 	return kflags;
 }
 
-static struct kevent events[ULOOP_MAX_EVENTS];
-
-static int register_kevent(struct uloop_fd *fd, unsigned int flags)
+static int register_kevent(struct uloop_ctx *ctx, struct uloop_fd *fd,
+			   unsigned int flags)
 {
 	struct timespec timeout = { 0, 0 };
 	struct kevent ev[2];
@@ -80,29 +87,31 @@ static int register_kevent(struct uloop_fd *fd, unsigned int flags)
 		fl |= EV_DELETE;
 
 	fd->flags = flags;
-	if (kevent(poll_fd, ev, nev, NULL, fl, &timeout) == -1)
+	if (kevent(ctx->poll_fd, ev, nev, NULL, fl, &timeout) == -1)
 		return -1;
 
 	return 0;
 }
 
-static int register_poll(struct uloop_fd *fd, unsigned int flags)
+static int register_poll(struct uloop_ctx *ctx, struct uloop_fd *fd,
+			 unsigned int flags)
 {
 	if (flags & ULOOP_EDGE_TRIGGER)
 		flags |= ULOOP_EDGE_DEFER;
 	else
 		flags &= ~ULOOP_EDGE_DEFER;
 
-	return register_kevent(fd, flags);
+	return register_kevent(ctx, fd, flags);
 }
 
-static int __uloop_fd_delete(struct uloop_fd *fd)
+static int __uloop_fd_delete(struct uloop_ctx *ctx, struct uloop_fd *fd)
 {
-	return register_poll(fd, 0);
+	return register_poll(ctx, fd, 0);
 }
 
-static int uloop_fetch_events(int timeout)
+static int uloop_fetch_events(struct uloop_ctx *ctx, int timeout)
 {
+	struct kevent *events = ctx->events;
 	struct timespec ts;
 	int nfds, n;
 
@@ -111,9 +120,10 @@ static int uloop_fetch_events(int timeout)
 		ts.tv_nsec = (timeout % 1000) * 1000000;
 	}
 
-	nfds = kevent(poll_fd, NULL, 0, events, ARRAY_SIZE(events), timeout >= 0 ? &ts : NULL);
+	nfds = kevent(ctx->poll_fd, NULL, 0, events, ctx->poll_max_events,
+		      timeout >= 0 ? &ts : NULL);
 	for (n = 0; n < nfds; n++) {
-		struct uloop_fd_event *cur = &cur_fds[n];
+		struct uloop_fd_event *cur = &ctx->cur_fds[n];
 		struct uloop_fd *u = events[n].udata;
 		unsigned int ev = 0;
 
@@ -141,7 +151,7 @@ static int uloop_fetch_events(int timeout)
 		if (u->flags & ULOOP_EDGE_DEFER) {
 			u->flags &= ~ULOOP_EDGE_DEFER;
 			u->flags |= ULOOP_EDGE_TRIGGER;
-			register_kevent(u, u->flags);
+			register_kevent(ctx, u, u->flags);
 		}
 	}
 	return nfds;
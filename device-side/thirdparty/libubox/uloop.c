@@ -26,6 +26,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <limits.h>
 
 #include "uloop.h"
 #include "utils.h"
@@ -35,6 +36,7 @@
 #endif
 #ifdef USE_EPOLL
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #endif
 #include <sys/wait.h>
 
@@ -49,92 +51,274 @@ struct uloop_fd_stack {
 	unsigned int events;
 };
 
-static struct uloop_fd_stack *fd_stack = NULL;
+#define ULOOP_MAX_EVENTS 64
+#define ULOOP_ONE_EVENTS 10
 
-#define ULOOP_MAX_EVENTS 10
+/*
+ * Pending timeouts are kept in a 4-ary min-heap ordered by (expires, seq),
+ * so that equal deadlines fire in the order added. Each slot holds both
+ * keys, so sifting compares without touching the timeouts; the timeouts
+ * are only written to update their heap index. A 4-ary heap is half as
+ * deep as a binary one.
+ */
+struct uloop_timeout_slot {
+	int64_t expires;
+	uint64_t seq;
+	struct uloop_timeout *t;
+};
+
+#define ULOOP_HEAP_ARITY	4
+#define ULOOP_HEAP_MIN_SIZE	16
+
+struct uloop_uring;
+
+struct uloop_ctx {
+	int poll_fd;
+#ifdef USE_IO_URING
+	struct uloop_uring *uring;
+#endif
+#ifdef USE_EPOLL
+	struct epoll_event events[ULOOP_MAX_EVENTS];
+#endif
+#ifdef USE_KQUEUE
+	struct kevent events[ULOOP_MAX_EVENTS];
+#endif
+
+	struct uloop_fd_event cur_fds[ULOOP_MAX_EVENTS];
+	int cur_fd, cur_nfds;
+	struct uloop_fd_stack *fd_stack;
+
+	struct uloop_timeout_slot *timeouts;
+	unsigned int timeouts_len, timeouts_size;
+	uint64_t timeouts_seq;
+
+	/* uloop_cancelled for the default context */
+	bool *cancelled;
+	bool cancelled_flag;
+	int status;
+	int run_depth;
+
+	enum uloop_dispatch_mode dispatch_mode;
+	int dispatch_max;
+	/* events fetched per poll; batches get a bigger share of the ready set */
+	int poll_max_events;
+
+	/* an eventfd, or a pipe where there is none */
+	int waker_pipe;
+	struct uloop_fd waker_fd;
+	struct uloop_call *calls;
+	/* calls taken off the stack, oldest first; owned by the loop thread */
+	struct uloop_call *calls_taken;
+	struct uloop_call **calls_taken_tail;
+};
 
-static struct list_head timeouts = LIST_HEAD_INIT(timeouts);
 static struct list_head processes = LIST_HEAD_INIT(processes);
 
-static int poll_fd = -1;
 bool uloop_cancelled = false;
 bool uloop_handle_sigchld = true;
-static int uloop_status = 0;
 static bool do_sigchld = false;
 
-static struct uloop_fd_event cur_fds[ULOOP_MAX_EVENTS];
-static int cur_fd, cur_nfds;
-static int uloop_run_depth = 0;
+static void waker_consume(struct uloop_fd *fd, unsigned int events);
+
+#define ULOOP_CTX_INIT(_ctx, _cancelled) {			\
+	.poll_fd = -1,						\
+	.cancelled = _cancelled,				\
+	.dispatch_mode = ULOOP_DISPATCH_ONE,			\
+	.dispatch_max = 1,					\
+	.poll_max_events = ULOOP_ONE_EVENTS,			\
+	.waker_pipe = -1,					\
+	.calls_taken_tail = &(_ctx)->calls_taken,		\
+	.waker_fd = {						\
+		.fd = -1,					\
+		.cb = waker_consume,				\
+		.ctx = _ctx,					\
+	},							\
+}
 
-int uloop_fd_add(struct uloop_fd *sock, unsigned int flags);
+static struct uloop_ctx default_ctx =
+	ULOOP_CTX_INIT(&default_ctx, &uloop_cancelled);
+static __thread struct uloop_ctx *cur_ctx;
 
 #ifdef USE_KQUEUE
 #include "uloop-kqueue.c"
 #endif
 
 #ifdef USE_EPOLL
+#ifdef USE_IO_URING
+#include "uloop-io_uring.c"
+#endif
 #include "uloop-epoll.c"
 #endif
 
+static void uloop_take_calls(struct uloop_ctx *ctx)
+{
+	struct uloop_call *list, *call, *prev = NULL;
+
+	list = __atomic_exchange_n(&ctx->calls, NULL, __ATOMIC_ACQUIRE);
+	if (!list)
+		return;
+
+	/* the calls were pushed onto a stack, queue them in order */
+	while (list) {
+		call = list;
+		list = call->next;
+		call->next = prev;
+		prev = call;
+	}
+
+	*ctx->calls_taken_tail = prev;
+	while (prev->next)
+		prev = prev->next;
+	ctx->calls_taken_tail = &prev->next;
+}
+
+static void uloop_run_calls(struct uloop_ctx *ctx)
+{
+	struct uloop_call *call;
+
+	uloop_take_calls(ctx);
+
+	while ((call = ctx->calls_taken) != NULL) {
+		ctx->calls_taken = call->next;
+		if (!call->next)
+			ctx->calls_taken_tail = &ctx->calls_taken;
+		__atomic_store_n(&call->pending, false, __ATOMIC_RELEASE);
+		call->cb(call);
+	}
+}
+
 static void waker_consume(struct uloop_fd *fd, unsigned int events)
 {
-	char buf[4];
+	char buf[8];
 
-	while (read(fd->fd, buf, 4) > 0)
+	while (read(fd->fd, buf, sizeof(buf)) > 0)
 		;
-}
 
-static int waker_pipe = -1;
-static struct uloop_fd waker_fd = {
-	.fd = -1,
-	.cb = waker_consume,
-};
+	uloop_run_calls(fd->ctx);
+}
 
+#ifndef USE_EPOLL
 static void waker_init_fd(int fd)
 {
 	fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
 	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 }
+#endif
 
-static int waker_init(void)
+static int waker_init(struct uloop_ctx *ctx)
 {
 	int fds[2];
 
-	if (waker_pipe >= 0)
+	if (ctx->waker_pipe >= 0)
 		return 0;
 
+#ifdef USE_EPOLL
+	fds[0] = fds[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fds[0] < 0)
+		return -1;
+#else
 	if (pipe(fds) < 0)
 		return -1;
 
 	waker_init_fd(fds[0]);
 	waker_init_fd(fds[1]);
-	waker_pipe = fds[1];
+#endif
+	ctx->waker_pipe = fds[1];
 
-	waker_fd.fd = fds[0];
-	waker_fd.cb = waker_consume;
-	uloop_fd_add(&waker_fd, ULOOP_READ);
+	ctx->waker_fd.fd = fds[0];
+	uloop_ctx_fd_add(ctx, &ctx->waker_fd, ULOOP_READ);
 
 	return 0;
 }
 
+static void waker_done(struct uloop_ctx *ctx)
+{
+	if (ctx->waker_pipe < 0)
+		return;
+
+	uloop_fd_delete(&ctx->waker_fd);
+	if (ctx->waker_fd.fd != ctx->waker_pipe)
+		close(ctx->waker_pipe);
+	close(ctx->waker_fd.fd);
+	ctx->waker_pipe = -1;
+	ctx->waker_fd.fd = -1;
+}
+
 static void uloop_setup_signals(bool add);
 
-int uloop_init(void)
+static int uloop_ctx_init(struct uloop_ctx *ctx)
 {
-	if (uloop_init_pollfd() < 0)
+	if (uloop_init_pollfd(ctx) < 0)
 		return -1;
 
-	if (waker_init() < 0) {
-		uloop_done();
+	if (waker_init(ctx) < 0) {
+		uloop_done_pollfd(ctx);
 		return -1;
 	}
 
-	uloop_setup_signals(true);
+	return 0;
+}
+
+struct uloop_ctx *uloop_ctx_default(void)
+{
+	return &default_ctx;
+}
+
+struct uloop_ctx *uloop_ctx_current(void)
+{
+	return cur_ctx ? cur_ctx : &default_ctx;
+}
+
+void uloop_ctx_bind(struct uloop_ctx *ctx)
+{
+	cur_ctx = ctx;
+}
+
+struct uloop_ctx *uloop_ctx_new(void)
+{
+	struct uloop_ctx *ctx = malloc(sizeof(*ctx));
+
+	if (!ctx)
+		return NULL;
+
+	*ctx = (struct uloop_ctx) ULOOP_CTX_INIT(ctx, &ctx->cancelled_flag);
+	if (uloop_ctx_init(ctx) < 0) {
+		free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+static void uloop_ctx_done(struct uloop_ctx *ctx);
+
+void uloop_ctx_free(struct uloop_ctx *ctx)
+{
+	if (!ctx || ctx == &default_ctx)
+		return;
+
+	if (cur_ctx == ctx)
+		cur_ctx = NULL;
+
+	uloop_ctx_done(ctx);
+	free(ctx);
+}
+
+int uloop_init(void)
+{
+	struct uloop_ctx *ctx = uloop_ctx_current();
+
+	if (uloop_ctx_init(ctx) < 0)
+		return -1;
+
+	if (ctx == &default_ctx)
+		uloop_setup_signals(true);
 
 	return 0;
 }
 
-static bool uloop_fd_stack_event(struct uloop_fd *fd, int events)
+static bool uloop_fd_stack_event(struct uloop_ctx *ctx, struct uloop_fd *fd,
+				 int events)
 {
 	struct uloop_fd_stack *cur;
 
@@ -145,7 +329,7 @@ static bool uloop_fd_stack_event(struct uloop_fd *fd, int events)
 	if (!(fd->flags & ULOOP_EDGE_TRIGGER))
 		return false;
 
-	for (cur = fd_stack; cur; cur = cur->next) {
+	for (cur = ctx->fd_stack; cur; cur = cur->next) {
 		if (cur->fd != fd)
 			continue;
 
@@ -160,24 +344,46 @@ static bool uloop_fd_stack_event(struct uloop_fd *fd, int events)
 	return false;
 }
 
-static void uloop_run_events(int timeout)
+int uloop_set_dispatch(enum uloop_dispatch_mode mode, int max_events)
+{
+	struct uloop_ctx *ctx = uloop_ctx_current();
+
+	if (mode < ULOOP_DISPATCH_ONE || mode > ULOOP_DISPATCH_ALL ||
+	    max_events < 0)
+		return -1;
+
+	ctx->dispatch_mode = mode;
+	if (mode == ULOOP_DISPATCH_ONE) {
+		ctx->dispatch_max = 1;
+		ctx->poll_max_events = ULOOP_ONE_EVENTS;
+	} else {
+		ctx->dispatch_max = max_events ? max_events : ULOOP_MAX_EVENTS;
+		ctx->poll_max_events = ULOOP_MAX_EVENTS;
+	}
+
+	return 0;
+}
+
+static void uloop_run_events(struct uloop_ctx *ctx, int timeout)
 {
 	struct uloop_fd_event *cur;
 	struct uloop_fd *fd;
+	int dispatched = 0;
 
-	if (!cur_nfds) {
-		cur_fd = 0;
-		cur_nfds = uloop_fetch_events(timeout);
-		if (cur_nfds < 0)
-			cur_nfds = 0;
+	if (!ctx->cur_nfds) {
+		ctx->cur_fd = 0;
+		ctx->cur_nfds = uloop_fetch_events(ctx, timeout);
+		if (ctx->cur_nfds < 0)
+			ctx->cur_nfds = 0;
 	}
 
-	while (cur_nfds > 0) {
+	while (ctx->cur_nfds > 0) {
 		struct uloop_fd_stack stack_cur;
 		unsigned int events;
+		bool edge;
 
-		cur = &cur_fds[cur_fd++];
-		cur_nfds--;
+		cur = &ctx->cur_fds[ctx->cur_fd++];
+		ctx->cur_nfds--;
 
 		fd = cur->fd;
 		events = cur->events;
@@ -187,24 +393,33 @@ static void uloop_run_events(int timeout)
 		if (!fd->cb)
 			continue;
 
-		if (uloop_fd_stack_event(fd, cur->events))
+		if (uloop_fd_stack_event(ctx, fd, cur->events))
 			continue;
 
-		stack_cur.next = fd_stack;
+		/* the callback may change the flags or free the fd */
+		edge = fd->flags & ULOOP_EDGE_TRIGGER;
+
+		stack_cur.next = ctx->fd_stack;
 		stack_cur.fd = fd;
-		fd_stack = &stack_cur;
+		ctx->fd_stack = &stack_cur;
 		do {
 			stack_cur.events = 0;
 			fd->cb(fd, events);
 			events = stack_cur.events & ULOOP_EVENT_MASK;
 		} while (stack_cur.fd && events);
-		fd_stack = stack_cur.next;
+		ctx->fd_stack = stack_cur.next;
 
-		return;
+		if (++dispatched >= ctx->dispatch_max ||
+		    __atomic_load_n(ctx->cancelled, __ATOMIC_RELAXED))
+			return;
+
+		if (ctx->dispatch_mode == ULOOP_DISPATCH_EDGE && !edge)
+			return;
 	}
 }
 
-int uloop_fd_add(struct uloop_fd *sock, unsigned int flags)
+int uloop_ctx_fd_add(struct uloop_ctx *ctx, struct uloop_fd *sock,
+		     unsigned int flags)
 {
 	unsigned int fl;
 	int ret;
@@ -212,16 +427,21 @@ int uloop_fd_add(struct uloop_fd *sock, unsigned int flags)
 	if (!(flags & (ULOOP_READ | ULOOP_WRITE)))
 		return uloop_fd_delete(sock);
 
+	/* a registered fd stays with its context */
+	if (sock->registered)
+		ctx = sock->ctx;
+
 	if (!sock->registered && !(flags & ULOOP_BLOCKING)) {
 		fl = fcntl(sock->fd, F_GETFL, 0);
 		fl |= O_NONBLOCK;
 		fcntl(sock->fd, F_SETFL, fl);
 	}
 
-	ret = register_poll(sock, flags);
+	ret = register_poll(ctx, sock, flags);
 	if (ret < 0)
 		goto out;
 
+	sock->ctx = ctx;
 	sock->registered = true;
 	sock->eof = false;
 	sock->error = false;
@@ -230,103 +450,208 @@ out:
 	return ret;
 }
 
+int uloop_fd_add(struct uloop_fd *sock, unsigned int flags)
+{
+	return uloop_ctx_fd_add(uloop_ctx_current(), sock, flags);
+}
+
 int uloop_fd_delete(struct uloop_fd *fd)
 {
+	/* an fd that is not registered can only be in the running batch */
+	struct uloop_ctx *ctx = fd->registered ? fd->ctx : uloop_ctx_current();
 	int i;
 
-	for (i = 0; i < cur_nfds; i++) {
-		if (cur_fds[cur_fd + i].fd != fd)
+	for (i = 0; i < ctx->cur_nfds; i++) {
+		if (ctx->cur_fds[ctx->cur_fd + i].fd != fd)
 			continue;
 
-		cur_fds[cur_fd + i].fd = NULL;
+		ctx->cur_fds[ctx->cur_fd + i].fd = NULL;
 	}
 
 	if (!fd->registered)
 		return 0;
 
 	fd->registered = false;
-	uloop_fd_stack_event(fd, -1);
-	return __uloop_fd_delete(fd);
+	uloop_fd_stack_event(ctx, fd, -1);
+	return __uloop_fd_delete(ctx, fd);
 }
 
-static int tv_diff(struct timeval *t1, struct timeval *t2)
+#define NSEC_PER_MSEC	1000000LL
+#define NSEC_PER_SEC	1000000000LL
+
+static int64_t uloop_gettime(void)
 {
-	return
-		(t1->tv_sec - t2->tv_sec) * 1000 +
-		(t1->tv_usec - t2->tv_usec) / 1000;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
 }
 
-int uloop_timeout_add(struct uloop_timeout *timeout)
+static bool timeout_before(const struct uloop_timeout_slot *a,
+			   const struct uloop_timeout_slot *b)
+{
+	if (a->expires != b->expires)
+		return a->expires < b->expires;
+
+	return a->seq < b->seq;
+}
+
+static void timeout_heap_place(struct uloop_ctx *ctx, unsigned int i,
+			       struct uloop_timeout_slot slot)
+{
+	ctx->timeouts[i] = slot;
+	slot.t->heap_index = i;
+}
+
+static void timeout_heap_up(struct uloop_ctx *ctx, unsigned int i,
+			    struct uloop_timeout_slot slot)
+{
+	struct uloop_timeout_slot *timeouts = ctx->timeouts;
+
+	while (i > 0) {
+		unsigned int parent = (i - 1) / ULOOP_HEAP_ARITY;
+
+		if (!timeout_before(&slot, &timeouts[parent]))
+			break;
+
+		timeout_heap_place(ctx, i, timeouts[parent]);
+		i = parent;
+	}
+
+	timeout_heap_place(ctx, i, slot);
+}
+
+static void timeout_heap_down(struct uloop_ctx *ctx, unsigned int i,
+			      struct uloop_timeout_slot slot)
+{
+	struct uloop_timeout_slot *timeouts = ctx->timeouts;
+	unsigned int len = ctx->timeouts_len;
+
+	while (1) {
+		unsigned int child = i * ULOOP_HEAP_ARITY + 1;
+		unsigned int end = child + ULOOP_HEAP_ARITY;
+		unsigned int min;
+
+		if (child >= len)
+			break;
+
+		if (end > len)
+			end = len;
+
+		for (min = child++; child < end; child++)
+			if (timeout_before(&timeouts[child], &timeouts[min]))
+				min = child;
+
+		if (!timeout_before(&timeouts[min], &slot))
+			break;
+
+		timeout_heap_place(ctx, i, timeouts[min]);
+		i = min;
+	}
+
+	timeout_heap_place(ctx, i, slot);
+}
+
+static int __uloop_timeout_add(struct uloop_ctx *ctx,
+			       struct uloop_timeout *timeout)
 {
-	struct uloop_timeout *tmp;
-	struct list_head *h = &timeouts;
+	struct uloop_timeout_slot slot = {
+		.expires = timeout->expires,
+		.t = timeout,
+	};
 
 	if (timeout->pending)
 		return -1;
 
-	list_for_each_entry(tmp, &timeouts, list) {
-		if (tv_diff(&tmp->time, &timeout->time) > 0) {
-			h = &tmp->list;
-			break;
-		}
+	if (ctx->timeouts_len == ctx->timeouts_size) {
+		unsigned int size = ctx->timeouts_size ?
+				    ctx->timeouts_size * 2 :
+				    ULOOP_HEAP_MIN_SIZE;
+		struct uloop_timeout_slot *heap;
+
+		heap = realloc(ctx->timeouts, size * sizeof(*heap));
+		if (!heap)
+			return -1;
+
+		ctx->timeouts = heap;
+		ctx->timeouts_size = size;
 	}
 
-	list_add_tail(&timeout->list, h);
+	slot.seq = ctx->timeouts_seq++;
+	timeout->ctx = ctx;
 	timeout->pending = true;
+	timeout_heap_up(ctx, ctx->timeouts_len++, slot);
 
 	return 0;
 }
 
-static void uloop_gettime(struct timeval *tv)
+int uloop_ctx_timeout_add(struct uloop_ctx *ctx, struct uloop_timeout *timeout)
 {
-	struct timespec ts;
+	if (timeout->pending)
+		return -1;
 
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	tv->tv_sec = ts.tv_sec;
-	tv->tv_usec = ts.tv_nsec / 1000;
+	timeout->expires = (int64_t)timeout->time.tv_sec * NSEC_PER_SEC +
+			   (int64_t)timeout->time.tv_usec * 1000;
+
+	return __uloop_timeout_add(ctx, timeout);
 }
 
-int uloop_timeout_set(struct uloop_timeout *timeout, int msecs)
+int uloop_timeout_add(struct uloop_timeout *timeout)
 {
-	struct timeval *time = &timeout->time;
+	return uloop_ctx_timeout_add(uloop_ctx_current(), timeout);
+}
+
+int uloop_ctx_timeout_set(struct uloop_ctx *ctx, struct uloop_timeout *timeout,
+			  int msecs)
+{
+	int64_t expires;
 
 	if (timeout->pending)
 		uloop_timeout_cancel(timeout);
 
-	uloop_gettime(time);
-
-	time->tv_sec += msecs / 1000;
-	time->tv_usec += (msecs % 1000) * 1000;
+	expires = uloop_gettime() + (int64_t)msecs * NSEC_PER_MSEC;
+	timeout->expires = expires;
+	timeout->time.tv_sec = expires / NSEC_PER_SEC;
+	timeout->time.tv_usec = (expires % NSEC_PER_SEC) / 1000;
 
-	if (time->tv_usec > 1000000) {
-		time->tv_sec++;
-		time->tv_usec -= 1000000;
-	}
+	return __uloop_timeout_add(ctx, timeout);
+}
 
-	return uloop_timeout_add(timeout);
+int uloop_timeout_set(struct uloop_timeout *timeout, int msecs)
+{
+	return uloop_ctx_timeout_set(uloop_ctx_current(), timeout, msecs);
 }
 
 int uloop_timeout_cancel(struct uloop_timeout *timeout)
 {
+	struct uloop_ctx *ctx = timeout->ctx;
+	unsigned int i = timeout->heap_index;
+	struct uloop_timeout_slot last;
+
 	if (!timeout->pending)
 		return -1;
 
-	list_del(&timeout->list);
 	timeout->pending = false;
 
+	last = ctx->timeouts[--ctx->timeouts_len];
+	if (i == ctx->timeouts_len)
+		return 0;
+
+	if (i > 0 &&
+	    timeout_before(&last, &ctx->timeouts[(i - 1) / ULOOP_HEAP_ARITY]))
+		timeout_heap_up(ctx, i, last);
+	else
+		timeout_heap_down(ctx, i, last);
+
 	return 0;
 }
 
 int uloop_timeout_remaining(struct uloop_timeout *timeout)
 {
-	struct timeval now;
-
 	if (!timeout->pending)
 		return -1;
 
-	uloop_gettime(&now);
-
-	return tv_diff(&timeout->time, &now);
+	return (timeout->expires - uloop_gettime()) / NSEC_PER_MSEC;
 }
 
 int uloop_process_add(struct uloop_process *p)
@@ -391,10 +716,12 @@ static void uloop_handle_processes(void)
 
 }
 
-static void uloop_signal_wake(void)
+void uloop_ctx_wake(struct uloop_ctx *ctx)
 {
+	uint64_t one = 1;
+
 	do {
-		if (write(waker_pipe, "w", 1) < 0) {
+		if (write(ctx->waker_pipe, &one, sizeof(one)) < 0) {
 			if (errno == EINTR)
 				continue;
 		}
@@ -402,17 +729,214 @@ static void uloop_signal_wake(void)
 	} while (1);
 }
 
+int uloop_ctx_call(struct uloop_ctx *ctx, struct uloop_call *call)
+{
+	struct uloop_call *head;
+
+	if (__atomic_exchange_n(&call->pending, true, __ATOMIC_ACQ_REL))
+		return -1;
+
+	head = __atomic_load_n(&ctx->calls, __ATOMIC_RELAXED);
+	do {
+		call->next = head;
+	} while (!__atomic_compare_exchange_n(&ctx->calls, &head, call, true,
+					      __ATOMIC_RELEASE,
+					      __ATOMIC_RELAXED));
+
+	/* otherwise the context has a wakeup coming for the earlier calls */
+	if (!head)
+		uloop_ctx_wake(ctx);
+
+	return 0;
+}
+
+int uloop_ctx_call_cancel(struct uloop_ctx *ctx, struct uloop_call *call)
+{
+	struct uloop_call **cur;
+
+	uloop_take_calls(ctx);
+
+	for (cur = &ctx->calls_taken; *cur; cur = &(*cur)->next) {
+		if (*cur != call)
+			continue;
+
+		*cur = call->next;
+		if (!call->next)
+			ctx->calls_taken_tail = cur;
+		__atomic_store_n(&call->pending, false, __ATOMIC_RELEASE);
+		return 0;
+	}
+
+	return -1;
+}
+
+#ifdef USE_IO_URING
+static struct uloop_uring *uloop_io_uring(struct uloop_ctx *ctx)
+{
+	if (!ctx->uring)
+		errno = ENOTSUP;
+
+	return ctx->uring;
+}
+
+bool uloop_io_supported(void)
+{
+	return !!uloop_ctx_current()->uring;
+}
+
+int uloop_io_read(struct uloop_io *io, int fd, unsigned int buf_group, int len)
+{
+	struct uloop_ctx *ctx = uloop_ctx_current();
+	struct uloop_uring *u = uloop_io_uring(ctx);
+
+	if (!u)
+		return -1;
+
+	io->ctx = ctx;
+	return uring_io_read(u, io, fd, buf_group, len, false);
+}
+
+int uloop_io_recv(struct uloop_io *io, int fd, unsigned int buf_group, int len)
+{
+	struct uloop_ctx *ctx = uloop_ctx_current();
+	struct uloop_uring *u = uloop_io_uring(ctx);
+
+	if (!u)
+		return -1;
+
+	io->ctx = ctx;
+	return uring_io_read(u, io, fd, buf_group, len, true);
+}
+
+int uloop_io_writev(struct uloop_io *io, int fd, const struct iovec *iov,
+		    int iovcnt)
+{
+	struct uloop_ctx *ctx = uloop_ctx_current();
+	struct uloop_uring *u = uloop_io_uring(ctx);
+
+	if (!u)
+		return -1;
+
+	io->ctx = ctx;
+	return uring_io_writev(u, io, fd, iov, iovcnt);
+}
+
+int uloop_io_cancel(struct uloop_io *io)
+{
+	struct uloop_uring *u;
+
+	if (!io->pending)
+		return -1;
+
+	u = uloop_io_uring(io->ctx);
+	if (!u)
+		return -1;
+
+	return uring_io_cancel(u, io);
+}
+
+int uloop_io_provide_buffer(unsigned int buf_group, void *buf, int len,
+			    int buf_id)
+{
+	struct uloop_uring *u = uloop_io_uring(uloop_ctx_current());
+
+	if (!u)
+		return -1;
+
+	return uring_io_buffers(u, IORING_OP_PROVIDE_BUFFERS, buf_group,
+				buf, len, 1, buf_id);
+}
+
+int uloop_io_remove_buffers(unsigned int buf_group, int nr)
+{
+	struct uloop_uring *u = uloop_io_uring(uloop_ctx_current());
+
+	if (!u)
+		return -1;
+
+	return uring_io_buffers(u, IORING_OP_REMOVE_BUFFERS, buf_group,
+				NULL, 0, nr, 0);
+}
+
+unsigned int uloop_io_ring_id(void)
+{
+	struct uloop_uring *u = uloop_ctx_current()->uring;
+
+	return u ? u->id : 0;
+}
+#else
+bool uloop_io_supported(void)
+{
+	return false;
+}
+
+int uloop_io_read(struct uloop_io *io, int fd, unsigned int buf_group, int len)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+int uloop_io_recv(struct uloop_io *io, int fd, unsigned int buf_group, int len)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+int uloop_io_writev(struct uloop_io *io, int fd, const struct iovec *iov,
+		    int iovcnt)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+int uloop_io_cancel(struct uloop_io *io)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+int uloop_io_provide_buffer(unsigned int buf_group, void *buf, int len,
+			    int buf_id)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+int uloop_io_remove_buffers(unsigned int buf_group, int nr)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+unsigned int uloop_io_ring_id(void)
+{
+	return 0;
+}
+#endif
+
+void uloop_ctx_end(struct uloop_ctx *ctx)
+{
+	__atomic_store_n(ctx->cancelled, true, __ATOMIC_RELEASE);
+	if (ctx != uloop_ctx_current())
+		uloop_ctx_wake(ctx);
+}
+
+void uloop_end(void)
+{
+	__atomic_store_n(uloop_ctx_current()->cancelled, true, __ATOMIC_RELAXED);
+}
+
 static void uloop_handle_sigint(int signo)
 {
-	uloop_status = signo;
+	default_ctx.status = signo;
 	uloop_cancelled = true;
-	uloop_signal_wake();
+	uloop_ctx_wake(&default_ctx);
 }
 
 static void uloop_sigchld(int signo)
 {
 	do_sigchld = true;
-	uloop_signal_wake();
+	uloop_ctx_wake(&default_ctx);
 }
 
 static void uloop_install_handler(int signum, void (*handler)(int), struct sigaction* old, bool add)
@@ -474,31 +998,31 @@ static void uloop_setup_signals(bool add)
 	uloop_ignore_signal(SIGPIPE, add);
 }
 
-static int uloop_get_next_timeout(struct timeval *tv)
+static int uloop_get_next_timeout(struct uloop_ctx *ctx, int64_t now)
 {
-	struct uloop_timeout *timeout;
-	int diff;
+	int64_t diff;
 
-	if (list_empty(&timeouts))
+	if (!ctx->timeouts_len)
 		return -1;
 
-	timeout = list_first_entry(&timeouts, struct uloop_timeout, list);
-	diff = tv_diff(&timeout->time, tv);
-	if (diff < 0)
+	diff = ctx->timeouts[0].expires - now;
+	if (diff <= 0)
 		return 0;
 
+	/* round up, so that the loop does not wake before the deadline */
+	diff = (diff + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+	if (diff > INT_MAX)
+		return INT_MAX;
+
 	return diff;
 }
 
-static void uloop_process_timeouts(struct timeval *tv)
+static void uloop_process_timeouts(struct uloop_ctx *ctx, int64_t now)
 {
 	struct uloop_timeout *t;
 
-	while (!list_empty(&timeouts)) {
-		t = list_first_entry(&timeouts, struct uloop_timeout, list);
-
-		if (tv_diff(&t->time, tv) > 0)
-			break;
+	while (ctx->timeouts_len && ctx->timeouts[0].expires <= now) {
+		t = ctx->timeouts[0].t;
 
 		uloop_timeout_cancel(t);
 		if (t->cb)
@@ -506,12 +1030,14 @@ static void uloop_process_timeouts(struct timeval *tv)
 	}
 }
 
-static void uloop_clear_timeouts(void)
+static void uloop_clear_timeouts(struct uloop_ctx *ctx)
 {
-	struct uloop_timeout *t, *tmp;
+	while (ctx->timeouts_len)
+		uloop_timeout_cancel(ctx->timeouts[ctx->timeouts_len - 1].t);
 
-	list_for_each_entry_safe(t, tmp, &timeouts, list)
-		uloop_timeout_cancel(t);
+	free(ctx->timeouts);
+	ctx->timeouts = NULL;
+	ctx->timeouts_size = 0;
 }
 
 static void uloop_clear_processes(void)
@@ -524,58 +1050,66 @@ static void uloop_clear_processes(void)
 
 bool uloop_cancelling(void)
 {
-	return uloop_run_depth > 0 && uloop_cancelled;
+	struct uloop_ctx *ctx = uloop_ctx_current();
+
+	return ctx->run_depth > 0 &&
+	       __atomic_load_n(ctx->cancelled, __ATOMIC_RELAXED);
 }
 
-int uloop_run_timeout(int timeout)
+int uloop_ctx_run(struct uloop_ctx *ctx, int timeout)
 {
+	struct uloop_ctx *prev = cur_ctx;
 	int next_time = 0;
-	struct timeval tv;
 
-	uloop_run_depth++;
+	cur_ctx = ctx;
+	ctx->run_depth++;
 
-	uloop_status = 0;
-	uloop_cancelled = false;
-	while (!uloop_cancelled)
+	ctx->status = 0;
+	__atomic_store_n(ctx->cancelled, false, __ATOMIC_RELAXED);
+	while (!__atomic_load_n(ctx->cancelled, __ATOMIC_ACQUIRE))
 	{
-		uloop_gettime(&tv);
-		uloop_process_timeouts(&tv);
+		uloop_process_timeouts(ctx, uloop_gettime());
 
-		if (do_sigchld)
+		if (ctx == &default_ctx && do_sigchld)
 			uloop_handle_processes();
 
-		if (uloop_cancelled)
+		if (__atomic_load_n(ctx->cancelled, __ATOMIC_RELAXED))
 			break;
 
-		uloop_gettime(&tv);
-
-		next_time = uloop_get_next_timeout(&tv);
+		next_time = uloop_get_next_timeout(ctx, uloop_gettime());
 		if (timeout >= 0 && timeout < next_time)
 			next_time = timeout;
-		uloop_run_events(next_time);
+		uloop_run_events(ctx, next_time);
 	}
 
-	--uloop_run_depth;
+	--ctx->run_depth;
+	cur_ctx = prev;
 
-	return uloop_status;
+	return ctx->status;
 }
 
-void uloop_done(void)
+int uloop_run_timeout(int timeout)
 {
-	uloop_setup_signals(false);
+	return uloop_ctx_run(uloop_ctx_current(), timeout);
+}
 
-	if (poll_fd >= 0) {
-		close(poll_fd);
-		poll_fd = -1;
-	}
+static void uloop_ctx_done(struct uloop_ctx *ctx)
+{
+	/* the waker goes first, it is deleted from the poll fd */
+	waker_done(ctx);
+	uloop_done_pollfd(ctx);
+	uloop_clear_timeouts(ctx);
+	uloop_run_calls(ctx);
+}
+
+void uloop_done(void)
+{
+	struct uloop_ctx *ctx = uloop_ctx_current();
 
-	if (waker_pipe >= 0) {
-		uloop_fd_delete(&waker_fd);
-		close(waker_pipe);
-		close(waker_fd.fd);
-		waker_pipe = -1;
+	if (ctx == &default_ctx) {
+		uloop_setup_signals(false);
+		uloop_clear_processes();
 	}
 
-	uloop_clear_timeouts();
-	uloop_clear_processes();
+	uloop_ctx_done(ctx);
 }
@@ -32,13 +32,19 @@
 
 #include "list.h"
 
+struct uloop_ctx;
 struct uloop_fd;
 struct uloop_timeout;
 struct uloop_process;
+struct uloop_call;
+struct uloop_io;
+struct iovec;
 
 typedef void (*uloop_fd_handler)(struct uloop_fd *u, unsigned int events);
 typedef void (*uloop_timeout_handler)(struct uloop_timeout *t);
 typedef void (*uloop_process_handler)(struct uloop_process *c, int ret);
+typedef void (*uloop_call_handler)(struct uloop_call *c);
+typedef void (*uloop_io_handler)(struct uloop_io *io, int res, int buf_id);
 
 #define ULOOP_READ		(1 << 0)
 #define ULOOP_WRITE		(1 << 1)
@@ -63,15 +69,22 @@ struct uloop_fd
 	bool error;
 	bool registered;
 	uint8_t flags;
+
+	struct uloop_ctx *ctx;
 };
 
 struct uloop_timeout
 {
-	struct list_head list;
+	unsigned int heap_index;
 	bool pending;
 
 	uloop_timeout_handler cb;
 	struct timeval time;
+
+	/* CLOCK_MONOTONIC nanoseconds */
+	int64_t expires;
+
+	struct uloop_ctx *ctx;
 };
 
 struct uloop_process
@@ -83,6 +96,39 @@ struct uloop_process
 	pid_t pid;
 };
 
+struct uloop_call
+{
+	struct uloop_call *next;
+	bool pending;
+
+	uloop_call_handler cb;
+};
+
+struct uloop_io
+{
+	struct list_head list;
+	struct uloop_ctx *ctx;
+	bool pending;
+	unsigned short buf_group;
+
+	uloop_io_handler cb;
+};
+
+/*
+ * Which ready fds uloop dispatches from one poll before it runs the
+ * timeouts, processes and signals again:
+ *
+ * ULOOP_DISPATCH_ONE:	one fd (the default)
+ * ULOOP_DISPATCH_EDGE:	all edge-triggered fds, up to the first other one;
+ *			their callbacks read until EAGAIN anyway
+ * ULOOP_DISPATCH_ALL:	all fds
+ */
+enum uloop_dispatch_mode {
+	ULOOP_DISPATCH_ONE,
+	ULOOP_DISPATCH_EDGE,
+	ULOOP_DISPATCH_ALL,
+};
+
 extern bool uloop_cancelled;
 extern bool uloop_handle_sigchld;
 
@@ -94,15 +140,17 @@ int uloop_timeout_set(struct uloop_timeout *timeout, int msecs);
 int uloop_timeout_cancel(struct uloop_timeout *timeout);
 int uloop_timeout_remaining(struct uloop_timeout *timeout);
 
+/*
+ * max_events bounds the callbacks of one batch, so that timeouts are not
+ * starved under load; 0 means the whole ready set of a poll
+ */
+int uloop_set_dispatch(enum uloop_dispatch_mode mode, int max_events);
+
 int uloop_process_add(struct uloop_process *p);
 int uloop_process_delete(struct uloop_process *p);
 
 bool uloop_cancelling(void);
-
-static inline void uloop_end(void)
-{
-	uloop_cancelled = true;
-}
+void uloop_end(void);
 
 int uloop_init(void);
 int uloop_run_timeout(int timeout);
@@ -112,4 +160,86 @@ static inline int uloop_run(void)
 }
 void uloop_done(void);
 
+/*
+ * Event loop contexts
+ *
+ * All the state of an event loop is kept in a struct uloop_ctx, so that a
+ * process can run one loop per thread. The functions above work on the
+ * context of the calling thread: the one it runs with uloop_ctx_run(), or
+ * has bound with uloop_ctx_bind(), and the default context otherwise.
+ * Registered fds and pending timeouts stay with the context that they
+ * were added to.
+ *
+ * A context is used by one thread at a time; only uloop_ctx_wake(),
+ * uloop_ctx_end() and uloop_ctx_call() may be called from other threads.
+ * Signals and child processes are handled by the default context.
+ */
+struct uloop_ctx *uloop_ctx_new(void);
+void uloop_ctx_free(struct uloop_ctx *ctx);
+
+struct uloop_ctx *uloop_ctx_default(void);
+struct uloop_ctx *uloop_ctx_current(void);
+/* NULL binds the calling thread to the default context again */
+void uloop_ctx_bind(struct uloop_ctx *ctx);
+
+int uloop_ctx_fd_add(struct uloop_ctx *ctx, struct uloop_fd *sock,
+		     unsigned int flags);
+int uloop_ctx_timeout_add(struct uloop_ctx *ctx, struct uloop_timeout *timeout);
+int uloop_ctx_timeout_set(struct uloop_ctx *ctx, struct uloop_timeout *timeout,
+			  int msecs);
+
+int uloop_ctx_run(struct uloop_ctx *ctx, int timeout);
+void uloop_ctx_end(struct uloop_ctx *ctx);
+
+/* interrupts the poll of the context, through its eventfd */
+void uloop_ctx_wake(struct uloop_ctx *ctx);
+
+/*
+ * uloop_ctx_call: run call->cb in the thread of the context, from its
+ * loop; fails if the call is still pending
+ */
+int uloop_ctx_call(struct uloop_ctx *ctx, struct uloop_call *call);
+/*
+ * uloop_ctx_call_cancel: drop a pending call before it runs; only from
+ * the thread of the context. Fails if the call is not pending there.
+ */
+int uloop_ctx_call_cancel(struct uloop_ctx *ctx, struct uloop_call *call);
+
+/*
+ * Asynchronous I/O
+ *
+ * With the io_uring backend, a struct uloop_io runs a read or a write on
+ * an fd without waiting for the fd to be ready first. The request goes
+ * out with the next poll of the loop, together with all the others, and
+ * io->cb runs from the loop with the result of the syscall: the length,
+ * or a negative errno (-ECANCELED once cancelled). The request must stay
+ * valid until then; requests still pending when the loop is torn down
+ * are cancelled, and their callbacks run from uloop_done().
+ *
+ * uloop_io_read reads into a buffer of buf_group, picked by the kernel
+ * when the data arrives, so that a stream does not tie up a buffer while
+ * it is idle. The callback gets the id of the buffer, or -1. Buffers are
+ * given to a group with uloop_io_provide_buffer, and are the caller's
+ * again once a read has used them. uloop_io_recv does the same on a
+ * socket, where it can wait for data before it tries to read.
+ *
+ * All of them fail with ENOTSUP when the loop of the calling thread does
+ * not use io_uring.
+ */
+bool uloop_io_supported(void);
+int uloop_io_read(struct uloop_io *io, int fd, unsigned int buf_group, int len);
+int uloop_io_recv(struct uloop_io *io, int fd, unsigned int buf_group, int len);
+int uloop_io_writev(struct uloop_io *io, int fd, const struct iovec *iov,
+		    int iovcnt);
+int uloop_io_cancel(struct uloop_io *io);
+int uloop_io_provide_buffer(unsigned int buf_group, void *buf, int len,
+			    int buf_id);
+/* takes back the buffers of a group that no read has used */
+int uloop_io_remove_buffers(unsigned int buf_group, int nr);
+/*
+ * identifies the ring of the loop of the calling thread, or 0; the buffers
+ * given to a ring are the caller's again once uloop_done() has run
+ */
+unsigned int uloop_io_ring_id(void);
+
 #endif
@@ -16,11 +16,237 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <sys/stat.h>
+
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "ustream.h"
 
+/*
+ * With the io_uring backend the fd is not polled: a read is kept pending
+ * on it, into a buffer the loop picks from the ones lent by the thread,
+ * and queued write data goes out with a single writev request at a time.
+ */
+#define USTREAM_FD_READ_LEN	4096
+#define USTREAM_FD_READ_BUFS	8
+#define USTREAM_FD_READ_BUFS_MAX	256
+#define USTREAM_FD_MAX_IOV	16
+
+struct ustream_fd_uring {
+	/* NULL once the stream is freed with requests still pending */
+	struct ustream_fd *sf;
+
+	struct uloop_io rd, wr;
+	struct uloop_timeout kick;
+	bool sock;
+
+	/* read data the stream had no room for */
+	struct ustream_buf *stash;
+
+	/* write buffers of a freed stream, kept until its write completes */
+	struct ustream_buf_list w;
+
+	struct iovec iov[USTREAM_FD_MAX_IOV];
+};
+
+/*
+ * how many read buffers the thread keeps lent, doubled whenever a read
+ * finds none, so that it follows the number of streams that get data at
+ * the same time
+ */
+static __thread int read_bufs = USTREAM_FD_READ_BUFS;
+
+static void ustream_fd_uring_put(struct ustream_fd_uring *u)
+{
+	if (u->sf || u->rd.pending || u->wr.pending)
+		return;
+
+	ustream_free_buffers(&u->w);
+	free(u);
+}
+
+static void ustream_fd_uring_read(struct ustream_fd_uring *u)
+{
+	struct ustream *s = &u->sf->stream;
+	int ret;
+
+	if (u->rd.pending || u->stash || s->read_blocked || s->eof)
+		return;
+
+	while (ustream_lent_read_bufs() < read_bufs)
+		if (ustream_lend_read_buf(NULL, USTREAM_FD_READ_LEN) < 0)
+			break;
+
+	if (u->sock)
+		ret = uloop_io_recv(&u->rd, u->sf->fd.fd, USTREAM_BUF_GROUP,
+				    USTREAM_FD_READ_LEN);
+	else
+		ret = uloop_io_read(&u->rd, u->sf->fd.fd, USTREAM_BUF_GROUP,
+				    USTREAM_FD_READ_LEN);
+
+	/* the submission queue is full, retry once it is flushed */
+	if (ret < 0)
+		uloop_timeout_set(&u->kick, 1);
+}
+
+static void ustream_fd_uring_write(struct ustream_fd_uring *u)
+{
+	struct ustream *s = &u->sf->stream;
+	int n;
+
+	if (u->wr.pending)
+		return;
+
+	n = ustream_get_write_iov(s, u->iov, USTREAM_FD_MAX_IOV);
+	if (!n)
+		return;
+
+	if (uloop_io_writev(&u->wr, u->sf->fd.fd, u->iov, n) < 0) {
+		s->w.busy = false;
+		uloop_timeout_set(&u->kick, 1);
+	}
+}
+
+/* passes the stashed read data to the stream as far as it takes it */
+static void ustream_fd_uring_deliver(struct ustream_fd_uring *u)
+{
+	struct ustream *s = &u->sf->stream;
+	struct ustream_buf *buf = u->stash;
+
+	if (!buf || s->read_blocked)
+		return;
+
+	u->stash = NULL;
+	if (ustream_fill_read_buf(s, buf))
+		return;
+
+	if (buf->data < buf->tail)
+		u->stash = buf;
+	else
+		ustream_lend_read_buf(buf, 0);
+}
+
+static void ustream_fd_uring_read_cb(struct uloop_io *io, int res, int buf_id)
+{
+	struct ustream_fd_uring *u = container_of(io, struct ustream_fd_uring, rd);
+	struct ustream_buf *buf = ustream_take_read_buf(buf_id);
+	struct ustream *s;
+
+	if (!u->sf) {
+		if (buf)
+			ustream_lend_read_buf(buf, 0);
+		ustream_fd_uring_put(u);
+		return;
+	}
+
+	s = &u->sf->stream;
+	if (res <= 0 && buf) {
+		ustream_lend_read_buf(buf, 0);
+		buf = NULL;
+	}
+
+	switch (res) {
+	case -ENOBUFS:
+		if (read_bufs < USTREAM_FD_READ_BUFS_MAX)
+			read_bufs *= 2;
+		/* fall through */
+	case -EINTR:
+	case -EAGAIN:
+	case -ECANCELED:
+		break;
+	default:
+		if (res > 0 && buf) {
+			buf->tail = buf->data + res;
+			u->stash = buf;
+			ustream_fd_uring_deliver(u);
+			break;
+		}
+
+		if (!s->eof)
+			ustream_state_change(s);
+		s->eof = true;
+		return;
+	}
+
+	ustream_fd_uring_read(u);
+}
+
+static void ustream_fd_uring_write_cb(struct uloop_io *io, int res, int buf_id)
+{
+	struct ustream_fd_uring *u = container_of(io, struct ustream_fd_uring, wr);
+
+	if (!u->sf) {
+		ustream_fd_uring_put(u);
+		return;
+	}
+
+	if (res == -EINTR || res == -EAGAIN)
+		res = 0;
+
+	ustream_write_done(&u->sf->stream, res);
+	if (res >= 0)
+		ustream_fd_uring_write(u);
+}
+
+static void ustream_fd_uring_kick_cb(struct uloop_timeout *t)
+{
+	struct ustream_fd_uring *u = container_of(t, struct ustream_fd_uring, kick);
+
+	ustream_fd_uring_write(u);
+	ustream_fd_uring_read(u);
+}
+
+static struct ustream_fd_uring *ustream_fd_uring_new(struct ustream_fd *sf)
+{
+	struct ustream_fd_uring *u;
+	struct stat st;
+
+	if (!uloop_io_supported())
+		return NULL;
+
+	u = calloc(1, sizeof(*u));
+	if (!u)
+		return NULL;
+
+	/* as uloop_fd_add would, for the direct writes */
+	fcntl(sf->fd.fd, F_SETFL, fcntl(sf->fd.fd, F_GETFL) | O_NONBLOCK);
+
+	u->sf = sf;
+	u->sock = !fstat(sf->fd.fd, &st) && S_ISSOCK(st.st_mode);
+	u->rd.cb = ustream_fd_uring_read_cb;
+	u->wr.cb = ustream_fd_uring_write_cb;
+	u->kick.cb = ustream_fd_uring_kick_cb;
+
+	return u;
+}
+
+static void ustream_fd_uring_free(struct ustream_fd_uring *u)
+{
+	struct ustream *s = &u->sf->stream;
+
+	uloop_timeout_cancel(&u->kick);
+	if (u->stash)
+		ustream_lend_read_buf(u->stash, 0);
+	u->stash = NULL;
+
+	/* the kernel may still be reading the data of a pending write */
+	if (u->wr.pending) {
+		u->w = s->w;
+		u->w.busy = false;
+		memset(&s->w, 0, sizeof(s->w));
+		s->w.alloc = u->w.alloc;
+	}
+
+	u->sf = NULL;
+	uloop_io_cancel(&u->rd);
+	uloop_io_cancel(&u->wr);
+	ustream_fd_uring_put(u);
+}
+
 static void ustream_fd_set_uloop(struct ustream *s, bool write)
 {
 	struct ustream_fd *sf = container_of(s, struct ustream_fd, stream);
@@ -39,9 +265,26 @@ static void ustream_fd_set_uloop(struct ustream *s, bool write)
 
 static void ustream_fd_set_read_blocked(struct ustream *s)
 {
+	struct ustream_fd *sf = container_of(s, struct ustream_fd, stream);
+
+	if (sf->uring) {
+		ustream_fd_uring_deliver(sf->uring);
+		ustream_fd_uring_read(sf->uring);
+		return;
+	}
+
 	ustream_fd_set_uloop(s, false);
 }
 
+/* the rest of the data is queued, flush it once the fd takes more */
+static void ustream_fd_want_write(struct ustream_fd *sf)
+{
+	if (sf->uring)
+		uloop_timeout_set(&sf->uring->kick, 0);
+	else
+		ustream_fd_set_uloop(&sf->stream, true);
+}
+
 static void ustream_fd_read_pending(struct ustream_fd *sf, bool *more)
 {
 	struct ustream *s = &sf->stream;
@@ -86,7 +329,7 @@ static int ustream_fd_write(struct ustream *s, const char *buf, int buflen, bool
 	struct ustream_fd *sf = container_of(s, struct ustream_fd, stream);
 	ssize_t ret = 0, len;
 
-	if (!buflen)
+	if (!buflen || (sf->uring && sf->uring->wr.pending))
 		return 0;
 
 	while (buflen) {
@@ -108,11 +351,41 @@ static int ustream_fd_write(struct ustream *s, const char *buf, int buflen, bool
 	}
 
 	if (buflen)
-		ustream_fd_set_uloop(s, true);
+		ustream_fd_want_write(sf);
 
 	return ret;
 }
 
+static int ustream_fd_writev(struct ustream *s, const struct iovec *iov, int iovcnt)
+{
+	struct ustream_fd *sf = container_of(s, struct ustream_fd, stream);
+	ssize_t len;
+	size_t total = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		total += iov[i].iov_len;
+
+	if (!total || (sf->uring && sf->uring->wr.pending))
+		return 0;
+
+	do {
+		len = writev(sf->fd.fd, iov, iovcnt);
+	} while (len < 0 && errno == EINTR);
+
+	if (len < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOTCONN)
+			return -1;
+
+		len = 0;
+	}
+
+	if ((size_t)len < total)
+		ustream_fd_want_write(sf);
+
+	return len;
+}
+
 static bool __ustream_fd_poll(struct ustream_fd *sf, unsigned int events)
 {
 	struct ustream *s = &sf->stream;
@@ -140,6 +413,10 @@ static bool ustream_fd_poll(struct ustream *s)
 {
 	struct ustream_fd *sf = container_of(s, struct ustream_fd, stream);
 
+	/* reading here would race with the pending read */
+	if (sf->uring)
+		return false;
+
 	return __ustream_fd_poll(sf, ULOOP_READ | ULOOP_WRITE);
 }
 
@@ -154,6 +431,11 @@ static void ustream_fd_free(struct ustream *s)
 {
 	struct ustream_fd *sf = container_of(s, struct ustream_fd, stream);
 
+	if (sf->uring) {
+		ustream_fd_uring_free(sf->uring);
+		sf->uring = NULL;
+	}
+
 	uloop_fd_delete(&sf->fd);
 }
 
@@ -167,7 +449,13 @@ void ustream_fd_init(struct ustream_fd *sf, int fd)
 	sf->fd.cb = ustream_uloop_cb;
 	s->set_read_blocked = ustream_fd_set_read_blocked;
 	s->write = ustream_fd_write;
+	s->writev = ustream_fd_writev;
 	s->free = ustream_fd_free;
 	s->poll = ustream_fd_poll;
-	ustream_fd_set_uloop(s, false);
+
+	sf->uring = ustream_fd_uring_new(sf);
+	if (sf->uring)
+		ustream_fd_uring_read(sf->uring);
+	else
+		ustream_fd_set_uloop(s, false);
 }
@@ -24,6 +24,234 @@
 
 #include "ustream.h"
 
+/*
+ * Buffers of ustream_alloc_default and the headers of queued references
+ * are kept on free lists when they are released, one list per
+ * buffer size, so that a stream in steady state does not allocate.
+ * Each thread has its own lists, as it has its own uloop context.
+ */
+#define USTREAM_POOL_SIZES	4
+#define USTREAM_POOL_MAX	32
+
+static int ustream_alloc_default(struct ustream *s, struct ustream_buf_list *l);
+
+struct ustream_pool {
+	int len;
+	int count;
+	struct ustream_buf *free;
+};
+
+static __thread struct ustream_pool buf_pools[USTREAM_POOL_SIZES];
+static __thread struct ustream_pool ref_pool;
+
+/*
+ * Read buffers lent to the loop for uloop_io_read, by buffer id, and the
+ * ids that are free. They are shared by the streams of a thread, as its
+ * loop is.
+ */
+#define USTREAM_LENT_MAX	65536
+
+static __thread struct ustream_buf **lent_bufs;
+static __thread uint16_t *lent_free_ids;
+static __thread int lent_size, lent_nr_free, lent_count;
+static __thread unsigned int lent_ring;
+
+static struct ustream_pool *ustream_find_pool(int len, bool claim)
+{
+	int i;
+
+	for (i = 0; i < USTREAM_POOL_SIZES; i++) {
+		if (buf_pools[i].len == len)
+			return &buf_pools[i];
+	}
+
+	if (!claim)
+		return NULL;
+
+	for (i = 0; i < USTREAM_POOL_SIZES; i++) {
+		if (!buf_pools[i].len) {
+			buf_pools[i].len = len;
+			return &buf_pools[i];
+		}
+	}
+
+	return NULL;
+}
+
+static struct ustream_buf *ustream_pool_get(struct ustream_pool *pool, int len)
+{
+	struct ustream_buf *buf;
+
+	if (pool && pool->free) {
+		buf = pool->free;
+		pool->free = buf->next;
+		pool->count--;
+		return buf;
+	}
+
+	/* one more byte for string_data streams */
+	return malloc(sizeof(*buf) + len + 1);
+}
+
+static void ustream_pool_put(struct ustream_pool *pool, struct ustream_buf *buf)
+{
+	if (!pool || pool->count >= USTREAM_POOL_MAX) {
+		free(buf);
+		return;
+	}
+
+	buf->next = pool->free;
+	pool->free = buf;
+	pool->count++;
+}
+
+static void ustream_init_buf(struct ustream_buf *buf, int len);
+
+static int ustream_grow_lent(void)
+{
+	struct ustream_buf **bufs;
+	uint16_t *ids;
+	int i, size;
+
+	if (lent_size >= USTREAM_LENT_MAX)
+		return -1;
+
+	size = lent_size ? lent_size * 2 : 16;
+	bufs = realloc(lent_bufs, size * sizeof(*bufs));
+	if (!bufs)
+		return -1;
+
+	lent_bufs = bufs;
+	ids = realloc(lent_free_ids, size * sizeof(*ids));
+	if (!ids)
+		return -1;
+
+	lent_free_ids = ids;
+	/* the lowest ids go first */
+	for (i = size - 1; i >= lent_size; i--) {
+		lent_bufs[i] = NULL;
+		lent_free_ids[lent_nr_free++] = i;
+	}
+	lent_size = size;
+
+	return 0;
+}
+
+/* the buffers lent to a loop that has been torn down are free again */
+static void ustream_check_lent(void)
+{
+	unsigned int ring = uloop_io_ring_id();
+	struct ustream_buf *buf;
+	int i;
+
+	if (ring == lent_ring)
+		return;
+
+	lent_ring = ring;
+	lent_nr_free = 0;
+	for (i = lent_size - 1; i >= 0; i--) {
+		buf = lent_bufs[i];
+		if (buf)
+			ustream_pool_put(ustream_find_pool(buf->end - buf->head, true), buf);
+		lent_bufs[i] = NULL;
+		lent_free_ids[lent_nr_free++] = i;
+	}
+	lent_count = 0;
+}
+
+int ustream_lend_read_buf(struct ustream_buf *buf, int len)
+{
+	int id;
+
+	ustream_check_lent();
+
+	if (buf)
+		len = buf->end - buf->head;
+	else
+		buf = ustream_pool_get(ustream_find_pool(len, false), len);
+	if (!buf)
+		return -1;
+
+	ustream_init_buf(buf, len);
+	if (!lent_nr_free && ustream_grow_lent() < 0)
+		goto error;
+
+	id = lent_free_ids[--lent_nr_free];
+	if (uloop_io_provide_buffer(USTREAM_BUF_GROUP, buf->head, len, id) < 0) {
+		lent_nr_free++;
+		goto error;
+	}
+
+	lent_bufs[id] = buf;
+	lent_count++;
+
+	return 0;
+
+error:
+	ustream_pool_put(ustream_find_pool(len, true), buf);
+	return -1;
+}
+
+struct ustream_buf *ustream_take_read_buf(int buf_id)
+{
+	struct ustream_buf *buf;
+
+	if (buf_id < 0 || buf_id >= lent_size || !lent_bufs[buf_id])
+		return NULL;
+
+	buf = lent_bufs[buf_id];
+	lent_bufs[buf_id] = NULL;
+	lent_free_ids[lent_nr_free++] = buf_id;
+	lent_count--;
+
+	return buf;
+}
+
+int ustream_lent_read_bufs(void)
+{
+	ustream_check_lent();
+	return lent_count;
+}
+
+void ustream_pool_flush(void)
+{
+	struct ustream_buf *buf;
+	int i;
+
+	if (lent_count && lent_ring == uloop_io_ring_id())
+		uloop_io_remove_buffers(USTREAM_BUF_GROUP, lent_count);
+
+	for (i = 0; i < lent_size; i++)
+		free(lent_bufs[i]);
+	free(lent_bufs);
+	free(lent_free_ids);
+	lent_bufs = NULL;
+	lent_free_ids = NULL;
+	lent_size = lent_nr_free = lent_count = 0;
+
+	for (i = 0; i <= USTREAM_POOL_SIZES; i++) {
+		struct ustream_pool *pool = i < USTREAM_POOL_SIZES ? &buf_pools[i] : &ref_pool;
+
+		while ((buf = pool->free) != NULL) {
+			pool->free = buf->next;
+			free(buf);
+		}
+		pool->count = 0;
+	}
+}
+
+static void ustream_release_buf(struct ustream_buf_list *l, struct ustream_buf *buf)
+{
+	if (buf->ref) {
+		ustream_ref_put(buf->ref);
+		ustream_pool_put(&ref_pool, buf);
+	} else if (l->alloc == ustream_alloc_default) {
+		ustream_pool_put(ustream_find_pool(buf->end - buf->head, true), buf);
+	} else {
+		free(buf);
+	}
+}
+
 static void ustream_init_buf(struct ustream_buf *buf, int len)
 {
 	if (!len)
@@ -64,7 +292,8 @@ static int ustream_alloc_default(struct ustream *s, struct ustream_buf_list *l)
 	if (!ustream_can_alloc(l))
 		return -1;
 
-	buf = malloc(sizeof(*buf) + l->buffer_len + s->string_data);
+	buf = ustream_pool_get(ustream_find_pool(l->buffer_len, false),
+			       l->buffer_len);
 	if (!buf)
 		return -1;
 
@@ -74,14 +303,14 @@ static int ustream_alloc_default(struct ustream *s, struct ustream_buf_list *l)
 	return 0;
 }
 
-static void ustream_free_buffers(struct ustream_buf_list *l)
+void ustream_free_buffers(struct ustream_buf_list *l)
 {
 	struct ustream_buf *buf = l->head;
 
 	while (buf) {
 		struct ustream_buf *next = buf->next;
 
-		free(buf);
+		ustream_release_buf(l, buf);
 		buf = next;
 	}
 	l->head = NULL;
@@ -148,8 +377,8 @@ static bool ustream_should_move(struct ustream_buf_list *l, struct ustream_buf *
 	int maxlen;
 	int offset;
 
-	/* nothing to squeeze */
-	if (buf->data == buf->head)
+	/* nothing to squeeze, or the data is being written */
+	if (buf->data == buf->head || buf->ref || l->busy)
 		return false;
 
 	maxlen = buf->end - buf->head;
@@ -182,8 +411,8 @@ static void ustream_free_buf(struct ustream_buf_list *l, struct ustream_buf *buf
 	if (buf == l->tail)
 		l->tail = NULL;
 
-	if (--l->buffers >= l->min_buffers) {
-		free(buf);
+	if (--l->buffers >= l->min_buffers || buf->ref) {
+		ustream_release_buf(l, buf);
 		return;
 	}
 
@@ -280,6 +509,7 @@ static bool ustream_prepare_buf(struct ustream *s, struct ustream_buf_list *l, i
 		return false;
 
 	l->data_tail = l->tail;
+	l->data_tail->ref = NULL;
 	return true;
 }
 
@@ -369,14 +599,155 @@ static void ustream_write_error(struct ustream *s)
 	s->write_error = true;
 }
 
-bool ustream_write_pending(struct ustream *s)
+#define USTREAM_MAX_IOV	16
+
+static int ustream_fill_write_iov(struct ustream *s, struct iovec *iov, int iovcnt, int *total)
+{
+	struct ustream_buf *buf;
+	int n = 0;
+
+	*total = 0;
+	for (buf = s->w.head; buf && n < iovcnt; buf = buf->next) {
+		if (buf->tail == buf->data)
+			break;
+
+		iov[n].iov_base = buf->data;
+		iov[n].iov_len = buf->tail - buf->data;
+		*total += iov[n++].iov_len;
+	}
+
+	return n;
+}
+
+/* drops len written bytes from the head of the write buffers */
+static void ustream_consume_write(struct ustream *s, int len)
+{
+	struct ustream_buf *buf;
+
+	s->w.data_bytes -= len;
+	while (len) {
+		int maxlen;
+
+		buf = s->w.head;
+		maxlen = buf->tail - buf->data;
+		if (len < maxlen) {
+			buf->data += len;
+			break;
+		}
+
+		len -= maxlen;
+		ustream_free_buf(&s->w, buf);
+	}
+}
+
+/* writes the queued buffers with s->writev, returns the bytes written */
+static int ustream_writev_pending(struct ustream *s)
+{
+	struct iovec iov[USTREAM_MAX_IOV];
+	int wr = 0, len, total, n;
+
+	while (s->w.data_bytes) {
+		n = ustream_fill_write_iov(s, iov, USTREAM_MAX_IOV, &total);
+		if (!n)
+			break;
+
+		len = s->writev(s, iov, n);
+		if (len < 0) {
+			ustream_write_error(s);
+			break;
+		}
+
+		if (len == 0)
+			break;
+
+		wr += len;
+		ustream_consume_write(s, len);
+		if (wr < total)
+			break;
+	}
+
+	return wr;
+}
+
+int ustream_get_write_iov(struct ustream *s, struct iovec *iov, int iovcnt)
+{
+	int total, n;
+
+	if (s->w.busy || s->write_error)
+		return 0;
+
+	n = ustream_fill_write_iov(s, iov, iovcnt, &total);
+	if (n)
+		s->w.busy = true;
+
+	return n;
+}
+
+void ustream_write_done(struct ustream *s, int len)
+{
+	s->w.busy = false;
+	if (len < 0) {
+		ustream_write_error(s);
+		return;
+	}
+
+	ustream_consume_write(s, len);
+	if (s->notify_write)
+		s->notify_write(s, len);
+
+	if (s->eof && len && !s->w.data_bytes)
+		ustream_state_change(s);
+}
+
+bool ustream_fill_read_buf(struct ustream *s, struct ustream_buf *buf)
+{
+	struct ustream_buf_list *l = &s->r;
+	int len = buf->tail - buf->data;
+	int maxlen;
+	char *data;
+
+	/* nothing to append to, take the buffer over */
+	if (!l->data_bytes && l->alloc == ustream_alloc_default) {
+		struct ustream_buf *cur;
+
+		while ((cur = l->head) != NULL) {
+			l->head = cur->next;
+			ustream_release_buf(l, cur);
+		}
+		l->data_tail = l->tail = NULL;
+		l->buffers = 0;
+
+		ustream_add_buf(l, buf);
+		l->data_tail = buf;
+		l->data_bytes = len;
+		ustream_fixup_string(s, buf);
+		if (s->notify_read)
+			s->notify_read(s, len);
+
+		return true;
+	}
+
+	while (buf->data < buf->tail) {
+		data = ustream_reserve(s, buf->tail - buf->data, &maxlen);
+		if (!data)
+			break;
+
+		if (maxlen > buf->tail - buf->data)
+			maxlen = buf->tail - buf->data;
+		memcpy(data, buf->data, maxlen);
+		buf->data += maxlen;
+		ustream_fill_read(s, maxlen);
+	}
+
+	return false;
+}
+
+/* writes the queued buffers one by one, returns the bytes written */
+static int ustream_write_bufs_pending(struct ustream *s)
 {
 	struct ustream_buf *buf = s->w.head;
 	int wr = 0, len;
 
-	if (s->write_error)
-		return false;
-
 	while (buf && s->w.data_bytes) {
 		struct ustream_buf *next = buf->next;
 		int maxlen = buf->tail - buf->data;
@@ -401,6 +772,21 @@ bool ustream_write_pending(struct ustream *s)
 		buf = next;
 	}
 
+	return wr;
+}
+
+bool ustream_write_pending(struct ustream *s)
+{
+	int wr;
+
+	if (s->write_error)
+		return false;
+
+	if (s->writev)
+		wr = ustream_writev_pending(s);
+	else
+		wr = ustream_write_bufs_pending(s);
+
 	if (s->notify_write)
 		s->notify_write(s, wr);
 
@@ -462,6 +848,135 @@ int ustream_write(struct ustream *s, const char *data, int len, bool more)
 	return ustream_write_buffered(s, data, len, wr);
 }
 
+int ustream_writev(struct ustream *s, const struct iovec *iov, int iovcnt, bool more)
+{
+	struct ustream_buf_list *l = &s->w;
+	int i, wr = 0, skip = 0;
+
+	if (s->write_error)
+		return 0;
+
+	if (!s->writev) {
+		for (i = 0; i < iovcnt; i++) {
+			int len = ustream_write(s, iov[i].iov_base, iov[i].iov_len,
+						more || i < iovcnt - 1);
+			if (len < 0)
+				return len;
+
+			wr += len;
+			if (len < (int)iov[i].iov_len)
+				break;
+		}
+
+		return wr;
+	}
+
+	if (!l->data_bytes) {
+		skip = s->writev(s, iov, iovcnt);
+		if (skip < 0) {
+			ustream_write_error(s);
+			return skip;
+		}
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		int len = iov[i].iov_len;
+
+		if (skip >= len) {
+			skip -= len;
+			wr += len;
+			continue;
+		}
+
+		/* counts the bytes already written by s->writev too */
+		len = ustream_write_buffered(s, (char *)iov[i].iov_base + skip,
+					     len - skip, skip);
+		wr += len;
+		if (len < (int)iov[i].iov_len)
+			break;
+		skip = 0;
+	}
+
+	return wr;
+}
+
+/*
+ * queues buf behind the data already queued; the empty buffers which
+ * are kept at the end of the list stay behind it
+ */
+static void ustream_queue_buf(struct ustream_buf_list *l, struct ustream_buf *buf)
+{
+	struct ustream_buf *prev = l->data_tail;
+
+	if (prev && prev->tail == prev->data) {
+		struct ustream_buf *p = l->head;
+
+		if (p == prev) {
+			prev = NULL;
+		} else {
+			while (p->next != prev)
+				p = p->next;
+			prev = p;
+		}
+	}
+
+	if (prev) {
+		buf->next = prev->next;
+		prev->next = buf;
+	} else {
+		buf->next = l->head;
+		l->head = buf;
+	}
+
+	if (!buf->next)
+		l->tail = buf;
+
+	l->data_tail = buf->next ? buf->next : buf;
+	l->buffers++;
+}
+
+int ustream_write_ref(struct ustream *s, struct ustream_ref *ref,
+		      const char *data, int len)
+{
+	struct ustream_buf_list *l = &s->w;
+	struct ustream_buf *buf;
+	int wr = 0;
+
+	if (s->write_error)
+		return 0;
+
+	if (!l->data_bytes) {
+		wr = s->write(s, data, len, false);
+		if (wr == len)
+			return wr;
+
+		if (wr < 0) {
+			ustream_write_error(s);
+			return wr;
+		}
+
+		data += wr;
+		len -= wr;
+	}
+
+	if (!ustream_can_alloc(l))
+		return ustream_write_buffered(s, data, len, wr);
+
+	buf = ustream_pool_get(&ref_pool, 0);
+	if (!buf)
+		return ustream_write_buffered(s, data, len, wr);
+
+	buf->data = (char *)data;
+	buf->tail = buf->end = (char *)data + len;
+	buf->ref = ref;
+	ustream_ref_get(ref);
+
+	ustream_queue_buf(l, buf);
+	l->data_bytes += len;
+
+	return wr + len;
+}
+
 #define MAX_STACK_BUFLEN	256
 
 int ustream_vprintf(struct ustream *s, const char *format, va_list arg)
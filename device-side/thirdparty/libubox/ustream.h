@@ -20,11 +20,33 @@
 #define __USTREAM_H
 
 #include <stdarg.h>
+#include <sys/uio.h>
 #include "uloop.h"
 
 struct ustream;
 struct ustream_buf;
 
+/*
+ * ustream_ref: caller-owned data queued by ustream_write_ref without
+ * copying. The stream holds a reference until the data is written;
+ * release is called when the last reference is dropped.
+ */
+struct ustream_ref {
+	int refcount;
+	void (*release)(struct ustream_ref *ref);
+};
+
+static inline void ustream_ref_get(struct ustream_ref *ref)
+{
+	ref->refcount++;
+}
+
+static inline void ustream_ref_put(struct ustream_ref *ref)
+{
+	if (!--ref->refcount && ref->release)
+		ref->release(ref);
+}
+
 enum read_blocked_reason {
 	READ_BLOCKED_USER = (1 << 0),
 	READ_BLOCKED_FULL = (1 << 1),
@@ -44,6 +66,9 @@ struct ustream_buf_list {
 	int buffer_len;
 
 	int buffers;
+
+	/* the queued data is being written asynchronously */
+	bool busy;
 };
 
 struct ustream {
@@ -117,11 +142,25 @@ struct ustream {
 	bool eof, eof_write_done;
 
 	enum read_blocked_reason read_blocked;
+
+	/*
+	 * writev: (optional)
+	 * defined by ustream implementation, like write but takes the data
+	 * of several buffers at once, so that the queued buffers can be
+	 * flushed with a single syscall.
+	 * kept last, so that the layout of the older members does not change
+	 */
+	int (*writev)(struct ustream *s, const struct iovec *iov, int iovcnt);
 };
 
+struct ustream_fd_uring;
+
 struct ustream_fd {
 	struct ustream stream;
 	struct uloop_fd fd;
+
+	/* set when the loop reads and writes the fd through io_uring */
+	struct ustream_fd_uring *uring;
 };
 
 struct ustream_buf {
@@ -131,6 +170,9 @@ struct ustream_buf {
 	char *tail;
 	char *end;
 
+	/* set if data points to caller-owned data, see ustream_write_ref */
+	struct ustream_ref *ref;
+
 	char head[];
 };
 
@@ -150,9 +192,28 @@ void ustream_consume(struct ustream *s, int len);
 int ustream_read(struct ustream *s, char *buf, int buflen);
 /* ustream_write: add data to the write buffer */
 int ustream_write(struct ustream *s, const char *buf, int len, bool more);
+/* ustream_writev: add the data of several buffers to the write buffer */
+int ustream_writev(struct ustream *s, const struct iovec *iov, int iovcnt, bool more);
+/*
+ * ustream_write_ref: queue caller-owned data without copying it
+ *
+ * takes a reference on ref for as long as the data is queued; the data
+ * must not change until the reference is dropped.
+ */
+int ustream_write_ref(struct ustream *s, struct ustream_ref *ref,
+		      const char *buf, int len);
 int ustream_printf(struct ustream *s, const char *format, ...);
 int ustream_vprintf(struct ustream *s, const char *format, va_list arg);
 
+/*
+ * ustream_pool_flush: free the buffers cached for reuse by this thread
+ *
+ * this includes the read buffers lent to the loop, so it must not run while
+ * reads started with uloop_io_read are pending. a thread that runs its own
+ * uloop context should call this before it exits.
+ */
+void ustream_pool_flush(void);
+
 /* ustream_get_read_buf: get a pointer to the next read buffer data */
 char *ustream_get_read_buf(struct ustream *s, int *buflen);
 
@@ -203,6 +264,43 @@ void ustream_fill_read(struct ustream *s, int len);
  */
 bool ustream_write_pending(struct ustream *s);
 
+/* ustream_free_buffers: release the buffers of a list */
+void ustream_free_buffers(struct ustream_buf_list *l);
+
+/*
+ * ustream_get_write_iov: fill iov with the queued write data for an
+ * asynchronous write, returns the number of entries used.
+ * the buffers stay in place until ustream_write_done is called, no other
+ * write may be started before that.
+ */
+int ustream_get_write_iov(struct ustream *s, struct iovec *iov, int iovcnt);
+
+/*
+ * ustream_write_done: complete an asynchronous write started with
+ * ustream_get_write_iov, len is the number of bytes written or a
+ * negative error.
+ */
+void ustream_write_done(struct ustream *s, int len);
+
+/*
+ * ustream_fill_read_buf: pass the data between buf->data and buf->tail to
+ * the stream. returns true if the stream took the buffer itself, otherwise
+ * copies as much as fits and advances buf->data past it.
+ */
+bool ustream_fill_read_buf(struct ustream *s, struct ustream_buf *buf);
+
+/*
+ * read buffers lent to the loop for uloop_io_read in group USTREAM_BUF_GROUP,
+ * shared by the streams of the thread. ustream_lend_read_buf takes buf or,
+ * if NULL, allocates one of len bytes; ustream_take_read_buf returns the
+ * buffer the loop picked for a completed read.
+ */
+#define USTREAM_BUF_GROUP	1
+
+int ustream_lend_read_buf(struct ustream_buf *buf, int len);
+struct ustream_buf *ustream_take_read_buf(int buf_id);
+int ustream_lent_read_bufs(void);
+
 static inline void ustream_state_change(struct ustream *s)
 {
 	uloop_timeout_set(&s->state_change, 0);